@@ -1,28 +1,51 @@
 #include "Appointment.h"
 #include "Doctor.h"
 #include "Patient.h"
+#include "Utils.h"
 #include <string>
 
 using namespace std;
 
 Appointment::Appointment() 
-    : date(""), time(""), doctor(nullptr), patient(nullptr), isEmergency(false), isMissed(false) {}
+    : id(0), doctor(nullptr), patient(nullptr), packedDate(0), minutes(0), flags(0) {}
 
 Appointment::Appointment(const string& date, const string& time, Doctor* doc, Patient* pat, bool isEmergency)
-    : date(date), time(time), doctor(doc), patient(pat), isEmergency(isEmergency), isMissed(false) {}
+    : id(0), doctor(doc), patient(pat), packedDate(Utils::packDate(date)), minutes(Utils::packTime(time)),
+      flags(isEmergency ? EMERGENCY : 0) {}
+
+string Appointment::getDate() const {
+    return Utils::unpackDate(packedDate);
+}
+
+string Appointment::getTime() const {
+    return Utils::unpackTime(minutes);
+}
 
 string Appointment::getAppointmentTime() const {
-    return date + " " + time;
+    return getDate() + " " + getTime();
 }
 
 void Appointment::markMissed() {
-    isMissed = true;
+    flags |= MISSED;
+    if (doctor) {
+        doctor->dirty = true;
+        doctor->scheduleInSnapshot = false;
+    }
+}
+
+void Appointment::reschedule(const string& date, const string& time) {
+    packedDate = Utils::packDate(date);
+    minutes = Utils::packTime(time);
+    flags &= ~MISSED;
+    if (doctor) {
+        doctor->dirty = true;
+        doctor->scheduleInSnapshot = false;
+    }
 }
 
 bool Appointment::equals(const Appointment& other) const {
-    return date == other.date && 
-           time == other.time && 
+    return packedDate == other.packedDate && 
+           minutes == other.minutes && 
            doctor == other.doctor && 
            patient == other.patient;
 }
-
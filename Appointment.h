@@ -1,27 +1,40 @@
 #ifndef APPOINTMENT_H
 #define APPOINTMENT_H
 
+#include <cstdint>
 #include <string>
 
 class Doctor;
 class Patient;
 
+// Compact appointment record: date and time are packed integers (see
+// Utils::packDate / Utils::packTime) and status lives in a flag byte.
 class Appointment {
 public:
-    std::string date;
-    std::string time;
+    enum Flags : uint8_t {
+        MISSED = 1 << 0,
+        EMERGENCY = 1 << 1
+    };
+
+    uint32_t id;        // assigned by AppointmentRegistry, 0 until stored
     Doctor* doctor;
     Patient* patient;
-    bool isMissed = false;
-    bool isEmergency = false;
+    uint32_t packedDate;
+    uint16_t minutes;
+    uint8_t flags;
 
     Appointment();
     Appointment(const std::string& date, const std::string& time, Doctor* doctor, Patient* patient, bool emergency = false);
 
+    std::string getDate() const;
+    std::string getTime() const;
     std::string getAppointmentTime() const;
+    bool isMissed() const { return (flags & MISSED) != 0; }
+    bool isEmergency() const { return (flags & EMERGENCY) != 0; }
+
     void markMissed();
+    void reschedule(const std::string& date, const std::string& time);
     bool equals(const Appointment& other) const;
 };
 
 #endif
-
@@ -0,0 +1,467 @@
+#include "AppointmentArchive.h"
+#include "AppointmentRegistry.h"
+#include "CancelAppointmentManager.h"
+#include "DoctorManager.h"
+#include "Journal.h"
+#include "ScheduleStore.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace {
+    const char MAGIC[8] = {'A', 'M', 'S', 'A', 'R', 'C', 'H', '1'};
+    const string SEGMENT_PREFIX = "archive_";
+    const string SEGMENT_SUFFIX = ".seg";
+    const size_t COLUMNS = 6;
+    const size_t HEADER_BYTES = sizeof(MAGIC) + 4 * (7 + COLUMNS);
+
+    void putU32(string& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>((value >> shift) & 0xFF);
+    }
+
+    uint32_t getU32(const char* p) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(p);
+        return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    }
+
+    void putVarint(string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    // Column reader over one encoded column; a read past its end or a
+    // malformed varint marks it failed
+    struct ColumnReader {
+        const unsigned char* p;
+        const unsigned char* end;
+        bool ok = true;
+
+        ColumnReader(const char* data, size_t size)
+            : p(reinterpret_cast<const unsigned char*>(data)), end(p + size) {}
+
+        uint32_t varint() {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7) {
+                if (p == end) break;
+                unsigned char byte = *p++;
+                value |= uint32_t(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            ok = false;
+            return 0;
+        }
+    };
+
+    uint32_t zigzag(int64_t delta) {
+        return static_cast<uint32_t>(delta < 0 ? (uint64_t(-delta) << 1) - 1 : uint64_t(delta) << 1);
+    }
+
+    int64_t unzigzag(uint32_t value) {
+        return (value & 1) ? -int64_t(value >> 1) - 1 : int64_t(value >> 1);
+    }
+
+    // (value, run length) pairs
+    template <typename Value>
+    string encodeRuns(const vector<Value>& values) {
+        string out;
+        for (size_t i = 0; i < values.size();) {
+            size_t run = 1;
+            while (i + run < values.size() && values[i + run] == values[i]) ++run;
+            putVarint(out, values[i]);
+            putVarint(out, static_cast<uint32_t>(run));
+            i += run;
+        }
+        return out;
+    }
+
+    template <typename Value>
+    bool decodeRuns(ColumnReader reader, size_t rows, vector<Value>& values) {
+        values.clear();
+        values.reserve(rows);
+        while (values.size() < rows && reader.ok) {
+            Value value = static_cast<Value>(reader.varint());
+            uint32_t run = reader.varint();
+            if (run == 0 || run > rows - values.size()) return false;
+            values.insert(values.end(), run, value);
+        }
+        return reader.ok && values.size() == rows;
+    }
+
+    bool rowBefore(const AppointmentArchive::Row& a, const AppointmentArchive::Row& b) {
+        if (a.packedDate != b.packedDate) return a.packedDate < b.packedDate;
+        if (a.minutes != b.minutes) return a.minutes < b.minutes;
+        return a.id < b.id;
+    }
+}
+
+string AppointmentArchive::Row::getDate() const {
+    return Utils::unpackDate(packedDate);
+}
+
+string AppointmentArchive::Row::getTime() const {
+    return Utils::unpackTime(minutes);
+}
+
+AppointmentArchive::Row AppointmentArchive::Segment::row(size_t i) const {
+    Row row;
+    row.id = ids[i];
+    row.doctorID = doctors[doctorIndex[i]];
+    if (patientIndex[i] > 0) row.patientID = patients[patientIndex[i] - 1];
+    row.packedDate = dates[i];
+    row.minutes = minutes[i];
+    row.flags = flags[i];
+    return row;
+}
+
+AppointmentArchive& AppointmentArchive::instance() {
+    static AppointmentArchive archive;
+    return archive;
+}
+
+bool AppointmentArchive::isSegmentFile(const string& name) {
+    return name.size() > SEGMENT_PREFIX.size() + SEGMENT_SUFFIX.size() &&
+           name.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) == 0 &&
+           name.compare(name.size() - SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX.size(), SEGMENT_SUFFIX) == 0;
+}
+
+string AppointmentArchive::segmentName(uint32_t month) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04u-%02u", month >> 4, month & 0x0F);
+    return SEGMENT_PREFIX + buffer + SEGMENT_SUFFIX;
+}
+
+void AppointmentArchive::open() {
+    segments.clear();
+    cache.clear();
+    opened = true;
+
+    error_code ec;
+    Utils::ensureDirectoryExists(Utils::DATA_DIR);
+    for (const auto& entry : filesystem::directory_iterator(Utils::DATA_DIR, ec)) {
+        string name = entry.path().filename().string();
+        if (!isSegmentFile(name)) continue;
+        SegmentInfo info;
+        info.path = entry.path().string();
+        if (!readHeader(info.path, info)) {
+            cerr << "Warning: Skipped damaged archive segment " << info.path << "\n";
+            continue;
+        }
+        segments[monthOf(info.minDate)] = info;
+    }
+    AppointmentRegistry::instance().reserveIds(maxId());
+}
+
+bool AppointmentArchive::readHeader(const string& path, SegmentInfo& info) {
+    ifstream in(path, ios::binary);
+    char header[HEADER_BYTES];
+    if (!in.read(header, sizeof(header)) || memcmp(header, MAGIC, sizeof(MAGIC)) != 0) return false;
+    const char* p = header + sizeof(MAGIC);
+    info.rows = getU32(p);
+    info.minId = getU32(p + 4);
+    info.maxId = getU32(p + 8);
+    info.minDate = getU32(p + 12);
+    info.maxDate = getU32(p + 16);
+    error_code ec;
+    info.bytes = filesystem::file_size(path, ec);
+    return info.rows > 0 && monthOf(info.minDate) == monthOf(info.maxDate);
+}
+
+AppointmentArchive::SegmentPtr AppointmentArchive::load(uint32_t month) {
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+        if (it->first == month) {
+            cache.splice(cache.begin(), cache, it);
+            return it->second;
+        }
+    }
+    auto info = segments.find(month);
+    if (info == segments.end()) return nullptr;
+
+    ifstream in(info->second.path, ios::binary);
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (data.size() < HEADER_BYTES || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        cerr << "Error: Archive segment " << info->second.path << " is damaged\n";
+        return nullptr;
+    }
+
+    const char* header = data.data() + sizeof(MAGIC);
+    size_t rows = getU32(header);
+    uint32_t doctorCount = getU32(header + 20);
+    uint32_t patientCount = getU32(header + 24);
+    size_t columnBytes[COLUMNS];
+    size_t total = HEADER_BYTES;
+    for (size_t c = 0; c < COLUMNS; ++c) {
+        columnBytes[c] = getU32(header + 28 + 4 * c);
+        total += columnBytes[c];
+    }
+
+    auto segment = make_shared<Segment>();
+    ColumnReader dictionary(data.data() + HEADER_BYTES, data.size() - HEADER_BYTES);
+    for (uint32_t i = 0; i < doctorCount + patientCount && dictionary.ok; ++i) {
+        uint32_t length = dictionary.varint();
+        if (length > size_t(dictionary.end - dictionary.p)) dictionary.ok = false;
+        if (!dictionary.ok) break;
+        string id(reinterpret_cast<const char*>(dictionary.p), length);
+        dictionary.p += length;
+        (i < doctorCount ? segment->doctors : segment->patients).push_back(std::move(id));
+    }
+    size_t dictionaryBytes = reinterpret_cast<const char*>(dictionary.p) - (data.data() + HEADER_BYTES);
+    bool ok = dictionary.ok && total + dictionaryBytes == data.size();
+
+    const char* column = data.data() + HEADER_BYTES + dictionaryBytes;
+    auto next = [&](size_t c) {
+        ColumnReader reader(column, columnBytes[c]);
+        column += columnBytes[c];
+        return reader;
+    };
+    if (ok) {
+        ColumnReader ids = next(0);
+        segment->ids.resize(rows);
+        int64_t id = 0;
+        for (uint32_t& value : segment->ids) value = static_cast<uint32_t>(id += unzigzag(ids.varint()));
+        ok = ids.ok;
+
+        vector<uint32_t> days;
+        ok = ok && decodeRuns(next(1), rows, days);
+        segment->dates.resize(rows);
+        for (size_t i = 0; ok && i < rows; ++i) segment->dates[i] = (month << 5) | days[i];
+
+        ColumnReader minutes = next(2);
+        segment->minutes.resize(rows);
+        int64_t minute = 0;
+        for (uint16_t& value : segment->minutes) value = static_cast<uint16_t>(minute += unzigzag(minutes.varint()));
+        ok = ok && minutes.ok;
+
+        ok = ok && decodeRuns(next(3), rows, segment->flags);
+
+        ColumnReader doctors = next(4);
+        segment->doctorIndex.resize(rows);
+        for (uint32_t& value : segment->doctorIndex) {
+            value = doctors.varint();
+            if (value >= doctorCount) doctors.ok = false;
+        }
+        ok = ok && doctors.ok;
+
+        ColumnReader patients = next(5);
+        segment->patientIndex.resize(rows);
+        for (uint32_t& value : segment->patientIndex) {
+            value = patients.varint();
+            if (value > patientCount) patients.ok = false;
+        }
+        ok = ok && patients.ok;
+    }
+    if (!ok) {
+        cerr << "Error: Archive segment " << info->second.path << " is damaged\n";
+        return nullptr;
+    }
+
+    cache.emplace_front(month, segment);
+    if (cache.size() > CACHED_SEGMENTS) cache.pop_back();
+    return segment;
+}
+
+// Rows must all be in month; they are sorted here
+bool AppointmentArchive::write(uint32_t month, vector<Row>& rows) {
+    sort(rows.begin(), rows.end(), rowBefore);
+
+    vector<string> doctors, patients;
+    unordered_map<string, uint32_t> doctorNumbers, patientNumbers;
+    vector<uint32_t> days;
+    vector<uint8_t> flags;
+    string columns[COLUMNS];
+    uint32_t minId = rows.front().id, maxId = rows.front().id;
+    int64_t lastId = 0, lastMinutes = 0;
+    for (const Row& row : rows) {
+        minId = min(minId, row.id);
+        maxId = max(maxId, row.id);
+        putVarint(columns[0], zigzag(int64_t(row.id) - lastId));
+        lastId = row.id;
+        days.push_back(row.packedDate & 0x1F);
+        putVarint(columns[2], zigzag(int64_t(row.minutes) - lastMinutes));
+        lastMinutes = row.minutes;
+        flags.push_back(row.flags);
+
+        auto doctor = doctorNumbers.emplace(row.doctorID, static_cast<uint32_t>(doctors.size()));
+        if (doctor.second) doctors.push_back(row.doctorID);
+        putVarint(columns[4], doctor.first->second);
+
+        uint32_t patientNumber = 0;
+        if (!row.patientID.empty()) {
+            auto patient = patientNumbers.emplace(row.patientID, static_cast<uint32_t>(patients.size()));
+            if (patient.second) patients.push_back(row.patientID);
+            patientNumber = patient.first->second + 1;
+        }
+        putVarint(columns[5], patientNumber);
+    }
+    columns[1] = encodeRuns(days);
+    columns[3] = encodeRuns(flags);
+
+    string header(MAGIC, sizeof(MAGIC));
+    putU32(header, static_cast<uint32_t>(rows.size()));
+    putU32(header, minId);
+    putU32(header, maxId);
+    putU32(header, rows.front().packedDate);
+    putU32(header, rows.back().packedDate);
+    putU32(header, static_cast<uint32_t>(doctors.size()));
+    putU32(header, static_cast<uint32_t>(patients.size()));
+    for (const string& column : columns) putU32(header, static_cast<uint32_t>(column.size()));
+    for (const vector<string>* dictionary : {&doctors, &patients}) {
+        for (const string& id : *dictionary) {
+            putVarint(header, static_cast<uint32_t>(id.size()));
+            header += id;
+        }
+    }
+
+    string path = Utils::getDataPath(segmentName(month));
+    bool saved = Utils::writeFileAtomically(path, [&](ostream& out) {
+        out.write(header.data(), static_cast<streamsize>(header.size()));
+        for (const string& column : columns) out.write(column.data(), static_cast<streamsize>(column.size()));
+    }, true);
+    if (!saved) return false;
+
+    SegmentInfo info;
+    if (!readHeader(path, info)) return false;
+    info.path = path;
+    segments[month] = info;
+    cache.remove_if([month](const pair<uint32_t, SegmentPtr>& entry) { return entry.first == month; });
+    return true;
+}
+
+size_t AppointmentArchive::archiveBefore(uint32_t horizon, DoctorManager& doctorManager, bool quiet) {
+    if (!opened) open();
+    Journal::instance().appointmentsArchived(horizon);
+
+    map<uint32_t, vector<Row>> byMonth;
+    vector<uint32_t> moved;
+    ScheduleStore::instance().loadBefore(horizon);
+    for (Doctor* doctor : doctorManager.getAllDoctors()) {
+        for (const Appointment& appointment : doctor->appointments) {
+            if (appointment.packedDate >= horizon) continue;
+            Row row;
+            row.id = appointment.id;
+            row.doctorID = doctor->getId();
+            if (appointment.patient) row.patientID = appointment.patient->getId();
+            row.packedDate = appointment.packedDate;
+            row.minutes = appointment.minutes;
+            row.flags = appointment.flags;
+            byMonth[monthOf(row.packedDate)].push_back(std::move(row));
+            moved.push_back(appointment.id);
+        }
+    }
+    if (moved.empty()) {
+        if (!quiet) cout << "No appointments before " << Utils::unpackDate(horizon) << " to archive.\n";
+        return 0;
+    }
+
+    // Every segment is written before anything leaves the hot structures,
+    // so a failure part way loses nothing
+    for (auto& [month, rows] : byMonth) {
+        SegmentPtr existing = segments.count(month) ? load(month) : nullptr;
+        if (segments.count(month) && !existing) return 0;
+        if (existing) {
+            unordered_set<uint32_t> archived(existing->ids.begin(), existing->ids.end());
+            rows.erase(remove_if(rows.begin(), rows.end(),
+                                 [&archived](const Row& row) { return archived.count(row.id) > 0; }),
+                       rows.end());
+            if (rows.empty()) continue;  // Archived before, e.g. on an earlier replay
+            for (size_t i = 0; i < existing->ids.size(); ++i) rows.push_back(existing->row(i));
+        }
+        if (!write(month, rows)) {
+            cerr << "Error: Could not write archive segment for " << segmentName(month) << ", nothing archived\n";
+            return 0;
+        }
+    }
+
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    for (uint32_t id : moved) {
+        const AppointmentRegistry::Location* location = registry.locate(id);
+        if (!location) continue;
+        CancelAppointmentManager::freeUpSlot(location->doctor, location->doctor->appointments[location->doctorIndex],
+                                             location->slotIndex);
+        registry.erase(id);
+    }
+    registry.shrinkToFit();
+    for (Doctor* doctor : doctorManager.getAllDoctors()) doctor->appointments.shrink_to_fit();
+    if (!quiet) {
+        cout << "Archived " << moved.size() << " appointment(s) before " << Utils::unpackDate(horizon) << " into "
+             << byMonth.size() << " monthly segment(s).\n";
+    }
+    return moved.size();
+}
+
+bool AppointmentArchive::find(uint32_t id, Row& row) {
+    if (!opened) open();
+    for (const auto& [month, info] : segments) {
+        if (id < info.minId || id > info.maxId) continue;
+        SegmentPtr segment = load(month);
+        if (!segment) continue;
+        auto it = std::find(segment->ids.begin(), segment->ids.end(), id);
+        if (it != segment->ids.end()) {
+            row = segment->row(static_cast<size_t>(it - segment->ids.begin()));
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<AppointmentArchive::Row> AppointmentArchive::query(const Query& query) {
+    if (!opened) open();
+    vector<Row> rows;
+    auto first = query.fromDate ? segments.lower_bound(monthOf(query.fromDate)) : segments.begin();
+    for (auto it = first; it != segments.end(); ++it) {
+        const SegmentInfo& info = it->second;
+        if (query.toDate && info.minDate > query.toDate) break;
+        if (info.maxDate < query.fromDate) continue;
+        SegmentPtr segment = load(it->first);
+        if (!segment) continue;
+
+        // An ID missing from a dictionary rules out the whole segment
+        uint32_t doctor = 0, patient = 0;
+        if (!query.doctorID.empty()) {
+            auto found = std::find(segment->doctors.begin(), segment->doctors.end(), query.doctorID);
+            if (found == segment->doctors.end()) continue;
+            doctor = static_cast<uint32_t>(found - segment->doctors.begin());
+        }
+        if (!query.patientID.empty()) {
+            auto found = std::find(segment->patients.begin(), segment->patients.end(), query.patientID);
+            if (found == segment->patients.end()) continue;
+            patient = static_cast<uint32_t>(found - segment->patients.begin()) + 1;
+        }
+        for (size_t i = 0; i < segment->ids.size(); ++i) {
+            if (!query.doctorID.empty() && segment->doctorIndex[i] != doctor) continue;
+            if (!query.patientID.empty() && segment->patientIndex[i] != patient) continue;
+            if (segment->dates[i] < query.fromDate || (query.toDate && segment->dates[i] > query.toDate)) continue;
+            rows.push_back(segment->row(i));
+        }
+    }
+    return rows;
+}
+
+size_t AppointmentArchive::rowCount() const {
+    size_t rows = 0;
+    for (const auto& entry : segments) rows += entry.second.rows;
+    return rows;
+}
+
+uint64_t AppointmentArchive::storedBytes() const {
+    uint64_t bytes = 0;
+    for (const auto& entry : segments) bytes += entry.second.bytes;
+    return bytes;
+}
+
+uint32_t AppointmentArchive::maxId() const {
+    uint32_t id = 0;
+    for (const auto& entry : segments) id = max(id, entry.second.maxId);
+    return id;
+}
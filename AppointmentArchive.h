@@ -0,0 +1,123 @@
+#ifndef APPOINTMENT_ARCHIVE_H
+#define APPOINTMENT_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class DoctorManager;
+
+// Cold storage for appointments older than a horizon. Archived
+// appointments leave the doctors' vectors, the registry and the slots, so
+// the hot structures only hold the active window; they stay queryable
+// here by ID, doctor, patient and date.
+//
+// One segment file per month (data/archive_<YYYY-MM>.seg), columnar and
+// compressed: rows sorted by date and time, each column stored apart and
+// encoded for what it holds. Doctor and patient IDs are dictionary
+// indices, days and flags are run-length encoded, IDs and times are
+// zigzag deltas, all as varints. A segment is rewritten whole, through
+// Utils::writeFileAtomically, when more appointments of its month are
+// archived.
+//
+// Segment layout (binary, little-endian):
+//   "AMSARCH1" rows minId maxId minDate maxDate
+//   doctorCount patientCount columnBytes[6]
+//   dictionaries (varint length + bytes each), then the six columns:
+//   ids, days, minutes, flags, doctors, patients
+//
+// Only the segment headers are kept in memory; queries skip the months
+// and ID ranges they cannot match and decode the rest, keeping the most
+// recently decoded segments in a small cache.
+//
+// Not thread-safe; used from the menu thread.
+class AppointmentArchive {
+public:
+    struct Row {
+        uint32_t id = 0;
+        std::string doctorID;
+        std::string patientID;  // Empty for an appointment without patient
+        uint32_t packedDate = 0;
+        uint16_t minutes = 0;
+        uint8_t flags = 0;      // Appointment::Flags
+
+        std::string getDate() const;
+        std::string getTime() const;
+    };
+
+    // Empty IDs match any doctor or patient; a zero date is unbounded
+    struct Query {
+        std::string doctorID;
+        std::string patientID;
+        uint32_t fromDate = 0;
+        uint32_t toDate = 0;  // Inclusive
+    };
+
+    static const std::size_t CACHED_SEGMENTS = 4;
+
+    static AppointmentArchive& instance();
+
+    // Reads the headers of the segments in the data directory
+    void open();
+
+    // Moves every appointment dated before horizon (a packed date) into
+    // the archive, then releases its slot and removes it from the hot
+    // structures. Journals the horizon first, so replay repeats the move;
+    // appointments already archived are not written twice. Returns the
+    // number moved, or 0 if a segment could not be written.
+    std::size_t archiveBefore(uint32_t horizon, DoctorManager& doctorManager, bool quiet = false);
+
+    bool find(uint32_t id, Row& row);
+    // Matching rows by date and time, oldest first
+    std::vector<Row> query(const Query& query);
+
+    std::size_t rowCount() const;
+    uint64_t storedBytes() const;
+    // Highest archived ID, which new appointments must not reuse
+    uint32_t maxId() const;
+
+    static bool isSegmentFile(const std::string& name);
+
+private:
+    struct SegmentInfo {
+        std::string path;
+        uint32_t rows = 0;
+        uint32_t minId = 0, maxId = 0;
+        uint32_t minDate = 0, maxDate = 0;
+        uint64_t bytes = 0;
+    };
+
+    // A decoded segment, one vector per column
+    struct Segment {
+        std::vector<std::string> doctors;
+        std::vector<std::string> patients;
+        std::vector<uint32_t> ids;
+        std::vector<uint32_t> dates;
+        std::vector<uint16_t> minutes;
+        std::vector<uint8_t> flags;
+        std::vector<uint32_t> doctorIndex;
+        std::vector<uint32_t> patientIndex;  // 0 = none, else dictionary index + 1
+
+        Row row(std::size_t i) const;
+    };
+    using SegmentPtr = std::shared_ptr<const Segment>;
+
+    std::map<uint32_t, SegmentInfo> segments;  // By month: year * 16 + month
+    std::list<std::pair<uint32_t, SegmentPtr>> cache;  // Most recent first
+    bool opened = false;
+
+    AppointmentArchive() = default;
+
+    static uint32_t monthOf(uint32_t packedDate) { return packedDate >> 5; }
+    static std::string segmentName(uint32_t month);
+
+    SegmentPtr load(uint32_t month);
+    bool write(uint32_t month, std::vector<Row>& rows);
+    static bool readHeader(const std::string& path, SegmentInfo& info);
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "AppointmentEvents.h"
+#include "AppointmentViews.h"
+#include "Appointment.h"
+#include "Doctor.h"
+#include "DoctorManager.h"
+#include "Journal.h"
+#include "MappedFile.h"
+#include "Patient.h"
+#include "RecordParser.h"
+#include "ScheduleStore.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+const char* const AppointmentEventLog::FILE_NAME = "appointment_events.log";
+
+namespace {
+    const char* const TYPE_NAMES[] = {"BOOKED", "CANCELLED", "MISSED", "REBOOKED"};
+    const size_t FIELD_COUNT = 10;
+
+    // Bytes read from the end of the log to find the last sequence number
+    const size_t TAIL_BYTES = 64 * 1024;
+
+    bool toUnsigned(string_view text, uint64_t& value) {
+        if (text.empty() || text.size() > 19) return false;
+        value = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9') return false;
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return true;
+    }
+}
+
+const char* AppointmentEvent::typeName(Type type) {
+    return TYPE_NAMES[type];
+}
+
+AppointmentEventLog& AppointmentEventLog::instance() {
+    static AppointmentEventLog log;
+    return log;
+}
+
+bool AppointmentEventLog::open(const DoctorManager& doctorManager) {
+    close();
+    path = Utils::getDataPath(FILE_NAME);
+    AppointmentViews::instance().reset();
+
+    sequence = 0;
+    if (!filesystem::exists(path) && !seed(doctorManager)) {
+        cerr << "Error: Could not write " << path << "\n";
+        return false;
+    }
+    Utils::dropIncompleteLastLine(path);
+    sequence = readLastSequence(path);
+    out.open(path, ios::app | ios::binary);
+    if (!out.is_open()) {
+        cerr << "Error: Could not open " << path << " for appending\n";
+        return false;
+    }
+    return true;
+}
+
+void AppointmentEventLog::close() {
+    if (out.is_open()) {
+        out.close();
+    }
+}
+
+// The appointments that exist before the log does, as if just booked
+bool AppointmentEventLog::seed(const DoctorManager& doctorManager) {
+    size_t seeded = 0;
+    bool written = Utils::writeFileAtomically(path, [&](ostream& file) {
+        for (Doctor* doctor : doctorManager.getAllDoctors()) {
+            ScheduleStore::instance().ensureLoaded(doctor);
+            for (const Appointment& appointment : doctor->appointments) {
+                AppointmentEvent event = makeEvent(AppointmentEvent::BOOKED, appointment);
+                event.sequence = ++sequence;
+                file << format(event);
+                if (appointment.isMissed()) {
+                    event.type = AppointmentEvent::MISSED;
+                    event.sequence = ++sequence;
+                    file << format(event);
+                }
+                ++seeded;
+            }
+        }
+    }, true);
+    if (written && seeded > 0) {
+        cout << "Appointment history started with " << seeded << " existing appointment(s).\n";
+    }
+    return written;
+}
+
+AppointmentEvent AppointmentEventLog::makeEvent(AppointmentEvent::Type type, const Appointment& appointment) const {
+    AppointmentEvent event;
+    event.recordedAt = time(nullptr);
+    event.type = type;
+    event.appointmentId = appointment.id;
+    event.doctorId = appointment.doctor->getId();
+    event.patientId = appointment.patient ? appointment.patient->getId() : string();
+    event.specialization = appointment.doctor->getSpecialization();
+    event.packedDate = appointment.packedDate;
+    event.minutes = appointment.minutes;
+    event.emergency = appointment.isEmergency();
+    return event;
+}
+
+void AppointmentEventLog::record(AppointmentEvent::Type type, const Appointment& appointment) {
+    if (!out.is_open()) return;
+
+    AppointmentEvent event = makeEvent(type, appointment);
+    event.sequence = sequence + 1;
+    string line = format(event);
+    out.write(line.data(), line.size());
+    out.flush();
+    if (!out) {
+        cerr << "Error: Failed to append to " << path << "\n";
+        out.clear();
+        return;
+    }
+    sequence = event.sequence;
+    AppointmentViews::instance().apply(event);
+}
+
+void AppointmentEventLog::booked(const Appointment& appointment) {
+    record(AppointmentEvent::BOOKED, appointment);
+}
+
+void AppointmentEventLog::cancelled(const Appointment& appointment) {
+    record(AppointmentEvent::CANCELLED, appointment);
+}
+
+void AppointmentEventLog::missed(const Appointment& appointment) {
+    record(AppointmentEvent::MISSED, appointment);
+}
+
+void AppointmentEventLog::rebooked(const Appointment& appointment) {
+    record(AppointmentEvent::REBOOKED, appointment);
+}
+
+string AppointmentEventLog::format(const AppointmentEvent& event) {
+    return Journal::formatRecord({to_string(event.sequence), AppointmentEvent::typeName(event.type),
+                                  to_string(static_cast<long long>(event.recordedAt)), to_string(event.appointmentId),
+                                  event.doctorId, event.patientId.empty() ? string("-") : event.patientId,
+                                  event.specialization, Utils::unpackDate(event.packedDate),
+                                  Utils::unpackTime(event.minutes), event.emergency ? "1" : "0"});
+}
+
+bool AppointmentEventLog::parse(string_view line, AppointmentEvent& event) {
+    if (!Journal::checkRecord(line)) return false;
+    string_view fields[FIELD_COUNT];
+    if (RecordParser::split(line, '\t', fields, FIELD_COUNT) != FIELD_COUNT) return false;
+
+    uint64_t sequence, recordedAt, id;
+    if (!toUnsigned(fields[0], sequence) || !toUnsigned(fields[2], recordedAt) || !toUnsigned(fields[3], id) ||
+        id > UINT32_MAX) {
+        return false;
+    }
+    size_t type = 0;
+    while (type < 4 && fields[1] != TYPE_NAMES[type]) ++type;
+    if (type == 4) return false;
+    try {
+        event.packedDate = Utils::packDate(string(fields[7]));
+        event.minutes = Utils::packTime(string(fields[8]));
+    } catch (const exception&) {
+        return false;
+    }
+
+    event.sequence = sequence;
+    event.type = static_cast<AppointmentEvent::Type>(type);
+    event.recordedAt = static_cast<time_t>(recordedAt);
+    event.appointmentId = static_cast<uint32_t>(id);
+    event.doctorId = string(fields[4]);
+    event.patientId = fields[5] == "-" ? string() : string(fields[5]);
+    event.specialization = string(fields[6]);
+    event.emergency = fields[9] == "1";
+    return true;
+}
+
+vector<AppointmentEvent> AppointmentEventLog::readAll(const string& path) {
+    MappedFile file;
+    if (!file.open(path) || file.size() == 0) return {};
+    vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+    if (file.data()[file.size() - 1] != '\n') lines.pop_back();
+
+    vector<AppointmentEvent> events(lines.size());
+    vector<char> parsed(lines.size(), 0);
+    ThreadPool::instance().parallelFor(lines.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (lines[i].empty()) continue;
+            parsed[i] = parse(lines[i], events[i]);
+            if (!parsed[i]) RecordParser::reportMalformed(path, i + 1, "damaged or unknown event, skipped");
+        }
+    }, 4096);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (!parsed[i]) continue;
+        if (kept != i) events[kept] = std::move(events[i]);
+        ++kept;
+    }
+    events.resize(kept);
+    return events;
+}
+
+// The sequence number of the last intact line, read from the end of the
+// file so opening does not depend on the length of the history
+uint64_t AppointmentEventLog::readLastSequence(const string& path) {
+    error_code ec;
+    uintmax_t size = filesystem::file_size(path, ec);
+    if (ec || size == 0) return 0;
+
+    uintmax_t start = size > TAIL_BYTES ? size - TAIL_BYTES : 0;
+    string tail(static_cast<size_t>(size - start), '\0');
+    ifstream file(path, ios::binary);
+    file.seekg(static_cast<streamoff>(start));
+    if (file.read(&tail[0], static_cast<streamsize>(tail.size()))) {
+        vector<string_view> lines = RecordParser::splitLines(tail.data(), tail.size());
+        // The first line may be cut by the start of the tail
+        for (size_t i = lines.size(); i-- > (start > 0 ? 1 : 0);) {
+            AppointmentEvent event;
+            if (!lines[i].empty() && parse(lines[i], event)) return event.sequence;
+        }
+    }
+    vector<AppointmentEvent> events = readAll(path);
+    return events.empty() ? 0 : events.back().sequence;
+}
@@ -0,0 +1,92 @@
+#ifndef APPOINTMENT_EVENTS_H
+#define APPOINTMENT_EVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Appointment;
+class DoctorManager;
+
+// One change to an appointment. Every event carries the appointment's
+// doctor, patient, specialization, date and time as of the change, so a
+// view can apply it without looking anything up.
+struct AppointmentEvent {
+    enum Type : uint8_t {
+        BOOKED,
+        CANCELLED,
+        MISSED,
+        REBOOKED  // Date and time are the new ones
+    };
+
+    uint64_t sequence = 0;  // 1 for the first event, then consecutive
+    time_t recordedAt = 0;
+    Type type = BOOKED;
+    uint32_t appointmentId = 0;
+    std::string doctorId;
+    std::string patientId;  // Empty for an appointment without patient
+    std::string specialization;
+    uint32_t packedDate = 0;
+    uint16_t minutes = 0;
+    bool emergency = false;
+
+    static const char* typeName(Type type);
+};
+
+// The history of every appointment as an append-only stream of events
+// (data/appointment_events.log). Unlike the journal it is never truncated:
+// the snapshot holds the current state, this log how it came about.
+// AppointmentViews are built from it.
+//
+// One line per event, in the journal's format with a checksum:
+//   sequence type recordedAt appointmentId doctorId patientId specialization
+//   date time emergency
+//
+// The first open, when there is no log yet, writes a BOOKED event (and a
+// MISSED one where it applies) for every appointment that already exists.
+// Appends are ignored while the log is closed, as during journal replay,
+// whose changes were recorded when they were first made.
+class AppointmentEventLog {
+public:
+    static const char* const FILE_NAME;
+
+    static AppointmentEventLog& instance();
+
+    // Call after the journal is replayed. Resets AppointmentViews, which
+    // are rebuilt from this file when next used.
+    bool open(const DoctorManager& doctorManager);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+    const std::string& filePath() const { return path; }
+    uint64_t lastSequence() const { return sequence; }
+
+    void booked(const Appointment& appointment);
+    void cancelled(const Appointment& appointment);
+    void missed(const Appointment& appointment);
+    void rebooked(const Appointment& appointment);
+
+    // Every intact event of the file, in order, parsed in parallel. Damaged
+    // lines are reported and skipped; a last line without its newline was
+    // torn by a crash and is ignored.
+    static std::vector<AppointmentEvent> readAll(const std::string& path);
+
+private:
+    std::ofstream out;
+    std::string path;
+    uint64_t sequence = 0;
+
+    AppointmentEventLog() = default;
+    AppointmentEvent makeEvent(AppointmentEvent::Type type, const Appointment& appointment) const;
+    void record(AppointmentEvent::Type type, const Appointment& appointment);
+    bool seed(const DoctorManager& doctorManager);
+
+    static std::string format(const AppointmentEvent& event);
+    static bool parse(std::string_view line, AppointmentEvent& event);
+    static uint64_t readLastSequence(const std::string& path);
+};
+
+#endif
@@ -1,41 +1,89 @@
 #include "AppointmentFileHandler.h"
+#include "AppointmentRegistry.h"
 #include "Utils.h"
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <sstream>
-#include <queue>
 
 using namespace std;
 
-void AppointmentFileHandler::saveAppointmentsToFile(const Doctor* doctor, const string& filename) {
-    ofstream file(filename);
-    if (!file.is_open()) {
-        cout << "Error: Could not open file " << filename << " for writing.\n";
-        return;
+// Each appointment line is "<appointmentID> <patientID> <date> <time>".
+// Files written before appointments had IDs omit the first field.
+static void writeAppointments(ostream& file, const Doctor* doctor, bool emergency) {
+    size_t count = 0;
+    for (const auto& appt : doctor->appointments) {
+        if (appt.isEmergency() == emergency) count++;
     }
-
-    // Save regular appointments
-    queue<Appointment> tempQueue = doctor->regularAppointments; // Create a copy to preserve const correctness
-    file << "REGULAR_APPOINTMENTS\n";
-    file << tempQueue.size() << "\n";
-    while (!tempQueue.empty()) {
-        const auto& appt = tempQueue.front();
-        file << appt.patient->getId() << " " << appt.date << " " << appt.time << "\n";
-        tempQueue.pop();
+    file << count << "\n";
+    for (const auto& appt : doctor->appointments) {
+        if (appt.isEmergency() != emergency) continue;
+        file << appt.id << " " << (appt.patient ? appt.patient->getId() : string("-")) << " "
+             << appt.getDate() << " " << appt.getTime() << "\n";
     }
+}
 
-    // Save emergency appointments
-    file << "EMERGENCY_APPOINTMENTS\n";
-    file << doctor->appointments.size() << "\n";
-    for (const auto& appt : doctor->appointments) {
-        file << appt.patient->getId() << " " << appt.date << " " << appt.time << "\n";
+// Files without IDs listed every appointment again under
+// EMERGENCY_APPOINTMENTS. Their regular lines are collected in unnumbered,
+// and an emergency line matching one of them is that same appointment.
+static void readAppointments(ifstream& file, Doctor* doctor, bool emergency, const PatientIndex& patients,
+                             multiset<string>& unnumbered) {
+    int count;
+    file >> count;
+    string line;
+    getline(file, line);  // Rest of the count line
+
+    for (int i = 0; i < count && getline(file, line); i++) {
+        istringstream fields(line);
+        vector<string> tokens;
+        string token;
+        while (fields >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.size() < 3) continue;
+
+        size_t first = tokens.size() >= 4 ? 1 : 0;
+        if (first == 0) {
+            string key = tokens[0] + " " + tokens[1] + " " + tokens[2];
+            if (!emergency) {
+                unnumbered.insert(key);
+            } else if (auto repeated = unnumbered.find(key); repeated != unnumbered.end()) {
+                unnumbered.erase(repeated);
+                continue;
+            }
+        }
+        auto patientIt = patients.find(tokens[first]);
+        Patient* patient = patientIt == patients.end() ? nullptr : patientIt->second;
+        Appointment appt(tokens[first + 1], tokens[first + 2], doctor, patient, emergency);
+        if (first == 1) {
+            appt.id = static_cast<uint32_t>(stoul(tokens[0]));
+            // Already restored from the snapshot
+            if (AppointmentRegistry::instance().find(appt.id)) continue;
+        }
+        // Registering also appends the ID to the patient's list
+        doctor->restoreSlot(AppointmentRegistry::instance().insert(appt));
     }
+}
 
-    file.close();
+bool AppointmentFileHandler::saveAppointmentsToFile(const Doctor* doctor, const string& filename) {
+    bool saved = Utils::writeFileAtomically(filename, [doctor](ostream& file) {
+        // Save regular appointments
+        file << "REGULAR_APPOINTMENTS\n";
+        writeAppointments(file, doctor, false);
+
+        // Save emergency appointments
+        file << "EMERGENCY_APPOINTMENTS\n";
+        writeAppointments(file, doctor, true);
+    });
+    if (!saved) {
+        cout << "Error: Could not save appointments to " << filename << ".\n";
+        return false;
+    }
     cout << "Appointments saved to " << filename << " successfully.\n";
+    return true;
 }
 
-void AppointmentFileHandler::loadAppointmentsFromFile(Doctor* doctor, vector<bool>& patientFlags, int patientCount, const string& filename) {
+void AppointmentFileHandler::loadAppointmentsFromFile(Doctor* doctor, const PatientIndex& patients, const string& filename) {
     ifstream file(filename);
     if (!file.is_open()) {
         cout << "Error: Could not open file " << filename << " for reading.\n";
@@ -43,44 +91,20 @@ void AppointmentFileHandler::loadAppointmentsFromFile(Doctor* doctor, vector<boo
     }
 
     string section;
-    int count;
+    multiset<string> unnumbered;
 
     // Load regular appointments
     file >> section;
     if (section == "REGULAR_APPOINTMENTS") {
-        file >> count;
-        for (int i = 0; i < count; i++) {
-            string patientId, date, time;
-            file >> patientId >> date >> time;
-            
-            // Create and add appointment
-            Appointment appt;
-            appt.patient = nullptr; // Will be set later when patient object is available
-            appt.date = date;
-            appt.time = time;
-            doctor->regularAppointments.push(appt);
-        }
+        readAppointments(file, doctor, false, patients, unnumbered);
     }
 
     // Load emergency appointments
     file >> section;
     if (section == "EMERGENCY_APPOINTMENTS") {
-        file >> count;
-        for (int i = 0; i < count; i++) {
-            string patientId, date, time;
-            file >> patientId >> date >> time;
-            
-            // Create and add appointment
-            Appointment appt;
-            appt.patient = nullptr; // Will be set later when patient object is available
-            appt.date = date;
-            appt.time = time;
-            doctor->appointments.push_back(appt);
-        }
+        readAppointments(file, doctor, true, patients, unnumbered);
     }
 
     file.close();
     cout << "Appointments loaded from " << filename << " successfully.\n";
 }
-
-
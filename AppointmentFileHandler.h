@@ -8,8 +8,10 @@
 
 class AppointmentFileHandler {
 public:
-    void saveAppointmentsToFile(const Doctor* doctor, const std::string& filename);
-    void loadAppointmentsFromFile(Doctor* doctor, std::vector<bool>& patientFlags, int patientCount, const std::string& filename);
+    bool saveAppointmentsToFile(const Doctor* doctor, const std::string& filename);
+    // Restores the file's appointments in one pass: patient IDs are resolved
+    // through the index and each appointment reclaims its slot.
+    void loadAppointmentsFromFile(Doctor* doctor, const PatientIndex& patients, const std::string& filename);
 };
 
 #endif
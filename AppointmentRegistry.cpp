@@ -0,0 +1,105 @@
+#include "AppointmentRegistry.h"
+#include "Doctor.h"
+#include "Patient.h"
+#include "ScheduleStore.h"
+
+using namespace std;
+
+AppointmentRegistry& AppointmentRegistry::instance() {
+    static AppointmentRegistry registry;
+    return registry;
+}
+
+Appointment& AppointmentRegistry::insert(Appointment appointment) {
+    Doctor* doctor = appointment.doctor;
+    ScheduleStore::instance().ensureLoaded(doctor);
+    if (appointment.id == 0 || locations.count(appointment.id)) {
+        appointment.id = ++lastId;
+    } else if (appointment.id > lastId) {
+        lastId = appointment.id;  // Keep generated IDs above any restored one
+    }
+
+    doctor->dirty = true;
+    doctor->scheduleInSnapshot = false;
+    Location location{doctor, static_cast<uint32_t>(doctor->appointments.size()), 0, NO_SLOT};
+    if (appointment.patient) {
+        location.patientIndex = static_cast<uint32_t>(appointment.patient->appointmentIds.size());
+        appointment.patient->appointmentIds.push_back(appointment.id);
+    }
+
+    locations[appointment.id] = location;
+    doctor->appointments.push_back(appointment);
+    return doctor->appointments.back();
+}
+
+void AppointmentRegistry::attachSlot(uint32_t id, int32_t slotIndex) {
+    auto it = locations.find(id);
+    if (it != locations.end()) {
+        it->second.slotIndex = slotIndex;
+    }
+}
+
+void AppointmentRegistry::erase(uint32_t id) {
+    auto it = locations.find(id);
+    if (it == locations.end()) return;
+    Location location = it->second;
+    locations.erase(it);
+
+    location.doctor->dirty = true;
+    location.doctor->scheduleInSnapshot = false;
+    vector<Appointment>& appointments = location.doctor->appointments;
+    Patient* patient = appointments[location.doctorIndex].patient;
+
+    if (patient) {
+        vector<uint32_t>& ids = patient->appointmentIds;
+        uint32_t moved = ids.back();
+        ids[location.patientIndex] = moved;
+        ids.pop_back();
+        if (moved != id) {
+            locations[moved].patientIndex = location.patientIndex;
+        }
+    }
+
+    if (location.doctorIndex + 1 != appointments.size()) {
+        appointments[location.doctorIndex] = appointments.back();
+        locations[appointments[location.doctorIndex].id].doctorIndex = location.doctorIndex;
+    }
+    appointments.pop_back();
+}
+
+void AppointmentRegistry::eraseDoctor(Doctor* doctor) {
+    // Appointments still only in the snapshot go with it
+    ScheduleStore::instance().forget(doctor);
+    while (!doctor->appointments.empty()) {
+        erase(doctor->appointments.back().id);
+    }
+}
+
+void AppointmentRegistry::clear() {
+    locations.clear();
+}
+
+void AppointmentRegistry::reserveIds(uint32_t id) {
+    if (id > lastId) lastId = id;
+}
+
+void AppointmentRegistry::shrinkToFit() {
+    locations.rehash(0);
+}
+
+Appointment* AppointmentRegistry::find(uint32_t id) {
+    auto it = locations.find(id);
+    if (it == locations.end() && ScheduleStore::instance().loadAppointment(id)) {
+        it = locations.find(id);
+    }
+    if (it == locations.end()) return nullptr;
+    return &it->second.doctor->appointments[it->second.doctorIndex];
+}
+
+const AppointmentRegistry::Location* AppointmentRegistry::locate(uint32_t id) {
+    auto it = locations.find(id);
+    if (it == locations.end() && ScheduleStore::instance().loadAppointment(id)) {
+        it = locations.find(id);
+    }
+    return it == locations.end() ? nullptr : &it->second;
+}
@@ -0,0 +1,52 @@
+#ifndef APPOINTMENT_REGISTRY_H
+#define APPOINTMENT_REGISTRY_H
+
+#include <cstdint>
+#include <unordered_map>
+#include "Appointment.h"
+
+class Doctor;
+
+// Global index from appointment ID to where the appointment lives.
+// Each appointment is stored once, in its doctor's appointments vector; the
+// patient keeps only the ID. Removal swaps the last element into the hole,
+// so insert, lookup and erase are all constant time. Doctors whose
+// appointments are still only in the snapshot are loaded through
+// ScheduleStore on first access.
+class AppointmentRegistry {
+public:
+    static const int32_t NO_SLOT = -1;
+
+    struct Location {
+        Doctor* doctor;
+        uint32_t doctorIndex;   // position in Doctor::appointments
+        uint32_t patientIndex;  // position in Patient::appointmentIds
+        int32_t slotIndex;      // normal or emergency slot, by appointment type
+    };
+
+    static AppointmentRegistry& instance();
+
+    // Stores the appointment with its doctor and patient. A fresh ID is
+    // assigned when appointment.id is 0 or already taken.
+    Appointment& insert(Appointment appointment);
+    void attachSlot(uint32_t id, int32_t slotIndex);
+    void erase(uint32_t id);
+    void eraseDoctor(Doctor* doctor);
+    void clear();
+    // Keeps generated IDs above id, e.g. the highest archived one
+    void reserveIds(uint32_t id);
+    // Returns memory left over after many erases
+    void shrinkToFit();
+
+    // Both load the appointment's doctor from the snapshot if needed
+    Appointment* find(uint32_t id);
+    const Location* locate(uint32_t id);
+
+private:
+    std::unordered_map<uint32_t, Location> locations;
+    uint32_t lastId = 0;
+
+    AppointmentRegistry() = default;
+};
+
+#endif
@@ -0,0 +1,353 @@
+#include "AppointmentStore.h"
+#include "AppointmentEvents.h"
+#include "AppointmentFileHandler.h"
+#include "AppointmentRegistry.h"
+#include "Journal.h"
+#include "MappedFile.h"
+#include "ScheduleStore.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+const string AppointmentStore::STORE_FILE = "appointments.store";
+const string AppointmentStore::INDEX_FILE = "appointments.idx";
+
+namespace {
+    const char* const SEGMENT_TAG = "SEGMENT";
+    const char* const INDEX_TAG = "APPOINTMENT_INDEX";
+    const int INDEX_VERSION = 1;
+
+    // Compact only once the file is worth rewriting
+    const uint64_t MIN_COMPACTION_BYTES = 64 * 1024;
+}
+
+AppointmentStore::AppointmentStore()
+    : AppointmentStore(Utils::getDataPath(STORE_FILE), Utils::getDataPath(INDEX_FILE)) {}
+
+AppointmentStore::AppointmentStore(const string& storePath, const string& indexPath)
+    : storePath(storePath), indexPath(indexPath) {
+    Utils::dropIncompleteLastLine(storePath);
+    error_code ec;
+    storeSize = filesystem::exists(storePath, ec) ? filesystem::file_size(storePath, ec) : 0;
+    if (!loadIndex()) {
+        rebuildIndex();
+    }
+}
+
+uint64_t AppointmentStore::liveBytes() const {
+    uint64_t total = 0;
+    for (const auto& entry : index) {
+        total += entry.second.length;
+    }
+    return total;
+}
+
+bool AppointmentStore::loadIndex() {
+    index.clear();
+    ifstream in(indexPath);
+    if (!in.is_open()) {
+        return storeSize == 0;  // Nothing stored yet
+    }
+
+    // The header records the store size the index was written for; any
+    // other size means an append or compaction was interrupted
+    string line, tag;
+    int version = 0;
+    uint64_t indexedSize = 0;
+    if (!getline(in, line) || !(istringstream(line) >> tag >> version >> indexedSize) ||
+        tag != INDEX_TAG || version != INDEX_VERSION || indexedSize != storeSize) {
+        return false;
+    }
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string doctorID;
+        Segment segment;
+        if (!(fields >> doctorID >> segment.offset >> segment.length >> segment.count) ||
+            segment.offset + segment.length > storeSize) {
+            return false;
+        }
+        index[doctorID] = segment;
+    }
+    return true;
+}
+
+bool AppointmentStore::saveIndex() const {
+    return Utils::writeFileAtomically(indexPath, [this](ostream& out) {
+        out << INDEX_TAG << " " << INDEX_VERSION << " " << storeSize << "\n";
+        for (const auto& entry : index) {
+            out << entry.first << " " << entry.second.offset << " " << entry.second.length << " "
+                << entry.second.count << "\n";
+        }
+    });
+}
+
+// The index is only a cache of where each doctor's latest segment starts,
+// so it can always be recovered by scanning the store. Incomplete segments
+// left by an interrupted append are ignored.
+void AppointmentStore::rebuildIndex() {
+    index.clear();
+    ifstream in(storePath, ios::binary);
+    if (!in.is_open()) return;
+
+    string line, tag, doctorID;
+    uint64_t offset = 0, segmentStart = 0;
+    uint32_t expected = 0, seen = 0;
+    bool inSegment = false;
+    while (getline(in, line)) {
+        uint64_t lineStart = offset;
+        offset += line.size() + 1;
+        if (in.eof()) break;  // No trailing newline: torn write
+
+        if (line.compare(0, 8, "SEGMENT ") == 0) {
+            istringstream fields(line);
+            inSegment = static_cast<bool>(fields >> tag >> doctorID >> expected);
+            segmentStart = lineStart;
+            seen = 0;
+        } else if (inSegment) {
+            ++seen;
+        }
+        if (inSegment && seen == expected) {
+            index[doctorID] = {segmentStart, offset - segmentStart, expected};
+            inSegment = false;
+        }
+    }
+    if (storeSize > 0) {
+        cout << "Appointment store index rebuilt: " << index.size() << " doctors.\n";
+        saveIndex();
+    }
+}
+
+string AppointmentStore::formatSegment(const Doctor* doctor, uint32_t& count) {
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    ostringstream out;
+    count = static_cast<uint32_t>(doctor->appointments.size());
+    out << SEGMENT_TAG << " " << doctor->getId() << " " << count << "\n";
+    for (const Appointment& app : doctor->appointments) {
+        const AppointmentRegistry::Location* location = registry.locate(app.id);
+        out << app.id << " " << (app.patient ? app.patient->getId() : string("-")) << " "
+            << app.getDate() << " " << app.getTime() << " " << static_cast<unsigned>(app.flags) << " "
+            << (location ? location->slotIndex : AppointmentRegistry::NO_SLOT) << "\n";
+    }
+    return out.str();
+}
+
+size_t AppointmentStore::save(const DoctorManager& doctorManager) {
+    vector<Doctor*> doctors = doctorManager.getAllDoctors();
+
+    // Forget doctors that were deleted since the last save
+    bool indexChanged = false;
+    for (auto it = index.begin(); it != index.end();) {
+        if (!doctorManager.getDoctorByID(it->first)) {
+            it = index.erase(it);
+            indexChanged = true;
+        } else {
+            ++it;
+        }
+    }
+
+    size_t saved = 0;
+    {
+        ofstream out(storePath, ios::binary | ios::app);
+        if (!out.is_open()) {
+            cerr << "Error: Could not open appointment store " << storePath << " for writing\n";
+            return 0;
+        }
+        ScheduleStore& scheduleStore = ScheduleStore::instance();
+        for (Doctor* doctor : doctors) {
+            // A clean doctor is only missing from the store when it came
+            // from a snapshot, which is read instead of the store at startup;
+            // writing it would load every doctor's appointments
+            if (!doctor->dirty && (index.count(doctor->getId()) || scheduleStore.isAttached(doctor))) continue;
+            scheduleStore.ensureLoaded(doctor);
+
+            uint32_t count = 0;
+            string segment = formatSegment(doctor, count);
+            out.write(segment.data(), segment.size());
+            out.flush();
+            if (!out) {
+                cerr << "Error: Failed writing appointments of Dr. " << doctor->getName() << "\n";
+                break;
+            }
+            index[doctor->getId()] = {storeSize, segment.size(), count};
+            storeSize += segment.size();
+            doctor->dirty = false;
+            indexChanged = true;
+            ++saved;
+        }
+    }
+
+    // The new segments only become visible once the index points at them
+    if (indexChanged) {
+        saveIndex();
+    }
+    if (storeSize >= MIN_COMPACTION_BYTES && storeSize - liveBytes() > liveBytes()) {
+        compact();
+    }
+    return saved;
+}
+
+// Parsing touches nothing but the mapped file and rows, so segments of
+// different doctors can be parsed concurrently
+bool AppointmentStore::parseSegment(const MappedFile& file, const Segment& segment, const Doctor* doctor,
+                                    vector<Row>& rows) {
+    if (segment.offset + segment.length > file.size()) {
+        cerr << "Error: Appointment store segment of Dr. " + doctor->getName() + " is truncated\n";
+        return false;
+    }
+
+    istringstream lines(string(file.data() + segment.offset, segment.length));
+    string line, tag, doctorID;
+    uint32_t count = 0;
+    if (!getline(lines, line) || !(istringstream(line) >> tag >> doctorID >> count) ||
+        tag != SEGMENT_TAG || doctorID != doctor->getId()) {
+        cerr << "Error: Appointment store segment of Dr. " + doctor->getName() + " is damaged\n";
+        return false;
+    }
+
+    rows.reserve(count);
+    for (uint32_t i = 0; i < count && getline(lines, line); ++i) {
+        istringstream fields(line);
+        Row row;
+        unsigned flags;
+        if (!(fields >> row.id >> row.patientID >> row.date >> row.time >> flags >> row.slotIndex)) continue;
+        row.flags = static_cast<uint8_t>(flags);
+        rows.push_back(std::move(row));
+    }
+    return true;
+}
+
+size_t AppointmentStore::applyRows(const vector<Row>& rows, Doctor* doctor, const PatientIndex& patients) {
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    bool wasDirty = doctor->dirty;
+    size_t loaded = 0;
+    for (const Row& row : rows) {
+        if (registry.find(row.id)) continue;
+
+        auto patientIt = patients.find(row.patientID);
+        Patient* patient = patientIt == patients.end() ? nullptr : patientIt->second;
+        Appointment appt(row.date, row.time, doctor, patient, (row.flags & Appointment::EMERGENCY) != 0);
+        appt.id = row.id;
+        appt.flags = row.flags;
+        doctor->restoreSlot(registry.insert(appt), row.slotIndex);
+        ++loaded;
+    }
+    doctor->dirty = wasDirty;  // Loaded state is already stored
+    return loaded;
+}
+
+size_t AppointmentStore::loadAll(DoctorManager& doctorManager, const vector<Patient*>& patients) {
+    MappedFile file;
+    if (!file.open(storePath)) return 0;
+
+    // Visit segments in file order so the read stays sequential
+    vector<pair<const Segment*, Doctor*>> live;
+    live.reserve(index.size());
+    for (const auto& entry : index) {
+        Doctor* doctor = doctorManager.getDoctorByID(entry.first);
+        if (doctor) live.push_back({&entry.second, doctor});
+    }
+    sort(live.begin(), live.end(), [](const auto& a, const auto& b) { return a.first->offset < b.first->offset; });
+
+    // Parse in parallel, then link on this thread: the registry, slots and
+    // patient lists are not shared-write safe
+    vector<vector<Row>> rows(live.size());
+    ThreadPool::instance().parallelFor(live.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            parseSegment(file, *live[i].first, live[i].second, rows[i]);
+        }
+    }, 16);
+
+    PatientIndex patientIndex = buildPatientIndex(patients);
+    size_t loaded = 0;
+    for (size_t i = 0; i < live.size(); ++i) {
+        loaded += applyRows(rows[i], live[i].second, patientIndex);
+    }
+    return loaded;
+}
+
+size_t AppointmentStore::loadDoctor(Doctor* doctor, const PatientIndex& patients) {
+    auto it = index.find(doctor->getId());
+    if (it == index.end()) return 0;
+    MappedFile file;
+    if (!file.open(storePath)) return 0;
+
+    vector<Row> rows;
+    if (!parseSegment(file, it->second, doctor, rows)) return 0;
+    return applyRows(rows, doctor, patients);
+}
+
+size_t AppointmentStore::importLegacyFiles(DoctorManager& doctorManager, const vector<Patient*>& patients) {
+    AppointmentFileHandler legacy;
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    PatientIndex patientIndex = buildPatientIndex(patients);
+    size_t imported = 0;
+    for (Doctor* doctor : doctorManager.getAllDoctors()) {
+        string filename = "appointments_" + doctor->getId() + ".txt";
+        for (const string& path : {filename, Utils::getDataPath(filename)}) {
+            if (!filesystem::exists(path)) continue;
+            // Imported appointments are appended after the loaded ones and
+            // journaled like new bookings, so the next start replays them
+            ScheduleStore::instance().ensureLoaded(doctor);
+            size_t first = doctor->appointments.size();
+            legacy.loadAppointmentsFromFile(doctor, patientIndex, path);
+            for (size_t i = first; i < doctor->appointments.size(); ++i) {
+                const Appointment& appointment = doctor->appointments[i];
+                const AppointmentRegistry::Location* location = registry.locate(appointment.id);
+                Journal::instance().appointmentBooked(appointment, location ? location->slotIndex
+                                                                            : AppointmentRegistry::NO_SLOT);
+                AppointmentEventLog::instance().booked(appointment);
+            }
+            doctor->dirty = true;
+
+            error_code ec;
+            filesystem::rename(path, path + ".migrated", ec);
+            if (ec) {
+                cerr << "Warning: Could not rename " << path << " after import: " << ec.message() << "\n";
+            }
+            ++imported;
+        }
+    }
+    return imported;
+}
+
+bool AppointmentStore::compact() {
+    ifstream in(storePath, ios::binary);
+    if (!in.is_open()) return false;
+
+    vector<pair<string, Segment>> live(index.begin(), index.end());
+    sort(live.begin(), live.end(), [](const auto& a, const auto& b) { return a.second.offset < b.second.offset; });
+
+    unordered_map<string, Segment> compacted;
+    uint64_t offset = 0;
+    bool ok = Utils::writeFileAtomically(storePath, [&](ostream& out) {
+        string buffer;
+        for (const auto& [doctorID, segment] : live) {
+            buffer.resize(segment.length);
+            in.seekg(static_cast<streamoff>(segment.offset));
+            if (!in.read(&buffer[0], static_cast<streamsize>(segment.length))) {
+                out.setstate(ios::failbit);
+                return;
+            }
+            out.write(buffer.data(), buffer.size());
+            compacted[doctorID] = {offset, segment.length, segment.count};
+            offset += segment.length;
+        }
+    }, true);
+    in.close();
+    if (!ok) {
+        cerr << "Error: Appointment store compaction failed, old store kept\n";
+        return false;
+    }
+
+    // A crash before the new index lands leaves a size mismatch, and the
+    // next start rebuilds the index from the compacted file
+    index = std::move(compacted);
+    storeSize = offset;
+    return saveIndex();
+}
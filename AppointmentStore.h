@@ -0,0 +1,93 @@
+#ifndef APPOINTMENT_STORE_H
+#define APPOINTMENT_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Doctor.h"
+#include "DoctorManager.h"
+
+class MappedFile;
+
+// All doctors' appointments in one append-only segment file. Saving a
+// doctor appends a new segment holding that doctor's full appointment
+// list; a small index file maps each doctor ID to the offset and length
+// of its latest segment. Older segments become dead space and are dropped
+// by compact() once they outweigh the live ones.
+//
+// The store is the appointment checkpoint for the text data files: it is
+// loaded at startup only when there is no snapshot, before the journal is
+// replayed over it. With a snapshot, the snapshot and journal hold every
+// appointment and the store is not read.
+//
+// Segment layout (text):
+//   SEGMENT <doctorID> <count>
+//   <appointmentID> <patientID or -> <DD-MM-YYYY> <HH:MM> <flags> <slotIndex>
+class AppointmentStore {
+public:
+    AppointmentStore();
+    AppointmentStore(const std::string& storePath, const std::string& indexPath);
+
+    // Appends a segment for every dirty doctor and clears its flag. Clean
+    // doctors the store has never seen are written too, unless the attached
+    // snapshot holds them. Drops index entries of doctors that no longer
+    // exist, and compacts when needed. Returns the number of doctors written.
+    std::size_t save(const DoctorManager& doctorManager);
+
+    // Reads every live segment in file order, in a single pass: patient IDs
+    // are resolved through a hash index, and each appointment is registered
+    // with its patient and reclaims its slot, which also keeps new IDs
+    // above the stored ones. Appointments whose ID is already registered
+    // are skipped. Call before the journal is replayed, so the journal's
+    // cancellations apply to what was stored. Returns the number loaded.
+    std::size_t loadAll(DoctorManager& doctorManager, const std::vector<Patient*>& patients);
+    std::size_t loadDoctor(Doctor* doctor, const PatientIndex& patients);
+
+    // Imports per-doctor appointments_<id>.txt files from the working
+    // directory and data/, renaming each to .migrated once read. Every
+    // imported appointment is journaled, and the imported doctors are left
+    // dirty so the next save() stores them. Returns the number of files.
+    std::size_t importLegacyFiles(DoctorManager& doctorManager, const std::vector<Patient*>& patients);
+
+    bool compact();
+
+    bool contains(const std::string& doctorID) const { return index.count(doctorID) != 0; }
+    uint64_t liveBytes() const;
+    uint64_t fileBytes() const { return storeSize; }
+
+private:
+    struct Segment {
+        uint64_t offset;
+        uint64_t length;
+        uint32_t count;
+    };
+
+    // One parsed appointment line, before it is linked to its patient
+    struct Row {
+        uint32_t id;
+        uint8_t flags;
+        int32_t slotIndex;
+        std::string patientID;
+        std::string date;
+        std::string time;
+    };
+
+    static const std::string STORE_FILE;
+    static const std::string INDEX_FILE;
+
+    std::string storePath;
+    std::string indexPath;
+    std::unordered_map<std::string, Segment> index;
+    uint64_t storeSize = 0;
+
+    bool loadIndex();
+    bool saveIndex() const;
+    void rebuildIndex();
+    static std::string formatSegment(const Doctor* doctor, uint32_t& count);
+    static bool parseSegment(const MappedFile& file, const Segment& segment, const Doctor* doctor,
+                             std::vector<Row>& rows);
+    static std::size_t applyRows(const std::vector<Row>& rows, Doctor* doctor, const PatientIndex& patients);
+};
+
+#endif
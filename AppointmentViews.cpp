@@ -0,0 +1,179 @@
+#include "AppointmentViews.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include <functional>
+#include <future>
+
+using namespace std;
+
+namespace {
+    // Folds the events into parts.size() partial views, each holding the
+    // keys that hash to it, on the pool. shardOf[i] is the part of
+    // events[i]. Waits through pending, filled here.
+    template <typename View>
+    void foldShards(const vector<AppointmentEvent>& events, const vector<uint16_t>& shardOf, vector<View>& parts,
+                    vector<future<void>>& pending) {
+        for (size_t shard = 0; shard < parts.size(); ++shard) {
+            pending.push_back(ThreadPool::instance().submit([&events, &shardOf, &parts, shard]() {
+                View& part = parts[shard];
+                for (size_t i = 0; i < events.size(); ++i) {
+                    if (shardOf[i] == shard) part.apply(events[i]);
+                }
+            }));
+        }
+    }
+
+    template <typename View>
+    void mergeShards(vector<View>& parts, View& view) {
+        view.clear();
+        for (View& part : parts) view.merge(part);
+    }
+}
+
+// --- DoctorScheduleView ---
+
+void DoctorScheduleView::apply(const AppointmentEvent& event) {
+    if (event.type == AppointmentEvent::BOOKED) {
+        schedules[event.doctorId][event.appointmentId] =
+            Entry{event.patientId, event.packedDate, event.minutes, event.emergency, false};
+        return;
+    }
+    auto doctor = schedules.find(event.doctorId);
+    if (doctor == schedules.end()) return;
+    auto entry = doctor->second.find(event.appointmentId);
+    if (entry == doctor->second.end()) return;
+
+    if (event.type == AppointmentEvent::CANCELLED) {
+        doctor->second.erase(entry);
+        if (doctor->second.empty()) schedules.erase(doctor);
+    } else if (event.type == AppointmentEvent::MISSED) {
+        entry->second.missed = true;
+    } else {
+        entry->second.packedDate = event.packedDate;
+        entry->second.minutes = event.minutes;
+        entry->second.missed = false;
+    }
+}
+
+void DoctorScheduleView::merge(DoctorScheduleView& other) {
+    schedules.merge(other.schedules);
+}
+
+const DoctorScheduleView::Schedule* DoctorScheduleView::schedule(const string& doctorId) const {
+    auto it = schedules.find(doctorId);
+    return it == schedules.end() ? nullptr : &it->second;
+}
+
+// --- PatientTimelineView ---
+
+void PatientTimelineView::apply(const AppointmentEvent& event) {
+    if (event.patientId.empty()) return;
+    timelines[event.patientId].push_back(Entry{event.sequence, event.recordedAt, event.type, event.appointmentId,
+                                               event.doctorId, event.packedDate, event.minutes});
+}
+
+void PatientTimelineView::merge(PatientTimelineView& other) {
+    timelines.merge(other.timelines);
+}
+
+const PatientTimelineView::Timeline* PatientTimelineView::timeline(const string& patientId) const {
+    auto it = timelines.find(patientId);
+    return it == timelines.end() ? nullptr : &it->second;
+}
+
+// --- SpecializationUtilizationView ---
+
+void SpecializationUtilizationView::apply(const AppointmentEvent& event) {
+    Counters& count = counters[event.specialization];
+    switch (event.type) {
+        case AppointmentEvent::BOOKED: ++count.booked; break;
+        case AppointmentEvent::CANCELLED: ++count.cancelled; break;
+        case AppointmentEvent::MISSED: ++count.missed; break;
+        case AppointmentEvent::REBOOKED: ++count.rebooked; break;
+    }
+}
+
+void SpecializationUtilizationView::merge(SpecializationUtilizationView& other) {
+    counters.merge(other.counters);
+}
+
+// --- AppointmentViews ---
+
+AppointmentViews& AppointmentViews::instance() {
+    static AppointmentViews views;
+    return views;
+}
+
+void AppointmentViews::reset() {
+    schedules.clear();
+    timelines.clear();
+    utilization.clear();
+    built = false;
+    sequence = 0;
+}
+
+void AppointmentViews::rebuild() {
+    string path = AppointmentEventLog::instance().filePath();
+    if (path.empty()) path = Utils::getDataPath(AppointmentEventLog::FILE_NAME);
+    rebuild(AppointmentEventLog::readAll(path));
+}
+
+void AppointmentViews::rebuild(const vector<AppointmentEvent>& events) {
+    ThreadPool& pool = ThreadPool::instance();
+    size_t shards = max<size_t>(1, pool.size());
+
+    // Shard of every event in each view, by its key in that view
+    vector<uint16_t> doctorShard(events.size()), patientShard(events.size()), specializationShard(events.size());
+    pool.parallelFor(events.size(), [&](size_t begin, size_t end) {
+        hash<string> hasher;
+        for (size_t i = begin; i < end; ++i) {
+            doctorShard[i] = static_cast<uint16_t>(hasher(DoctorScheduleView::keyOf(events[i])) % shards);
+            patientShard[i] = static_cast<uint16_t>(hasher(PatientTimelineView::keyOf(events[i])) % shards);
+            specializationShard[i] =
+                static_cast<uint16_t>(hasher(SpecializationUtilizationView::keyOf(events[i])) % shards);
+        }
+    }, 4096);
+
+    vector<DoctorScheduleView> scheduleParts(shards);
+    vector<PatientTimelineView> timelineParts(shards);
+    vector<SpecializationUtilizationView> utilizationParts(shards);
+    vector<future<void>> pending;
+    foldShards(events, doctorShard, scheduleParts, pending);
+    foldShards(events, patientShard, timelineParts, pending);
+    foldShards(events, specializationShard, utilizationParts, pending);
+    for (auto& future : pending) future.wait();
+    for (auto& future : pending) future.get();
+
+    mergeShards(scheduleParts, schedules);
+    mergeShards(timelineParts, timelines);
+    mergeShards(utilizationParts, utilization);
+    sequence = events.empty() ? 0 : events.back().sequence;
+    built = true;
+}
+
+void AppointmentViews::apply(const AppointmentEvent& event) {
+    if (!built) return;  // The next build reads the event from the log
+    schedules.apply(event);
+    timelines.apply(event);
+    utilization.apply(event);
+    sequence = event.sequence;
+}
+
+void AppointmentViews::ensureBuilt() {
+    if (!built) rebuild();
+}
+
+const DoctorScheduleView& AppointmentViews::doctorSchedules() {
+    ensureBuilt();
+    return schedules;
+}
+
+const PatientTimelineView& AppointmentViews::patientTimelines() {
+    ensureBuilt();
+    return timelines;
+}
+
+const SpecializationUtilizationView& AppointmentViews::specializationUtilization() {
+    ensureBuilt();
+    return utilization;
+}
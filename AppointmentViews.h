@@ -0,0 +1,130 @@
+#ifndef APPOINTMENT_VIEWS_H
+#define APPOINTMENT_VIEWS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AppointmentEvents.h"
+
+// Each view folds AppointmentEvents in sequence order. A view's state for
+// one key (doctor, patient or specialization) depends only on the events
+// with that key, which is what lets AppointmentViews::rebuild split the
+// log by key across threads.
+
+// Appointments each doctor has, as of the last event applied. Archived
+// appointments stay listed: archiving moves them, it does not cancel them.
+class DoctorScheduleView {
+public:
+    struct Entry {
+        std::string patientId;
+        uint32_t packedDate = 0;
+        uint16_t minutes = 0;
+        bool emergency = false;
+        bool missed = false;
+    };
+    using Schedule = std::map<uint32_t, Entry>;  // By appointment ID
+
+    static const std::string& keyOf(const AppointmentEvent& event) { return event.doctorId; }
+    void apply(const AppointmentEvent& event);
+    void merge(DoctorScheduleView& other);
+    void clear() { schedules.clear(); }
+
+    const Schedule* schedule(const std::string& doctorId) const;
+    std::size_t doctorCount() const { return schedules.size(); }
+
+private:
+    std::unordered_map<std::string, Schedule> schedules;
+};
+
+// Every event of each patient's appointments, oldest first
+class PatientTimelineView {
+public:
+    struct Entry {
+        uint64_t sequence;
+        time_t recordedAt;
+        AppointmentEvent::Type type;
+        uint32_t appointmentId;
+        std::string doctorId;
+        uint32_t packedDate;
+        uint16_t minutes;
+    };
+    using Timeline = std::vector<Entry>;
+
+    static const std::string& keyOf(const AppointmentEvent& event) { return event.patientId; }
+    void apply(const AppointmentEvent& event);
+    void merge(PatientTimelineView& other);
+    void clear() { timelines.clear(); }
+
+    const Timeline* timeline(const std::string& patientId) const;
+
+private:
+    std::unordered_map<std::string, Timeline> timelines;
+};
+
+// Event counts per specialization
+class SpecializationUtilizationView {
+public:
+    struct Counters {
+        uint64_t booked = 0;
+        uint64_t cancelled = 0;
+        uint64_t missed = 0;
+        uint64_t rebooked = 0;
+
+        uint64_t active() const { return booked - cancelled; }
+    };
+
+    static const std::string& keyOf(const AppointmentEvent& event) { return event.specialization; }
+    void apply(const AppointmentEvent& event);
+    void merge(SpecializationUtilizationView& other);
+    void clear() { counters.clear(); }
+
+    const std::map<std::string, Counters>& all() const { return counters; }
+
+private:
+    std::map<std::string, Counters> counters;
+};
+
+// The three views over AppointmentEventLog. They are built from the log
+// the first time they are used after the log is opened, and from then on
+// AppointmentEventLog applies each event it records, so a view is never
+// rebuilt just to see a new change.
+//
+// Not thread-safe; used from the menu thread. rebuild() runs its work on
+// the shared ThreadPool and returns when it is done.
+class AppointmentViews {
+public:
+    static AppointmentViews& instance();
+
+    // Drops the views; the next use rebuilds them from the log
+    void reset();
+    // Reads the log and builds every view from it
+    void rebuild();
+    // Builds the views from events, in sequence order, using the pool:
+    // each view is split into shards by key and every shard folds its own
+    // events, then the shards are merged.
+    void rebuild(const std::vector<AppointmentEvent>& events);
+    // Brings built views up to date with one new event
+    void apply(const AppointmentEvent& event);
+
+    bool isBuilt() const { return built; }
+    uint64_t lastSequence() const { return sequence; }
+
+    const DoctorScheduleView& doctorSchedules();
+    const PatientTimelineView& patientTimelines();
+    const SpecializationUtilizationView& specializationUtilization();
+
+private:
+    DoctorScheduleView schedules;
+    PatientTimelineView timelines;
+    SpecializationUtilizationView utilization;
+    bool built = false;
+    uint64_t sequence = 0;
+
+    AppointmentViews() = default;
+    void ensureBuilt();
+};
+
+#endif
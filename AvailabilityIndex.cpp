@@ -0,0 +1,195 @@
+#include "AvailabilityIndex.h"
+#include "Doctor.h"
+#include "Utils.h"
+
+// Build with -mavx2 to enable the 16-wide kernel. SSE2 is part of the
+// x86-64 baseline; other targets use the scalar loop only.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AMS_AVAILABILITY_AVX2 1
+#define AMS_AVAILABILITY_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AMS_AVAILABILITY_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+    inline unsigned lowestSetBit(uint32_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(value));
+#endif
+    }
+
+    // Booked bits for slots [first, first + width). first is a multiple of width
+    // and width divides 64, so the run never straddles two words.
+    inline uint32_t bookedBits(const vector<uint64_t>& booked, size_t first, unsigned width) {
+        uint64_t word = booked[first / 64] >> (first % 64);
+        return static_cast<uint32_t>(word & ((uint64_t(1) << width) - 1));
+    }
+
+    // Marks a gap; packTime never returns it, so no scan matches it
+    const uint16_t GAP = 0xFFFF;
+}
+
+void AvailabilityIndex::pushSlot(Column& column, uint16_t minutes, uint32_t owner, bool booked) {
+    size_t position = column.minutes.size();
+    column.minutes.push_back(minutes);
+    column.owner.push_back(owner);
+    if (column.booked.size() * 64 <= position) {
+        column.booked.push_back(0);
+    }
+    if (booked) {
+        column.booked[position / 64] |= uint64_t(1) << (position % 64);
+    }
+}
+
+void AvailabilityIndex::appendDoctor(Column& column, Doctor* doctor) {
+    uint32_t owner = static_cast<uint32_t>(column.doctors.size());
+    column.doctors.push_back(doctor);
+    doctor->availabilityOffset = column.minutes.size();
+    doctor->availabilityOwner = owner;
+
+    for (const auto& slot : doctor->normalSlots) {
+        pushSlot(column, slot.minutes, owner, slot.isBooked);
+    }
+}
+
+void AvailabilityIndex::compact(Column& column, const Doctor* skip) {
+    Column rebuilt;
+    for (Doctor* doctor : column.doctors) {
+        if (doctor != skip) {
+            appendDoctor(rebuilt, doctor);
+        }
+    }
+    column = std::move(rebuilt);
+}
+
+void AvailabilityIndex::addDoctor(Doctor* doctor) {
+    if (!doctor) return;
+    appendDoctor(columns[doctor->getSpecialization()], doctor);
+    doctor->availabilityIndex = this;
+}
+
+void AvailabilityIndex::removeDoctor(Doctor* doctor) {
+    if (!doctor || doctor->availabilityIndex != this) return;
+    doctor->availabilityIndex = nullptr;
+
+    auto it = columns.find(doctor->getSpecialization());
+    if (it == columns.end()) return;
+
+    // Compact the column; the remaining doctors get new offsets
+    compact(it->second, doctor);
+    if (it->second.doctors.empty()) {
+        columns.erase(it);
+    }
+}
+
+void AvailabilityIndex::appendSlot(Doctor* doctor) {
+    if (!doctor || doctor->availabilityIndex != this || doctor->normalSlots.empty()) return;
+    auto it = columns.find(doctor->getSpecialization());
+    if (it == columns.end()) return;
+    Column& column = it->second;
+
+    // The new slot is the last one; the ones before it are already indexed
+    size_t run = doctor->normalSlots.size() - 1;
+    size_t offset = doctor->availabilityOffset;
+    if (offset + run != column.minutes.size()) {
+        // Another doctor's run follows, so move this one to the end
+        doctor->availabilityOffset = column.minutes.size();
+        for (size_t i = offset; i < offset + run; ++i) {
+            bool booked = (column.booked[i / 64] >> (i % 64)) & 1;
+            pushSlot(column, column.minutes[i], doctor->availabilityOwner, booked);
+            column.minutes[i] = GAP;
+        }
+        column.gaps += run;
+    }
+    const Slot& slot = doctor->normalSlots.back();
+    pushSlot(column, slot.minutes, doctor->availabilityOwner, slot.isBooked);
+
+    if (column.gaps * 2 > column.minutes.size()) {
+        compact(column);
+    }
+}
+
+void AvailabilityIndex::clear() {
+    for (auto& pair : columns) {
+        for (Doctor* doctor : pair.second.doctors) {
+            doctor->availabilityIndex = nullptr;
+        }
+    }
+    columns.clear();
+}
+
+void AvailabilityIndex::setBooked(const Doctor* doctor, size_t slotIndex, bool booked) {
+    auto it = columns.find(doctor->getSpecialization());
+    if (it == columns.end()) return;
+
+    size_t position = doctor->availabilityOffset + slotIndex;
+    uint64_t bit = uint64_t(1) << (position % 64);
+    if (booked) {
+        it->second.booked[position / 64] |= bit;
+    } else {
+        it->second.booked[position / 64] &= ~bit;
+    }
+}
+
+void AvailabilityIndex::scanColumn(const Column& column, uint16_t minute, pmr::vector<Doctor*>& result) {
+    const uint16_t* times = column.minutes.data();
+    const size_t count = column.minutes.size();
+    size_t i = 0;
+
+    auto collect = [&](size_t base, uint32_t hits) {
+        while (hits) {
+            result.push_back(column.doctors[column.owner[base + lowestSetBit(hits)]]);
+            hits &= hits - 1;
+        }
+    };
+
+#if defined(AMS_AVAILABILITY_AVX2)
+    const __m256i needle16 = _mm256_set1_epi16(static_cast<short>(minute));
+    for (; i + 16 <= count; i += 16) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(times + i));
+        __m256i equal = _mm256_cmpeq_epi16(block, needle16);
+        __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(equal), _mm256_extracti128_si256(equal, 1));
+        uint32_t hits = static_cast<uint32_t>(_mm_movemask_epi8(packed));
+        collect(i, hits & ~bookedBits(column.booked, i, 16));
+    }
+#endif
+
+#if defined(AMS_AVAILABILITY_SSE2)
+    const __m128i needle8 = _mm_set1_epi16(static_cast<short>(minute));
+    for (; i + 8 <= count; i += 8) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(times + i));
+        __m128i equal = _mm_cmpeq_epi16(block, needle8);
+        uint32_t hits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128())));
+        collect(i, hits & ~bookedBits(column.booked, i, 8));
+    }
+#endif
+
+    // Scalar tail, and the whole column on targets without SSE2
+    for (; i < count; ++i) {
+        if (times[i] == minute && !((column.booked[i / 64] >> (i % 64)) & 1)) {
+            result.push_back(column.doctors[column.owner[i]]);
+        }
+    }
+}
+
+pmr::vector<Doctor*> AvailabilityIndex::findFreeDoctors(const string& specialization, const string& time,
+                                                        pmr::memory_resource* resource) const {
+    pmr::vector<Doctor*> result(resource);
+    auto it = columns.find(specialization);
+    if (it != columns.end()) {
+        scanColumn(it->second, Utils::packTime(time), result);
+    }
+    return result;
+}
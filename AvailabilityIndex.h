@@ -0,0 +1,54 @@
+#ifndef AVAILABILITY_INDEX_H
+#define AVAILABILITY_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Doctor;
+
+// Columnar copy of every registered doctor's regular slots, grouped by
+// specialization. Slot times are packed as minutes since midnight and the
+// booked state is kept as a bitset, so "who is free at HH:MM" is a single
+// linear pass over a few contiguous arrays instead of a walk over Doctor
+// and Slot objects. A doctor's slots occupy one contiguous run starting at
+// Doctor::availabilityOffset. A slot added to a doctor whose run is not at
+// the end of its column moves the run there and leaves a gap that no scan
+// matches; the column is compacted once gaps make up half of it.
+class AvailabilityIndex {
+private:
+    struct Column {
+        std::vector<uint16_t> minutes;   // slot time, minutes since midnight
+        std::vector<uint32_t> owner;     // index into doctors
+        std::vector<uint64_t> booked;    // one bit per slot
+        std::vector<Doctor*> doctors;
+        std::size_t gaps = 0;            // slots left behind by moved runs
+    };
+
+    std::unordered_map<std::string, Column> columns;
+
+    static void pushSlot(Column& column, uint16_t minutes, uint32_t owner, bool booked);
+    static void appendDoctor(Column& column, Doctor* doctor);
+    // Rebuilds the column without gaps, leaving out skip
+    static void compact(Column& column, const Doctor* skip = nullptr);
+    static void scanColumn(const Column& column, uint16_t minute, std::pmr::vector<Doctor*>& result);
+
+public:
+    void addDoctor(Doctor* doctor);
+    void removeDoctor(Doctor* doctor);
+    void clear();
+
+    // Mirrors a slot appended to Doctor::normalSlots.
+    void appendSlot(Doctor* doctor);
+
+    // Mirrors a change of Doctor::normalSlots[slotIndex].isBooked.
+    void setBooked(const Doctor* doctor, std::size_t slotIndex, bool booked);
+
+    std::pmr::vector<Doctor*> findFreeDoctors(const std::string& specialization, const std::string& time,
+                                              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+};
+
+#endif
@@ -0,0 +1,651 @@
+#include "BTreeStorage.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+    const char MAGIC[8] = {'A', 'M', 'S', 'B', 'T', 'R', 'E', '1'};
+    const uint32_t VERSION = 1;
+    const uint8_t LEAF_PAGE = 1;
+    const uint8_t INTERNAL_PAGE = 2;
+    const uint8_t FREE_PAGE = 3;
+    const size_t PAGE_HEADER = 8;  // type, reserved, count, checksum
+    const size_t FREE_PER_PAGE = (BTreeStorage::PAGE_SIZE - PAGE_HEADER - 4) / 4;
+
+    struct Meta {
+        char magic[8];
+        uint32_t version;
+        uint32_t pageSize;
+        uint64_t generation;
+        uint64_t recordCount;
+        uint32_t root;
+        uint32_t pageCount;
+        uint32_t freeHead;
+        uint32_t freeCount;
+        uint32_t checksum;  // CRC-32 with this field zeroed
+        uint32_t reserved;
+    };
+
+    uint16_t get16(const char* at) { uint16_t v; memcpy(&v, at, 2); return v; }
+    uint32_t get32(const char* at) { uint32_t v; memcpy(&v, at, 4); return v; }
+    void put16(char* at, size_t v) { uint16_t n = static_cast<uint16_t>(v); memcpy(at, &n, 2); }
+    void put32(char* at, uint32_t v) { memcpy(at, &v, 4); }
+
+    // CRC-32 of a page with its checksum field (bytes 4-7) zeroed
+    uint32_t pageChecksum(const char* page) {
+        const uint32_t zero = 0;
+        uint32_t crc = Utils::crc32(page, 4);
+        crc = Utils::crc32(&zero, 4, crc);
+        return Utils::crc32(page + PAGE_HEADER, BTreeStorage::PAGE_SIZE - PAGE_HEADER, crc);
+    }
+
+    uint32_t metaChecksum(Meta meta) {
+        meta.checksum = 0;
+        return Utils::crc32(&meta, sizeof(meta));
+    }
+
+    int openReadWrite(const string& path) {
+#ifdef _WIN32
+        // Shared for deletion like MappedFile, so a restore can rename a
+        // file over this one while it is open
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return -1;
+        int fd = _open_osfhandle(reinterpret_cast<intptr_t>(file), _O_RDWR | _O_BINARY);
+        if (fd < 0) CloseHandle(file);
+        return fd;
+#else
+        return ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+    }
+
+    uint64_t fileSize(int fd) {
+#ifdef _WIN32
+        return static_cast<uint64_t>(_lseeki64(fd, 0, SEEK_END));
+#else
+        struct stat info;
+        return fstat(fd, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+#endif
+    }
+
+    bool readPage(int fd, uint32_t page, char* buffer) {
+        uint64_t offset = uint64_t(page) * BTreeStorage::PAGE_SIZE;
+#ifdef _WIN32
+        return _lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0 &&
+               _read(fd, buffer, BTreeStorage::PAGE_SIZE) == static_cast<int>(BTreeStorage::PAGE_SIZE);
+#else
+        size_t done = 0;
+        while (done < BTreeStorage::PAGE_SIZE) {
+            ssize_t n = ::pread(fd, buffer + done, BTreeStorage::PAGE_SIZE - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    bool writePage(int fd, uint32_t page, const char* buffer) {
+        uint64_t offset = uint64_t(page) * BTreeStorage::PAGE_SIZE;
+#ifdef _WIN32
+        return _lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0 &&
+               _write(fd, buffer, BTreeStorage::PAGE_SIZE) == static_cast<int>(BTreeStorage::PAGE_SIZE);
+#else
+        size_t done = 0;
+        while (done < BTreeStorage::PAGE_SIZE) {
+            ssize_t n = ::pwrite(fd, buffer + done, BTreeStorage::PAGE_SIZE - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+#endif
+    }
+
+    bool syncFd(int fd) {
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
+    }
+
+    void closeFd(int fd) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+}
+
+BTreeStorage::BTreeStorage(const string& path, size_t cachePages)
+    : path(path), cachePages(max<size_t>(cachePages, 16)) {
+    if (!openFile() && fd >= 0) {
+        closeFd(fd);
+        fd = -1;
+    }
+}
+
+BTreeStorage::~BTreeStorage() {
+    if (fd >= 0) closeFd(fd);
+}
+
+bool BTreeStorage::openFile() {
+    fd = openReadWrite(path);
+    if (fd < 0) {
+        cerr << "Error: Could not open " << path << "\n";
+        return false;
+    }
+    if (fileSize(fd) == 0) {
+        changed = true;  // A new file gets its first meta page
+        return flush();
+    }
+
+    // The newest meta page that is intact
+    Meta best{};
+    bool found = false;
+    char buffer[PAGE_SIZE];
+    for (uint32_t page = 0; page < 2; ++page) {
+        if (!readPage(fd, page, buffer)) continue;
+        Meta meta;
+        memcpy(&meta, buffer, sizeof(meta));
+        if (memcmp(meta.magic, MAGIC, sizeof(MAGIC)) != 0 || meta.version != VERSION || meta.pageSize != PAGE_SIZE ||
+            meta.checksum != metaChecksum(meta) || meta.pageCount < 2 || meta.root >= meta.pageCount) {
+            continue;
+        }
+        if (!found || meta.generation > best.generation) best = meta;
+        found = true;
+    }
+    if (!found) {
+        cerr << "Error: " << path << " is not a storage file or is damaged\n";
+        return false;
+    }
+    generation = best.generation;
+    recordCount = best.recordCount;
+    root = best.root;
+    pages = best.pageCount;
+    if (!readFreeList(best.freeHead) || freePages.size() != best.freeCount) {
+        // Only space is lost: those pages stay unused
+        cerr << "Warning: Free page list of " << path << " is damaged, its pages will not be reused\n";
+        freePages.clear();
+        freeListPages.clear();
+    }
+    return true;
+}
+
+bool BTreeStorage::readFreeList(uint32_t head) {
+    char buffer[PAGE_SIZE];
+    for (uint32_t page = head; page != 0;) {
+        if (page < 2 || page >= pages || freeListPages.size() >= pages || !readPage(fd, page, buffer) ||
+            buffer[0] != static_cast<char>(FREE_PAGE) || get32(buffer + 4) != pageChecksum(buffer)) {
+            return false;
+        }
+        size_t count = get16(buffer + 2);
+        if (count > FREE_PER_PAGE) return false;
+        freeListPages.push_back(page);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t freePage = get32(buffer + PAGE_HEADER + 4 + i * 4);
+            if (freePage < 2 || freePage >= pages) return false;
+            freePages.push_back(freePage);
+        }
+        page = get32(buffer + PAGE_HEADER);
+    }
+    return true;
+}
+
+// --- Page encoding ---
+
+size_t BTreeStorage::encodedSize(const Node& node) {
+    size_t size = PAGE_HEADER;
+    if (node.leaf) {
+        for (size_t i = 0; i < node.keys.size(); ++i) size += 4 + node.keys[i].size() + node.values[i].size();
+    } else {
+        size += 4;
+        for (const string& key : node.keys) size += 2 + key.size() + 4;
+    }
+    return size;
+}
+
+void BTreeStorage::encode(const Node& node, char* page) {
+    memset(page, 0, PAGE_SIZE);
+    page[0] = static_cast<char>(node.leaf ? LEAF_PAGE : INTERNAL_PAGE);
+    put16(page + 2, node.keys.size());
+    char* at = page + PAGE_HEADER;
+    if (node.leaf) {
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            put16(at, node.keys[i].size());
+            put16(at + 2, node.values[i].size());
+            memcpy(at + 4, node.keys[i].data(), node.keys[i].size());
+            memcpy(at + 4 + node.keys[i].size(), node.values[i].data(), node.values[i].size());
+            at += 4 + node.keys[i].size() + node.values[i].size();
+        }
+    } else {
+        put32(at, node.children[0]);
+        at += 4;
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            put16(at, node.keys[i].size());
+            memcpy(at + 2, node.keys[i].data(), node.keys[i].size());
+            put32(at + 2 + node.keys[i].size(), node.children[i + 1]);
+            at += 2 + node.keys[i].size() + 4;
+        }
+    }
+    put32(page + 4, pageChecksum(page));
+}
+
+bool BTreeStorage::decode(const char* page, Node& node) {
+    if (get32(page + 4) != pageChecksum(page)) return false;
+    size_t count = get16(page + 2);
+    const char* at = page + PAGE_HEADER;
+    const char* end = page + PAGE_SIZE;
+    node.keys.resize(count);
+    if (page[0] == static_cast<char>(LEAF_PAGE)) {
+        node.leaf = true;
+        node.values.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (end - at < 4) return false;
+            size_t keyLength = get16(at), valueLength = get16(at + 2);
+            if (size_t(end - at) < 4 + keyLength + valueLength) return false;
+            node.keys[i].assign(at + 4, keyLength);
+            node.values[i].assign(at + 4 + keyLength, valueLength);
+            at += 4 + keyLength + valueLength;
+        }
+        return true;
+    }
+    if (page[0] != static_cast<char>(INTERNAL_PAGE)) return false;
+    node.leaf = false;
+    node.children.resize(count + 1);
+    node.children[0] = get32(at);
+    at += 4;
+    for (size_t i = 0; i < count; ++i) {
+        if (end - at < 2) return false;
+        size_t keyLength = get16(at);
+        if (size_t(end - at) < 2 + keyLength + 4) return false;
+        node.keys[i].assign(at + 2, keyLength);
+        node.children[i + 1] = get32(at + 2 + keyLength);
+        at += 2 + keyLength + 4;
+    }
+    return true;
+}
+
+// --- Page cache ---
+
+BTreeStorage::Node* BTreeStorage::load(uint32_t page) {
+    auto it = cache.find(page);
+    if (it != cache.end()) {
+        lru.splice(lru.begin(), lru, it->second.position);
+        return it->second.node.get();
+    }
+    char buffer[PAGE_SIZE];
+    unique_ptr<Node> node(new Node());
+    if (page < 2 || page >= pages || !readPage(fd, page, buffer) || !decode(buffer, *node)) {
+        cerr << "Error: Page " << page << " of " << path << " is damaged\n";
+        failed = true;
+        return nullptr;
+    }
+    return cacheNode(page, std::move(node));
+}
+
+BTreeStorage::Node* BTreeStorage::cacheNode(uint32_t page, unique_ptr<Node> node) {
+    lru.push_front(page);
+    Node* raw = node.get();
+    cache[page] = {std::move(node), lru.begin()};
+    return raw;
+}
+
+void BTreeStorage::dropCached(uint32_t page) {
+    auto it = cache.find(page);
+    if (it == cache.end()) return;
+    lru.erase(it->second.position);
+    cache.erase(it);
+}
+
+// Runs only between operations, so no caller holds a Node pointer
+void BTreeStorage::trimCache() {
+    while (cache.size() > cachePages) {
+        uint32_t page = lru.back();
+        Node& node = *cache[page].node;
+        if (node.dirty) {
+            if (!writeNode(page, node)) {
+                failed = true;
+                return;
+            }
+            node.dirty = false;
+        }
+        lru.pop_back();
+        cache.erase(page);
+    }
+}
+
+bool BTreeStorage::writeNode(uint32_t page, const Node& node) {
+    char buffer[PAGE_SIZE];
+    encode(node, buffer);
+    if (!writePage(fd, page, buffer)) {
+        cerr << "Error: Could not write page " << page << " of " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// --- Copy on write ---
+
+uint32_t BTreeStorage::allocate() {
+    if (!freePages.empty()) {
+        uint32_t page = freePages.back();
+        freePages.pop_back();
+        return page;
+    }
+    return pages++;
+}
+
+void BTreeStorage::release(uint32_t page) {
+    dropCached(page);
+    if (fresh.erase(page)) {
+        freePages.push_back(page);  // Never part of a flushed tree
+    } else {
+        pendingFree.push_back(page);
+    }
+}
+
+// The page to change in place of page: itself if it was written since the
+// last flush, otherwise a fresh copy. Returns 0 on error.
+uint32_t BTreeStorage::writable(uint32_t page) {
+    Node* node = load(page);
+    if (!node) return 0;
+    if (fresh.count(page)) {
+        node->dirty = true;
+        return page;
+    }
+    unique_ptr<Node> copy(new Node(*node));
+    copy->dirty = true;
+    dropCached(page);
+    pendingFree.push_back(page);
+    uint32_t target = allocate();
+    fresh.insert(target);
+    cacheNode(target, std::move(copy));
+    return target;
+}
+
+uint32_t BTreeStorage::newNode(bool leaf) {
+    uint32_t page = allocate();
+    fresh.insert(page);
+    unique_ptr<Node> node(new Node());
+    node->leaf = leaf;
+    node->dirty = true;
+    cacheNode(page, std::move(node));
+    return page;
+}
+
+// --- Operations ---
+
+bool BTreeStorage::get(const string& key, string& value) {
+    if (fd < 0 || root == 0) return false;
+    failed = false;
+    bool found = false;
+    uint32_t page = root;
+    while (Node* node = load(page)) {
+        if (node->leaf) {
+            auto it = lower_bound(node->keys.begin(), node->keys.end(), key);
+            if (it != node->keys.end() && *it == key) {
+                value = node->values[it - node->keys.begin()];
+                found = true;
+            }
+            break;
+        }
+        page = node->children[upper_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin()];
+    }
+    trimCache();
+    return found;
+}
+
+bool BTreeStorage::put(const string& key, const string& value) {
+    if (fd < 0) return false;
+    if (key.size() + value.size() > MAX_RECORD_SIZE) {
+        cerr << "Error: Record " << key.substr(0, 64) << " is too large for " << path << "\n";
+        return false;
+    }
+    failed = false;
+    if (root == 0) root = newNode(true);
+    Split split;
+    uint32_t top = insert(root, key, value, split);
+    if (top != 0 && split.right != 0) {
+        uint32_t newRoot = newNode(false);
+        Node* node = load(newRoot);
+        node->keys.push_back(split.key);
+        node->children = {top, split.right};
+        top = newRoot;
+    }
+    if (top != 0) {
+        root = top;
+        changed = true;
+    }
+    trimCache();
+    return top != 0 && !failed;
+}
+
+// Returns the page now holding page's subtree, or 0 on error
+uint32_t BTreeStorage::insert(uint32_t page, const string& key, const string& value, Split& split) {
+    uint32_t target = writable(page);
+    if (target == 0) return 0;
+    Node* node = load(target);
+    if (node->leaf) {
+        auto it = lower_bound(node->keys.begin(), node->keys.end(), key);
+        size_t i = it - node->keys.begin();
+        if (it != node->keys.end() && *it == key) {
+            node->values[i] = value;
+        } else {
+            node->keys.insert(it, key);
+            node->values.insert(node->values.begin() + i, value);
+            ++recordCount;
+        }
+    } else {
+        size_t i = upper_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin();
+        Split childSplit;
+        uint32_t child = insert(node->children[i], key, value, childSplit);
+        if (child == 0) return 0;
+        node->children[i] = child;
+        if (childSplit.right != 0) {
+            node->keys.insert(node->keys.begin() + i, childSplit.key);
+            node->children.insert(node->children.begin() + i + 1, childSplit.right);
+        }
+    }
+    if (encodedSize(*node) > PAGE_SIZE) splitNode(target, split);
+    return target;
+}
+
+// Moves the upper half of an overfull node, by encoded size, to a new page
+void BTreeStorage::splitNode(uint32_t page, Split& split) {
+    split.right = newNode(load(page)->leaf);
+    Node* right = load(split.right);
+    Node* node = load(page);
+
+    size_t total = encodedSize(*node), half = 0, at = 0;
+    while (at + 1 < node->keys.size()) {
+        half += node->leaf ? 4 + node->keys[at].size() + node->values[at].size() : 6 + node->keys[at].size();
+        if (half > total / 2) break;
+        ++at;
+    }
+    at = max<size_t>(at, 1);
+    if (node->leaf) {
+        right->keys.assign(node->keys.begin() + at, node->keys.end());
+        right->values.assign(node->values.begin() + at, node->values.end());
+        node->keys.resize(at);
+        node->values.resize(at);
+        split.key = right->keys.front();
+    } else {
+        // The middle key moves up; the children on each side stay with it
+        split.key = node->keys[at];
+        right->keys.assign(node->keys.begin() + at + 1, node->keys.end());
+        right->children.assign(node->children.begin() + at + 1, node->children.end());
+        node->keys.resize(at);
+        node->children.resize(at + 1);
+    }
+}
+
+bool BTreeStorage::erase(const string& key) {
+    string value;
+    if (!get(key, value)) return false;
+    failed = false;
+    uint32_t top = remove(root, key);
+    if (failed) {
+        trimCache();
+        return false;
+    }
+    root = top;
+    // An internal root with a single child is replaced by that child
+    while (root != 0) {
+        Node* node = load(root);
+        if (!node || node->leaf || node->children.size() > 1) break;
+        uint32_t only = node->children[0];
+        release(root);
+        root = only;
+    }
+    changed = true;
+    trimCache();
+    return !failed;
+}
+
+// Returns the page now holding page's subtree, or 0 if it became empty
+// (or on error, with failed set). The key must be present.
+uint32_t BTreeStorage::remove(uint32_t page, const string& key) {
+    uint32_t target = writable(page);
+    if (target == 0) return 0;
+    Node* node = load(target);
+    if (node->leaf) {
+        size_t i = lower_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin();
+        node->keys.erase(node->keys.begin() + i);
+        node->values.erase(node->values.begin() + i);
+        --recordCount;
+    } else {
+        size_t i = upper_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin();
+        uint32_t child = remove(node->children[i], key);
+        if (failed) return 0;
+        if (child != 0) {
+            node->children[i] = child;
+        } else {
+            node->children.erase(node->children.begin() + i);
+            if (!node->keys.empty()) node->keys.erase(node->keys.begin() + (i == 0 ? 0 : i - 1));
+        }
+    }
+    if (node->keys.empty() && (node->leaf || node->children.empty())) {
+        release(target);
+        return 0;
+    }
+    return target;
+}
+
+void BTreeStorage::scan(const string& from, const string& to, const Visitor& visit) {
+    if (fd < 0 || root == 0 || (!to.empty() && to <= from)) return;
+    failed = false;
+    scanFrom(root, from, to, visit);
+    trimCache();
+}
+
+// False once the scan is over
+bool BTreeStorage::scanFrom(uint32_t page, const string& from, const string& to, const Visitor& visit) {
+    Node* node = load(page);
+    if (!node) return false;
+    if (node->leaf) {
+        size_t i = lower_bound(node->keys.begin(), node->keys.end(), from) - node->keys.begin();
+        for (; i < node->keys.size(); ++i) {
+            if (!to.empty() && node->keys[i] >= to) return false;
+            if (!visit(node->keys[i], node->values[i])) return false;
+        }
+        return true;
+    }
+    // Copied, so the cache can be trimmed while the children are walked
+    size_t first = upper_bound(node->keys.begin(), node->keys.end(), from) - node->keys.begin();
+    vector<uint32_t> children(node->children.begin() + first, node->children.end());
+    vector<string> bounds(node->keys.begin() + first, node->keys.end());  // bounds[j - 1] starts children[j]
+    for (size_t j = 0; j < children.size(); ++j) {
+        if (j > 0 && !to.empty() && bounds[j - 1] >= to) return false;
+        if (!scanFrom(children[j], from, to, visit)) return false;
+        trimCache();
+    }
+    return true;
+}
+
+bool BTreeStorage::flush() {
+    if (fd < 0) return false;
+    if (!changed) return true;
+
+    // After this flush the pages it drops and the previous free list's
+    // pages are reusable too. The new list itself goes on pages that are
+    // already free, which no flushed tree refers to.
+    vector<uint32_t> reusable = pendingFree;
+    reusable.insert(reusable.end(), freeListPages.begin(), freeListPages.end());
+    vector<uint32_t> listPages;
+    while (listPages.size() * FREE_PER_PAGE < reusable.size() + freePages.size()) {
+        listPages.push_back(allocate());
+    }
+    reusable.insert(reusable.end(), freePages.begin(), freePages.end());
+
+    bool ok = true;
+    for (auto& [page, entry] : cache) {
+        if (!entry.node->dirty) continue;
+        if (!writeNode(page, *entry.node)) {
+            ok = false;
+            break;
+        }
+        entry.node->dirty = false;
+    }
+    char buffer[PAGE_SIZE];
+    for (size_t i = 0; ok && i < listPages.size(); ++i) {
+        memset(buffer, 0, PAGE_SIZE);
+        size_t first = i * FREE_PER_PAGE;
+        size_t count = min(FREE_PER_PAGE, reusable.size() - first);
+        buffer[0] = static_cast<char>(FREE_PAGE);
+        put16(buffer + 2, count);
+        put32(buffer + PAGE_HEADER, i + 1 < listPages.size() ? listPages[i + 1] : 0);
+        for (size_t j = 0; j < count; ++j) put32(buffer + PAGE_HEADER + 4 + j * 4, reusable[first + j]);
+        put32(buffer + 4, pageChecksum(buffer));
+        ok = writePage(fd, listPages[i], buffer);
+    }
+    ok = ok && syncFd(fd);
+
+    // The meta page the last flush did not use; the old one stays valid
+    // until this one is on disk
+    Meta meta{};
+    memcpy(meta.magic, MAGIC, sizeof(MAGIC));
+    meta.version = VERSION;
+    meta.pageSize = PAGE_SIZE;
+    meta.generation = generation + 1;
+    meta.recordCount = recordCount;
+    meta.root = root;
+    meta.pageCount = pages;
+    meta.freeHead = listPages.empty() ? 0 : listPages.front();
+    meta.freeCount = static_cast<uint32_t>(reusable.size());
+    meta.checksum = metaChecksum(meta);
+    memset(buffer, 0, PAGE_SIZE);
+    memcpy(buffer, &meta, sizeof(meta));
+    ok = ok && writePage(fd, static_cast<uint32_t>(meta.generation % 2), buffer) && syncFd(fd);
+    if (!ok) {
+        cerr << "Error: Could not flush " << path << ", changes kept in memory\n";
+        freePages.insert(freePages.end(), listPages.begin(), listPages.end());
+        return false;
+    }
+
+    generation = meta.generation;
+    freePages = std::move(reusable);
+    pendingFree.clear();
+    freeListPages = std::move(listPages);
+    fresh.clear();
+    changed = false;
+    return true;
+}
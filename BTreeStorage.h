@@ -0,0 +1,126 @@
+#ifndef BTREE_STORAGE_H
+#define BTREE_STORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "StorageEngine.h"
+
+// Records in one file, as a copy-on-write B+tree of fixed-size pages.
+//
+// A page that belongs to the last flushed tree is never written again:
+// the first change to it after a flush goes to a copy on a free page, and
+// so does every page on the path up to the root. flush() writes the
+// changed pages, syncs, then writes the meta page the previous flush did
+// not use and syncs again. Opening picks the meta page with the highest
+// generation and a valid checksum, so a crash at any point leaves the
+// file as of the last flush. Pages the tree no longer uses are listed in
+// free pages and reused once the flush that dropped them is durable.
+//
+// Every page carries a CRC-32. Leaves hold sorted key/value pairs,
+// internal pages separator keys and child page numbers. There are no
+// sibling links (they would spread each copy to the neighbours), so scans
+// walk down from the root. Pages are decoded into a cache of cachePages
+// nodes with the least recently used evicted first; a changed page
+// evicted before the flush is written early, to its copy. Erasing does
+// not merge underfull pages; a page left empty is dropped from its parent.
+//
+// Page layout (little-endian):
+//   meta (pages 0 and 1): "AMSBTRE1" version pageSize generation recordCount
+//                         root pageCount freeHead freeCount checksum
+//   leaf:     type=1 0 count:u16 checksum:u32, count x (keyLength:u16 valueLength:u16 key value)
+//   internal: type=2 0 count:u16 checksum:u32 child:u32, count x (keyLength:u16 key child:u32)
+//   free:     type=3 0 count:u16 checksum:u32 next:u32, count x page:u32
+class BTreeStorage : public StorageEngine {
+public:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+    static constexpr std::size_t MAX_RECORD_SIZE = 1024;  // Key plus value
+    static constexpr std::size_t DEFAULT_CACHE_PAGES = 4096;
+
+    explicit BTreeStorage(const std::string& path, std::size_t cachePages = DEFAULT_CACHE_PAGES);
+    ~BTreeStorage() override;
+
+    BTreeStorage(const BTreeStorage&) = delete;
+    BTreeStorage& operator=(const BTreeStorage&) = delete;
+
+    bool isOpen() const override { return fd >= 0; }
+    bool get(const std::string& key, std::string& value) override;
+    bool put(const std::string& key, const std::string& value) override;
+    bool erase(const std::string& key) override;
+    void scan(const std::string& from, const std::string& to, const Visitor& visit) override;
+    std::size_t size() const override { return static_cast<std::size_t>(recordCount); }
+    bool flush() override;
+
+    uint32_t pageCount() const { return pages; }
+
+private:
+    struct Node {
+        bool leaf = true;
+        bool dirty = false;
+        std::vector<std::string> keys;
+        std::vector<std::string> values;   // Leaf only
+        std::vector<uint32_t> children;    // Internal only, one more than keys
+    };
+
+    struct CachedNode {
+        std::unique_ptr<Node> node;
+        std::list<uint32_t>::iterator position;
+    };
+
+    // A node that outgrew its page: right takes the upper half, separated
+    // by key
+    struct Split {
+        uint32_t right = 0;
+        std::string key;
+    };
+
+    std::string path;
+    std::size_t cachePages;
+    int fd = -1;
+
+    // State as of the last flush, plus changes since
+    uint64_t generation = 0;
+    uint64_t recordCount = 0;
+    uint32_t root = 0;  // 0 while the tree is empty
+    uint32_t pages = 2;
+    bool changed = false;
+    bool failed = false;  // Set by page I/O errors during an operation
+
+    std::vector<uint32_t> freePages;      // Reusable now
+    std::vector<uint32_t> pendingFree;    // Dropped since the last flush, still in its tree
+    std::vector<uint32_t> freeListPages;  // Hold the free list of the last flush
+    std::unordered_set<uint32_t> fresh;   // Written since the last flush, changed in place
+
+    std::unordered_map<uint32_t, CachedNode> cache;
+    std::list<uint32_t> lru;  // Most recent first
+
+    bool openFile();
+    bool readFreeList(uint32_t head);
+
+    Node* load(uint32_t page);
+    Node* cacheNode(uint32_t page, std::unique_ptr<Node> node);
+    void dropCached(uint32_t page);
+    void trimCache();
+    bool writeNode(uint32_t page, const Node& node);
+
+    uint32_t allocate();
+    void release(uint32_t page);
+    uint32_t writable(uint32_t page);
+    uint32_t newNode(bool leaf);
+
+    uint32_t insert(uint32_t page, const std::string& key, const std::string& value, Split& split);
+    uint32_t remove(uint32_t page, const std::string& key);
+    void splitNode(uint32_t page, Split& split);
+    bool scanFrom(uint32_t page, const std::string& from, const std::string& to, const Visitor& visit);
+
+    static std::size_t encodedSize(const Node& node);
+    static void encode(const Node& node, char* page);
+    static bool decode(const char* page, Node& node);
+};
+
+#endif
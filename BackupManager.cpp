@@ -0,0 +1,383 @@
+#include "BackupManager.h"
+#include "AppointmentArchive.h"
+#include "Utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+    const char* const MANIFEST_FILE = "MANIFEST";
+    const char* const MANIFEST_TAG = "AMS_BACKUP";
+
+    // Data files that are only replaced whole, by atomic rename
+    const vector<string> WHOLE_FILES = {"ams.snap", "users.dat", "doctors.dat", "patients.dat", "appointments.idx",
+                                      "medical_history.idx", "medical_history.search"};
+    // Data files changed in place, such as B+tree storage files; always
+    // copied, since a hard link would follow later changes
+    const vector<string> IN_PLACE_FILES = {"users.db"};
+    // Data files that only grow between compactions
+    const vector<string> APPEND_ONLY_FILES = {"ams.journal", "appointments.store", "medical_history.log",
+                                             "appointment_events.log"};
+
+    // WHOLE_FILES and IN_PLACE_FILES plus the appointment archive segments
+    // present in dataDir, which are also only ever replaced whole
+    vector<string> wholeFiles(const string& dataDir) {
+        vector<string> names = WHOLE_FILES;
+        names.insert(names.end(), IN_PLACE_FILES.begin(), IN_PLACE_FILES.end());
+        error_code ec;
+        for (const auto& entry : filesystem::directory_iterator(dataDir, ec)) {
+            string name = entry.path().filename().string();
+            if (AppointmentArchive::isSegmentFile(name)) names.push_back(name);
+        }
+        return names;
+    }
+
+    // Bytes compared to tell an appended file from a rewritten one
+    const uint64_t CONTINUATION_CHECK_BYTES = 4096;
+
+    bool linkOrCopy(const string& from, const string& to) {
+        error_code ec;
+        filesystem::remove(to, ec);
+        string name = filesystem::path(from).filename().string();
+        if (find(IN_PLACE_FILES.begin(), IN_PLACE_FILES.end(), name) == IN_PLACE_FILES.end()) {
+            filesystem::create_hard_link(from, to, ec);
+            if (!ec) return true;
+        }
+        return filesystem::copy_file(from, to, filesystem::copy_options::overwrite_existing, ec) && !ec;
+    }
+
+    bool copyRange(const string& from, uint64_t offset, uint64_t length, ostream& out) {
+        ifstream in(from, ios::binary);
+        if (!in.is_open()) return false;
+        in.seekg(static_cast<streamoff>(offset));
+        char buffer[64 * 1024];
+        while (length > 0 && in) {
+            streamsize chunk = static_cast<streamsize>(min<uint64_t>(length, sizeof(buffer)));
+            in.read(buffer, chunk);
+            out.write(buffer, in.gcount());
+            length -= static_cast<uint64_t>(in.gcount());
+        }
+        return length == 0 && static_cast<bool>(out);
+    }
+
+    string readRange(const string& path, uint64_t offset, uint64_t length) {
+        string bytes(length, '\0');
+        ifstream in(path, ios::binary);
+        in.seekg(static_cast<streamoff>(offset));
+        if (!in.read(&bytes[0], static_cast<streamsize>(length))) return string();
+        return bytes;
+    }
+
+    // IDs sort in creation order, which retention and restore rely on, so
+    // a new one must sort after every existing one
+    string newGenerationId(const string& backupDir, const vector<string>& existing) {
+        time_t now = time(nullptr);
+        ostringstream base;
+        base << put_time(localtime(&now), "%Y%m%d-%H%M%S");
+        string id = base.str();
+        for (int n = 2; filesystem::exists(backupDir + "/" + id) || (!existing.empty() && id <= existing.back()); ++n) {
+            ostringstream numbered;
+            numbered << base.str() << "-" << setw(2) << setfill('0') << n;
+            id = numbered.str();
+        }
+        return id;
+    }
+}
+
+const BackupManager::Entry* BackupManager::Manifest::find(const string& name) const {
+    for (const Entry& entry : entries) {
+        if (entry.name == name) return &entry;
+    }
+    return nullptr;
+}
+
+BackupManager::BackupManager()
+    : dataDir(Utils::DATA_DIR), backupDir(Utils::getDataPath("backups")) {}
+
+BackupManager& BackupManager::instance() {
+    static BackupManager manager;
+    return manager;
+}
+
+void BackupManager::keepPreviousVersion(const string& path) {
+    if (!filesystem::exists(path)) return;
+    if (!linkOrCopy(path, path + ".bak")) {
+        cerr << "Warning: Could not keep previous version of " << path << "\n";
+    }
+}
+
+string BackupManager::generationPath(const string& id) const {
+    return backupDir + "/" + id;
+}
+
+string BackupManager::segmentFile(const string& id, const Entry& entry) const {
+    return generationPath(id) + "/" + entry.name + "." + to_string(entry.offset) + ".seg";
+}
+
+// Generations without a manifest were interrupted and are not listed
+vector<string> BackupManager::generationIds() const {
+    vector<string> ids;
+    error_code ec;
+    for (const auto& dir : filesystem::directory_iterator(backupDir, ec)) {
+        if (dir.is_directory() && filesystem::exists(dir.path() / MANIFEST_FILE)) {
+            ids.push_back(dir.path().filename().string());
+        }
+    }
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool BackupManager::readManifest(const string& id, Manifest& manifest) const {
+    ifstream in(generationPath(id) + "/" + MANIFEST_FILE);
+    string line, tag;
+    int version = 0;
+    long long created = 0;
+    if (!getline(in, line) || !(istringstream(line) >> tag >> version >> created) ||
+        tag != MANIFEST_TAG || version != MANIFEST_VERSION) {
+        return false;
+    }
+    manifest.created = static_cast<time_t>(created);
+    manifest.entries.clear();
+    while (getline(in, line)) {
+        istringstream fields(line);
+        Entry entry;
+        fields >> tag >> entry.name;
+        if (tag == "FULL") {
+            fields >> entry.length;
+        } else if (tag == "SEGMENT") {
+            entry.segment = true;
+            fields >> entry.offset >> entry.length;
+        } else {
+            return false;
+        }
+        if (!fields) return false;
+        manifest.entries.push_back(entry);
+    }
+    return true;
+}
+
+bool BackupManager::writeManifest(const string& id, const Manifest& manifest) const {
+    return Utils::writeFileAtomically(generationPath(id) + "/" + MANIFEST_FILE, [&manifest](ostream& out) {
+        out << MANIFEST_TAG << " " << MANIFEST_VERSION << " " << static_cast<long long>(manifest.created) << "\n";
+        for (const Entry& entry : manifest.entries) {
+            if (entry.segment) {
+                out << "SEGMENT " << entry.name << " " << entry.offset << " " << entry.length << "\n";
+            } else {
+                out << "FULL " << entry.name << " " << entry.length << "\n";
+            }
+        }
+    });
+}
+
+// Where the next segment of an append-only file starts: the end of the
+// backed-up chain if the file still holds the same bytes there, otherwise
+// 0 because the file was truncated or compacted since.
+uint64_t BackupManager::appendedFrom(const string& path, const string& name, const vector<string>& ids) const {
+    error_code ec;
+    uint64_t size = filesystem::file_size(path, ec);
+    if (ec) return 0;
+
+    // The newest segment that holds bytes; empty ones in between only
+    // record that nothing was appended
+    uint64_t end = UINT64_MAX;
+    for (size_t i = ids.size(); i-- > 0;) {
+        Manifest manifest;
+        if (!readManifest(ids[i], manifest)) return 0;
+        const Entry* entry = manifest.find(name);
+        if (!entry || !entry->segment) return 0;
+        if (end == UINT64_MAX) end = entry->offset + entry->length;
+        if (entry->offset + entry->length != end || size < end) return 0;
+        if (entry->length == 0) {
+            if (entry->offset == 0) return 0;
+            continue;
+        }
+
+        uint64_t check = min(entry->length, CONTINUATION_CHECK_BYTES);
+        string stored = readRange(segmentFile(ids[i], *entry), entry->length - check, check);
+        string current = readRange(path, end - check, check);
+        return !stored.empty() && stored == current ? end : 0;
+    }
+    return 0;
+}
+
+bool BackupManager::writeChain(ostream& out, const vector<string>& ids, size_t index, const string& name) const {
+    // Walk back to the generation holding offset 0, then replay forward
+    vector<pair<string, Entry>> chain;
+    uint64_t needEnd = UINT64_MAX;
+    for (size_t i = index + 1; i-- > 0;) {
+        Manifest manifest;
+        if (!readManifest(ids[i], manifest)) return false;
+        const Entry* entry = manifest.find(name);
+        if (!entry || !entry->segment) return false;
+        if (needEnd != UINT64_MAX && entry->offset + entry->length != needEnd) return false;
+        chain.push_back({ids[i], *entry});
+        if (entry->offset == 0) break;
+        needEnd = entry->offset;
+    }
+    if (chain.empty() || chain.back().second.offset != 0) return false;
+
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!copyRange(segmentFile(it->first, it->second), 0, it->second.length, out)) return false;
+    }
+    return true;
+}
+
+string BackupManager::createBackup(bool quiet) {
+    vector<string> ids = generationIds();
+    string id = newGenerationId(backupDir, ids);
+    string target = generationPath(id);
+    error_code ec;
+    filesystem::create_directories(target, ec);
+    if (ec) {
+        cerr << "Error: Could not create backup directory " << target << ": " << ec.message() << "\n";
+        return "";
+    }
+
+    Manifest manifest;
+    manifest.created = time(nullptr);
+    bool ok = true;
+    for (const string& name : wholeFiles(dataDir)) {
+        string path = dataDir + "/" + name;
+        if (!filesystem::exists(path)) continue;
+        Entry entry{name, false, 0, filesystem::file_size(path, ec)};
+        ok = ok && linkOrCopy(path, target + "/" + name);
+        manifest.entries.push_back(entry);
+    }
+    for (const string& name : APPEND_ONLY_FILES) {
+        string path = dataDir + "/" + name;
+        if (!filesystem::exists(path)) continue;
+        uint64_t size = filesystem::file_size(path, ec);
+        Entry entry{name, true, appendedFrom(path, name, ids), 0};
+        entry.length = size - entry.offset;
+        ofstream out(segmentFile(id, entry), ios::binary | ios::trunc);
+        ok = ok && out.is_open() && copyRange(path, entry.offset, entry.length, out);
+        manifest.entries.push_back(entry);
+    }
+
+    // The manifest goes last: a generation without one is incomplete
+    if (!ok || !writeManifest(id, manifest)) {
+        cerr << "Error: Backup " << id << " failed\n";
+        filesystem::remove_all(target, ec);
+        return "";
+    }
+    if (!quiet) {
+        cout << "Backup " << id << " created.\n";
+    }
+    applyRetention();
+    return id;
+}
+
+vector<BackupManager::BackupInfo> BackupManager::listBackups() const {
+    vector<BackupInfo> backups;
+    for (const string& id : generationIds()) {
+        Manifest manifest;
+        if (!readManifest(id, manifest)) continue;
+        BackupInfo info{id, manifest.created, 0};
+        for (const Entry& entry : manifest.entries) {
+            if (entry.segment) info.storedBytes += entry.length;
+        }
+        backups.push_back(info);
+    }
+    return backups;
+}
+
+bool BackupManager::restore(const string& id) {
+    vector<string> ids = generationIds();
+    auto found = find(ids.begin(), ids.end(), id);
+    Manifest manifest;
+    if (found == ids.end() || !readManifest(id, manifest)) {
+        cerr << "Error: No backup with ID " << id << "\n";
+        return false;
+    }
+    size_t index = static_cast<size_t>(found - ids.begin());
+
+    // Rebuild every file beside its target first, so a failure part way
+    // leaves the current data untouched
+    vector<string> staged;
+    bool ok = true;
+    for (const Entry& entry : manifest.entries) {
+        string tmp = dataDir + "/" + entry.name + ".restore";
+        ofstream out(tmp, ios::binary | ios::trunc);
+        ok = out.is_open() &&
+             (entry.segment ? writeChain(out, ids, index, entry.name)
+                            : copyRange(generationPath(id) + "/" + entry.name, 0, entry.length, out));
+        out.close();
+        staged.push_back(tmp);
+        if (!ok) {
+            cerr << "Error: Backup " << id << " is damaged, could not restore " << entry.name << "\n";
+            break;
+        }
+    }
+    error_code ec;
+    if (!ok) {
+        for (const string& tmp : staged) filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    createBackup(true);  // The state being replaced stays recoverable
+
+    for (const Entry& entry : manifest.entries) {
+        filesystem::rename(dataDir + "/" + entry.name + ".restore", dataDir + "/" + entry.name, ec);
+        if (ec) {
+            cerr << "Error: Could not restore " << entry.name << ": " << ec.message() << "\n";
+            return false;
+        }
+    }
+    const vector<string> tracked = wholeFiles(dataDir);
+    for (const vector<string>* names : {&tracked, &APPEND_ONLY_FILES}) {
+        for (const string& name : *names) {
+            if (!manifest.find(name)) filesystem::remove(dataDir + "/" + name, ec);
+        }
+    }
+    cout << "Backup " << id << " restored.\n";
+    return true;
+}
+
+// Drops generations outside the policy. A kept generation may continue a
+// segment chain that starts in a dropped one, so those chains are first
+// folded into a single segment at offset 0 in the oldest kept generation.
+void BackupManager::applyRetention() {
+    vector<string> ids = generationIds();
+    if (ids.size() <= 1) return;
+
+    time_t cutoff = retention.maxAgeDays > 0 ? time(nullptr) - time_t(retention.maxAgeDays) * 24 * 3600 : 0;
+    // Only the oldest generations can go, and only those that are both
+    // beyond the newest keepLast and older than the cutoff
+    size_t firstKept = 0;
+    while (firstKept + 1 < ids.size() && ids.size() - firstKept > retention.keepLast) {
+        Manifest manifest;
+        bool tooOld = cutoff > 0 && readManifest(ids[firstKept], manifest) && manifest.created < cutoff;
+        if (!tooOld) break;
+        ++firstKept;
+    }
+    if (firstKept == 0) return;
+
+    Manifest oldest;
+    if (!readManifest(ids[firstKept], oldest)) return;
+    bool rebased = false;
+    for (Entry& entry : oldest.entries) {
+        if (!entry.segment || entry.offset == 0) continue;
+        Entry folded{entry.name, true, 0, entry.offset + entry.length};
+        ofstream out(segmentFile(ids[firstKept], folded), ios::binary | ios::trunc);
+        if (!out.is_open() || !writeChain(out, ids, firstKept, entry.name)) {
+            cerr << "Warning: Could not fold backup chain of " << entry.name << ", old backups kept\n";
+            return;
+        }
+        out.close();
+        error_code ec;
+        filesystem::remove(segmentFile(ids[firstKept], entry), ec);
+        entry = folded;
+        rebased = true;
+    }
+    if (rebased && !writeManifest(ids[firstKept], oldest)) return;
+
+    for (size_t i = 0; i < firstKept; ++i) {
+        error_code ec;
+        filesystem::remove_all(generationPath(ids[i]), ec);
+    }
+}
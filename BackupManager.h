@@ -0,0 +1,93 @@
+#ifndef BACKUP_MANAGER_H
+#define BACKUP_MANAGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Point-in-time backups of the data directory, kept under data/backups.
+//
+// Each backup is a generation directory with a MANIFEST. Files that are
+// only ever replaced whole (snapshot, users.dat, archive segments, ...)
+// are hard-linked into it, falling back to a copy where links are not
+// supported, so a backup costs no data I/O for them. Append-only files (journal, appointment
+// store) are stored incrementally: a generation holds just the bytes
+// appended since the previous one, and restore joins the chain back up.
+//
+// Manifest layout (text):
+//   AMS_BACKUP <version> <unix time>
+//   FULL <name> <size>
+//   SEGMENT <name> <offset> <length>
+class BackupManager {
+public:
+    struct RetentionPolicy {
+        std::size_t keepLast = 5;  // Newest generations always kept
+        int maxAgeDays = 30;       // Older ones beyond keepLast are dropped; 0 keeps all
+    };
+
+    struct BackupInfo {
+        std::string id;
+        std::time_t created = 0;
+        uint64_t storedBytes = 0;  // Bytes held by this generation alone
+    };
+
+    static BackupManager& instance();
+
+    void setRetentionPolicy(const RetentionPolicy& policy) { retention = policy; }
+    const RetentionPolicy& retentionPolicy() const { return retention; }
+
+    // Keeps the current contents of path as path.bak before the caller
+    // replaces it. Callers write through Utils::writeFileAtomically, which
+    // renames a new file over the old one, so a hard link is enough.
+    static void keepPreviousVersion(const std::string& path);
+
+    // Backs up every tracked data file and applies the retention policy.
+    // Returns the new generation ID, or "" on failure.
+    std::string createBackup(bool quiet = false);
+
+    // Oldest first
+    std::vector<BackupInfo> listBackups() const;
+
+    // Puts the data files back as they were in generation id. The current
+    // files are backed up first. Tracked files missing from the generation
+    // are removed. The caller must close the journal before and reload all
+    // data after.
+    bool restore(const std::string& id);
+
+private:
+    struct Entry {
+        std::string name;
+        bool segment = false;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    struct Manifest {
+        std::time_t created = 0;
+        std::vector<Entry> entries;
+        const Entry* find(const std::string& name) const;
+    };
+
+    static const int MANIFEST_VERSION = 1;
+
+    std::string dataDir;
+    std::string backupDir;
+    RetentionPolicy retention;
+
+    BackupManager();
+
+    std::vector<std::string> generationIds() const;
+    std::string generationPath(const std::string& id) const;
+    std::string segmentFile(const std::string& id, const Entry& entry) const;
+    bool readManifest(const std::string& id, Manifest& manifest) const;
+    bool writeManifest(const std::string& id, const Manifest& manifest) const;
+
+    uint64_t appendedFrom(const std::string& path, const std::string& name, const std::vector<std::string>& ids) const;
+    bool writeChain(std::ostream& out, const std::vector<std::string>& ids, std::size_t index,
+                    const std::string& name) const;
+    void applyRetention();
+};
+
+#endif
@@ -1,87 +1,51 @@
 #include "CancelAppointmentManager.h"
+#include "AppointmentEvents.h"
+#include "AppointmentRegistry.h"
+#include "Journal.h"
 #include <iostream>
-#include <queue>
 
 using namespace std;
 
-void CancelAppointmentManager::cancelAppointment(Doctor* doctor, const string& patientID) {
-    if (!doctor) {
-        cout << "Doctor is null.\n";
-        return;
+bool CancelAppointmentManager::cancelAppointment(uint32_t appointmentId, bool quiet) {
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    const AppointmentRegistry::Location* location = registry.locate(appointmentId);
+    if (!location) {
+        cout << "No appointment found with ID: " << appointmentId << endl;
+        return false;
     }
 
-    bool found = false;
+    Doctor* doctor = location->doctor;
+    const Appointment& app = doctor->appointments[location->doctorIndex];
+    freeUpSlot(doctor, app, location->slotIndex);
 
-    // First try to find and remove from regular appointments
-    removeFromRegularAppointments(doctor, patientID);
-
-    // Then try emergency appointments
-    removeFromEmergencyAppointments(doctor, patientID);
-
-    // Finally, remove from the main appointments vector
-    auto& appointments = doctor->appointments;
-    for (auto it = appointments.begin(); it != appointments.end(); ) {
-        if (it->patient && it->patient->patientID == patientID) {
-            // Free up the corresponding slot
-            freeUpSlot(doctor, it->time, it->isEmergency);
-            
-            cout << "Cancelled appointment for patient " << it->patient->name 
-                 << " on " << it->date << " at " << it->time;
-            if (it->isEmergency) cout << " [EMERGENCY]";
-            cout << endl;
-            
-            it = appointments.erase(it);
-            found = true;
-        } else {
-            ++it;
-        }
+    if (!quiet) {
+        cout << "Cancelled appointment #" << appointmentId << " for patient "
+             << (app.patient ? app.patient->getName() : string("Unknown"))
+             << " on " << app.getDate() << " at " << app.getTime();
+        if (app.isEmergency()) cout << " [EMERGENCY]";
+        cout << endl;
     }
 
-    if (!found) {
-        cout << "No appointment found for patient ID: " << patientID << endl;
-    }
-}
-
-void CancelAppointmentManager::removeFromRegularAppointments(Doctor* doctor, const string& patientID) {
-    queue<Appointment>& regularAppts = doctor->getRegularAppointments();
-    queue<Appointment> tempQueue;
+    bool freedEmergencySlot = app.isEmergency() && location->slotIndex != AppointmentRegistry::NO_SLOT;
+    AppointmentEventLog::instance().cancelled(app);  // app goes with the erase
+    registry.erase(appointmentId);
+    Journal::instance().appointmentCancelled(appointmentId);
 
-    while (!regularAppts.empty()) {
-        Appointment app = regularAppts.front();
-        regularAppts.pop();
-
-        if (!(app.patient && app.patient->patientID == patientID)) {
-            tempQueue.push(app);
-        }
+    // The freed slot goes to whoever waits longest at the highest urgency.
+    // Replay skips this: the booking it makes has its own journal records.
+    if (freedEmergencySlot && !quiet) {
+        doctor->serveEmergencyQueue();
     }
-
-    regularAppts = tempQueue;
+    return true;
 }
 
-void CancelAppointmentManager::removeFromEmergencyAppointments(Doctor* doctor, const string& patientID) {
-    vector<Slot>& emergencySlots = doctor->getEmergencySlots();
-    for (auto& slot : emergencySlots) {
-        if (slot.isBooked && slot.appointment.patient && 
-            slot.appointment.patient->patientID == patientID) {
-            slot.isBooked = false;
-        }
-    }
-}
+void CancelAppointmentManager::freeUpSlot(Doctor* doctor, const Appointment& appointment, int32_t slotIndex) {
+    if (slotIndex == AppointmentRegistry::NO_SLOT) return;
 
-void CancelAppointmentManager::freeUpSlot(Doctor* doctor, const string& time, bool isEmergency) {
-    if (isEmergency) {
-        for (auto& slot : doctor->getEmergencySlots()) {
-            if (slot.time == time) {
-                slot.isBooked = false;
-                break;
-            }
-        }
-    } else {
-        for (auto& slot : doctor->getNormalSlots()) {
-            if (slot.time == time) {
-                slot.isBooked = false;
-                break;
-            }
-        }
+    vector<Slot>& slots = appointment.isEmergency() ? doctor->getEmergencySlots() : doctor->getNormalSlots();
+    Slot& slot = slots[slotIndex];
+    if (slot.appointmentId == appointment.id) {
+        doctor->setSlotBooked(slot, false);
+        slot.appointmentId = Slot::NO_APPOINTMENT;
     }
-} 
\ No newline at end of file
+}
@@ -1,17 +1,15 @@
 #ifndef CANCEL_APPOINTMENT_MANAGER_H
 #define CANCEL_APPOINTMENT_MANAGER_H
 
-#include <string>
+#include <cstdint>
 #include "Doctor.h"
 #include "Patient.h"
 
 class CancelAppointmentManager {
 public:
-    void cancelAppointment(Doctor* doctor, const std::string& patientID);
-private:
-    void removeFromRegularAppointments(Doctor* doctor, const std::string& patientID);
-    void removeFromEmergencyAppointments(Doctor* doctor, const std::string& patientID);
-    void freeUpSlot(Doctor* doctor, const std::string& time, bool isEmergency);
+    bool cancelAppointment(uint32_t appointmentId, bool quiet = false);
+    // Unbooks the slot if it still belongs to the appointment
+    static void freeUpSlot(Doctor* doctor, const Appointment& appointment, int32_t slotIndex);
 };
 
-#endif 
\ No newline at end of file
+#endif 
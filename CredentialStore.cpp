@@ -0,0 +1,147 @@
+#include "CredentialStore.h"
+#include "BackupManager.h"
+#include "Journal.h"
+#include "TextFileStorage.h"
+#include "Utils.h"
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+const char* const CredentialStore::USERS_FILE = "users.dat";
+const char* const CredentialStore::LEGACY_USERS_FILE = "users.txt";
+
+namespace {
+    // Stored values are "password,role"; the password holds no comma
+    bool splitValue(const string& value, CredentialStore::Credential& credential) {
+        size_t comma = value.find(',');
+        if (comma == string::npos) return false;
+        credential.password = value.substr(0, comma);
+        credential.role = value.substr(comma + 1);
+        return true;
+    }
+}
+
+CredentialStore& CredentialStore::instance() {
+    static CredentialStore credentials;
+    return credentials;
+}
+
+bool CredentialStore::open() {
+    index.clear();
+    storage.reset();  // Closed before the file is opened again
+    storage = StorageEngine::openDataFile(Utils::getDataPath(USERS_FILE), ',');
+
+    size_t malformed = 0;
+    index.reserve(storage->size());
+    storage->scan("", "", [&](const string& id, const string& value) {
+        Credential credential;
+        if (splitValue(value, credential)) {
+            index.emplace(id, std::move(credential));
+        } else {
+            ++malformed;
+        }
+        return true;
+    });
+    if (malformed > 0) {
+        cerr << "Warning: " << malformed << " user record(s) without a role were skipped\n";
+    }
+    importLegacyFile(LEGACY_USERS_FILE);
+    return storage->isOpen();
+}
+
+void CredentialStore::importLegacyFile(const string& path) {
+    if (!filesystem::exists(path)) return;
+
+    size_t imported = 0, kept = 0;
+    TextFileStorage legacy(path, ',');
+    legacy.scan("", "", [&](const string& id, const string& value) {
+        Credential credential;
+        if (!splitValue(value, credential)) return true;
+        if (index.count(id)) {
+            ++kept;
+        } else if (store(id, credential.password, credential.role)) {
+            ++imported;
+        }
+        return true;
+    });
+    if (!flush()) {
+        cerr << "Warning: Could not import " << path << ", it is kept\n";
+        return;
+    }
+
+    error_code ec;
+    filesystem::rename(path, path + ".migrated", ec);
+    if (ec) {
+        cerr << "Warning: Could not rename " << path << " after import: " << ec.message() << "\n";
+    }
+    cout << "Imported " << imported << " user(s) from " << path;
+    if (kept > 0) cout << "; " << kept << " already stored were kept";
+    cout << ".\n";
+}
+
+const CredentialStore::Credential* CredentialStore::find(const string& id) {
+    ensureOpen();
+    auto it = index.find(id);
+    return it == index.end() ? nullptr : &it->second;
+}
+
+size_t CredentialStore::size() {
+    ensureOpen();
+    return index.size();
+}
+
+bool CredentialStore::store(const string& id, const string& password, const string& role) {
+    if (!storage->put(id, password + "," + role)) return false;
+    index[id] = Credential{password, role};
+    return true;
+}
+
+bool CredentialStore::add(const string& id, const string& password, const string& role) {
+    ensureOpen();
+    // Commas separate the stored fields, tabs and line breaks the journal's
+    if (index.count(id) || id.find_first_of(",\t\r\n") != string::npos ||
+        password.find_first_of(",\t\r\n") != string::npos ||
+        !store(id, password, role)) {
+        return false;
+    }
+    if (Journal::instance().isOpen()) {
+        Journal::instance().userAdded(id, password, role);
+        return true;
+    }
+    return flush();
+}
+
+bool CredentialStore::remove(const string& id) {
+    ensureOpen();
+    if (index.erase(id) == 0) {
+        return false;
+    }
+    storage->erase(id);
+    if (Journal::instance().isOpen()) {
+        Journal::instance().userRemoved(id);
+        return true;
+    }
+    return flush();
+}
+
+void CredentialStore::replayAdd(const string& id, const string& password, const string& role) {
+    ensureOpen();
+    store(id, password, role);
+}
+
+void CredentialStore::replayRemove(const string& id) {
+    ensureOpen();
+    if (index.erase(id)) storage->erase(id);
+}
+
+bool CredentialStore::flush() {
+    ensureOpen();
+    // Only does something while users.dat itself is the storage
+    BackupManager::keepPreviousVersion(Utils::getDataPath(USERS_FILE));
+    if (!storage->flush()) {
+        cerr << "Error saving users\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef CREDENTIAL_STORE_H
+#define CREDENTIAL_STORE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "StorageEngine.h"
+
+// The one table of user accounts, shared by UserFileHandler and
+// UserHandler. The accounts live in the storage behind data/users.dat
+// (see StorageEngine::openDataFile) and are all held in a hash index, so
+// finding a user at login never touches the disk.
+//
+// While the journal is open a change is only appended to it, one record
+// whatever the number of users, and reaches the storage with the next
+// compaction (UserFileHandler::compact calls flush). Otherwise each change
+// is flushed at once.
+//
+// The users.txt table UserHandler used to keep in the working directory
+// is merged in on open, without overriding accounts already stored, and
+// then renamed to users.txt.migrated.
+//
+// Not thread-safe; used from the menu thread.
+class CredentialStore {
+public:
+    struct Credential {
+        std::string password;
+        std::string role;
+    };
+
+    static const char* const USERS_FILE;         // In the data directory
+    static const char* const LEGACY_USERS_FILE;  // In the working directory
+
+    static CredentialStore& instance();
+
+    // Reads the accounts, again if they were already read (e.g. after a
+    // backup is restored). The other methods open the store on first use.
+    bool open();
+    bool isOpen() const { return storage != nullptr; }
+
+    const Credential* find(const std::string& id);
+    std::size_t size();
+
+    // Both return false if nothing changed
+    bool add(const std::string& id, const std::string& password, const std::string& role);
+    bool remove(const std::string& id);
+
+    // Journal replay: the same changes, without journaling them again
+    void replayAdd(const std::string& id, const std::string& password, const std::string& role);
+    void replayRemove(const std::string& id);
+
+    bool flush();
+
+private:
+    std::unique_ptr<StorageEngine> storage;  // ID -> "password,role"
+    std::unordered_map<std::string, Credential> index;
+
+    CredentialStore() = default;
+    void ensureOpen() {
+        if (!storage) open();
+    }
+    bool store(const std::string& id, const std::string& password, const std::string& role);
+    void importLegacyFile(const std::string& path);
+};
+
+#endif
@@ -1,4 +1,12 @@
 #include "Doctor.h"
+#include "AvailabilityIndex.h"
+#include "AppointmentRegistry.h"
+#include "AppointmentEvents.h"
+#include "Journal.h"
+#include "ScheduleStore.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <iostream>
 #include <iomanip>
 
@@ -29,16 +37,16 @@ bool Doctor::checkEmergencySlotAvailability() const {
 bool Doctor::hasSlotOverlap(const string& newTime) const {
     // First check regular slots
     for (const auto& slot : normalSlots) {
-        if (slot.time == newTime) {
-            cout << "Debug: Found overlap with regular slot " << slot.time << endl;
+        if (slot.isAt(newTime)) {
+            cout << "Debug: Found overlap with regular slot " << slot.getTime() << endl;
             return true;
         }
     }
     
     // Then check emergency slots
     for (const auto& slot : emergencySlots) {
-        if (slot.time == newTime) {
-            cout << "Debug: Found overlap with emergency slot " << slot.time << endl;
+        if (slot.isAt(newTime)) {
+            cout << "Debug: Found overlap with emergency slot " << slot.getTime() << endl;
             return true;
         }
     }
@@ -46,7 +54,7 @@ bool Doctor::hasSlotOverlap(const string& newTime) const {
     return false;
 }
 
-void Doctor::addSlot(const string& time) {
+void Doctor::addSlot(const string& time, bool quiet) {
     Utils::validateOrThrow(Utils::isValidTime(time), "Invalid time format");
     
     // Check for overlaps with both regular and emergency slots
@@ -59,10 +67,16 @@ void Doctor::addSlot(const string& time) {
     }
 
     normalSlots.push_back(Slot(time));
-    cout << "Regular slot added: " << time << "\n";
+    dirty = true;
+    if (availabilityIndex) {
+        availabilityIndex->appendSlot(this);
+    }
+    if (!quiet) {
+        cout << "Regular slot added: " << time << "\n";
+    }
 }
 
-void Doctor::addEmergencySlot(const string& time) {
+void Doctor::addEmergencySlot(const string& time, bool quiet) {
     Utils::validateOrThrow(Utils::isValidTime(time), "Invalid time format");
     
     // Check for overlaps with both regular and emergency slots
@@ -75,7 +89,10 @@ void Doctor::addEmergencySlot(const string& time) {
     }
 
     emergencySlots.push_back(Slot(time));
-    cout << "Emergency slot added: " << time << "\n";
+    dirty = true;
+    if (!quiet) {
+        cout << "Emergency slot added: " << time << "\n";
+    }
 }
 
 void Doctor::displayAvailableSlots() const {
@@ -86,7 +103,7 @@ void Doctor::displayAvailableSlots() const {
     bool hasRegularSlots = false;
     for (const auto& slot : normalSlots) {
         if (!slot.isBooked) {
-            cout << "  - " << slot.time << "\n";
+            cout << "  - " << slot.getTime() << "\n";
             hasRegularSlots = true;
         }
     }
@@ -99,7 +116,7 @@ void Doctor::displayAvailableSlots() const {
     bool hasEmergencySlots = false;
     for (const auto& slot : emergencySlots) {
         if (!slot.isBooked) {
-            cout << "  - " << slot.time << "\n";
+            cout << "  - " << slot.getTime() << "\n";
             hasEmergencySlots = true;
         }
     }
@@ -111,7 +128,7 @@ void Doctor::displayAvailableSlots() const {
 bool Doctor::isSlotAvailable(const string& time) const {
     Utils::validateOrThrow(Utils::isValidTime(time), "Invalid time format");
     for (const auto& slot : normalSlots) {
-        if (slot.time == time && !slot.isBooked) {
+        if (slot.isAt(time) && !slot.isBooked) {
             return true;
         }
     }
@@ -125,7 +142,7 @@ bool Doctor::isSlotAvailable(const string& date, const string& time) const {
     // First check if the slot time exists and is available
     bool slotExists = false;
     for (const auto& slot : normalSlots) {
-        if (slot.time == time) {
+        if (slot.isAt(time)) {
             slotExists = true;
             if (slot.isBooked) return false;
             break;
@@ -134,16 +151,54 @@ bool Doctor::isSlotAvailable(const string& date, const string& time) const {
     if (!slotExists) return false;
 
     // Then check if there's no appointment at this date and time
-    string dateTime = date + " " + time;
+    uint32_t packedDate = Utils::packDate(date);
+    uint16_t minutes = Utils::packTime(time);
+    ScheduleStore::instance().ensureLoaded(this);
     for (const auto& app : appointments) {
-        if (app.getAppointmentTime() == dateTime) {
+        if (app.packedDate == packedDate && app.minutes == minutes) {
             return false;
         }
     }
     return true;
 }
 
-void Doctor::bookRegularAppointment(Patient* patient, const string& date, const string& time) {
+void Doctor::setSlotBooked(Slot& slot, bool booked) {
+    slot.isBooked = booked;
+    dirty = true;
+    if (availabilityIndex && !normalSlots.empty() &&
+        &slot >= &normalSlots.front() && &slot <= &normalSlots.back()) {
+        availabilityIndex->setBooked(this, &slot - &normalSlots.front(), booked);
+    }
+}
+
+int32_t Doctor::restoreSlot(const Appointment& appointment, int32_t slotHint) {
+    vector<Slot>& slots = appointment.isEmergency() ? emergencySlots : normalSlots;
+    auto fits = [&](size_t i) {
+        return slots[i].minutes == appointment.minutes &&
+               (!slots[i].isBooked || slots[i].appointmentId == appointment.id);
+    };
+
+    int32_t index = AppointmentRegistry::NO_SLOT;
+    if (slotHint >= 0 && static_cast<size_t>(slotHint) < slots.size() && fits(slotHint)) {
+        index = slotHint;
+    } else {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (fits(i)) {
+                index = static_cast<int32_t>(i);
+                break;
+            }
+        }
+    }
+
+    if (index != AppointmentRegistry::NO_SLOT) {
+        setSlotBooked(slots[index], true);
+        slots[index].appointmentId = appointment.id;
+        AppointmentRegistry::instance().attachSlot(appointment.id, index);
+    }
+    return index;
+}
+
+uint32_t Doctor::bookRegularAppointment(Patient* patient, const string& date, const string& time) {
     Utils::validateOrThrow(patient != nullptr, "Invalid patient");
     Utils::validateOrThrow(Utils::isValidDate(date), "Invalid date format");
     Utils::validateOrThrow(Utils::isValidTime(time), "Invalid time format");
@@ -152,23 +207,31 @@ void Doctor::bookRegularAppointment(Patient* patient, const string& date, const
         cout << "The requested time " << time << " is not available.\n";
         cout << "Please choose from the following available slots:\n";
         displayAvailableSlots();
-        return;
+        return 0;
     }
 
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    Appointment& appointment = registry.insert(Appointment(date, time, this, patient));
+    uint32_t id = appointment.id;
+
     // Find and mark the slot as booked
-    for (auto& slot : normalSlots) {
-        if (slot.time == time && !slot.isBooked) {
-            slot.isBooked = true;
+    int32_t slotIndex = AppointmentRegistry::NO_SLOT;
+    for (size_t i = 0; i < normalSlots.size(); ++i) {
+        Slot& slot = normalSlots[i];
+        if (slot.isAt(time) && !slot.isBooked) {
+            setSlotBooked(slot, true);
+            slot.appointmentId = id;
+            slotIndex = static_cast<int32_t>(i);
+            registry.attachSlot(id, slotIndex);
             break;
         }
     }
+    Journal::instance().appointmentBooked(appointment, slotIndex);
+    AppointmentEventLog::instance().booked(appointment);
 
-    Appointment app(date, time, this, patient);
-    regularAppointments.push(app);
-    appointments.push_back(app);
-    patient->addAppointment(app);
     cout << "\nAppointment confirmed!\n";
     cout << "--------------------\n";
+    cout << "Appointment ID: " << id << "\n";
     cout << "Patient: " << patient->name << "\n";
     cout << "Doctor: Dr. " << name << "\n";
     cout << "Date: " << date << "\n";
@@ -176,26 +239,18 @@ void Doctor::bookRegularAppointment(Patient* patient, const string& date, const
     cout << "Location: " << location << "\n";
     cout << "Specialization: " << specialization << "\n";
     cout << "--------------------\n";
+    return id;
 }
 
 void Doctor::assignEmergencyAppointment(Patient* patient) {
     Utils::validateOrThrow(patient != nullptr, "Invalid patient");
 
-    // Get current date
-    time_t now = time(0);
-    tm* ltm = localtime(&now);
-    string currentDate = to_string(ltm->tm_mday) + "-" + 
-                        to_string(1 + ltm->tm_mon) + "-" + 
-                        to_string(1900 + ltm->tm_year);
-
     // Add patient to emergency queue
-    emergencyQueue.push(patient);
+    enqueueEmergencyPatient(patient);
 
     // Try to book immediately if slots are available
     if (checkEmergencySlotAvailability()) {
-        Patient* topPatient = emergencyQueue.top();
-        emergencyQueue.pop();
-        bookEmergencySlot(topPatient, currentDate);
+        bookEmergencySlot(dequeueEmergencyPatient(), currentDate());
     } else {
         cout << "\nNo emergency slots available at the moment. Patient " 
              << patient->getName() << " has been added to the emergency queue with urgency level " 
@@ -203,84 +258,120 @@ void Doctor::assignEmergencyAppointment(Patient* patient) {
     }
 }
 
-void Doctor::bookEmergencySlot(Patient* patient, const string& date) {
+uint32_t Doctor::bookEmergencySlot(Patient* patient, const string& date) {
     Utils::validateOrThrow(patient != nullptr, "Invalid patient");
     Utils::validateOrThrow(Utils::isValidDate(date), "Invalid date format");
 
     if (!checkEmergencySlotAvailability()) {
         cout << "\nSorry, no emergency slots are available with Dr. " << name << ".\n";
         cout << "Please try another doctor for emergency consultation.\n";
-        return;
+        return 0;
     }
 
     // Find first available emergency slot
-    for (auto& slot : emergencySlots) {
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    for (size_t i = 0; i < emergencySlots.size(); ++i) {
+        Slot& slot = emergencySlots[i];
         if (slot.isAvailable()) {
-            slot.isBooked = true;
-            Appointment app(date, slot.time, this, patient, true);
-            slot.assignAppointment(app);
-            appointments.push_back(app);
-            patient->addAppointment(app);
+            Appointment& appointment = registry.insert(Appointment(date, slot.getTime(), this, patient, true));
+            uint32_t id = appointment.id;
+            setSlotBooked(slot, true);
+            slot.appointmentId = id;
+            registry.attachSlot(id, static_cast<int32_t>(i));
+            Journal::instance().appointmentBooked(appointment, static_cast<int32_t>(i));
+            AppointmentEventLog::instance().booked(appointment);
             
             cout << "\nEmergency Appointment confirmed!\n";
             cout << "--------------------\n";
+            cout << "Appointment ID: " << id << "\n";
             cout << "Patient: " << patient->name << "\n";
             cout << "Doctor: Dr. " << name << "\n";
             cout << "Date: " << date << "\n";
-            cout << "Time: " << slot.time << "\n";
+            cout << "Time: " << slot.getTime() << "\n";
             cout << "Location: " << location << "\n";
             cout << "Specialization: " << specialization << "\n";
             cout << "Type: EMERGENCY\n";
             cout << "Urgency Level: " << patient->getUrgencyLevel() << "\n";
             cout << "--------------------\n";
-            return;
+            return id;
         }
     }
+    return 0;
 }
 
 void Doctor::addEmergencyPatient(Patient* patient) {
-    emergencyQueue.push(patient);
+    enqueueEmergencyPatient(patient);
     cout << "Emergency patient added: " << patient->name << endl;
 
     if (checkEmergencySlotAvailability()) {
-        Patient* topPatient = emergencyQueue.top();
-        emergencyQueue.pop();
+        Patient* topPatient = dequeueEmergencyPatient();
         bookEmergencySlot(topPatient, topPatient->appointmentDate);
     }
 }
 
+uint32_t Doctor::serveEmergencyQueue() {
+    if (emergencyQueue.empty() || !checkEmergencySlotAvailability()) return 0;
+    return bookEmergencySlot(dequeueEmergencyPatient(), currentDate());
+}
+
+// DD-MM-YYYY, as Utils::isValidDate expects
+string Doctor::currentDate() {
+    time_t now = time(0);
+    char buffer[16];
+    strftime(buffer, sizeof(buffer), "%d-%m-%Y", localtime(&now));
+    return buffer;
+}
+
+void Doctor::enqueueEmergencyPatient(Patient* patient) {
+    // Strictly increasing, so patients queued in the same millisecond keep
+    // their order and each entry stays distinct for journal replay
+    static int64_t lastEnqueued = 0;
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    now = lastEnqueued = max(now, lastEnqueued + 1);
+    EmergencyQueue::Entry entry{patient, now, patient->urgencyLevel};
+    emergencyQueue.push(entry);
+    Journal::instance().emergencyQueued(this, entry);
+}
+
+Patient* Doctor::dequeueEmergencyPatient() {
+    Patient* patient = emergencyQueue.top().patient;
+    emergencyQueue.pop();
+    Journal::instance().emergencyDequeued(this, patient);
+    return patient;
+}
+
 void Doctor::viewAppointments() const {
     cout << "Appointments for Dr. " << name << ":\n";
+    if (!emergencyQueue.empty()) {
+        cout << "  " << emergencyQueue.size() << " patient(s) waiting for an emergency slot\n";
+    }
+    ScheduleStore::instance().ensureLoaded(this);
     if (appointments.empty()) {
         cout << "  No appointments scheduled.\n";
         return;
     }
 
-    // First show regular appointments
-    queue<Appointment> tempQueue = regularAppointments;
-    while (!tempQueue.empty()) {
-        const Appointment& app = tempQueue.front();
-        cout << app.patient->name << " at " << app.time << " on " << app.date;
-        if (app.isMissed) cout << " [MISSED]";
-        cout << endl;
-        tempQueue.pop();
+    // Regular appointments first, each group in date and time order
+    vector<const Appointment*> ordered;
+    ordered.reserve(appointments.size());
+    for (const auto& app : appointments) {
+        ordered.push_back(&app);
     }
-
-    // Then show emergency appointments
-    for (const auto& slot : emergencySlots) {
-        if (slot.isBooked) {
-            const Appointment& app = slot.appointment;
-            cout << app.patient->name << " at " << app.time << " on " << app.date;
-            if (app.isMissed) cout << " [MISSED]";
-            cout << " [EMERGENCY]" << endl;
-        }
+    sort(ordered.begin(), ordered.end(), [](const Appointment* a, const Appointment* b) {
+        if (a->isEmergency() != b->isEmergency()) return b->isEmergency();
+        if (a->packedDate != b->packedDate) return a->packedDate < b->packedDate;
+        return a->minutes < b->minutes;
+    });
+
+    for (const Appointment* app : ordered) {
+        cout << "#" << app->id << " " << (app->patient ? app->patient->getName() : string("Unknown patient"))
+             << " at " << app->getTime() << " on " << app->getDate();
+        if (app->isMissed()) cout << " [MISSED]";
+        if (app->isEmergency()) cout << " [EMERGENCY]";
+        cout << endl;
     }
 }
 
-std::queue<Appointment>& Doctor::getRegularAppointments() {
-    return regularAppointments;
-}
-
 vector<Slot>& Doctor::getNormalSlots() {
     return normalSlots;
 }
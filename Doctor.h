@@ -3,34 +3,47 @@
 
 #include <string>
 #include <vector>
-#include <queue>
+#include "FixedString.h"
 #include "Slot.h"
 #include "Patient.h"
 #include "Appointment.h"
+#include "EmergencyQueue.h"
 #include "Utils.h"
 
+class AvailabilityIndex;
+
 class Doctor {
 public:
-    std::string doctorID;
-    std::string name;
-    std::string specialization;
-    std::string location;
+    IdString doctorID;
+    NameString name;
+    SpecializationString specialization;
+    SectorString location;
 
     int maxNormalSlots;
     int maxEmergencySlots;
 
     std::vector<Slot> normalSlots;
     std::vector<Slot> emergencySlots;
-    std::queue<Appointment> regularAppointments;
-    std::vector<Appointment> appointments;
+    std::vector<Appointment> appointments;  // Maintained by AppointmentRegistry
+
+    // Saved in the snapshot, changes journaled
+    EmergencyQueue emergencyQueue;
+
+    // Set when slots or appointments change; Save Data writes only dirty
+    // doctors and clears the flag
+    bool dirty = true;
 
-    struct CompareUrgency {
-        bool operator()(const Patient* a, const Patient* b) const {
-            return a->urgencyLevel > b->urgencyLevel;
-        }
-    };
+    // Set by ScheduleStore: appointments not loaded yet are still only in
+    // the snapshot, and loaded ones that have not changed since can be
+    // evicted again
+    bool scheduleLoaded = true;
+    bool scheduleInSnapshot = false;
+    uint32_t scheduleIndex = 0;
 
-    std::priority_queue<Patient*, std::vector<Patient*>, CompareUrgency> emergencyQueue;
+    // Set by AvailabilityIndex while this doctor is registered with it
+    AvailabilityIndex* availabilityIndex = nullptr;
+    std::size_t availabilityOffset = 0;
+    uint32_t availabilityOwner = 0;
 
     Doctor(std::string id, std::string name, std::string spec, std::string loc, int normal, int emergency);
 
@@ -43,11 +56,20 @@ public:
     bool hasAvailableSlot() const;
     bool checkEmergencySlotAvailability() const;
     bool hasSlotOverlap(const std::string& time) const;
-    void addSlot(const std::string& time);
-    void addEmergencySlot(const std::string& time);
-    void bookRegularAppointment(Patient* patient, const std::string& date, const std::string& time);
-    void bookEmergencySlot(Patient* patient, const std::string& date);
+    void addSlot(const std::string& time, bool quiet = false);
+    void addEmergencySlot(const std::string& time, bool quiet = false);
+    // Both return the new appointment's ID, or 0 if nothing was booked
+    uint32_t bookRegularAppointment(Patient* patient, const std::string& date, const std::string& time);
+    uint32_t bookEmergencySlot(Patient* patient, const std::string& date);
     void addEmergencyPatient(Patient* patient);
+    // Queues the patient at its current urgency, or takes the next one off
+    // the queue; both are journaled
+    void enqueueEmergencyPatient(Patient* patient);
+    Patient* dequeueEmergencyPatient();
+    // Books today's emergency slot for the first queued patient when one is
+    // free. Returns the appointment ID, or 0.
+    uint32_t serveEmergencyQueue();
+    static std::string currentDate();
     void viewAppointments() const;
     void assignEmergencyAppointment(Patient* patient);
 
@@ -55,9 +77,13 @@ public:
     void displayAvailableSlots() const;
     bool isSlotAvailable(const std::string& time) const;
     bool isSlotAvailable(const std::string& date, const std::string& time) const;
+    void setSlotBooked(Slot& slot, bool booked);
+    // Books the slot of an appointment read back from disk: slotHint when it
+    // is still at the appointment's time, else the first free slot there.
+    // Returns the slot index, or -1 when no slot fits.
+    int32_t restoreSlot(const Appointment& appointment, int32_t slotHint = -1);
 
     // For other modules:
-    std::queue<Appointment>& getRegularAppointments();
     std::vector<Slot>& getNormalSlots();
     std::vector<Slot>& getEmergencySlots();
 };
@@ -1,4 +1,7 @@
 #include "DoctorManager.h"
+#include "AppointmentRegistry.h"
+#include "Journal.h"
+#include "ScheduleStore.h"
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
@@ -12,7 +15,7 @@ DoctorManager::~DoctorManager() {
     clearDoctors();
 }
 
-void DoctorManager::addDoctor(Doctor* doctor) {
+void DoctorManager::addDoctor(Doctor* doctor, bool quiet) {
     if (!doctor) {
         cerr << "Error: Cannot add null doctor pointer\n";
         return;
@@ -26,7 +29,10 @@ void DoctorManager::addDoctor(Doctor* doctor) {
 
     allDoctors[id] = doctor;
     doctorsBySpecialization[doctor->getSpecialization()].push_back(doctor);
-    cout << "Doctor " << doctor->getName() << " added successfully.\n";
+    availability.addDoctor(doctor);
+    if (!quiet) {
+        cout << "Doctor " << doctor->getName() << " added successfully.\n";
+    }
 }
 
 void DoctorManager::deleteDoctor(const string& doctorID) {
@@ -50,8 +56,11 @@ void DoctorManager::deleteDoctor(const string& doctorID) {
     }
 
     // Remove from main map and delete
+    AppointmentRegistry::instance().eraseDoctor(doctor);
+    availability.removeDoctor(doctor);
     allDoctors.erase(it);
     delete doctor;
+    Journal::instance().doctorDeleted(doctorID);
     cout << "Doctor removed successfully.\n";
 }
 
@@ -72,10 +81,11 @@ Doctor* DoctorManager::getDoctorByName(const string& name) const {
     return nullptr;
 }
 
-vector<Doctor*> DoctorManager::getDoctorsBySpecialization(const string& specialization) const {
+const vector<Doctor*>& DoctorManager::getDoctorsBySpecialization(const string& specialization) const {
+    static const vector<Doctor*> none;
     auto it = doctorsBySpecialization.find(specialization);
     if (it == doctorsBySpecialization.end()) {
-        return vector<Doctor*>();
+        return none;
     }
     return it->second;
 }
@@ -89,6 +99,11 @@ vector<Doctor*> DoctorManager::getAllDoctors() const {
     return doctors;
 }
 
+pmr::vector<Doctor*> DoctorManager::getFreeDoctorsAt(const string& specialization, const string& time,
+                                                     pmr::memory_resource* resource) const {
+    return availability.findFreeDoctors(specialization, time, resource);
+}
+
 void DoctorManager::listAllDoctors() const {
     if (allDoctors.empty()) {
         cout << "No doctors registered in the system.\n";
@@ -107,6 +122,11 @@ void DoctorManager::listAllDoctors() const {
 }
 
 void DoctorManager::clearDoctors() {
+    // Patients may already be gone here, so drop the index without
+    // touching their appointment lists
+    AppointmentRegistry::instance().clear();
+    ScheduleStore::instance().detach();
+    availability.clear();
     for (const auto& pair : allDoctors) {
         delete pair.second;
     }
@@ -5,22 +5,26 @@
 #include <unordered_map>
 #include <vector>
 #include "Doctor.h"
+#include "AvailabilityIndex.h"
 
 class DoctorManager {
 private:
     std::unordered_map<std::string, Doctor*> allDoctors;
     std::unordered_map<std::string, std::vector<Doctor*>> doctorsBySpecialization;
+    AvailabilityIndex availability;
 
 public:
     DoctorManager();
     ~DoctorManager();
 
-    void addDoctor(Doctor* doctor);
+    void addDoctor(Doctor* doctor, bool quiet = false);
     void deleteDoctor(const std::string& doctorID);
     Doctor* getDoctorByID(const std::string& doctorID) const;
     Doctor* getDoctorByName(const std::string& name) const;
-    std::vector<Doctor*> getDoctorsBySpecialization(const std::string& specialization) const;
+    const std::vector<Doctor*>& getDoctorsBySpecialization(const std::string& specialization) const;
     std::vector<Doctor*> getAllDoctors() const;
+    std::pmr::vector<Doctor*> getFreeDoctorsAt(const std::string& specialization, const std::string& time,
+                                               std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
     void listAllDoctors() const;
     void clearDoctors();  // Added for proper cleanup
 };
@@ -0,0 +1,81 @@
+#ifndef EMERGENCY_QUEUE_H
+#define EMERGENCY_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Patient;
+
+// Patients waiting for one doctor's emergency slot. Each entry keeps the
+// urgency it was queued with and when it was queued: the most urgent
+// patient comes first, and among equally urgent ones whoever has waited
+// longest. Entries are a binary heap in a plain vector, so the queue can
+// be saved as it is and rebuilt with one O(n) heapify.
+class EmergencyQueue {
+public:
+    struct Entry {
+        Patient* patient;
+        int64_t enqueuedAt;  // Milliseconds since the epoch
+        int32_t urgency;     // 1 is the most urgent
+    };
+
+    bool empty() const { return heap.empty(); }
+    std::size_t size() const { return heap.size(); }
+    const Entry& top() const { return heap.front(); }
+    // In heap order, for saving
+    const std::vector<Entry>& entries() const { return heap; }
+
+    void push(const Entry& entry) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), servedLater);
+    }
+
+    void pop() {
+        std::pop_heap(heap.begin(), heap.end(), servedLater);
+        heap.pop_back();
+    }
+
+    // Replaces the contents, in any order
+    void assign(std::vector<Entry> entries) {
+        heap = std::move(entries);
+        std::make_heap(heap.begin(), heap.end(), servedLater);
+    }
+
+    bool contains(const Patient* patient, int64_t enqueuedAt) const {
+        return std::any_of(heap.begin(), heap.end(), [&](const Entry& entry) {
+            return entry.patient == patient && entry.enqueuedAt == enqueuedAt;
+        });
+    }
+
+    // Removes the patient's earliest entry. O(log n) when it is on top,
+    // as it is for every dequeue, O(n) otherwise.
+    bool remove(const Patient* patient) {
+        if (heap.empty()) return false;
+        if (heap.front().patient == patient) {
+            pop();
+            return true;
+        }
+        auto found = heap.end();
+        for (auto it = heap.begin(); it != heap.end(); ++it) {
+            if (it->patient == patient && (found == heap.end() || it->enqueuedAt < found->enqueuedAt)) found = it;
+        }
+        if (found == heap.end()) return false;
+        heap.erase(found);
+        std::make_heap(heap.begin(), heap.end(), servedLater);
+        return true;
+    }
+
+    void clear() { heap.clear(); }
+
+private:
+    std::vector<Entry> heap;
+
+    static bool servedLater(const Entry& a, const Entry& b) {
+        if (a.urgency != b.urgency) return a.urgency > b.urgency;
+        return a.enqueuedAt > b.enqueuedAt;
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// Fixed-capacity string stored inline in the owning object.
+// Holds at most N characters plus a terminating '\0', never allocates,
+// and throws std::invalid_argument when a longer value is assigned.
+template <std::size_t N>
+class FixedString {
+private:
+    char data_[N + 1];
+
+public:
+    FixedString() { std::memset(data_, 0, sizeof(data_)); }
+    FixedString(const char* value) { assign(value, std::strlen(value)); }
+    FixedString(const std::string& value) { assign(value.data(), value.size()); }
+
+    void assign(const char* value, std::size_t length) {
+        if (length > N) {
+            throw std::invalid_argument("Value '" + std::string(value, length) +
+                                        "' exceeds " + std::to_string(N) + " characters");
+        }
+        std::memset(data_, 0, sizeof(data_));
+        std::memcpy(data_, value, length);
+    }
+
+    static constexpr std::size_t capacity() { return N; }
+    std::size_t size() const { return std::strlen(data_); }
+    bool empty() const { return data_[0] == '\0'; }
+    const char* c_str() const { return data_; }
+    std::string str() const { return std::string(data_); }
+    operator std::string() const { return str(); }
+
+    bool operator==(const FixedString& other) const { return std::strcmp(data_, other.data_) == 0; }
+    bool operator!=(const FixedString& other) const { return !(*this == other); }
+    bool operator==(const std::string& other) const { return other == data_; }
+    bool operator!=(const std::string& other) const { return !(*this == other); }
+    bool operator==(const char* other) const { return std::strcmp(data_, other) == 0; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    bool operator<(const FixedString& other) const { return std::strcmp(data_, other.data_) < 0; }
+};
+
+template <std::size_t N>
+bool operator==(const std::string& lhs, const FixedString<N>& rhs) { return rhs == lhs; }
+
+template <std::size_t N>
+bool operator!=(const std::string& lhs, const FixedString<N>& rhs) { return rhs != lhs; }
+
+template <std::size_t N>
+std::ostream& operator<<(std::ostream& os, const FixedString<N>& value) {
+    return os << value.c_str();
+}
+
+// Field widths used by the entity classes. Names and specializations follow
+// the limits enforced by Utils::isValidName and Utils::isValidSpecialization.
+using IdString = FixedString<15>;
+using DateString = FixedString<10>;            // DD-MM-YYYY
+using TimeString = FixedString<5>;             // HH:MM
+using NameString = FixedString<30>;
+using SpecializationString = FixedString<20>;
+using SectorString = FixedString<7>;           // e.g. G-10
+
+#endif
@@ -7,9 +7,10 @@ void Graph::addEdge(const std::string& from, const std::string& to, int distance
     adjacencyList[to].push_back({from, distance}); // Since it's an undirected graph
 }
 
-void Graph::dijkstra(const std::string& start, std::unordered_map<std::string, int>& distances) const {
+template <typename DistanceMap>
+void Graph::shortestPaths(const std::string& start, DistanceMap& distances, std::pmr::memory_resource* resource) const {
     distances.clear();
-    std::unordered_map<std::string, bool> visited;
+    std::pmr::unordered_map<std::string, bool> visited(resource);
     
     // Initialize distances
     for (const auto& pair : adjacencyList) {
@@ -18,9 +19,9 @@ void Graph::dijkstra(const std::string& start, std::unordered_map<std::string, i
     distances[start] = 0;
 
     // Priority queue to get vertex with minimum distance
-    std::priority_queue<std::pair<int, std::string>, 
-                      std::vector<std::pair<int, std::string>>, 
-                      std::greater<std::pair<int, std::string>>> pq;
+    using Entry = std::pair<int, std::string>;
+    std::priority_queue<Entry, std::pmr::vector<Entry>, std::greater<Entry>> pq{
+        std::greater<Entry>(), std::pmr::vector<Entry>(resource)};
     
     pq.push({0, start});
 
@@ -34,7 +35,7 @@ void Graph::dijkstra(const std::string& start, std::unordered_map<std::string, i
         auto it = adjacencyList.find(current);
         if (it != adjacencyList.end()) {
             for (const auto& neighbor : it->second) {
-                std::string next = neighbor.first;
+                const std::string& next = neighbor.first;
                 int weight = neighbor.second;
 
                 if (!visited[next] && distances[current] != std::numeric_limits<int>::max() && 
@@ -45,4 +46,12 @@ void Graph::dijkstra(const std::string& start, std::unordered_map<std::string, i
             }
         }
     }
-} 
\ No newline at end of file
+}
+
+void Graph::dijkstra(const std::string& start, std::unordered_map<std::string, int>& distances) const {
+    shortestPaths(start, distances, std::pmr::get_default_resource());
+}
+
+void Graph::dijkstra(const std::string& start, std::pmr::unordered_map<std::string, int>& distances) const {
+    shortestPaths(start, distances, distances.get_allocator().resource());
+}
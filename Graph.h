@@ -3,15 +3,21 @@
 
 #include <string>
 #include <unordered_map>
+#include <memory_resource>
 #include <vector>
 
 class Graph {
 private:
     std::unordered_map<std::string, std::vector<std::pair<std::string, int>>> adjacencyList;
 
+    template <typename DistanceMap>
+    void shortestPaths(const std::string& start, DistanceMap& distances, std::pmr::memory_resource* resource) const;
+
 public:
     void addEdge(const std::string& from, const std::string& to, int distance);
     void dijkstra(const std::string& start, std::unordered_map<std::string, int>& distances) const;
+    // Same as above; the working set is allocated from distances' memory resource
+    void dijkstra(const std::string& start, std::pmr::unordered_map<std::string, int>& distances) const;
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,218 @@
+#include "Journal.h"
+#include "Appointment.h"
+#include "Doctor.h"
+#include "Patient.h"
+#include "Utils.h"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+const char* const Journal::USER_ADD = "USER_ADD";
+const char* const Journal::USER_REMOVE = "USER_REMOVE";
+const char* const Journal::DOCTOR_ADD = "DOCTOR_ADD";
+const char* const Journal::DOCTOR_DELETE = "DOCTOR_DELETE";
+const char* const Journal::PATIENT_ADD = "PATIENT_ADD";
+const char* const Journal::PATIENT_UPDATE = "PATIENT_UPDATE";
+const char* const Journal::BOOK = "BOOK";
+const char* const Journal::CANCEL = "CANCEL";
+const char* const Journal::MISSED = "MISSED";
+const char* const Journal::REBOOK = "REBOOK";
+const char* const Journal::ARCHIVE = "ARCHIVE";
+const char* const Journal::EMERGENCY_QUEUE = "EMERGENCY_QUEUE";
+const char* const Journal::EMERGENCY_DEQUEUE = "EMERGENCY_DEQUEUE";
+
+namespace {
+    // Each line ends in a field holding the CRC-32 of the rest of the line
+    const char CHECKSUM_MARK = '~';
+    const size_t CHECKSUM_FIELD = 1 + 1 + 8;  // Tab, mark, 8 hex digits
+
+    string checksumField(string_view text) {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "\t%c%08x", CHECKSUM_MARK, static_cast<unsigned>(Utils::crc32(text.data(), text.size())));
+        return buffer;
+    }
+
+    string joinSlotTimes(const vector<Slot>& slots) {
+        string times;
+        for (const Slot& slot : slots) {
+            if (!times.empty()) times += ',';
+            times += slot.getTime();
+        }
+        return times;
+    }
+}
+
+Journal& Journal::instance() {
+    static Journal journal;
+    return journal;
+}
+
+bool Journal::open(const string& journalPath, size_t existingRecords) {
+    close();
+    Utils::dropIncompleteLastLine(journalPath);
+    out.open(journalPath, ios::app);
+    if (!out.is_open()) {
+        cerr << "Error: Could not open journal " << journalPath << " for appending\n";
+        return false;
+    }
+    path = journalPath;
+    records = existingRecords;
+    return true;
+}
+
+void Journal::close() {
+    if (out.is_open()) {
+        out.close();
+    }
+}
+
+void Journal::append(const vector<string>& fields) {
+    if (!out.is_open()) return;
+
+    string line = formatRecord(fields);
+
+    // One write and flush per record, so a crash loses at most the record
+    // being written
+    out.write(line.data(), line.size());
+    out.flush();
+    if (!out) {
+        cerr << "Error: Failed to append to journal " << path << "\n";
+        out.clear();
+        return;
+    }
+    ++records;
+}
+
+void Journal::userAdded(const string& id, const string& password, const string& role) {
+    append({USER_ADD, id, password, role});
+}
+
+void Journal::userRemoved(const string& id) {
+    append({USER_REMOVE, id});
+}
+
+void Journal::doctorAdded(const Doctor* doctor) {
+    append({DOCTOR_ADD, doctor->getId(), doctor->getName(), doctor->getSpecialization(), doctor->getLocation(),
+            to_string(doctor->maxNormalSlots), to_string(doctor->maxEmergencySlots),
+            joinSlotTimes(doctor->normalSlots), joinSlotTimes(doctor->emergencySlots)});
+}
+
+void Journal::doctorDeleted(const string& id) {
+    append({DOCTOR_DELETE, id});
+}
+
+void Journal::patientAdded(const Patient* patient) {
+    append({PATIENT_ADD, patient->getId(), patient->getName(), patient->getLocation()});
+}
+
+void Journal::patientUpdated(const Patient* patient) {
+    append({PATIENT_UPDATE, patient->getId(), to_string(patient->getUrgencyLevel())});
+}
+
+void Journal::appointmentBooked(const Appointment& appointment, int32_t slotIndex) {
+    append({BOOK, to_string(appointment.id), appointment.doctor->getId(),
+            appointment.patient ? appointment.patient->getId() : string("-"),
+            appointment.getDate(), appointment.getTime(), appointment.isEmergency() ? "1" : "0",
+            to_string(slotIndex)});
+}
+
+void Journal::appointmentCancelled(uint32_t id) {
+    append({CANCEL, to_string(id)});
+}
+
+void Journal::appointmentMissed(uint32_t id) {
+    append({MISSED, to_string(id)});
+}
+
+void Journal::appointmentRebooked(const Appointment& appointment, int32_t slotIndex) {
+    append({REBOOK, to_string(appointment.id), appointment.getDate(), appointment.getTime(), to_string(slotIndex)});
+}
+
+void Journal::appointmentsArchived(uint32_t horizon) {
+    append({ARCHIVE, Utils::unpackDate(horizon)});
+}
+
+void Journal::emergencyQueued(const Doctor* doctor, const EmergencyQueue::Entry& entry) {
+    append({EMERGENCY_QUEUE, doctor->getId(), entry.patient->getId(), to_string(entry.urgency), to_string(entry.enqueuedAt)});
+}
+
+void Journal::emergencyDequeued(const Doctor* doctor, const Patient* patient) {
+    append({EMERGENCY_DEQUEUE, doctor->getId(), patient->getId()});
+}
+
+bool Journal::truncate() {
+    if (path.empty()) return false;
+    bool wasOpen = out.is_open();
+    close();
+    error_code ec;
+    filesystem::rename(path, path + ".bak", ec);
+    if (ec) {
+        cerr << "Warning: Could not keep the previous journal: " << ec.message() << "\n";
+    }
+    ofstream empty(path, ios::trunc);
+    if (!empty.is_open()) {
+        cerr << "Error: Could not truncate journal " << path << "\n";
+        if (wasOpen) open(path, records);
+        return false;
+    }
+    empty.close();
+    records = 0;
+    return wasOpen ? open(path) : true;
+}
+
+string Journal::formatRecord(const vector<string>& fields) {
+    string line;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (i) line += '\t';
+        line += fields[i];
+    }
+    line += checksumField(line);
+    line += '\n';
+    return line;
+}
+
+bool Journal::checkRecord(string_view& line) {
+    // Lines written before checksums were added have none
+    if (line.size() > CHECKSUM_FIELD && line[line.size() - CHECKSUM_FIELD] == '\t' &&
+        line[line.size() - CHECKSUM_FIELD + 1] == CHECKSUM_MARK) {
+        string_view text = line.substr(0, line.size() - CHECKSUM_FIELD);
+        if (checksumField(text) != line.substr(text.size())) return false;
+        line = text;
+    }
+    return true;
+}
+
+size_t Journal::read(const string& journalPath, const function<void(const vector<string>&, size_t)>& visit) {
+    ifstream file(journalPath, ios::binary);
+    if (!file.is_open()) return 0;
+
+    size_t lineNumber = 0;
+    string line;
+    vector<string> fields;
+    while (getline(file, line)) {
+        if (file.eof()) {
+            cerr << "Warning: Ignoring incomplete last record in journal " << journalPath << "\n";
+            break;
+        }
+        ++lineNumber;
+        if (line.empty()) continue;
+
+        string_view text = line;
+        if (!checkRecord(text)) {
+            cerr << "Warning: Journal line " << lineNumber << " is damaged (checksum mismatch), skipped\n";
+            continue;
+        }
+
+        fields.clear();
+        stringstream ss{string(text)};
+        string field;
+        while (getline(ss, field, '\t')) {
+            fields.push_back(field);
+        }
+        visit(fields, lineNumber);
+    }
+    return lineNumber;
+}
@@ -0,0 +1,99 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "EmergencyQueue.h"
+
+class Appointment;
+class Doctor;
+class Patient;
+
+// Append-only write-ahead log of user and entity mutations. Each change
+// appends one tab-separated line, so the cost of recording it does not
+// depend on how much data is stored. The snapshot and users.dat hold the
+// state as of the last compaction; replaying the journal on top of them
+// restores everything after it (see UserFileHandler::replayJournal).
+//
+// Every line ends in a CRC-32 of the rest of it, so a record damaged by a
+// torn write or on disk is detected and skipped on replay.
+//
+// Appends are ignored while the journal is closed, which is the case
+// during startup replay.
+class Journal {
+public:
+    // Record keywords, the first field of each line
+    static const char* const USER_ADD;
+    static const char* const USER_REMOVE;
+    static const char* const DOCTOR_ADD;
+    static const char* const DOCTOR_DELETE;
+    static const char* const PATIENT_ADD;
+    static const char* const PATIENT_UPDATE;
+    static const char* const BOOK;
+    static const char* const CANCEL;
+    static const char* const MISSED;
+    static const char* const REBOOK;
+    static const char* const ARCHIVE;
+    static const char* const EMERGENCY_QUEUE;
+    static const char* const EMERGENCY_DEQUEUE;
+
+    // Record count after which the caller should compact
+    static const std::size_t COMPACTION_THRESHOLD = 1000;
+
+    static Journal& instance();
+
+    bool open(const std::string& path, std::size_t existingRecords = 0);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+
+    void userAdded(const std::string& id, const std::string& password, const std::string& role);
+    void userRemoved(const std::string& id);
+    void doctorAdded(const Doctor* doctor);
+    void doctorDeleted(const std::string& id);
+    void patientAdded(const Patient* patient);
+    void patientUpdated(const Patient* patient);
+    void appointmentBooked(const Appointment& appointment, int32_t slotIndex);
+    void appointmentCancelled(uint32_t id);
+    void appointmentMissed(uint32_t id);
+    void appointmentRebooked(const Appointment& appointment, int32_t slotIndex);
+    void appointmentsArchived(uint32_t horizon);
+    void emergencyQueued(const Doctor* doctor, const EmergencyQueue::Entry& entry);
+    void emergencyDequeued(const Doctor* doctor, const Patient* patient);
+
+    std::size_t recordCount() const { return records; }
+    bool needsCompaction() const { return records >= COMPACTION_THRESHOLD; }
+
+    // Empties the journal once its records are covered by a snapshot. The
+    // records are kept as <path>.bak until the next call, so the previous
+    // snapshot plus them can stand in for a damaged new one.
+    bool truncate();
+
+    // Calls visit(fields, lineNumber) for every complete line of the file.
+    // A last line without its newline was torn by a crash and is skipped,
+    // as is any line whose checksum does not match.
+    // Returns the number of lines visited.
+    static std::size_t read(const std::string& path,
+                            const std::function<void(const std::vector<std::string>&, std::size_t)>& visit);
+
+    // One line in the journal's format: the fields joined by tabs, then the
+    // checksum field and a newline. Shared with AppointmentEventLog.
+    static std::string formatRecord(const std::vector<std::string>& fields);
+    // Strips the checksum field from a line read back, without its newline.
+    // Returns false if it does not match; a line without one is accepted.
+    static bool checkRecord(std::string_view& line);
+
+private:
+    std::ofstream out;
+    std::string path;
+    std::size_t records = 0;
+
+    Journal() = default;
+    void append(const std::vector<std::string>& fields);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. An empty file opens
+// successfully with size() == 0 and data() == nullptr.
+// On POSIX the file may be replaced by a rename while it is mapped, and
+// the mapping keeps the old contents. Windows refuses to replace or delete
+// a file while a view of it is mapped, so close it first.
+class MappedFile {
+private:
+    const char* mapped = nullptr;
+    std::size_t length = 0;
+    bool opened = false;
+    std::string filePath;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return opened; }
+    const std::string& path() const { return filePath; }
+    const char* data() const { return mapped; }
+    std::size_t size() const { return length; }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MEDICAL_HISTORY_HANDLE_H
+#define MEDICAL_HISTORY_HANDLE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FixedString.h"
+
+// A patient's link to its medical history. The records themselves live in
+// the history log and are loaded on demand through MedicalHistoryManager's
+// cache, so a Patient costs the same however long its history is.
+class MedicalHistoryHandle {
+public:
+    explicit MedicalHistoryHandle(const std::string& patientID) : patientID(patientID) {}
+
+    // All records, oldest first, read from the history log
+    std::shared_ptr<const std::vector<std::string>> records() const;
+    std::size_t size() const;
+    bool add(const std::string& record) const;
+
+private:
+    IdString patientID;
+};
+
+#endif
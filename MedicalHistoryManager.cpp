@@ -1,41 +1,212 @@
 #include "MedicalHistoryManager.h"
+#include "Utils.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
 using namespace std;
 
-std::string MedicalHistoryManager::getHistoryFilename(const Patient* patient) const {
-    return "medical_history_" + patient->getId() + ".txt";
+const std::string MedicalHistoryManager::SEARCH_INDEX_FILE = "medical_history.search";
+
+MedicalHistoryManager& MedicalHistoryManager::instance() {
+    static MedicalHistoryManager manager;
+    return manager;
+}
+
+std::shared_ptr<const std::vector<std::string>> MedicalHistoryHandle::records() const {
+    return MedicalHistoryManager::instance().records(patientID);
+}
+
+std::size_t MedicalHistoryHandle::size() const {
+    return MedicalHistoryManager::instance().recordCount(patientID);
+}
+
+bool MedicalHistoryHandle::add(const std::string& record) const {
+    return MedicalHistoryManager::instance().addRecord(patientID, record);
+}
+
+MedicalHistoryManager::Records MedicalHistoryManager::records(const std::string& patientID) const {
+    return std::make_shared<const std::vector<std::string>>(
+        store ? store->readAll(patientID) : std::vector<std::string>());
+}
+
+MedicalHistoryManager::Records MedicalHistoryManager::newestRecords(const std::string& patientID) {
+    CacheEntry& entry = touch(patientID);
+    if (entry.newest) {
+        ++hits;
+        return entry.newest;
+    }
+
+    ++misses;
+    Records newest = std::make_shared<const std::vector<std::string>>(
+        store ? store->lastRecords(patientID, PAGE_SIZE) : std::vector<std::string>());
+    hold(entry, entry.newest, newest);
+    evict();
+    return newest;
+}
+
+MedicalHistoryManager::Records MedicalHistoryManager::pageRecords(const std::string& patientID, std::size_t page) {
+    CacheEntry& entry = touch(patientID);
+    auto it = entry.pages.find(page);
+    if (it != entry.pages.end()) {
+        ++hits;
+        return it->second;
+    }
+
+    ++misses;
+    Records records = std::make_shared<const std::vector<std::string>>(
+        store && page > 0 ? store->readPage(patientID, page - 1, PAGE_SIZE) : std::vector<std::string>());
+    hold(entry, entry.pages[page], records);
+    evict();
+    return records;
+}
+
+std::size_t MedicalHistoryManager::recordCount(const std::string& patientID) const {
+    return store ? store->recordCount(patientID) : 0;
+}
+
+bool MedicalHistoryManager::addRecord(const std::string& patientID, const std::string& record) {
+    if (!store || !store->append(patientID, record)) {
+        return false;
+    }
+    searchIndex->catchUp(store->path());
+
+    auto it = cache.find(patientID);
+    if (it == cache.end()) {
+        return true;
+    }
+    // Views handed out earlier keep the old lists. The newest page gets a
+    // copy with the record; the numbered page it lands on is read again
+    // when next asked for.
+    CacheEntry& entry = it->second;
+    if (entry.newest) {
+        auto updated = std::make_shared<std::vector<std::string>>(*entry.newest);
+        updated->push_back(record);
+        if (updated->size() > PAGE_SIZE) {
+            updated->erase(updated->begin());
+        }
+        hold(entry, entry.newest, std::move(updated));
+    }
+    std::size_t lastPage = (store->recordCount(patientID) + PAGE_SIZE - 1) / PAGE_SIZE;
+    auto page = entry.pages.find(lastPage);
+    if (page != entry.pages.end()) {
+        hold(entry, page->second, nullptr);
+        entry.pages.erase(page);
+    }
+    return true;
+}
+
+MedicalHistoryManager::CacheEntry& MedicalHistoryManager::touch(const std::string& patientID) {
+    auto it = cache.find(patientID);
+    if (it != cache.end()) {
+        recency.splice(recency.begin(), recency, it->second.recency);
+        return it->second;
+    }
+    recency.push_front(patientID);
+    CacheEntry& entry = cache[patientID];
+    entry.recency = recency.begin();
+    return entry;
+}
+
+void MedicalHistoryManager::hold(CacheEntry& entry, Records& slot, Records records) {
+    std::size_t before = slot ? slot->size() : 0;
+    std::size_t after = records ? records->size() : 0;
+    entry.recordCount = entry.recordCount - before + after;
+    cachedRecords = cachedRecords - before + after;
+    slot = std::move(records);
+}
+
+// The entry just used is at the front and always kept
+void MedicalHistoryManager::evict() {
+    while (cache.size() > 1 && (cache.size() > CACHE_PATIENTS || cachedRecords > CACHE_RECORDS)) {
+        auto it = cache.find(recency.back());
+        cachedRecords -= it->second.recordCount;
+        cache.erase(it);
+        recency.pop_back();
+    }
 }
 
 void MedicalHistoryManager::addMedicalHistory(Patient* patient, const std::string& record) {
-    std::ofstream file(getHistoryFilename(patient), std::ios::app);
-    if (file.is_open()) {
-        file << record << "\n";
-        file.close();
+    if (addRecord(patient->getId(), record)) {
         std::cout << "Medical history record added successfully.\n";
     } else {
-        std::cout << "Error: Could not open medical history file.\n";
+        std::cout << "Error: Could not save medical history record.\n";
     }
 }
 
-void MedicalHistoryManager::viewMedicalHistory(const Patient* patient) const {
-    std::ifstream file(getHistoryFilename(patient));
-    if (file.is_open()) {
-        std::cout << "\nMedical History for Patient " << patient->getName() << " (ID: " << patient->getId() << "):\n";
-        std::cout << "----------------------------------------\n";
-        std::string line;
-        bool hasHistory = false;
-        while (std::getline(file, line)) {
-            std::cout << "- " << line << "\n";
-            hasHistory = true;
-        }
-        if (!hasHistory) {
-            std::cout << "No medical history records found.\n";
-        }
-        file.close();
-    } else {
+void MedicalHistoryManager::viewMedicalHistory(const Patient* patient) {
+    std::size_t total = recordCount(patient->getId());
+    std::cout << "\nMedical History for Patient " << patient->getName() << " (ID: " << patient->getId() << "):\n";
+    std::cout << "----------------------------------------\n";
+    if (total == 0) {
         std::cout << "No medical history records found.\n";
+        return;
+    }
+    for (const std::string& record : *newestRecords(patient->getId())) {
+        std::cout << "- " << record << "\n";
+    }
+    if (total > PAGE_SIZE) {
+        std::cout << "(Newest " << PAGE_SIZE << " of " << total << " records; "
+                  << (total + PAGE_SIZE - 1) / PAGE_SIZE << " pages in all)\n";
     }
 }
 
+void MedicalHistoryManager::viewMedicalHistoryPage(const Patient* patient, std::size_t page) {
+    std::size_t total = recordCount(patient->getId());
+    std::size_t pages = (total + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (page == 0 || page > pages) {
+        std::cout << "Invalid page. Patient " << patient->getName() << " has " << pages << " page(s) of history.\n";
+        return;
+    }
+    std::cout << "\nMedical History for Patient " << patient->getName() << ", page " << page << " of " << pages << ":\n";
+    std::cout << "----------------------------------------\n";
+    for (const std::string& record : *pageRecords(patient->getId(), page)) {
+        std::cout << "- " << record << "\n";
+    }
+}
+
+void MedicalHistoryManager::searchMedicalHistories(const std::string& query) const {
+    if (!searchIndex) return;
+    std::vector<MedicalHistorySearch::Hit> hits = searchIndex->search(query);
+    if (hits.empty()) {
+        std::cout << "No medical history records match.\n";
+        return;
+    }
+    // Only the records shown are read from the log
+    std::vector<uint32_t> shown;
+    for (const auto& hit : hits) {
+        shown.insert(shown.end(), hit.records.begin(),
+                     hit.records.begin() + std::min(hit.records.size(), SEARCH_RECORDS_SHOWN));
+    }
+    std::vector<std::string> texts = searchIndex->readRecords(shown);
+
+    std::cout << "\nPatients with matching records (" << hits.size() << "):\n";
+    std::cout << "----------------------------------------\n";
+    std::size_t next = 0;
+    for (const auto& hit : hits) {
+        std::cout << "Patient ID " << hit.patientID << ": " << hit.records.size() << " record(s)\n";
+        for (std::size_t i = 0; i < hit.records.size() && i < SEARCH_RECORDS_SHOWN; ++i) {
+            std::cout << "  - " << texts[next++] << "\n";
+        }
+    }
+}
+
+std::size_t MedicalHistoryManager::open() {
+    close();
+    store = std::make_unique<MedicalHistoryStore>();
+    std::size_t imported = store->importLegacyFiles({".", Utils::DATA_DIR});
+    if (imported > 0) {
+        std::cout << "Imported " << imported << " medical history file(s) into the history log.\n";
+    }
+    searchIndex = std::make_unique<MedicalHistorySearch>(Utils::getDataPath(SEARCH_INDEX_FILE));
+    searchIndex->catchUp(store->path());
+    return imported;
+}
+
+void MedicalHistoryManager::close() {
+    searchIndex.reset();
+    store.reset();
+    cache.clear();
+    recency.clear();
+    cachedRecords = 0;
+}
@@ -1,19 +1,93 @@
 #ifndef MEDICAL_HISTORY_MANAGER_H
 #define MEDICAL_HISTORY_MANAGER_H
 
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include "Patient.h"
+#include "MedicalHistoryStore.h"
+#include "MedicalHistorySearch.h"
 
+// The one place medical histories are read and written. Records live in
+// the history log; the views read only the page they show, through the
+// log's index, and the pages of recently viewed patients are kept in a
+// bounded LRU cache, so repeat views do not touch the disk and memory
+// grows with neither the number of patients nor the length of a history.
+// Patients reach it through their MedicalHistoryHandle.
+//
+// Not thread-safe; used from the menu thread.
 class MedicalHistoryManager {
-private:
-    std::string getHistoryFilename(const Patient* patient) const;
-
 public:
+    static const std::size_t PAGE_SIZE = 10;
+    static const std::size_t SEARCH_RECORDS_SHOWN = 3;  // Per patient
+    static const std::string SEARCH_INDEX_FILE;
+
+    // Cache bounds: whichever is reached first evicts the least recently
+    // used patient. The newest patient is always kept.
+    static const std::size_t CACHE_PATIENTS = 256;
+    static const std::size_t CACHE_RECORDS = 50000;
+
+    using Records = std::shared_ptr<const std::vector<std::string>>;
+
+    static MedicalHistoryManager& instance();
+
+    // Every record of one patient, oldest first, read from the log and not
+    // cached
+    Records records(const std::string& patientID) const;
+    // The newest PAGE_SIZE records, oldest first
+    Records newestRecords(const std::string& patientID);
+    // Records of one page, oldest first; page 1 is the oldest
+    Records pageRecords(const std::string& patientID, std::size_t page);
+    std::size_t recordCount(const std::string& patientID) const;
+    bool addRecord(const std::string& patientID, const std::string& record);
+
     void addMedicalHistory(Patient* patient, const std::string& record);
-    void viewMedicalHistory(const Patient* patient) const;
+    // Shows the newest PAGE_SIZE records
+    void viewMedicalHistory(const Patient* patient);
+    // Shows records of one page, oldest first; page 1 is the oldest
+    void viewMedicalHistoryPage(const Patient* patient, std::size_t page);
+    // Lists the patients with records matching query (see
+    // MedicalHistorySearch for the syntax)
+    void searchMedicalHistories(const std::string& query) const;
+
+    // Opens the history log and its search index, importing any
+    // medical_history_<id>.txt files left by older versions. Records are
+    // read later, when first asked for. Returns the files imported.
+    std::size_t open();
+    // Closes the log, e.g. before its files are replaced by a restore
+    void close();
+
+    std::size_t cacheHits() const { return hits; }
+    std::size_t cacheMisses() const { return misses; }
+
+private:
+    // The parts of one patient's history read so far
+    struct CacheEntry {
+        Records newest;                                  // From lastRecords
+        std::unordered_map<std::size_t, Records> pages;  // From readPage, by page
+        std::size_t recordCount = 0;                     // Held in newest and pages
+        std::list<std::string>::iterator recency;
+    };
+
+    std::unique_ptr<MedicalHistoryStore> store;
+    std::unique_ptr<MedicalHistorySearch> searchIndex;
+
+    std::list<std::string> recency;  // Most recently used first
+    std::unordered_map<std::string, CacheEntry> cache;
+    std::size_t cachedRecords = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+
+    MedicalHistoryManager() = default;
+    // The patient's entry, created if needed and marked most recently used
+    CacheEntry& touch(const std::string& patientID);
+    // Replaces slot's records in entry, keeping the counts right
+    void hold(CacheEntry& entry, Records& slot, Records records);
+    void evict();
 };
 
 #endif
@@ -0,0 +1,377 @@
+#include "MedicalHistorySearch.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+    const char MAGIC[8] = {'A', 'M', 'S', 'H', 'S', 'R', 'C', '\0'};
+    const uint32_t VERSION = 2;  // 2 adds term positions
+
+    // Covered bytes below which the index file is not rewritten
+    const uint64_t MIN_UNSAVED_BYTES = 1 << 20;
+
+    // One AND-group of a query. Each item is a phrase; single terms are
+    // one-word phrases.
+    struct Clause {
+        vector<vector<string>> required;
+        vector<vector<string>> excluded;
+    };
+
+    bool parseQuery(const string& query, vector<Clause>& clauses) {
+        clauses.assign(1, Clause());
+        bool negate = false;
+        size_t i = 0;
+        while (i < query.size()) {
+            if (isspace(static_cast<unsigned char>(query[i]))) {
+                ++i;
+                continue;
+            }
+            vector<string> terms;
+            if (query[i] == '"') {
+                size_t close = query.find('"', i + 1);
+                if (close == string::npos) {
+                    cout << "Unclosed quote in search query.\n";
+                    return false;
+                }
+                terms = MedicalHistorySearch::tokenize(query.substr(i + 1, close - i - 1));
+                i = close + 1;
+            } else {
+                if (query[i] == '-') {
+                    negate = true;
+                    ++i;
+                    continue;
+                }
+                size_t end = i;
+                while (end < query.size() && !isspace(static_cast<unsigned char>(query[end])) && query[end] != '"') ++end;
+                string word = query.substr(i, end - i);
+                i = end;
+                if (word == "OR") {
+                    clauses.emplace_back();
+                    negate = false;
+                    continue;
+                }
+                if (word == "NOT") {
+                    negate = true;
+                    continue;
+                }
+                terms = MedicalHistorySearch::tokenize(word);  // "covid-19" is the phrase "covid 19"
+            }
+            if (!terms.empty()) {
+                (negate ? clauses.back().excluded : clauses.back().required).push_back(terms);
+            }
+            negate = false;
+        }
+        for (const Clause& clause : clauses) {
+            if (clause.required.empty()) {
+                cout << "Each part of a search query needs at least one term that is not excluded.\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    vector<uint32_t> intersect(const vector<uint32_t>& a, const vector<uint32_t>& b) {
+        vector<uint32_t> result;
+        set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(result));
+        return result;
+    }
+
+    template <typename T>
+    void writeValue(ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeString(ostream& out, const string& text) {
+        writeValue(out, static_cast<uint32_t>(text.size()));
+        out.write(text.data(), static_cast<streamsize>(text.size()));
+    }
+
+    void writeList(ostream& out, const vector<uint32_t>& list) {
+        writeValue(out, static_cast<uint32_t>(list.size()));
+        out.write(reinterpret_cast<const char*>(list.data()), static_cast<streamsize>(list.size() * sizeof(uint32_t)));
+    }
+
+    template <typename T>
+    bool readValue(istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    bool readString(istream& in, string& text) {
+        uint32_t length = 0;
+        if (!readValue(in, length) || length > (1u << 20)) return false;
+        text.resize(length);
+        return length == 0 || static_cast<bool>(in.read(&text[0], length));
+    }
+
+    bool readList(istream& in, vector<uint32_t>& list, uint32_t maxCount) {
+        uint32_t count = 0;
+        if (!readValue(in, count) || count > maxCount) return false;
+        list.resize(count);
+        return count == 0 ||
+               static_cast<bool>(in.read(reinterpret_cast<char*>(list.data()), static_cast<streamsize>(count * sizeof(uint32_t))));
+    }
+}
+
+MedicalHistorySearch::MedicalHistorySearch(const string& indexPath) : indexPath(indexPath) {
+    if (!load()) clear();
+}
+
+MedicalHistorySearch::~MedicalHistorySearch() {
+    if (coveredSize != savedSize) save();
+}
+
+vector<string> MedicalHistorySearch::tokenize(const string& text) {
+    vector<string> tokens;
+    string current;
+    for (char c : text) {
+        if (isalnum(static_cast<unsigned char>(c))) {
+            current += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        } else if (!current.empty()) {
+            tokens.push_back(std::move(current));
+            current.clear();
+        }
+    }
+    if (!current.empty()) tokens.push_back(std::move(current));
+    return tokens;
+}
+
+void MedicalHistorySearch::clear() {
+    coveredSize = savedSize = 0;
+    patientIDs.clear();
+    patientNumbers.clear();
+    records.clear();
+    postings.clear();
+}
+
+void MedicalHistorySearch::addRecord(const string& patientID, const string& text, uint64_t offset) {
+    auto [it, added] = patientNumbers.try_emplace(patientID, static_cast<uint32_t>(patientIDs.size()));
+    if (added) patientIDs.push_back(patientID);
+
+    uint32_t id = static_cast<uint32_t>(records.size());
+    records.push_back({offset, it->second});
+    vector<string> tokens = tokenize(text);
+    for (uint32_t position = 0; position < tokens.size(); ++position) {
+        Postings& list = postings[tokens[position]];
+        if (list.records.empty() || list.records.back() != id) {
+            list.records.push_back(id);
+            list.ends.push_back(static_cast<uint32_t>(list.positions.size()));
+        }
+        list.positions.push_back(position);
+        ++list.ends.back();
+    }
+}
+
+size_t MedicalHistorySearch::catchUp(const string& path) {
+    logPath = path;
+    error_code ec;
+    uint64_t size = filesystem::exists(path, ec) ? filesystem::file_size(path, ec) : 0;
+    if (size < coveredSize) {
+        clear();  // The log was replaced; start over
+    }
+    if (size == coveredSize) return 0;
+
+    ifstream log(path, ios::binary);
+    log.seekg(static_cast<streamoff>(coveredSize));
+    size_t added = 0;
+    string line;
+    while (getline(log, line)) {
+        if (log.eof()) break;  // No newline yet: still being written
+        uint64_t offset = coveredSize;
+        coveredSize += line.size() + 1;
+        size_t tab = line.find('\t');
+        if (tab == string::npos || tab == 0) continue;
+        addRecord(line.substr(0, tab), line.substr(tab + 1), offset);
+        ++added;
+    }
+
+    if (coveredSize - savedSize > max(MIN_UNSAVED_BYTES, savedSize)) save();
+    return added;
+}
+
+bool MedicalHistorySearch::readRecord(ifstream& log, uint32_t id, string& text) const {
+    log.clear();
+    log.seekg(static_cast<streamoff>(records[id].offset));
+    if (!getline(log, text)) return false;
+    size_t tab = text.find('\t');
+    text.erase(0, tab == string::npos ? text.size() : tab + 1);
+    return true;
+}
+
+// Follows the positions of the phrase's first term through the others:
+// each position survives only if the k-th term is at it plus k
+bool MedicalHistorySearch::containsPhrase(uint32_t id, const vector<string>& phrase) const {
+    vector<uint32_t> starts;
+    for (size_t k = 0; k < phrase.size(); ++k) {
+        auto it = postings.find(phrase[k]);
+        if (it == postings.end()) return false;
+        const Postings& list = it->second;
+        auto found = lower_bound(list.records.begin(), list.records.end(), id);
+        if (found == list.records.end() || *found != id) return false;
+        size_t run = static_cast<size_t>(found - list.records.begin());
+        const uint32_t* first = list.positions.data() + (run == 0 ? 0 : list.ends[run - 1]);
+        const uint32_t* last = list.positions.data() + list.ends[run];
+        if (k == 0) {
+            starts.assign(first, last);
+            continue;
+        }
+        starts.erase(remove_if(starts.begin(), starts.end(),
+                               [&](uint32_t start) { return !binary_search(first, last, static_cast<uint32_t>(start + k)); }),
+                     starts.end());
+        if (starts.empty()) return false;
+    }
+    return !starts.empty();
+}
+
+vector<uint32_t> MedicalHistorySearch::findRecords(const string& query) const {
+    vector<Clause> clauses;
+    vector<uint32_t> matches;
+    if (!parseQuery(query, clauses)) return matches;
+
+    for (const Clause& clause : clauses) {
+        // Intersect every required term, rarest first
+        vector<const vector<uint32_t>*> lists;
+        bool missing = false;
+        for (const vector<string>& phrase : clause.required) {
+            for (const string& term : phrase) {
+                auto it = postings.find(term);
+                if (it == postings.end()) {
+                    missing = true;
+                    break;
+                }
+                lists.push_back(&it->second.records);
+            }
+        }
+        if (missing) continue;
+        sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+        vector<uint32_t> candidates = *lists.front();
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            candidates = intersect(candidates, *lists[i]);
+        }
+
+        // Exclusions by a single term need only the posting list; phrases
+        // and exclusions of phrases are checked against the term positions
+        bool hasPhrases = false;
+        for (const vector<string>& phrase : clause.required) hasPhrases = hasPhrases || phrase.size() > 1;
+        for (const vector<string>& phrase : clause.excluded) {
+            if (phrase.size() > 1) {
+                hasPhrases = true;
+                continue;
+            }
+            auto it = postings.find(phrase.front());
+            if (it == postings.end()) continue;
+            vector<uint32_t> kept;
+            set_difference(candidates.begin(), candidates.end(), it->second.records.begin(), it->second.records.end(),
+                           back_inserter(kept));
+            candidates.swap(kept);
+        }
+        if (hasPhrases) {
+            vector<uint32_t> verified;
+            for (uint32_t id : candidates) {
+                auto contains = [this, id](const vector<string>& phrase) { return containsPhrase(id, phrase); };
+                if (all_of(clause.required.begin(), clause.required.end(), contains) &&
+                    none_of(clause.excluded.begin(), clause.excluded.end(), contains)) {
+                    verified.push_back(id);
+                }
+            }
+            candidates.swap(verified);
+        }
+
+        vector<uint32_t> merged;
+        set_union(matches.begin(), matches.end(), candidates.begin(), candidates.end(), back_inserter(merged));
+        matches.swap(merged);
+    }
+    return matches;
+}
+
+vector<MedicalHistorySearch::Hit> MedicalHistorySearch::search(const string& query) const {
+    vector<Hit> hits;
+    unordered_map<uint32_t, size_t> hitOfPatient;
+    for (uint32_t id : findRecords(query)) {
+        uint32_t patient = records[id].patient;
+        auto [it, added] = hitOfPatient.try_emplace(patient, hits.size());
+        if (added) hits.push_back({patientIDs[patient], {}});
+        hits[it->second].records.push_back(id);
+    }
+    return hits;
+}
+
+vector<string> MedicalHistorySearch::readRecords(const vector<uint32_t>& ids) const {
+    vector<string> texts(ids.size());
+    ifstream log(logPath, ios::binary);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] >= records.size() || !readRecord(log, ids[i], texts[i])) texts[i].clear();
+    }
+    return texts;
+}
+
+bool MedicalHistorySearch::save() {
+    bool saved = Utils::writeFileAtomically(indexPath, [this](ostream& out) {
+        out.write(MAGIC, sizeof(MAGIC));
+        writeValue(out, VERSION);
+        writeValue(out, coveredSize);
+        writeValue(out, static_cast<uint32_t>(patientIDs.size()));
+        writeValue(out, static_cast<uint32_t>(records.size()));
+        writeValue(out, static_cast<uint32_t>(postings.size()));
+        for (const string& patientID : patientIDs) writeString(out, patientID);
+        for (const Record& record : records) {
+            writeValue(out, record.offset);
+            writeValue(out, record.patient);
+        }
+        for (const auto& [term, list] : postings) {
+            writeString(out, term);
+            writeList(out, list.records);
+            writeList(out, list.ends);
+            writeList(out, list.positions);
+        }
+    }, true);
+    if (saved) savedSize = coveredSize;
+    return saved;
+}
+
+// Any inconsistency discards the file; catchUp() then rebuilds the index
+// from the log
+bool MedicalHistorySearch::load() {
+    ifstream in(indexPath, ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0, patientCount = 0, recordCount = 0, termCount = 0;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !readValue(in, version) || version != VERSION || !readValue(in, coveredSize) ||
+        !readValue(in, patientCount) || !readValue(in, recordCount) || !readValue(in, termCount)) {
+        return false;
+    }
+
+    patientIDs.resize(patientCount);
+    for (uint32_t i = 0; i < patientCount; ++i) {
+        if (!readString(in, patientIDs[i])) return false;
+        patientNumbers[patientIDs[i]] = i;
+    }
+    records.resize(recordCount);
+    for (Record& record : records) {
+        if (!readValue(in, record.offset) || !readValue(in, record.patient) ||
+            record.patient >= patientCount || record.offset >= coveredSize) {
+            return false;
+        }
+    }
+    postings.reserve(termCount);
+    string term;
+    for (uint32_t i = 0; i < termCount; ++i) {
+        if (!readString(in, term)) return false;
+        Postings& list = postings[term];
+        if (!readList(in, list.records, recordCount) || !readList(in, list.ends, recordCount) ||
+            !readList(in, list.positions, UINT32_MAX) || list.ends.size() != list.records.size() ||
+            (!list.records.empty() && (list.records.back() >= recordCount || list.ends.back() != list.positions.size()))) {
+            return false;
+        }
+    }
+    savedSize = coveredSize;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef MEDICAL_HISTORY_SEARCH_H
+#define MEDICAL_HISTORY_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index over the medical history log: every term maps to the
+// ascending list of records containing it, with its positions in each, so
+// queries, phrases included, are answered from the index alone and only
+// the records shown are read from the log. Terms are lower-cased runs of
+// letters and digits.
+//
+// The index covers the log up to a recorded size. catchUp() indexes
+// whatever was appended after that, so the index stays current with one
+// call after each append and survives restarts by persisting to its own
+// file (binary, rewritten atomically).
+//
+// Query syntax:
+//   hypertension diabetes      both terms (AND)
+//   asthma OR copd             either side; AND binds tighter than OR
+//   -smoker, NOT smoker        exclude records with the term
+//   "blood pressure"           terms next to each other, in order
+//
+// Not thread-safe; used from the thread that owns MedicalHistoryManager.
+class MedicalHistorySearch {
+public:
+    struct Hit {
+        std::string patientID;
+        std::vector<uint32_t> records;  // Matching record numbers, oldest first
+    };
+
+    explicit MedicalHistorySearch(const std::string& indexPath);
+    ~MedicalHistorySearch();
+
+    MedicalHistorySearch(const MedicalHistorySearch&) = delete;
+    MedicalHistorySearch& operator=(const MedicalHistorySearch&) = delete;
+
+    // Indexes the complete lines of logPath past the covered size. A log
+    // shorter than that was replaced, and is indexed from the start.
+    // Returns the number of records added.
+    std::size_t catchUp(const std::string& logPath);
+
+    // Matching record numbers, ascending. Malformed queries print why and
+    // return nothing.
+    std::vector<uint32_t> findRecords(const std::string& query) const;
+    // Matches grouped by patient, in the order patients first appear
+    std::vector<Hit> search(const std::string& query) const;
+    // The text of each record, read from the log; "" where it cannot be read
+    std::vector<std::string> readRecords(const std::vector<uint32_t>& ids) const;
+
+    std::size_t recordCount() const { return records.size(); }
+    std::size_t termCount() const { return postings.size(); }
+
+    bool save();
+
+    static std::vector<std::string> tokenize(const std::string& text);
+
+private:
+    struct Record {
+        uint64_t offset;   // Line start in the log
+        uint32_t patient;  // Into patientIDs
+    };
+
+    struct Postings {
+        std::vector<uint32_t> records;    // Ascending
+        std::vector<uint32_t> ends;       // Per record, end of its run in positions
+        std::vector<uint32_t> positions;  // Token numbers within the record, ascending
+    };
+
+    std::string indexPath;
+    std::string logPath;
+    uint64_t coveredSize = 0;
+    uint64_t savedSize = 0;
+    std::vector<std::string> patientIDs;
+    std::unordered_map<std::string, uint32_t> patientNumbers;
+    std::vector<Record> records;
+    std::unordered_map<std::string, Postings> postings;
+
+    bool load();
+    void clear();
+    void addRecord(const std::string& patientID, const std::string& text, uint64_t offset);
+    bool readRecord(std::ifstream& log, uint32_t id, std::string& text) const;
+    bool containsPhrase(uint32_t id, const std::vector<std::string>& phrase) const;
+};
+
+#endif
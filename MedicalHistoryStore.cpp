@@ -0,0 +1,344 @@
+#include "MedicalHistoryStore.h"
+#include "MappedFile.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const string MedicalHistoryStore::LOG_FILE = "medical_history.log";
+const string MedicalHistoryStore::INDEX_FILE = "medical_history.idx";
+
+namespace {
+    const char* const INDEX_TAG = "HISTORY_INDEX";
+    const int INDEX_VERSION = 1;
+    const string LEGACY_PREFIX = "medical_history_";
+    const string LEGACY_SUFFIX = ".txt";
+
+    int openForAppend(const string& path) {
+#ifdef _WIN32
+        return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+    }
+
+    // Writes the whole buffer and forces it to disk
+    bool writeDurably(int fd, const string& buffer) {
+        const char* data = buffer.data();
+        size_t left = buffer.size();
+        while (left > 0) {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned>(min<size_t>(left, 1 << 30)));
+            if (written <= 0) return false;
+#else
+            ssize_t written = ::write(fd, data, left);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+#endif
+            data += written;
+            left -= static_cast<size_t>(written);
+        }
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
+    }
+
+    void truncateTo(int fd, uint64_t size) {
+#ifdef _WIN32
+        _chsize_s(fd, static_cast<__int64>(size));
+#else
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            cerr << "Error: Could not roll back a failed medical history write\n";
+        }
+#endif
+    }
+
+    void closeFile(int fd) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+}
+
+MedicalHistoryStore::MedicalHistoryStore()
+    : MedicalHistoryStore(Utils::getDataPath(LOG_FILE), Utils::getDataPath(INDEX_FILE)) {}
+
+MedicalHistoryStore::MedicalHistoryStore(const string& logPath, const string& indexPath)
+    : MedicalHistoryStore(logPath, indexPath, GroupCommitOptions()) {}
+
+MedicalHistoryStore::MedicalHistoryStore(const string& logPath, const string& indexPath,
+                                         const GroupCommitOptions& options)
+    : logPath(logPath), indexPath(indexPath), options(options) {
+    Utils::dropIncompleteLastLine(logPath);
+    error_code ec;
+    logSize = filesystem::exists(logPath, ec) ? filesystem::file_size(logPath, ec) : 0;
+
+    if (!loadIndex()) {
+        offsets.clear();
+        indexedSize = 0;
+    }
+    if (indexedSize < logSize) {
+        scanFrom(indexedSize);
+        saveIndex();
+    }
+    fd = openForAppend(logPath);
+    if (fd < 0) {
+        cerr << "Error: Could not open medical history log " << logPath << "\n";
+    }
+    writer = thread([this]() { runWriter(); });
+}
+
+MedicalHistoryStore::~MedicalHistoryStore() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    writer.join();  // Commits whatever is still queued
+    if (indexedSize != logSize) saveIndex();
+    if (fd >= 0) closeFile(fd);
+}
+
+bool MedicalHistoryStore::loadIndex() {
+    ifstream in(indexPath);
+    if (!in.is_open()) return false;
+
+    string line, tag;
+    int version = 0;
+    if (!getline(in, line) || !(istringstream(line) >> tag >> version >> indexedSize) ||
+        tag != INDEX_TAG || version != INDEX_VERSION || indexedSize > logSize) {
+        return false;
+    }
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string patientID;
+        size_t count = 0;
+        if (!(fields >> patientID >> count)) return false;
+        vector<uint64_t>& list = offsets[patientID];
+        list.resize(count);
+        for (uint64_t& offset : list) {
+            if (!(fields >> offset) || offset >= indexedSize) return false;
+        }
+    }
+    return true;
+}
+
+bool MedicalHistoryStore::saveIndex() {
+    lock_guard<mutex> saving(saveMutex);
+    shared_lock<shared_mutex> reading(indexMutex);
+    uint64_t covered = logSize;
+    bool saved = Utils::writeFileAtomically(indexPath, [this, covered](ostream& file) {
+        file << INDEX_TAG << " " << INDEX_VERSION << " " << covered << "\n";
+        for (const auto& [patientID, list] : offsets) {
+            file << patientID << " " << list.size();
+            for (uint64_t offset : list) file << " " << offset;
+            file << "\n";
+        }
+    });
+    reading.unlock();
+    if (saved) {
+        unique_lock<shared_mutex> writing(indexMutex);
+        indexedSize = covered;
+    }
+    return saved;
+}
+
+// Indexes the records from offset to the end of the log
+void MedicalHistoryStore::scanFrom(uint64_t offset) {
+    MappedFile log;
+    if (!log.open(logPath) || log.size() == 0) return;
+    const char* data = log.data();
+    uint64_t size = log.size();
+    while (offset < size) {
+        const char* line = data + offset;
+        const char* newline = static_cast<const char*>(memchr(line, '\n', size - offset));
+        uint64_t length = (newline ? newline : data + size) - line;
+        const char* tab = static_cast<const char*>(memchr(line, '\t', length));
+        if (tab && tab != line) {
+            offsets[string(line, tab)].push_back(offset);
+        }
+        offset += length + 1;
+    }
+}
+
+future<bool> MedicalHistoryStore::appendAsync(const string& patientID, const string& record) {
+    promise<bool> done;
+    future<bool> result = done.get_future();
+    if (fd < 0) {
+        done.set_value(false);
+        return result;
+    }
+    if (record.find_first_of("\r\n") != string::npos || patientID.empty() ||
+        patientID.find_first_of("\t\r\n ") != string::npos) {
+        cerr << "Error: Medical history records must be a single line\n";
+        done.set_value(false);
+        return result;
+    }
+
+    bool wake;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.push_back({patientID, patientID + "\t" + record + "\n", std::move(done)});
+        wake = queue.size() == 1 || queue.size() >= options.maxBatch;
+    }
+    if (wake) queued.notify_one();
+    return result;
+}
+
+bool MedicalHistoryStore::append(const string& patientID, const string& record) {
+    return appendAsync(patientID, record).get();
+}
+
+void MedicalHistoryStore::runWriter() {
+    while (true) {
+        deque<PendingRecord> batch;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queued.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) return;  // Stopping and drained
+            if (!stopping && options.maxDelay.count() > 0) {
+                queued.wait_for(lock, options.maxDelay,
+                                [this]() { return stopping || queue.size() >= options.maxBatch; });
+            }
+            batch.swap(queue);
+        }
+        commit(batch);
+    }
+}
+
+// One write and one fsync for the whole batch. The records become
+// visible to readers only once they are durable.
+void MedicalHistoryStore::commit(deque<PendingRecord>& batch) {
+    string buffer;
+    vector<uint64_t> starts;
+    starts.reserve(batch.size());
+    for (const PendingRecord& pending : batch) {
+        starts.push_back(logSize + buffer.size());
+        buffer += pending.line;
+    }
+
+    bool ok = writeDurably(fd, buffer);
+    if (ok) {
+        unique_lock<shared_mutex> writing(indexMutex);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            offsets[batch[i].patientID].push_back(starts[i]);
+        }
+        logSize += buffer.size();
+    } else {
+        cerr << "Error: Could not write to medical history log\n";
+        truncateTo(fd, logSize);  // A partial batch must not stay in the log
+    }
+    for (PendingRecord& pending : batch) {
+        pending.done.set_value(ok);
+    }
+
+    if (ok && logSize - indexedSize > max(MIN_UNINDEXED_BYTES, indexedSize)) {
+        saveIndex();
+    }
+}
+
+size_t MedicalHistoryStore::recordCount(const string& patientID) const {
+    shared_lock<shared_mutex> reading(indexMutex);
+    auto it = offsets.find(patientID);
+    return it == offsets.end() ? 0 : it->second.size();
+}
+
+vector<string> MedicalHistoryStore::readRange(const string& patientID, size_t begin, size_t end) const {
+    vector<string> records;
+    vector<uint64_t> wanted;
+    {
+        shared_lock<shared_mutex> reading(indexMutex);
+        auto it = offsets.find(patientID);
+        if (it == offsets.end()) return records;
+        end = min(end, it->second.size());
+        if (begin >= end) return records;
+        wanted.assign(it->second.begin() + begin, it->second.begin() + end);
+    }
+
+    ifstream in(logPath, ios::binary);
+    string line;
+    records.reserve(wanted.size());
+    for (uint64_t offset : wanted) {
+        in.seekg(static_cast<streamoff>(offset));
+        if (!getline(in, line)) break;
+        size_t tab = line.find('\t');
+        records.push_back(tab == string::npos ? string() : line.substr(tab + 1));
+    }
+    return records;
+}
+
+vector<string> MedicalHistoryStore::readAll(const string& patientID) const {
+    return readRange(patientID, 0, recordCount(patientID));
+}
+
+vector<string> MedicalHistoryStore::lastRecords(const string& patientID, size_t n) const {
+    size_t count = recordCount(patientID);
+    return readRange(patientID, count > n ? count - n : 0, count);
+}
+
+vector<string> MedicalHistoryStore::readPage(const string& patientID, size_t page, size_t pageSize) const {
+    return readRange(patientID, page * pageSize, (page + 1) * pageSize);
+}
+
+size_t MedicalHistoryStore::importLegacyFiles(const vector<string>& directories) {
+    size_t imported = 0;
+    for (const string& directory : directories) {
+        error_code ec;
+        vector<filesystem::path> files;
+        for (const auto& entry : filesystem::directory_iterator(directory, ec)) {
+            string name = entry.path().filename().string();
+            if (name.size() > LEGACY_PREFIX.size() + LEGACY_SUFFIX.size() &&
+                name.compare(0, LEGACY_PREFIX.size(), LEGACY_PREFIX) == 0 &&
+                name.compare(name.size() - LEGACY_SUFFIX.size(), LEGACY_SUFFIX.size(), LEGACY_SUFFIX) == 0) {
+                files.push_back(entry.path());
+            }
+        }
+        sort(files.begin(), files.end());
+
+        for (const filesystem::path& file : files) {
+            string name = file.filename().string();
+            string patientID = name.substr(LEGACY_PREFIX.size(), name.size() - LEGACY_PREFIX.size() - LEGACY_SUFFIX.size());
+            // Queue the whole file so it is committed in as few batches as
+            // possible, then wait for all of it
+            ifstream in(file);
+            string line;
+            vector<future<bool>> written;
+            while (getline(in, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) written.push_back(appendAsync(patientID, line));
+            }
+            in.close();
+            bool ok = true;
+            for (future<bool>& result : written) ok = result.get() && ok;
+            if (!ok) {
+                cerr << "Error: Could not import " << file.string() << ", file left in place\n";
+                continue;
+            }
+            filesystem::rename(file, file.string() + ".migrated", ec);
+            if (ec) {
+                cerr << "Warning: Could not rename " << file.string() << " after import: " << ec.message() << "\n";
+            }
+            ++imported;
+        }
+    }
+    return imported;
+}
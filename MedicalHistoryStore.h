@@ -0,0 +1,111 @@
+#ifndef MEDICAL_HISTORY_STORE_H
+#define MEDICAL_HISTORY_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class MappedFile;
+
+// Every patient's medical history in one append-only log, with an index
+// of where each patient's records start. Reads seek straight to the
+// records they need, so showing the latest few does not depend on how
+// long the history is.
+//
+// Log layout (text), one record per line:
+//   <patientID>\t<record>
+//
+// The index file is a cache: its header records the log size it covers,
+// and records appended after that are picked up by scanning just the tail
+// of the log on open.
+//
+// Appends are committed by a background writer. Records queued while it
+// is busy, or within maxDelay of the first one, go out together in one
+// write followed by one fsync; each caller's future becomes ready once its
+// record is durable and readable.
+class MedicalHistoryStore {
+public:
+    struct GroupCommitOptions {
+        std::chrono::microseconds maxDelay{0};  // Extra wait for more records after the first
+        std::size_t maxBatch = 4096;            // Commit at once when this many are queued
+    };
+
+    MedicalHistoryStore();
+    MedicalHistoryStore(const std::string& logPath, const std::string& indexPath);
+    MedicalHistoryStore(const std::string& logPath, const std::string& indexPath, const GroupCommitOptions& options);
+    ~MedicalHistoryStore();
+
+    MedicalHistoryStore(const MedicalHistoryStore&) = delete;
+    MedicalHistoryStore& operator=(const MedicalHistoryStore&) = delete;
+
+    // Queues a record; the future is true once it is on disk, false if it
+    // could not be written. Records may not contain line breaks.
+    std::future<bool> appendAsync(const std::string& patientID, const std::string& record);
+    // appendAsync and wait
+    bool append(const std::string& patientID, const std::string& record);
+
+    std::size_t recordCount(const std::string& patientID) const;
+    std::vector<std::string> readAll(const std::string& patientID) const;
+    // The newest n records, oldest first
+    std::vector<std::string> lastRecords(const std::string& patientID, std::size_t n) const;
+    // Records [page * pageSize, (page + 1) * pageSize), oldest first
+    std::vector<std::string> readPage(const std::string& patientID, std::size_t page, std::size_t pageSize) const;
+
+    const std::string& path() const { return logPath; }
+
+    // Appends the records of medical_history_<id>.txt files found in each
+    // directory and renames each file to .migrated. Returns files imported.
+    std::size_t importLegacyFiles(const std::vector<std::string>& directories);
+
+    bool saveIndex();
+
+private:
+    static const std::string LOG_FILE;
+    static const std::string INDEX_FILE;
+    // Unindexed tail, in bytes, below which the index is not rewritten.
+    // Above it the index is rewritten once the tail outgrows the indexed
+    // part, so the cost of rewriting stays proportional to the appends.
+    static constexpr uint64_t MIN_UNINDEXED_BYTES = 1 << 20;
+
+    struct PendingRecord {
+        std::string patientID;
+        std::string line;
+        std::promise<bool> done;
+    };
+
+    std::string logPath;
+    std::string indexPath;
+    GroupCommitOptions options;
+    int fd = -1;
+
+    // offsets, logSize and indexedSize change only on the writer thread,
+    // under an exclusive lock; readers take a shared one
+    mutable std::shared_mutex indexMutex;
+    uint64_t logSize = 0;
+    uint64_t indexedSize = 0;
+    std::unordered_map<std::string, std::vector<uint64_t>> offsets;
+    std::mutex saveMutex;  // One index rewrite at a time
+
+    std::mutex queueMutex;
+    std::condition_variable queued;
+    std::deque<PendingRecord> queue;
+    bool stopping = false;
+    std::thread writer;
+
+    void runWriter();
+    void commit(std::deque<PendingRecord>& batch);
+    bool loadIndex();
+    void scanFrom(uint64_t offset);
+    std::vector<std::string> readRange(const std::string& patientID, std::size_t begin, std::size_t end) const;
+};
+
+#endif
@@ -1,91 +1,41 @@
 #include "MissedAppointmentManager.h"
+#include "AppointmentEvents.h"
+#include "AppointmentRegistry.h"
+#include "Journal.h"
 #include <iostream>
-#include <queue>
 
 using namespace std;
 
-void MissedAppointmentManager::markAppointmentAsMissed(Doctor* doctor, const string& patientID) {
-    if (!doctor) {
-        cout << "Doctor is null.\n";
+void MissedAppointmentManager::markAppointmentAsMissed(uint32_t appointmentId) {
+    Appointment* app = AppointmentRegistry::instance().find(appointmentId);
+    if (!app) {
+        cout << "No appointment found with ID: " << appointmentId << endl;
         return;
     }
-
-    bool found = false;
-
-    // Update in regular appointments queue
-    queue<Appointment>& regularAppts = doctor->getRegularAppointments();
-    queue<Appointment> tempQueue;
-
-    while (!regularAppts.empty()) {
-        Appointment app = regularAppts.front();
-        regularAppts.pop();
-
-        if (app.patient && app.patient->patientID == patientID && !app.isMissed && !found) {
-            app.markMissed();
-            found = true;
-            cout << "Marked regular appointment for " << app.patient->name << " as missed.\n";
-            
-            // Also update in the main appointments vector
-            for (auto& mainApp : doctor->appointments) {
-                if (mainApp.patient && mainApp.patient->patientID == patientID &&
-                    mainApp.date == app.date && mainApp.time == app.time) {
-                    mainApp.markMissed();
-                    break;
-                }
-            }
-        }
-
-        tempQueue.push(app);
-    }
-
-    regularAppts = tempQueue;
-
-    // Check emergency appointments
-    vector<Slot>& emergencySlots = doctor->getEmergencySlots();
-    for (auto& slot : emergencySlots) {
-        if (slot.isBooked && slot.appointment.patient && 
-            slot.appointment.patient->patientID == patientID && 
-            !slot.appointment.isMissed && !found) {
-            slot.appointment.markMissed();
-            found = true;
-            cout << "Marked emergency appointment for " << slot.appointment.patient->name << " as missed.\n";
-            
-            // Also update in the main appointments vector
-            for (auto& mainApp : doctor->appointments) {
-                if (mainApp.patient && mainApp.patient->patientID == patientID &&
-                    mainApp.date == slot.appointment.date && mainApp.time == slot.appointment.time) {
-                    mainApp.markMissed();
-                    break;
-                }
-            }
-        }
+    if (app->isMissed()) {
+        cout << "Appointment #" << appointmentId << " is already marked as missed.\n";
+        return;
     }
 
-    if (!found) {
-        cout << "No matching appointment found for patient ID: " << patientID << endl;
-    }
+    app->markMissed();
+    Journal::instance().appointmentMissed(appointmentId);
+    AppointmentEventLog::instance().missed(*app);
+    cout << "Marked " << (app->isEmergency() ? "emergency" : "regular") << " appointment #" << appointmentId
+         << " for " << (app->patient ? app->patient->getName() : string("Unknown")) << " as missed.\n";
 }
 
-void MissedAppointmentManager::rebookMissedAppointment(Doctor* doctor, Patient* patient) {
-    if (!doctor || !patient) {
-        cout << "Invalid input.\n";
+void MissedAppointmentManager::rebookMissedAppointment(uint32_t appointmentId) {
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    const AppointmentRegistry::Location* location = registry.locate(appointmentId);
+    if (!location) {
+        cout << "No appointment found with ID: " << appointmentId << endl;
         return;
     }
 
-    bool found = false;
-
-    // First, find the missed appointment in the main appointments vector
-    Appointment* missedApp = nullptr;
-    for (auto& app : doctor->appointments) {
-        if (app.patient && app.patient->patientID == patient->patientID && app.isMissed) {
-            missedApp = &app;
-            found = true;
-            break;
-        }
-    }
-
-    if (!found) {
-        cout << "No missed appointment found for " << patient->name << ".\n";
+    Doctor* doctor = location->doctor;
+    Appointment& missedApp = doctor->appointments[location->doctorIndex];
+    if (!missedApp.isMissed()) {
+        cout << "Appointment #" << appointmentId << " is not marked as missed.\n";
         return;
     }
 
@@ -101,61 +51,42 @@ void MissedAppointmentManager::rebookMissedAppointment(Doctor* doctor, Patient*
         return;
     }
 
-    // Try to find an available slot
-    bool slotFound = false;
-    
-    // If it was a regular appointment
-    if (!missedApp->isEmergency) {
-        for (auto& slot : doctor->getNormalSlots()) {
-            if (slot.time == newTime && !slot.isBooked) {
-                // Update the appointment in all containers
-                missedApp->date = newDate;
-                missedApp->time = newTime;
-                missedApp->isMissed = false;
-                
-                // Update in regular appointments queue
-                queue<Appointment>& regularAppts = doctor->getRegularAppointments();
-                queue<Appointment> tempQueue;
-                while (!regularAppts.empty()) {
-                    Appointment app = regularAppts.front();
-                    regularAppts.pop();
-                    if (app.patient && app.patient->patientID == patient->patientID && app.isMissed) {
-                        app.date = newDate;
-                        app.time = newTime;
-                        app.isMissed = false;
-                    }
-                    tempQueue.push(app);
-                }
-                regularAppts = tempQueue;
-                
-                slot.isBooked = true;
-                slotFound = true;
-                cout << "Rebooked regular appointment for " << patient->name << ".\n";
-                break;
-            }
-        }
-    }
-    // If it was an emergency appointment
-    else {
-        for (auto& slot : doctor->getEmergencySlots()) {
-            if (!slot.isBooked) {
-                // Update the appointment
-                missedApp->date = newDate;
-                missedApp->isMissed = false;
-                
-                // Move the appointment to the new slot
-                slot.isBooked = true;
-                slot.appointment = *missedApp;
-                
-                slotFound = true;
-                cout << "Rebooked emergency appointment for " << patient->name << ".\n";
-                break;
-            }
+    // Regular appointments need a slot at the requested time; emergency ones
+    // take the first free emergency slot. The appointment's own slot counts
+    // as free.
+    vector<Slot>& slots = missedApp.isEmergency() ? doctor->getEmergencySlots() : doctor->getNormalSlots();
+    int32_t newIndex = AppointmentRegistry::NO_SLOT;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        bool usable = !slots[i].isBooked || slots[i].appointmentId == appointmentId;
+        if (usable && (missedApp.isEmergency() || slots[i].isAt(newTime))) {
+            newIndex = static_cast<int32_t>(i);
+            break;
         }
     }
 
-    if (!slotFound) {
+    if (newIndex == AppointmentRegistry::NO_SLOT) {
         cout << "Selected slot is not available. Please choose from:\n";
         doctor->displayAvailableSlots();
+        return;
+    }
+
+    // Release the old slot and take the new one
+    if (location->slotIndex != AppointmentRegistry::NO_SLOT && location->slotIndex != newIndex) {
+        Slot& oldSlot = slots[location->slotIndex];
+        if (oldSlot.appointmentId == appointmentId) {
+            doctor->setSlotBooked(oldSlot, false);
+            oldSlot.appointmentId = Slot::NO_APPOINTMENT;
+        }
     }
+    Slot& slot = slots[newIndex];
+    doctor->setSlotBooked(slot, true);
+    slot.appointmentId = appointmentId;
+    registry.attachSlot(appointmentId, newIndex);
+
+    missedApp.reschedule(newDate, slot.getTime());
+    Journal::instance().appointmentRebooked(missedApp, newIndex);
+    AppointmentEventLog::instance().rebooked(missedApp);
+    cout << "Rebooked " << (missedApp.isEmergency() ? "emergency" : "regular") << " appointment #" << appointmentId
+         << " for " << (missedApp.patient ? missedApp.patient->getName() : string("Unknown"))
+         << " on " << missedApp.getDate() << " at " << missedApp.getTime() << ".\n";
 }
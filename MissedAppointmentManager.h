@@ -1,14 +1,14 @@
 #ifndef MISSEDAPPOINTMENTMANAGER_H
 #define MISSEDAPPOINTMENTMANAGER_H
 
-#include <string>
+#include <cstdint>
 #include "Doctor.h"
 #include "Patient.h"
 
 class MissedAppointmentManager {
 public:
-    void markAppointmentAsMissed(Doctor* doctor, const std::string& patientID);
-    void rebookMissedAppointment(Doctor* doctor, Patient* patient);
+    void markAppointmentAsMissed(uint32_t appointmentId);
+    void rebookMissedAppointment(uint32_t appointmentId);
 };
 
 #endif
@@ -21,13 +21,14 @@ void NearestDoctorFinder::displayDoctorInfo(Doctor* doctor, int distance) {
 
 Doctor* NearestDoctorFinder::findNearestDoctor(Graph& city, const string& mySector, 
                                               const string& specialization, 
-                                              const vector<Doctor*>& doctors) {
-    unordered_map<string, int> distances;
+                                              const vector<Doctor*>& doctors,
+                                              pmr::memory_resource* resource) {
+    pmr::unordered_map<string, int> distances(resource);
     city.dijkstra(mySector, distances);
 
     Doctor* nearest = nullptr;
     int minDistance = INT_MAX;
-    vector<pair<Doctor*, int>> availableDoctors;
+    pmr::vector<pair<Doctor*, int>> availableDoctors(resource);
 
     // Find all doctors with matching specialization
     for (Doctor* doc : doctors) {
@@ -63,11 +64,12 @@ Doctor* NearestDoctorFinder::findNearestDoctor(Graph& city, const string& mySect
 void NearestDoctorFinder::findNearestDoctors(const std::string& patientLocation,
                                             const std::string& specialization,
                                             const std::vector<Doctor*>& doctors,
-                                            const Graph& city) {
-    std::unordered_map<std::string, int> distances;
+                                            const Graph& city,
+                                            std::pmr::memory_resource* resource) {
+    std::pmr::unordered_map<std::string, int> distances(resource);
     city.dijkstra(patientLocation, distances);
 
-    std::vector<std::pair<Doctor*, int>> availableDoctors;
+    std::pmr::vector<std::pair<Doctor*, int>> availableDoctors(resource);
     for (auto doc : doctors) {
         if (doc->getSpecialization() == specialization) {
             availableDoctors.push_back({doc, distances[doc->getLocation()]});
@@ -80,7 +82,7 @@ void NearestDoctorFinder::findNearestDoctors(const std::string& patientLocation,
     displayResults(availableDoctors);
 }
 
-void NearestDoctorFinder::displayResults(const std::vector<std::pair<Doctor*, int>>& doctors) {
+void NearestDoctorFinder::displayResults(const std::pmr::vector<std::pair<Doctor*, int>>& doctors) {
     if (doctors.empty()) {
         std::cout << "No doctors found with the specified specialization.\n";
         return;
@@ -1,6 +1,7 @@
 #ifndef NEAREST_DOCTOR_FINDER_H
 #define NEAREST_DOCTOR_FINDER_H
 
+#include <memory_resource>
 #include <string>
 #include <vector>
 #include "Doctor.h"
@@ -10,15 +11,17 @@ class NearestDoctorFinder {
 public:
     static Doctor* findNearestDoctor(Graph& city, const std::string& mySector, 
                                    const std::string& specialization, 
-                                   const std::vector<Doctor*>& doctors);
+                                   const std::vector<Doctor*>& doctors,
+                                   std::pmr::memory_resource* resource = std::pmr::get_default_resource());
     
     static void findNearestDoctors(const std::string& patientLocation,
                                   const std::string& specialization,
                                   const std::vector<Doctor*>& doctors,
-                                  const Graph& city);
+                                  const Graph& city,
+                                  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 private:
     static void displayDoctorInfo(Doctor* doctor, int distance);
-    static void displayResults(const std::vector<std::pair<Doctor*, int>>& doctors);
+    static void displayResults(const std::pmr::vector<std::pair<Doctor*, int>>& doctors);
 };
 
 #endif
@@ -1,6 +1,9 @@
 #include "Patient.h"
 #include "Doctor.h"
 #include "Appointment.h"
+#include "AppointmentRegistry.h"
+#include "CancelAppointmentManager.h"
+#include "ScheduleStore.h"
 #include "Utils.h"
 #include <iostream>
 #include <algorithm>
@@ -8,51 +11,46 @@
 using namespace std;
 
 Patient::Patient(string id, string name, string location)
-    : patientID(id), name(name), location(location), urgencyLevel(3) {}  // Default to medium urgency (3)
+    : patientID(id), name(name), location(location), urgencyLevel(3), medicalHistory(id) {}  // Default to medium urgency (3)
 
 void Patient::setUrgencyLevel(int level) {
     try {
         Utils::validateOrThrow(Utils::isValidUrgencyLevel(level), 
             "Invalid urgency level. Must be between 1 (highest) and 4 (lowest).");
         urgencyLevel = level;
+        dirty = true;
     } catch (const invalid_argument& e) {
         cerr << "Error setting urgency level: " << e.what() << endl;
         throw;  // Re-throw to let caller handle the error
     }
 }
 
-void Patient::addAppointment(const Appointment& app) {
-    appointments.push_back(app);
-}
-
-bool Patient::cancelAppointment(const string& dateTime) {
-    auto it = find_if(appointments.begin(), appointments.end(), [&](const Appointment& app) {
-        return app.getAppointmentTime() == dateTime;
-    });
-
-    if (it != appointments.end()) {
-        appointments.erase(it);
-        cout << "Appointment on " << dateTime << " cancelled for " << name << ".\n";
-        return true;
+bool Patient::cancelAppointment(uint32_t appointmentId) {
+    const Appointment* app = AppointmentRegistry::instance().find(appointmentId);
+    if (!app || app->patient != this) {
+        return false;
     }
-    return false;
+    return CancelAppointmentManager().cancelAppointment(appointmentId);
 }
 
 void Patient::addMedicalHistory(const string& record) {
-    if (!record.empty()) {
-        medicalHistory.push_back(record);
+    if (record.empty()) {
+        throw invalid_argument("Empty record not allowed.");
+    }
+    if (medicalHistory.add(record)) {
         cout << "Medical history added for " << name << ".\n";
     } else {
-        throw invalid_argument("Empty record not allowed.");
+        cerr << "Error: Could not save medical history for " << name << ".\n";
     }
 }
 
 void Patient::viewMedicalHistory() const {
     cout << "Medical History for " << name << ":\n";
-    if (medicalHistory.empty()) {
+    auto records = medicalHistory.records();
+    if (records->empty()) {
         cout << "  No records available.\n";
     } else {
-        for (const auto& record : medicalHistory) {
+        for (const auto& record : *records) {
             cout << "  - " << record << endl;
         }
     }
@@ -60,14 +58,18 @@ void Patient::viewMedicalHistory() const {
 
 void Patient::viewAppointments() const {
     cout << "Appointments for " << name << ":\n";
-    if (appointments.empty()) {
+    ScheduleStore::instance().loadPatient(this);
+    if (appointmentIds.empty()) {
         cout << "  No appointments scheduled.\n";
         return;
     }
-    for (const auto& app : appointments) {
-        cout << "  - " << app.getAppointmentTime()
-             << " with Dr. " << (app.doctor ? app.doctor->name : "Unknown");
-        if (app.isMissed) cout << " [MISSED]";
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    for (uint32_t id : appointmentIds) {
+        const Appointment* app = registry.find(id);
+        if (!app) continue;
+        cout << "  - #" << id << " " << app->getAppointmentTime()
+             << " with Dr. " << (app->doctor ? app->doctor->name : "Unknown");
+        if (app->isMissed()) cout << " [MISSED]";
         cout << endl;
     }
 }
@@ -76,3 +78,11 @@ void Patient::requestEmergencyAppointment(Doctor* doctor) {
     doctor->addEmergencyPatient(this);
 }
 
+PatientIndex buildPatientIndex(const vector<Patient*>& patients) {
+    PatientIndex index;
+    index.reserve(patients.size());
+    for (Patient* patient : patients) {
+        if (patient) index[patient->getId()] = patient;
+    }
+    return index;
+}
@@ -1,8 +1,12 @@
 #ifndef PATIENT_H
 #define PATIENT_H
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "FixedString.h"
+#include "MedicalHistoryHandle.h"
 
 // Forward declarations
 class Doctor;
@@ -10,15 +14,18 @@ class Appointment;
 
 class Patient {
 public:
-    std::string patientID;
-    std::string name;
-    std::string location;
-    std::string appointmentDate;
-    std::string appointmentTime;
+    IdString patientID;
+    NameString name;
+    SectorString location;
+    DateString appointmentDate;
+    TimeString appointmentTime;
     int urgencyLevel;  // 1 is highest priority, 10 is lowest priority
 
-    std::vector<Appointment> appointments;
-    std::vector<std::string> medicalHistory;
+    std::vector<uint32_t> appointmentIds;  // Maintained by AppointmentRegistry
+    MedicalHistoryHandle medicalHistory;
+
+    bool dirty = true;  // Changed since the last Save Data
+    uint32_t scheduleIndex = 0;  // Position in the snapshot, set by ScheduleStore
 
     Patient(std::string id, std::string name, std::string location);
 
@@ -29,12 +36,15 @@ public:
     int getUrgencyLevel() const { return urgencyLevel; }
 
     void setUrgencyLevel(int level);
-    void addAppointment(const Appointment& app);
-    bool cancelAppointment(const std::string& dateTime);
+    bool cancelAppointment(uint32_t appointmentId);
     void addMedicalHistory(const std::string& record);
     void viewMedicalHistory() const;
     void viewAppointments() const;
     void requestEmergencyAppointment(Doctor* doctor);
 };
 
+// Patient ID -> live record, used to resolve IDs read back from files
+using PatientIndex = std::unordered_map<std::string, Patient*>;
+PatientIndex buildPatientIndex(const std::vector<Patient*>& patients);
+
 #endif
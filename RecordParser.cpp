@@ -0,0 +1,77 @@
+#include "RecordParser.h"
+#include "MappedFile.h"
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+    // Cuts the line starting at cursor; cursor moves past its newline
+    string_view takeLine(const char*& cursor, const char* end) {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        const char* lineEnd = newline ? newline : end;
+        size_t length = lineEnd - cursor;
+        if (length > 0 && cursor[length - 1] == '\r') --length;
+        string_view line(cursor, length);
+        cursor = newline ? newline + 1 : end;
+        return line;
+    }
+}
+
+RecordParser::RecordParser(const char* data, size_t size, char delimiter)
+    : cursor(data), end(data ? data + size : data), delimiter(delimiter) {}
+
+RecordParser::RecordParser(const MappedFile& file, char delimiter)
+    : RecordParser(file.data(), file.size(), delimiter) {}
+
+bool RecordParser::next() {
+    while (cursor < end) {
+        current = takeLine(cursor, end);
+        ++lineNo;
+        if (current.find_first_not_of(" \t") == string_view::npos) continue;
+        count = split(current, delimiter, fields, MAX_FIELDS);
+        return true;
+    }
+    current = string_view();
+    count = 0;
+    return false;
+}
+
+size_t RecordParser::split(string_view text, char delimiter, string_view* out, size_t maxFields) {
+    if (maxFields == 0) return 0;
+    size_t n = 0;
+    size_t start = 0;
+    while (n + 1 < maxFields) {
+        size_t pos = text.find(delimiter, start);
+        if (pos == string_view::npos) break;
+        out[n++] = text.substr(start, pos - start);
+        start = pos + 1;
+    }
+    out[n++] = text.substr(start);
+    return n;
+}
+
+vector<string_view> RecordParser::splitLines(const char* data, size_t size) {
+    vector<string_view> lines;
+    if (!data) return lines;
+    const char* cursor = data;
+    const char* end = data + size;
+    while (cursor < end) {
+        lines.push_back(takeLine(cursor, end));
+    }
+    return lines;
+}
+
+bool RecordParser::toInt(string_view text, int& value) {
+    if (text.empty()) return false;
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (*first == '+') ++first;  // stoi accepted a leading '+'
+    auto [ptr, ec] = from_chars(first, last, value);
+    return ec == errc() && ptr == last;
+}
+
+void RecordParser::reportMalformed(const string& source, size_t lineNumber, const string& reason) {
+    cerr << ("Warning: Skipped malformed line " + to_string(lineNumber) + " in " + source + ": " + reason + "\n");
+}
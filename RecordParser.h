@@ -0,0 +1,67 @@
+#ifndef RECORD_PARSER_H
+#define RECORD_PARSER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class MappedFile;
+
+// Reads delimited text records (users.dat, doctors.dat, ...) straight out
+// of a buffer. Lines and fields are string_views into that buffer, so
+// nothing is copied until the caller keeps a value; the buffer must
+// outlive the parser.
+//
+//   RecordParser parser(file);
+//   while (parser.next()) {
+//       if (parser.fieldCount() < 3) { parser.reportMalformed(path, "expected 3 fields"); continue; }
+//       use(parser.field(0), parser.field(1), parser.field(2));
+//   }
+class RecordParser {
+public:
+    static const std::size_t MAX_FIELDS = 16;
+
+    RecordParser(const char* data, std::size_t size, char delimiter = ',');
+    explicit RecordParser(const MappedFile& file, char delimiter = ',');
+
+    // Moves to the next non-blank line and splits it. Returns false at the
+    // end of the buffer.
+    bool next();
+
+    std::string_view line() const { return current; }
+    std::size_t lineNumber() const { return lineNo; }  // 1-based
+
+    // Fields past MAX_FIELDS stay joined in the last one
+    std::size_t fieldCount() const { return count; }
+    std::string_view field(std::size_t i) const { return i < count ? fields[i] : std::string_view(); }
+
+    void reportMalformed(const std::string& source, const std::string& reason) const {
+        reportMalformed(source, lineNo, reason);
+    }
+
+    // Splits text at delimiter into at most maxFields views, the last of
+    // which keeps any remainder. Returns the number of fields.
+    static std::size_t split(std::string_view text, char delimiter, std::string_view* out, std::size_t maxFields);
+
+    // Every line of the buffer, blank ones included, so that index + 1 is
+    // the line number. A trailing '\r' is dropped.
+    static std::vector<std::string_view> splitLines(const char* data, std::size_t size);
+
+    // Whole-field decimal integer; false on anything else
+    static bool toInt(std::string_view text, int& value);
+
+    // One write per report, so it is safe from pool threads
+    static void reportMalformed(const std::string& source, std::size_t lineNumber, const std::string& reason);
+
+private:
+    const char* cursor;
+    const char* end;
+    char delimiter;
+    std::size_t lineNo = 0;
+    std::string_view current;
+    std::string_view fields[MAX_FIELDS];
+    std::size_t count = 0;
+};
+
+#endif
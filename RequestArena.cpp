@@ -0,0 +1,14 @@
+#include "RequestArena.h"
+
+RequestArena::RequestArena(std::size_t initialSize)
+    : buffer(initialSize),
+      resource(buffer.data(), buffer.size(), std::pmr::new_delete_resource()) {}
+
+std::pmr::memory_resource* RequestArena::get() {
+    return &resource;
+}
+
+void RequestArena::reset() {
+    // Returns any overflow blocks upstream and rewinds to the start of buffer
+    resource.release();
+}
@@ -0,0 +1,26 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Reusable arena for the temporaries built while serving one menu request
+// (candidate doctor lists, distance maps, sort buffers, queue copies).
+// Allocations are bump-pointer and are all released together by reset().
+class RequestArena {
+private:
+    std::vector<std::byte> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+
+public:
+    explicit RequestArena(std::size_t initialSize = 64 * 1024);
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* get();
+    void reset();
+};
+
+#endif
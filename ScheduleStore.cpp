@@ -0,0 +1,404 @@
+#include "ScheduleStore.h"
+#include "AppointmentRegistry.h"
+#include "Doctor.h"
+#include "Journal.h"
+#include "Patient.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+using namespace SnapshotFormat;
+
+ScheduleStore& ScheduleStore::instance() {
+    static ScheduleStore store;
+    return store;
+}
+
+bool ScheduleStore::attach(unique_ptr<MappedFile> snapshot, const vector<Doctor*>& snapshotDoctors,
+                           const vector<Patient*>& snapshotPatients) {
+    Header read{};
+    if (!snapshot || !snapshot->isOpen() || snapshot->size() < sizeof(Header)) {
+        cerr << "Error: Could not map the snapshot to read appointments from\n";
+        return false;
+    }
+    memcpy(&read, snapshot->data(), sizeof(Header));
+    bool valid = read.version == 4 && read.doctorCount == snapshotDoctors.size() &&
+                 read.patientCount == snapshotPatients.size() &&
+                 tableFits<AppointmentRecord>(*snapshot, read.appointmentOffset, read.appointmentCount) &&
+                 tableFits<DoctorScheduleRecord>(*snapshot, read.scheduleOffset, read.doctorCount) &&
+                 tableFits<PatientScheduleRecord>(*snapshot, read.patientScheduleOffset, read.patientCount) &&
+                 tableFits<IdIndexRecord>(*snapshot, read.idIndexOffset, read.appointmentCount) &&
+                 tableFits<uint32_t>(*snapshot, read.patientDoctorOffset, read.patientDoctorCount) &&
+                 read.patientDoctorOffset == read.idIndexOffset + read.appointmentCount * sizeof(IdIndexRecord);
+    for (uint64_t i = 0; valid && i < read.doctorCount; ++i) {
+        DoctorScheduleRecord run = readRecord<DoctorScheduleRecord>(*snapshot, read.scheduleOffset, i);
+        valid = uint64_t(run.firstAppointment) + run.appointmentCount <= read.appointmentCount;
+    }
+    for (uint64_t i = 0; valid && i < read.patientCount; ++i) {
+        PatientScheduleRecord run = readRecord<PatientScheduleRecord>(*snapshot, read.patientScheduleOffset, i);
+        valid = uint64_t(run.firstDoctor) + run.doctorCount <= read.patientDoctorCount;
+    }
+    if (!valid) {
+        cerr << "Error: Snapshot has an invalid appointment schedule table\n";
+        return false;
+    }
+
+    file = std::move(snapshot);
+    releasedPath.clear();
+    header = read;
+    doctors = snapshotDoctors;
+    patients = snapshotPatients;
+    lastUsed.assign(doctors.size(), 0);
+    damaged.assign(doctors.size(), false);
+    lookup = LookupState::Unchecked;
+
+    for (uint32_t i = 0; i < doctors.size(); ++i) {
+        Doctor* doctor = doctors[i];
+        doctor->scheduleIndex = i;
+        if (!doctor->scheduleLoaded &&
+            readRecord<DoctorScheduleRecord>(*file, header.scheduleOffset, i).appointmentCount == 0) {
+            doctor->scheduleLoaded = true;
+        }
+        // Whatever is loaded was just read from or written to this snapshot
+        if (doctor->scheduleLoaded) {
+            doctor->scheduleInSnapshot = true;
+            lastUsed[i] = ++tick;
+        }
+    }
+    for (uint32_t i = 0; i < patients.size(); ++i) {
+        patients[i]->scheduleIndex = i;
+    }
+    AppointmentRegistry::instance().reserveIds(header.maxAppointmentId);
+    return true;
+}
+
+void ScheduleStore::setPreviousVersion(const string& snapshotPath, const string& journalPath) {
+    previousSnapshot = snapshotPath;
+    previousJournal = journalPath;
+}
+
+void ScheduleStore::detach() {
+    file.reset();
+    releasedPath.clear();
+    header = Header{};
+    doctors.clear();
+    patients.clear();
+    lastUsed.clear();
+    damaged.clear();
+    lookup = LookupState::Unchecked;
+}
+
+void ScheduleStore::release() {
+    if (!file) return;
+    releasedPath = file->path();
+    file.reset();
+}
+
+bool ScheduleStore::reattach() {
+    if (releasedPath.empty()) return true;
+    unique_ptr<MappedFile> mapping = make_unique<MappedFile>(releasedPath);
+    releasedPath.clear();
+    if (!mapping->isOpen() || mapping->size() < sizeof(Header) ||
+        memcmp(mapping->data(), &header, sizeof(Header)) != 0) {
+        cerr << "Error: The snapshot changed while it was released; appointments not loaded yet are lost\n";
+        detach();
+        return false;
+    }
+    file = std::move(mapping);
+    return true;
+}
+
+void ScheduleStore::forget(const Doctor* doctor) {
+    if (isAttached(doctor)) doctors[doctor->scheduleIndex] = nullptr;
+}
+
+bool ScheduleStore::isAttached(const Doctor* doctor) const {
+    return doctor && doctor->scheduleIndex < doctors.size() && doctors[doctor->scheduleIndex] == doctor;
+}
+
+void ScheduleStore::ensureLoaded(const Doctor* doctor) {
+    if (!isAttached(doctor)) return;
+    if (!doctor->scheduleLoaded) {
+        load(doctor->scheduleIndex);
+    } else {
+        lastUsed[doctor->scheduleIndex] = ++tick;
+    }
+}
+
+bool ScheduleStore::readStored(const Doctor* doctor, vector<StoredAppointment>& appointments) const {
+    appointments.clear();
+    if (!isAttached(doctor)) return false;
+    uint32_t doctorIndex = doctor->scheduleIndex;
+    DoctorScheduleRecord run = readRecord<DoctorScheduleRecord>(*file, header.scheduleOffset, doctorIndex);
+    const char* first = file->data() + header.appointmentOffset + uint64_t(run.firstAppointment) * sizeof(AppointmentRecord);
+    if (Utils::crc32(first, size_t(run.appointmentCount) * sizeof(AppointmentRecord)) != run.checksum) {
+        return false;
+    }
+
+    appointments.reserve(run.appointmentCount);
+    for (uint32_t i = 0; i < run.appointmentCount; ++i) {
+        AppointmentRecord record = readRecord<AppointmentRecord>(*file, header.appointmentOffset, run.firstAppointment + i);
+        if (record.doctorIndex != doctorIndex ||
+            (record.patientIndex != NO_PATIENT && record.patientIndex >= patients.size())) {
+            appointments.clear();
+            return false;
+        }
+        StoredAppointment stored{Appointment(), record.slotIndex};
+        stored.appointment.id = record.id;
+        stored.appointment.doctor = doctors[doctorIndex];
+        stored.appointment.patient = record.patientIndex == NO_PATIENT ? nullptr : patients[record.patientIndex];
+        stored.appointment.packedDate = record.packedDate;
+        stored.appointment.minutes = record.minutes;
+        stored.appointment.flags = record.flags;
+        appointments.push_back(stored);
+    }
+    return true;
+}
+
+// The attached snapshot was written from the previous one plus the journal
+// records compacted into it, so the doctor's run in the previous snapshot
+// with the doctor's share of those records replayed over it is what the
+// damaged run held. Only a version 4 previous snapshot is used.
+bool ScheduleStore::recover(uint32_t doctorIndex, vector<StoredAppointment>& appointments) const {
+    appointments.clear();
+    MappedFile previous;
+    Header old{};
+    if (previousSnapshot.empty() || !previous.open(previousSnapshot) || previous.size() < sizeof(Header)) return false;
+    memcpy(&old, previous.data(), sizeof(Header));
+    if (memcmp(old.magic, MAGIC, sizeof(MAGIC)) != 0 || old.version != 4 || old.headerSize != sizeof(Header) ||
+        !tableFits<DoctorRecord>(previous, old.doctorOffset, old.doctorCount) ||
+        !tableFits<PatientRecord>(previous, old.patientOffset, old.patientCount) ||
+        !tableFits<AppointmentRecord>(previous, old.appointmentOffset, old.appointmentCount) ||
+        !tableFits<DoctorScheduleRecord>(previous, old.scheduleOffset, old.doctorCount)) {
+        return false;
+    }
+
+    // The previous snapshot numbers patients differently
+    unordered_map<string, Patient*> patientsById;
+    for (Patient* patient : patients) {
+        patientsById[patient->getId()] = patient;
+    }
+    auto findPatient = [&](const string& id) -> Patient* {
+        auto it = patientsById.find(id);
+        return it == patientsById.end() ? nullptr : it->second;
+    };
+
+    // A doctor added after the previous snapshot starts out with nothing
+    Doctor* doctor = doctors[doctorIndex];
+    const string doctorID = doctor->getId();
+    for (uint64_t i = 0; i < old.doctorCount; ++i) {
+        if (!(readRecord<DoctorRecord>(previous, old.doctorOffset, i).id == doctorID)) continue;
+        DoctorScheduleRecord run = readRecord<DoctorScheduleRecord>(previous, old.scheduleOffset, i);
+        const char* first = previous.data() + old.appointmentOffset + uint64_t(run.firstAppointment) * sizeof(AppointmentRecord);
+        if (uint64_t(run.firstAppointment) + run.appointmentCount > old.appointmentCount ||
+            Utils::crc32(first, size_t(run.appointmentCount) * sizeof(AppointmentRecord)) != run.checksum) {
+            return false;
+        }
+        for (uint32_t a = 0; a < run.appointmentCount; ++a) {
+            AppointmentRecord record = readRecord<AppointmentRecord>(previous, old.appointmentOffset, run.firstAppointment + a);
+            StoredAppointment stored{Appointment(), record.slotIndex};
+            stored.appointment.id = record.id;
+            stored.appointment.doctor = doctor;
+            if (record.patientIndex != NO_PATIENT && record.patientIndex < old.patientCount) {
+                stored.appointment.patient =
+                    findPatient(readRecord<PatientRecord>(previous, old.patientOffset, record.patientIndex).id.str());
+            }
+            stored.appointment.packedDate = record.packedDate;
+            stored.appointment.minutes = record.minutes;
+            stored.appointment.flags = record.flags;
+            appointments.push_back(stored);
+        }
+        break;
+    }
+
+    auto findStored = [&](const string& id) {
+        uint32_t appointmentId = static_cast<uint32_t>(stoul(id));
+        return find_if(appointments.begin(), appointments.end(),
+                       [&](const StoredAppointment& entry) { return entry.appointment.id == appointmentId; });
+    };
+    Journal::read(previousJournal, [&](const vector<string>& fields, size_t) {
+        if (fields.empty()) return;
+        const string& type = fields[0];
+        try {
+            if (type == Journal::BOOK && fields.size() == 8) {
+                if (fields[2] != doctorID || findStored(fields[1]) != appointments.end()) return;
+                StoredAppointment stored{Appointment(fields[4], fields[5], doctor, findPatient(fields[3]), fields[6] == "1"),
+                                         stoi(fields[7])};
+                stored.appointment.id = static_cast<uint32_t>(stoul(fields[1]));
+                appointments.push_back(stored);
+            } else if ((type == Journal::CANCEL && fields.size() == 2) ||
+                       (type == Journal::MISSED && fields.size() == 2) ||
+                       (type == Journal::REBOOK && fields.size() == 5)) {
+                auto it = findStored(fields[1]);
+                if (it == appointments.end()) return;
+                if (type == Journal::CANCEL) {
+                    appointments.erase(it);
+                } else if (type == Journal::MISSED) {
+                    it->appointment.markMissed();
+                } else {
+                    it->appointment.reschedule(fields[2], fields[3]);
+                    it->slotIndex = stoi(fields[4]);
+                }
+            } else if (type == Journal::ARCHIVE && fields.size() == 2) {
+                uint32_t horizon = Utils::packDate(fields[1]);
+                appointments.erase(remove_if(appointments.begin(), appointments.end(),
+                                             [&](const StoredAppointment& entry) { return entry.appointment.packedDate < horizon; }),
+                                   appointments.end());
+            } else if (type == Journal::DOCTOR_DELETE && fields.size() == 2 && fields[1] == doctorID) {
+                appointments.clear();
+            }
+        } catch (const exception&) {
+            // Replay skips the same malformed records
+        }
+    });
+    return true;
+}
+
+void ScheduleStore::load(uint32_t doctorIndex) {
+    Doctor* doctor = doctors[doctorIndex];
+    if (damaged[doctorIndex]) return;
+    vector<StoredAppointment> stored;
+    bool recovered = false;
+    if (!readStored(doctor, stored)) {
+        recovered = recover(doctorIndex, stored);
+        if (!recovered) {
+            cerr << "Error: Appointments of Dr. " << doctor->getName()
+                 << " are damaged in the snapshot and could not be recovered\n";
+            damaged[doctorIndex] = true;
+            return;
+        }
+        cerr << "Warning: Appointments of Dr. " << doctor->getName()
+             << " were damaged in the snapshot; recovered them from the previous snapshot and journal\n";
+    }
+
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    bool wasDirty = doctor->dirty;
+    doctor->scheduleLoaded = true;
+    doctor->appointments.reserve(stored.size());
+    for (const StoredAppointment& entry : stored) {
+        registry.attachSlot(registry.insert(entry.appointment).id, entry.slotIndex);
+    }
+    doctor->dirty = wasDirty;  // Loaded state is already stored
+    // A recovered doctor stays in memory until compaction rewrites its run
+    doctor->scheduleInSnapshot = !recovered;
+    lastUsed[doctorIndex] = ++tick;
+}
+
+void ScheduleStore::evict(uint32_t doctorIndex) {
+    Doctor* doctor = doctors[doctorIndex];
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    bool wasDirty = doctor->dirty;
+    while (!doctor->appointments.empty()) {
+        registry.erase(doctor->appointments.back().id);
+    }
+    doctor->dirty = wasDirty;
+    doctor->appointments.shrink_to_fit();
+    doctor->scheduleLoaded = false;
+}
+
+// The ID index and patient doctor table are checked once, on first use
+bool ScheduleStore::lookupValid() {
+    if (!file) return true;
+    if (lookup == LookupState::Unchecked) {
+        size_t bytes = header.appointmentCount * sizeof(IdIndexRecord) + header.patientDoctorCount * sizeof(uint32_t);
+        bool valid = Utils::crc32(file->data() + header.idIndexOffset, bytes) == header.lookupChecksum;
+        lookup = valid ? LookupState::Valid : LookupState::Damaged;
+        if (!valid) {
+            cerr << "Warning: The snapshot's appointment index is damaged, loading all appointments instead\n";
+        }
+    }
+    return lookup == LookupState::Valid;
+}
+
+bool ScheduleStore::loadAppointment(uint32_t id) {
+    if (!file || id == 0 || id > header.maxAppointmentId) return false;
+    if (!lookupValid()) {
+        loadAll();
+        return true;
+    }
+
+    uint64_t low = 0, high = header.appointmentCount;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (readRecord<IdIndexRecord>(*file, header.idIndexOffset, middle).id < id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == header.appointmentCount) return false;
+    IdIndexRecord entry = readRecord<IdIndexRecord>(*file, header.idIndexOffset, low);
+    if (entry.id != id || entry.appointmentIndex >= header.appointmentCount) return false;
+
+    uint32_t doctorIndex = readRecord<AppointmentRecord>(*file, header.appointmentOffset, entry.appointmentIndex).doctorIndex;
+    if (doctorIndex >= doctors.size() || !doctors[doctorIndex] || doctors[doctorIndex]->scheduleLoaded) {
+        return false;
+    }
+    load(doctorIndex);
+    return doctors[doctorIndex]->scheduleLoaded;
+}
+
+void ScheduleStore::loadPatient(const Patient* patient) {
+    if (!file || !patient || patient->scheduleIndex >= patients.size() || patients[patient->scheduleIndex] != patient) {
+        return;
+    }
+    if (!lookupValid()) {
+        loadAll();
+        return;
+    }
+    PatientScheduleRecord run = readRecord<PatientScheduleRecord>(*file, header.patientScheduleOffset, patient->scheduleIndex);
+    for (uint32_t i = 0; i < run.doctorCount; ++i) {
+        uint32_t doctorIndex = readRecord<uint32_t>(*file, header.patientDoctorOffset, run.firstDoctor + i);
+        if (doctorIndex < doctors.size() && doctors[doctorIndex] && !doctors[doctorIndex]->scheduleLoaded) {
+            load(doctorIndex);
+        }
+    }
+}
+
+void ScheduleStore::loadBefore(uint32_t packedDate) {
+    for (uint32_t i = 0; i < doctors.size(); ++i) {
+        if (!doctors[i] || doctors[i]->scheduleLoaded) continue;
+        DoctorScheduleRecord run = readRecord<DoctorScheduleRecord>(*file, header.scheduleOffset, i);
+        if (run.appointmentCount > 0 && run.firstDate < packedDate) load(i);
+    }
+}
+
+void ScheduleStore::loadAll() {
+    for (uint32_t i = 0; i < doctors.size(); ++i) {
+        if (doctors[i] && !doctors[i]->scheduleLoaded) load(i);
+    }
+}
+
+size_t ScheduleStore::residentAppointments() const {
+    size_t resident = 0;
+    for (const Doctor* doctor : doctors) {
+        if (doctor && doctor->scheduleLoaded) resident += doctor->appointments.size();
+    }
+    return resident;
+}
+
+size_t ScheduleStore::evictIdle() {
+    size_t resident = 0;
+    vector<uint32_t> idle;
+    for (uint32_t i = 0; i < doctors.size(); ++i) {
+        const Doctor* doctor = doctors[i];
+        if (!doctor || !doctor->scheduleLoaded) continue;
+        resident += doctor->appointments.size();
+        if (doctor->scheduleInSnapshot && !doctor->appointments.empty()) idle.push_back(i);
+    }
+    if (resident <= MAX_RESIDENT_APPOINTMENTS) return 0;
+
+    sort(idle.begin(), idle.end(), [this](uint32_t a, uint32_t b) { return lastUsed[a] < lastUsed[b]; });
+    size_t evicted = 0;
+    for (uint32_t doctorIndex : idle) {
+        if (resident <= MAX_RESIDENT_APPOINTMENTS) break;
+        resident -= doctors[doctorIndex]->appointments.size();
+        evict(doctorIndex);
+        ++evicted;
+    }
+    if (evicted > 0) AppointmentRegistry::instance().shrinkToFit();
+    return evicted;
+}
@@ -0,0 +1,118 @@
+#ifndef SCHEDULE_STORE_H
+#define SCHEDULE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Appointment.h"
+#include "MappedFile.h"
+#include "SnapshotFormat.h"
+
+class Doctor;
+class Patient;
+
+// Doctors' appointments, read from the snapshot on demand. Loading a
+// version 4 snapshot builds doctors, patients and slots only; each
+// doctor's appointments stay in the mapped file until something needs
+// them: a lookup by ID, a booking or listing for that doctor, a patient's
+// list, or a bulk operation such as archiving. Startup time and memory so
+// depend on how many doctors are used, not on how many appointments are
+// stored.
+//
+// Each doctor's appointments carry a checksum, checked when they are
+// loaded. A damaged run is rebuilt from the previous snapshot and the
+// journal compacted into the current one (see setPreviousVersion), so
+// damage costs that doctor a slower load instead of its appointments.
+//
+// Doctors whose appointments have not changed since the snapshot can be
+// dropped again and reloaded later; evictIdle drops the least recently
+// used ones once more than MAX_RESIDENT_APPOINTMENTS are in memory.
+// Slots are always loaded: the availability index needs all of them, and
+// they are bounded by the doctor's slot limits.
+//
+// Not thread-safe; used from the menu thread.
+class ScheduleStore {
+public:
+    static constexpr std::size_t MAX_RESIDENT_APPOINTMENTS = 1 << 18;
+
+    // An appointment as stored, with the slot it holds
+    struct StoredAppointment {
+        Appointment appointment;
+        int32_t slotIndex;
+    };
+
+    static ScheduleStore& instance();
+
+    // Serves appointments from a version 4 snapshot, whose doctor and
+    // patient tables are in the order given. Doctors not loaded yet read
+    // theirs from it from now on. Keeps the previous snapshot and returns
+    // false if this one cannot be used.
+    bool attach(std::unique_ptr<MappedFile> file, const std::vector<Doctor*>& doctors,
+                const std::vector<Patient*>& patients);
+    // The snapshot before the attached one and the journal records that
+    // compaction folded into it, which load() rebuilds damaged runs from
+    void setPreviousVersion(const std::string& snapshotPath, const std::string& journalPath);
+    // Drops the snapshot; for when every doctor is about to be deleted
+    void detach();
+    // Unmaps the snapshot while a new file is renamed over it, which
+    // Windows refuses for a mapped file, and maps it again afterwards.
+    // Nothing may be loaded in between. reattach returns false, and the
+    // doctors not loaded lose their appointments, if the file at the path
+    // is no longer the snapshot that was released.
+    void release();
+    bool reattach();
+    // Drops a doctor that is being deleted, with anything not loaded
+    void forget(const Doctor* doctor);
+    // True if the doctor is in the attached snapshot, which then holds its
+    // appointments as of the last compaction
+    bool isAttached(const Doctor* doctor) const;
+
+    void ensureLoaded(const Doctor* doctor);
+    // Loads the doctor holding this appointment ID, if it is not loaded.
+    // Returns true when that made the ID known.
+    bool loadAppointment(uint32_t id);
+    // Loads every doctor the patient has appointments with
+    void loadPatient(const Patient* patient);
+    // Loads every doctor with appointments dated before packedDate
+    void loadBefore(uint32_t packedDate);
+    void loadAll();
+
+    // Evicts unchanged doctors, least recently used first, until at most
+    // MAX_RESIDENT_APPOINTMENTS are in memory. References to evicted
+    // appointments become invalid, so call only between requests. Returns
+    // the number of doctors evicted.
+    std::size_t evictIdle();
+
+    // Appointments of a doctor that is not loaded, for saving. Returns
+    // false if they are damaged in the snapshot.
+    bool readStored(const Doctor* doctor, std::vector<StoredAppointment>& appointments) const;
+    std::size_t residentAppointments() const;
+    // False if the snapshot's ID index and patient doctor table are
+    // damaged; lookups then load every doctor instead
+    bool lookupValid();
+
+private:
+    enum class LookupState { Unchecked, Valid, Damaged };
+
+    std::unique_ptr<MappedFile> file;
+    std::string releasedPath;        // Set while the snapshot is released
+    SnapshotFormat::Header header{};
+    std::vector<Doctor*> doctors;    // Snapshot order; null once forgotten
+    std::vector<Patient*> patients;  // Snapshot order
+    std::vector<uint64_t> lastUsed;  // Per doctor, in ticks
+    std::vector<bool> damaged;       // Per doctor, run failed its checksum
+    uint64_t tick = 0;
+    LookupState lookup = LookupState::Unchecked;
+    std::string previousSnapshot;
+    std::string previousJournal;
+
+    ScheduleStore() = default;
+
+    bool recover(uint32_t doctorIndex, std::vector<StoredAppointment>& appointments) const;
+    void load(uint32_t doctorIndex);
+    void evict(uint32_t doctorIndex);
+};
+
+#endif
@@ -1,18 +1,25 @@
 #include "Slot.h"
+#include "Utils.h"
 #include <string>
 
 using namespace std;
 
-Slot::Slot(const string& time) : time(time) {}
+Slot::Slot(const string& time) : minutes(Utils::packTime(time)) {}
+
+Slot::Slot(uint16_t minutes) : minutes(minutes) {}
+
+string Slot::getTime() const {
+    return Utils::unpackTime(minutes);
+}
+
+bool Slot::isAt(const string& time) const {
+    return minutes == Utils::packTime(time);
+}
 
 bool Slot::isAvailable() const {
     return !isBooked;
 }
 
-void Slot::assignAppointment(const Appointment& app) {
-    if (isAvailable()) {
-        appointment = app;
-        isBooked = true;
-    }
+bool Slot::hasAppointment() const {
+    return appointmentId != NO_APPOINTMENT;
 }
-
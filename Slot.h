@@ -1,19 +1,25 @@
 #ifndef SLOT_H
 #define SLOT_H
 
+#include <cstdint>
 #include <string>
-#include "Appointment.h"
 
+// A bookable time of day. The booked appointment, if any, is referenced by
+// its ID (see AppointmentRegistry).
 class Slot {
 public:
-    std::string time;
+    static const uint32_t NO_APPOINTMENT = 0;
+
+    uint16_t minutes;   // minutes since midnight
     bool isBooked = false;
-    Appointment appointment;
+    uint32_t appointmentId = NO_APPOINTMENT;
 
     Slot(const std::string& time);
+    explicit Slot(uint16_t minutes);
+    std::string getTime() const;
+    bool isAt(const std::string& time) const;
     bool isAvailable() const;
-    void assignAppointment(const Appointment& app);
+    bool hasAppointment() const;
 };
 
 #endif
-
@@ -0,0 +1,363 @@
+#include "SnapshotFile.h"
+#include "AppointmentRegistry.h"
+#include "MappedFile.h"
+#include "ScheduleStore.h"
+#include "SnapshotFormat.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+using namespace SnapshotFormat;
+
+namespace {
+    // Version 4 leaves the appointment table and the lookup tables behind
+    // it out of this checksum: appointments are checked per doctor when
+    // they are loaded, the lookup tables on first use
+    uint32_t fileChecksum(const Header& header, const MappedFile& file) {
+        Header unsummed = header;
+        unsummed.checksum = 0;
+        uint32_t crc = Utils::crc32(&unsummed, header.headerSize);
+        if (header.version < 4) {
+            return Utils::crc32(file.data() + header.headerSize, file.size() - header.headerSize, crc);
+        }
+        auto table = [&](uint64_t offset, uint64_t bytes) {
+            crc = Utils::crc32(file.data() + offset, bytes, crc);
+        };
+        table(header.doctorOffset, header.doctorCount * sizeof(DoctorRecord));
+        table(header.patientOffset, header.patientCount * sizeof(PatientRecord));
+        table(header.slotOffset, header.slotCount * sizeof(SlotRecord));
+        table(header.queueOffset, header.queueCount * sizeof(QueueRecord));
+        table(header.scheduleOffset, header.doctorCount * sizeof(DoctorScheduleRecord));
+        table(header.patientScheduleOffset, header.patientCount * sizeof(PatientScheduleRecord));
+        return crc;
+    }
+
+    template <typename Record>
+    void writeTable(ostream& out, const vector<Record>& records) {
+        if (!records.empty()) {
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        }
+    }
+
+    template <typename Record>
+    uint32_t tableChecksum(const vector<Record>& records, uint32_t crc = 0) {
+        return Utils::crc32(records.data(), records.size() * sizeof(Record), crc);
+    }
+}
+
+bool SnapshotFile::save(const string& path, const DoctorManager& doctorManager, const vector<Patient*>& patients) {
+    vector<DoctorRecord> doctorRecords;
+    vector<PatientRecord> patientRecords;
+    vector<SlotRecord> slotRecords;
+    vector<AppointmentRecord> appointmentRecords;
+    vector<QueueRecord> queueRecords;
+    vector<DoctorScheduleRecord> scheduleRecords;
+    vector<Patient*> savedPatients;
+    unordered_map<const Patient*, uint32_t> patientIndex;
+
+    for (Patient* patient : patients) {
+        if (!patient) continue;
+        patientIndex[patient] = static_cast<uint32_t>(patientRecords.size());
+        savedPatients.push_back(patient);
+        PatientRecord record{};
+        record.id = patient->patientID;
+        record.name = patient->name;
+        record.location = patient->location;
+        record.urgencyLevel = patient->urgencyLevel;
+        patientRecords.push_back(record);
+    }
+
+    // (patient, doctor) for every appointment with a patient
+    vector<pair<uint32_t, uint32_t>> patientDoctorPairs;
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    ScheduleStore& store = ScheduleStore::instance();
+    vector<ScheduleStore::StoredAppointment> stored;
+
+    vector<Doctor*> doctors = doctorManager.getAllDoctors();
+    for (Doctor* doctor : doctors) {
+        uint32_t doctorIndex = static_cast<uint32_t>(doctorRecords.size());
+        DoctorRecord record{};
+        record.id = doctor->doctorID;
+        record.name = doctor->name;
+        record.specialization = doctor->specialization;
+        record.location = doctor->location;
+        record.maxNormalSlots = doctor->maxNormalSlots;
+        record.maxEmergencySlots = doctor->maxEmergencySlots;
+        record.firstSlot = static_cast<uint32_t>(slotRecords.size());
+        record.normalSlotCount = static_cast<uint16_t>(doctor->normalSlots.size());
+        record.emergencySlotCount = static_cast<uint16_t>(doctor->emergencySlots.size());
+        doctorRecords.push_back(record);
+
+        for (const auto* slots : {&doctor->normalSlots, &doctor->emergencySlots}) {
+            for (const Slot& slot : *slots) {
+                slotRecords.push_back({slot.minutes, static_cast<uint8_t>(slot.isBooked), 0, slot.appointmentId});
+            }
+        }
+
+        DoctorScheduleRecord schedule{};
+        schedule.firstAppointment = static_cast<uint32_t>(appointmentRecords.size());
+        auto addAppointment = [&](const Appointment& app, int32_t slotIndex) {
+            auto patientIt = patientIndex.find(app.patient);
+            AppointmentRecord appRecord{};
+            appRecord.id = app.id;
+            appRecord.doctorIndex = doctorIndex;
+            appRecord.patientIndex = patientIt == patientIndex.end() ? NO_PATIENT : patientIt->second;
+            appRecord.packedDate = app.packedDate;
+            appRecord.slotIndex = slotIndex;
+            appRecord.minutes = app.minutes;
+            appRecord.flags = app.flags;
+            appointmentRecords.push_back(appRecord);
+            if (appRecord.patientIndex != NO_PATIENT) patientDoctorPairs.emplace_back(appRecord.patientIndex, doctorIndex);
+            if (schedule.firstDate == 0 || app.packedDate < schedule.firstDate) schedule.firstDate = app.packedDate;
+        };
+        // Copied from the current snapshot without loading the doctor, unless
+        // the run there is damaged; loading it then recovers it
+        bool copied = !doctor->scheduleLoaded && store.readStored(doctor, stored);
+        if (!doctor->scheduleLoaded && !copied) {
+            store.ensureLoaded(doctor);
+        }
+        if (copied) {
+            for (const ScheduleStore::StoredAppointment& entry : stored) {
+                addAppointment(entry.appointment, entry.slotIndex);
+            }
+        } else if (doctor->scheduleLoaded) {
+            for (const Appointment& app : doctor->appointments) {
+                const AppointmentRegistry::Location* location = registry.locate(app.id);
+                addAppointment(app, location ? location->slotIndex : AppointmentRegistry::NO_SLOT);
+            }
+        } else {
+            cerr << "Error: Appointments of Dr. " << doctor->getName() << " could not be read, snapshot not saved\n";
+            return false;
+        }
+        schedule.appointmentCount = static_cast<uint32_t>(appointmentRecords.size()) - schedule.firstAppointment;
+        schedule.checksum = Utils::crc32(appointmentRecords.data() + schedule.firstAppointment,
+                                         schedule.appointmentCount * sizeof(AppointmentRecord));
+        scheduleRecords.push_back(schedule);
+
+        for (const EmergencyQueue::Entry& entry : doctor->emergencyQueue.entries()) {
+            auto patientIt = patientIndex.find(entry.patient);
+            if (patientIt == patientIndex.end()) continue;
+            queueRecords.push_back({entry.enqueuedAt, doctorIndex, patientIt->second, entry.urgency, 0});
+        }
+    }
+
+    // Lookup tables: appointment by ID, and the doctors of each patient
+    vector<IdIndexRecord> idIndex(appointmentRecords.size());
+    for (size_t i = 0; i < appointmentRecords.size(); ++i) {
+        idIndex[i] = {appointmentRecords[i].id, static_cast<uint32_t>(i)};
+    }
+    sort(idIndex.begin(), idIndex.end(), [](const IdIndexRecord& a, const IdIndexRecord& b) { return a.id < b.id; });
+
+    sort(patientDoctorPairs.begin(), patientDoctorPairs.end());
+    patientDoctorPairs.erase(unique(patientDoctorPairs.begin(), patientDoctorPairs.end()), patientDoctorPairs.end());
+    vector<PatientScheduleRecord> patientScheduleRecords(patientRecords.size(), PatientScheduleRecord{0, 0});
+    vector<uint32_t> patientDoctors;
+    patientDoctors.reserve(patientDoctorPairs.size());
+    for (const auto& [patient, doctor] : patientDoctorPairs) {
+        PatientScheduleRecord& run = patientScheduleRecords[patient];
+        if (run.doctorCount == 0) run.firstDoctor = static_cast<uint32_t>(patientDoctors.size());
+        ++run.doctorCount;
+        patientDoctors.push_back(doctor);
+    }
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+    header.doctorCount = doctorRecords.size();
+    header.doctorOffset = sizeof(Header);
+    header.patientCount = patientRecords.size();
+    header.patientOffset = header.doctorOffset + doctorRecords.size() * sizeof(DoctorRecord);
+    header.slotCount = slotRecords.size();
+    header.slotOffset = header.patientOffset + patientRecords.size() * sizeof(PatientRecord);
+    header.appointmentCount = appointmentRecords.size();
+    header.appointmentOffset = header.slotOffset + slotRecords.size() * sizeof(SlotRecord);
+    header.queueCount = queueRecords.size();
+    header.queueOffset = header.appointmentOffset + appointmentRecords.size() * sizeof(AppointmentRecord);
+    header.scheduleOffset = header.queueOffset + queueRecords.size() * sizeof(QueueRecord);
+    header.patientScheduleOffset = header.scheduleOffset + scheduleRecords.size() * sizeof(DoctorScheduleRecord);
+    header.idIndexOffset = header.patientScheduleOffset + patientScheduleRecords.size() * sizeof(PatientScheduleRecord);
+    header.patientDoctorCount = patientDoctors.size();
+    header.patientDoctorOffset = header.idIndexOffset + idIndex.size() * sizeof(IdIndexRecord);
+    header.lookupChecksum = tableChecksum(patientDoctors, tableChecksum(idIndex));
+    header.maxAppointmentId = idIndex.empty() ? 0 : idIndex.back().id;
+
+    // Same tables, in the same order, as fileChecksum reads them back
+    Header unsummed = header;
+    uint32_t crc = Utils::crc32(&unsummed, sizeof(unsummed));
+    crc = tableChecksum(doctorRecords, crc);
+    crc = tableChecksum(patientRecords, crc);
+    crc = tableChecksum(slotRecords, crc);
+    crc = tableChecksum(queueRecords, crc);
+    crc = tableChecksum(scheduleRecords, crc);
+    header.checksum = tableChecksum(patientScheduleRecords, crc);
+
+    // The current snapshot is usually the file being replaced, and Windows
+    // cannot rename over it while it is mapped; nothing is read from it
+    // past this point
+    store.release();
+    bool saved = Utils::writeFileAtomically(path, [&](ostream& out) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeTable(out, doctorRecords);
+        writeTable(out, patientRecords);
+        writeTable(out, slotRecords);
+        writeTable(out, appointmentRecords);
+        writeTable(out, queueRecords);
+        writeTable(out, scheduleRecords);
+        writeTable(out, patientScheduleRecords);
+        writeTable(out, idIndex);
+        writeTable(out, patientDoctors);
+    }, true);
+    // Doctors not loaded read from the new snapshot from now on, and loaded
+    // ones match it
+    if (!saved || !store.attach(make_unique<MappedFile>(path), doctors, savedPatients)) {
+        store.reattach();
+    }
+    return saved;
+}
+
+bool SnapshotFile::load(const string& path, DoctorManager& doctorManager, vector<Patient*>& patients) {
+    // Kept open by ScheduleStore for a version 4 snapshot
+    unique_ptr<MappedFile> mapping = make_unique<MappedFile>();
+    MappedFile& file = *mapping;
+    if (!file.open(path) || file.size() < headerSizeOf(1)) {
+        cerr << "Error: Snapshot " << path << " is truncated\n";
+        return false;
+    }
+
+    // Fields a version does not have stay zero
+    Header header{};
+    memcpy(&header, file.data(), headerSizeOf(1));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version < 1 || header.version > VERSION ||
+        header.headerSize != headerSizeOf(header.version)) {
+        cerr << "Error: " << path << " is not a version 1 to " << VERSION << " snapshot\n";
+        return false;
+    }
+    if (file.size() < header.headerSize) {
+        cerr << "Error: Snapshot " << path << " is truncated\n";
+        return false;
+    }
+    memcpy(&header, file.data(), header.headerSize);
+    bool lazy = header.version >= 4;
+    if (!tableFits<DoctorRecord>(file, header.doctorOffset, header.doctorCount) ||
+        !tableFits<PatientRecord>(file, header.patientOffset, header.patientCount) ||
+        !tableFits<SlotRecord>(file, header.slotOffset, header.slotCount) ||
+        !tableFits<AppointmentRecord>(file, header.appointmentOffset, header.appointmentCount) ||
+        !tableFits<QueueRecord>(file, header.queueOffset, header.queueCount) ||
+        (lazy && (!tableFits<DoctorScheduleRecord>(file, header.scheduleOffset, header.doctorCount) ||
+                  !tableFits<PatientScheduleRecord>(file, header.patientScheduleOffset, header.patientCount)))) {
+        cerr << "Error: Snapshot " << path << " is truncated\n";
+        return false;
+    }
+    // A torn or corrupted write fails here, before anything is built
+    if (header.version >= 2 && fileChecksum(header, file) != header.checksum) {
+        cerr << "Error: Snapshot " << path << " is damaged (checksum mismatch)\n";
+        return false;
+    }
+
+    // Check cross-table references before building anything
+    for (uint64_t i = 0; i < header.doctorCount; ++i) {
+        DoctorRecord record = readRecord<DoctorRecord>(file, header.doctorOffset, i);
+        if (uint64_t(record.firstSlot) + record.normalSlotCount + record.emergencySlotCount > header.slotCount) {
+            cerr << "Error: Snapshot " << path << " has an invalid slot table\n";
+            return false;
+        }
+    }
+    // Version 4 appointments are checked when their doctor is loaded
+    for (uint64_t i = 0; !lazy && i < header.appointmentCount; ++i) {
+        AppointmentRecord record = readRecord<AppointmentRecord>(file, header.appointmentOffset, i);
+        if (record.doctorIndex >= header.doctorCount ||
+            (record.patientIndex != NO_PATIENT && record.patientIndex >= header.patientCount)) {
+            cerr << "Error: Snapshot " << path << " has an invalid appointment table\n";
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < header.queueCount; ++i) {
+        QueueRecord record = readRecord<QueueRecord>(file, header.queueOffset, i);
+        if (record.doctorIndex >= header.doctorCount || record.patientIndex >= header.patientCount) {
+            cerr << "Error: Snapshot " << path << " has an invalid emergency queue table\n";
+            return false;
+        }
+    }
+
+    // Patient and doctor records are independent, so they are built in
+    // parallel; registration with the managers stays on this thread
+    ThreadPool& pool = ThreadPool::instance();
+    size_t firstPatient = patients.size();
+    patients.resize(firstPatient + header.patientCount, nullptr);
+    pool.parallelFor(header.patientCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PatientRecord record = readRecord<PatientRecord>(file, header.patientOffset, i);
+            Patient* patient = new Patient(record.id, record.name, record.location);
+            patient->urgencyLevel = record.urgencyLevel;
+            patients[firstPatient + i] = patient;
+        }
+    }, 4096);
+
+    vector<Doctor*> doctors(header.doctorCount, nullptr);
+    pool.parallelFor(header.doctorCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            DoctorRecord record = readRecord<DoctorRecord>(file, header.doctorOffset, i);
+            Doctor* doctor = new Doctor(record.id, record.name, record.specialization, record.location,
+                                        record.maxNormalSlots, record.maxEmergencySlots);
+            doctor->scheduleLoaded = !lazy;
+            doctor->normalSlots.reserve(record.normalSlotCount);
+            doctor->emergencySlots.reserve(record.emergencySlotCount);
+            for (uint32_t s = 0; s < uint32_t(record.normalSlotCount) + record.emergencySlotCount; ++s) {
+                SlotRecord slotRecord = readRecord<SlotRecord>(file, header.slotOffset, record.firstSlot + s);
+                Slot slot(slotRecord.minutes);
+                slot.isBooked = slotRecord.booked != 0;
+                slot.appointmentId = slotRecord.appointmentId;
+                (s < record.normalSlotCount ? doctor->normalSlots : doctor->emergencySlots).push_back(slot);
+            }
+            doctors[i] = doctor;
+        }
+    }, 1024);
+    for (Doctor* doctor : doctors) {
+        doctorManager.addDoctor(doctor, true);
+    }
+
+    if (lazy) {
+        // Appointments stay in the file until their doctor is needed
+        vector<Patient*> snapshotPatients(patients.begin() + firstPatient, patients.end());
+        if (!ScheduleStore::instance().attach(std::move(mapping), doctors, snapshotPatients)) return false;
+    }
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    for (uint64_t i = 0; !lazy && i < header.appointmentCount; ++i) {
+        AppointmentRecord record = readRecord<AppointmentRecord>(file, header.appointmentOffset, i);
+        Appointment app;
+        app.id = record.id;
+        app.doctor = doctors[record.doctorIndex];
+        app.patient = record.patientIndex == NO_PATIENT ? nullptr : patients[firstPatient + record.patientIndex];
+        app.packedDate = record.packedDate;
+        app.minutes = record.minutes;
+        app.flags = record.flags;
+        registry.attachSlot(registry.insert(app).id, record.slotIndex);
+    }
+
+    // Each doctor's run of entries becomes its queue with one heapify
+    vector<EmergencyQueue::Entry> entries;
+    for (uint64_t i = 0; i < header.queueCount;) {
+        uint32_t doctorIndex = readRecord<QueueRecord>(file, header.queueOffset, i).doctorIndex;
+        entries.clear();
+        for (; i < header.queueCount; ++i) {
+            QueueRecord record = readRecord<QueueRecord>(file, header.queueOffset, i);
+            if (record.doctorIndex != doctorIndex) break;
+            entries.push_back({patients[firstPatient + record.patientIndex], record.enqueuedAt, record.urgency});
+        }
+        doctors[doctorIndex]->emergencyQueue.assign(entries);
+    }
+
+    cout << "Snapshot loaded: " << header.doctorCount << " doctors, " << header.patientCount
+         << " patients, " << header.appointmentCount << " appointments";
+    if (lazy) cout << " (loaded on demand)";
+    if (header.queueCount > 0) cout << ", " << header.queueCount << " queued emergency patients";
+    cout << ".\n";
+    return true;
+}
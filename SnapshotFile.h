@@ -0,0 +1,32 @@
+#ifndef SNAPSHOT_FILE_H
+#define SNAPSHOT_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DoctorManager.h"
+#include "Patient.h"
+
+// Versioned binary image of doctors, patients, slots, appointments and,
+// from version 3, the emergency queues. Version 4 adds where each doctor's
+// appointments are, an index by appointment ID and each patient's doctors,
+// so appointments can be left in the file and loaded per doctor by
+// ScheduleStore. Record layouts are in SnapshotFormat.h.
+// Every record is fixed-size and each table is located through offsets in
+// the header, so loading maps the file and walks the tables directly,
+// without parsing or re-validating fields. Since version 2 the header
+// carries a CRC-32 of the whole file, so a torn or corrupted snapshot is
+// rejected before any of it is used; version 1 files still load. In
+// version 4 it covers everything read at load, and each doctor's
+// appointments carry their own, checked when they are loaded.
+class SnapshotFile {
+public:
+    static const uint32_t VERSION = 4;
+
+    // Doctors whose appointments are not loaded are copied from the
+    // current snapshot, and the new one takes its place in ScheduleStore
+    static bool save(const std::string& path, const DoctorManager& doctorManager, const std::vector<Patient*>& patients);
+    static bool load(const std::string& path, DoctorManager& doctorManager, std::vector<Patient*>& patients);
+};
+
+#endif
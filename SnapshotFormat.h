@@ -0,0 +1,137 @@
+#ifndef SNAPSHOT_FORMAT_H
+#define SNAPSHOT_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "FixedString.h"
+#include "MappedFile.h"
+
+// On-disk records of the snapshot, shared by SnapshotFile, which writes
+// and loads it, and ScheduleStore, which reads appointments out of it on
+// demand. All records are fixed-size and little-endian.
+namespace SnapshotFormat {
+    const char MAGIC[8] = {'A', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+    const uint32_t NO_PATIENT = 0xFFFFFFFF;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t doctorCount, doctorOffset;
+        uint64_t patientCount, patientOffset;
+        uint64_t slotCount, slotOffset;
+        uint64_t appointmentCount, appointmentOffset;
+        uint32_t checksum;  // CRC-32 with this field zeroed; from version 2
+        uint32_t reserved;
+        uint64_t queueCount, queueOffset;  // From version 3
+        // From version 4
+        uint64_t scheduleOffset;            // DoctorScheduleRecord per doctor
+        uint64_t patientScheduleOffset;     // PatientScheduleRecord per patient
+        uint64_t idIndexOffset;             // IdIndexRecord per appointment
+        uint64_t patientDoctorCount, patientDoctorOffset;  // uint32_t doctor indices
+        uint32_t lookupChecksum;            // CRC-32 of the ID index and patient doctors
+        uint32_t maxAppointmentId;
+    };
+
+    // Each version only appends fields to the header
+    inline uint32_t headerSizeOf(uint32_t version) {
+        switch (version) {
+            case 1: return offsetof(Header, checksum);
+            case 2: return offsetof(Header, queueCount);
+            case 3: return offsetof(Header, scheduleOffset);
+            case 4: return sizeof(Header);
+            default: return 0;
+        }
+    }
+
+    // Slots of a doctor are stored contiguously: normal slots first, then
+    // emergency slots, starting at firstSlot in the slot table.
+    struct DoctorRecord {
+        IdString id;
+        NameString name;
+        SpecializationString specialization;
+        SectorString location;
+        int32_t maxNormalSlots;
+        int32_t maxEmergencySlots;
+        uint32_t firstSlot;
+        uint16_t normalSlotCount;
+        uint16_t emergencySlotCount;
+    };
+
+    struct PatientRecord {
+        IdString id;
+        NameString name;
+        SectorString location;
+        int32_t urgencyLevel;
+    };
+
+    struct SlotRecord {
+        uint16_t minutes;
+        uint8_t booked;
+        uint8_t reserved;
+        uint32_t appointmentId;
+    };
+
+    // A doctor's queue entries are stored contiguously, in heap order
+    struct QueueRecord {
+        int64_t enqueuedAt;
+        uint32_t doctorIndex;
+        uint32_t patientIndex;
+        int32_t urgency;
+        uint32_t reserved;
+    };
+
+    // A doctor's appointments are stored contiguously
+    struct AppointmentRecord {
+        uint32_t id;
+        uint32_t doctorIndex;
+        uint32_t patientIndex;
+        uint32_t packedDate;
+        int32_t slotIndex;
+        uint16_t minutes;
+        uint8_t flags;
+        uint8_t reserved;
+    };
+
+    // Where a doctor's appointments are. Version 4 leaves the appointment
+    // table out of the header checksum; each run has its own, checked when
+    // the doctor is loaded.
+    struct DoctorScheduleRecord {
+        uint32_t firstAppointment;
+        uint32_t appointmentCount;
+        uint32_t checksum;   // CRC-32 of the run
+        uint32_t firstDate;  // Earliest packed date in the run, 0 when empty
+    };
+
+    // The distinct doctors a patient has appointments with, as a run in the
+    // patient doctor table
+    struct PatientScheduleRecord {
+        uint32_t firstDoctor;
+        uint32_t doctorCount;
+    };
+
+    // Sorted by id
+    struct IdIndexRecord {
+        uint32_t id;
+        uint32_t appointmentIndex;
+    };
+
+    static_assert(std::is_trivially_copyable<DoctorRecord>::value, "DoctorRecord must be trivially copyable");
+    static_assert(std::is_trivially_copyable<PatientRecord>::value, "PatientRecord must be trivially copyable");
+
+    template <typename Record>
+    bool tableFits(const MappedFile& file, uint64_t offset, uint64_t count) {
+        return offset <= file.size() && count <= (file.size() - offset) / sizeof(Record);
+    }
+
+    template <typename Record>
+    Record readRecord(const MappedFile& file, uint64_t offset, uint64_t index) {
+        Record record;
+        std::memcpy(&record, file.data() + offset + index * sizeof(Record), sizeof(Record));
+        return record;
+    }
+}
+
+#endif
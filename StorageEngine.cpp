@@ -0,0 +1,45 @@
+#include "StorageEngine.h"
+#include "BTreeStorage.h"
+#include "TextFileStorage.h"
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+unique_ptr<StorageEngine> StorageEngine::openDataFile(const string& textPath, char separator) {
+#ifdef AMS_TEXT_STORAGE
+    return unique_ptr<StorageEngine>(new TextFileStorage(textPath, separator));
+#else
+    string dbPath = filesystem::path(textPath).replace_extension(".db").string();
+    bool migrating = !filesystem::exists(dbPath) && filesystem::exists(textPath);
+
+    unique_ptr<BTreeStorage> tree(new BTreeStorage(dbPath));
+    if (!tree->isOpen()) {
+        cerr << "Warning: Falling back to " << textPath << "\n";
+        return unique_ptr<StorageEngine>(new TextFileStorage(textPath, separator));
+    }
+    if (!migrating) return tree;
+
+    // First start with the B+tree: import the text file, then set it aside
+    TextFileStorage text(textPath, separator);
+    bool imported = true;
+    text.scan("", "", [&](const string& key, const string& value) {
+        imported = tree->put(key, value);
+        return imported;
+    });
+    if (!imported || !tree->flush()) {
+        tree.reset();
+        error_code ec;
+        filesystem::remove(dbPath, ec);
+        cerr << "Warning: Could not import " << textPath << ", keeping it as the storage\n";
+        return unique_ptr<StorageEngine>(new TextFileStorage(textPath, separator));
+    }
+    error_code ec;
+    filesystem::rename(textPath, textPath + ".migrated", ec);
+    if (ec) {
+        cerr << "Warning: Could not rename " << textPath << " after import: " << ec.message() << "\n";
+    }
+    cout << "Imported " << tree->size() << " records from " << textPath << " into " << dbPath << "\n";
+    return tree;
+#endif
+}
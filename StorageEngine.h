@@ -0,0 +1,45 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Ordered key-value records behind a data file. Keys and values are byte
+// strings and keys compare bytewise. Changes are visible at once and
+// durable once flush() returns true; whatever was not flushed is dropped
+// when the engine is destroyed.
+//
+// Two backends: BTreeStorage, a single paged file with keyed point and
+// range access, and TextFileStorage, the legacy text file of
+// key<separator>value lines that is read and rewritten whole.
+//
+// Not thread-safe.
+class StorageEngine {
+public:
+    // Return false to stop the scan. Must not change the engine.
+    using Visitor = std::function<bool(const std::string& key, const std::string& value)>;
+
+    virtual ~StorageEngine() = default;
+
+    virtual bool isOpen() const = 0;
+    virtual bool get(const std::string& key, std::string& value) = 0;
+    // Inserts or replaces. Returns false if the record could not be stored.
+    virtual bool put(const std::string& key, const std::string& value) = 0;
+    // Returns false if there was no such key
+    virtual bool erase(const std::string& key) = 0;
+    // Records with from <= key < to, in key order; an empty to is unbounded
+    virtual void scan(const std::string& from, const std::string& to, const Visitor& visit) = 0;
+    virtual std::size_t size() const = 0;
+    virtual bool flush() = 0;
+
+    // The storage for a data file kept as key<separator>value lines, such
+    // as users.dat. By default the records live in a B+tree file beside it
+    // (users.db), filled from the text file the first time, which is then
+    // renamed to .migrated. Built with AMS_TEXT_STORAGE defined, the text
+    // file itself is used, as before.
+    static std::unique_ptr<StorageEngine> openDataFile(const std::string& textPath, char separator);
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "TextFileStorage.h"
+#include "MappedFile.h"
+#include "RecordParser.h"
+#include "Utils.h"
+#include <iostream>
+
+using namespace std;
+
+TextFileStorage::TextFileStorage(const string& path, char separator) : path(path), separator(separator) {
+    MappedFile file;
+    if (!file.open(path)) return;  // Not written yet
+    vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i].find_first_not_of(" \t") == string_view::npos) continue;
+        size_t split = lines[i].find(separator);
+        if (split == string_view::npos) {
+            RecordParser::reportMalformed(path, i + 1, string("expected a key and '") + separator + "'");
+            continue;
+        }
+        records[string(lines[i].substr(0, split))] = string(lines[i].substr(split + 1));
+    }
+}
+
+bool TextFileStorage::get(const string& key, string& value) {
+    auto it = records.find(key);
+    if (it == records.end()) return false;
+    value = it->second;
+    return true;
+}
+
+bool TextFileStorage::put(const string& key, const string& value) {
+    if (key.find(separator) != string::npos || key.find_first_of("\r\n") != string::npos ||
+        value.find_first_of("\r\n") != string::npos) {
+        cerr << "Error: Record " << key << " cannot be stored in " << path << "\n";
+        return false;
+    }
+    records[key] = value;
+    changed = true;
+    return true;
+}
+
+bool TextFileStorage::erase(const string& key) {
+    if (records.erase(key) == 0) return false;
+    changed = true;
+    return true;
+}
+
+void TextFileStorage::scan(const string& from, const string& to, const Visitor& visit) {
+    if (!to.empty() && to <= from) return;
+    auto end = to.empty() ? records.end() : records.lower_bound(to);
+    for (auto it = records.lower_bound(from); it != end; ++it) {
+        if (!visit(it->first, it->second)) return;
+    }
+}
+
+bool TextFileStorage::flush() {
+    if (!changed) return true;
+    bool saved = Utils::writeFileAtomically(path, [this](ostream& file) {
+        for (const auto& [key, value] : records) {
+            file << key << separator << value << "\n";
+        }
+    });
+    if (saved) changed = false;
+    return saved;
+}
@@ -0,0 +1,31 @@
+#ifndef TEXT_FILE_STORAGE_H
+#define TEXT_FILE_STORAGE_H
+
+#include <map>
+#include <string>
+#include "StorageEngine.h"
+
+// The legacy backend: a text file of key<separator>value lines, where the
+// value runs to the end of the line. The whole file is read when opened
+// and rewritten, atomically, by each flush that follows a change. Lines
+// without the separator are reported and skipped.
+class TextFileStorage : public StorageEngine {
+public:
+    TextFileStorage(const std::string& path, char separator);
+
+    bool isOpen() const override { return true; }
+    bool get(const std::string& key, std::string& value) override;
+    bool put(const std::string& key, const std::string& value) override;
+    bool erase(const std::string& key) override;
+    void scan(const std::string& from, const std::string& to, const Visitor& visit) override;
+    std::size_t size() const override { return records.size(); }
+    bool flush() override;
+
+private:
+    std::string path;
+    char separator;
+    std::map<std::string, std::string> records;
+    bool changed = false;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "ThreadPool.h"
+#include <cstdlib>
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threads) {
+    threads = max<size_t>(threads, 1);
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this]() { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool([]() -> size_t {
+        if (const char* configured = getenv("AMS_THREADS")) {
+            int threads = atoi(configured);
+            if (threads > 0) return static_cast<size_t>(threads);
+        }
+        return thread::hardware_concurrency();
+    }());
+    return pool;
+}
+
+void ThreadPool::run() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;  // Stopping and drained
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads fed from one task queue. Used by the
+// startup loaders to parse independent files and file chunks in parallel;
+// results are merged into the managers on the calling thread.
+//
+// Tasks must not wait on other tasks of the same pool.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Shared pool sized to the hardware, or to AMS_THREADS when set.
+    static ThreadPool& instance();
+
+    std::size_t size() const { return workers.size(); }
+
+    template <typename Fn>
+    std::future<std::invoke_result_t<Fn>> submit(Fn fn) {
+        using Result = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task]() { (*task)(); });
+        }
+        ready.notify_one();
+        return result;
+    }
+
+    // Splits [0, count) into contiguous ranges, runs fn(begin, end) for
+    // each on the pool and waits for all of them. The first exception
+    // thrown by a range is rethrown here.
+    template <typename Fn>
+    void parallelFor(std::size_t count, Fn fn, std::size_t minChunk = 1) {
+        if (count == 0) return;
+        std::size_t chunks = std::min(size() * 4, (count + minChunk - 1) / std::max<std::size_t>(minChunk, 1));
+        if (chunks <= 1 || size() <= 1) {
+            fn(std::size_t(0), count);
+            return;
+        }
+
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunks);
+        for (std::size_t c = 0; c < chunks; ++c) {
+            std::size_t begin = count * c / chunks;
+            std::size_t end = count * (c + 1) / chunks;
+            pending.push_back(submit([&fn, begin, end]() { fn(begin, end); }));
+        }
+        for (auto& future : pending) future.wait();
+        for (auto& future : pending) future.get();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    void run();
+};
+
+#endif
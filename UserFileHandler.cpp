@@ -1,104 +1,163 @@
 #include "UserFileHandler.h"
 #include "Utils.h"
+#include "BackupManager.h"
+#include "CredentialStore.h"
+#include "SnapshotFile.h"
+#include "Journal.h"
+#include "AppointmentRegistry.h"
+#include "AppointmentArchive.h"
+#include "CancelAppointmentManager.h"
+#include "MappedFile.h"
+#include "RecordParser.h"
+#include "ScheduleStore.h"
+#include "ThreadPool.h"
+#include <filesystem>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-const std::string UserFileHandler::USERS_FILE = "users.dat";
 const std::string UserFileHandler::DOCTORS_FILE = "doctors.dat";
 const std::string UserFileHandler::PATIENTS_FILE = "patients.dat";
+const std::string UserFileHandler::SNAPSHOT_FILE = "ams.snap";
+const std::string UserFileHandler::JOURNAL_FILE = "ams.journal";
 
-UserFileHandler::UserFileHandler() {
-    loadUsers();
-}
-
-bool UserFileHandler::loadUsers() {
-    std::string filepath = Utils::getDataPath(USERS_FILE);
-    if (!Utils::isFileValid(filepath)) {
-        std::cout << "No existing users file found. Starting with empty user database.\n";
-        return false;
-    }
-
-    try {
-        std::ifstream file(filepath);
-        std::string line;
-        while (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string id, password, role;
-            if (std::getline(ss, id, ',') && 
-                std::getline(ss, password, ',') && 
-                std::getline(ss, role, ',')) {
-                users[id] = std::make_pair(password, role);
-            } else {
-                std::cerr << "Warning: Skipped malformed line in users file\n";
+namespace {
+    // Adds each time of a comma-separated slot list such as "09:00,09:30,"
+    void addSlotList(Doctor* doctor, std::string_view times, bool emergency) {
+        while (!times.empty()) {
+            size_t comma = times.find(',');
+            std::string slotTime(times.substr(0, comma));
+            times = comma == std::string_view::npos ? std::string_view() : times.substr(comma + 1);
+            if (slotTime.empty()) continue;
+            try {
+                if (emergency) {
+                    doctor->addEmergencySlot(slotTime, true);
+                } else {
+                    doctor->addSlot(slotTime, true);
+                }
+            } catch (const std::invalid_argument& e) {
+                std::cerr << (std::string("Error adding ") + (emergency ? "emergency" : "regular") + " slot " + slotTime +
+                              " for Dr. " + doctor->getName() + ": " + e.what() + "\n");
+                throw;
             }
         }
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading users: " << e.what() << std::endl;
-        return false;
     }
-}
 
-bool UserFileHandler::saveUsers() {
-    std::string filepath = Utils::getDataPath(USERS_FILE);
-    Utils::backupFile(filepath);  // Create backup before saving
+    // Parses one doctors.dat line:
+    //   id,name,specialization,location,maxNormal,maxEmergency;regular:<times>;emergency:<times>
+    // Runs on pool threads, so it reports problems with a single write and
+    // returns nullptr instead of throwing.
+    Doctor* parseDoctorLine(std::string_view line, size_t lineNumber, const std::string& source) {
+        std::string_view sections[3];
+        size_t sectionCount = RecordParser::split(line, ';', sections, 3);
+        std::string_view info[6];
+        int maxNormal = 0, maxEmergency = 0;
+        if (RecordParser::split(sections[0], ',', info, 6) < 6) {
+            RecordParser::reportMalformed(source, lineNumber, "expected 6 doctor fields");
+            return nullptr;
+        }
+        if (!RecordParser::toInt(info[4], maxNormal) || !RecordParser::toInt(info[5], maxEmergency)) {
+            RecordParser::reportMalformed(source, lineNumber, "slot limits are not numbers");
+            return nullptr;
+        }
 
-    try {
-        std::ofstream file(filepath);
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not open users file for writing\n";
-            return false;
+        std::string id(info[0]);
+        Doctor* doctor = nullptr;
+        try {
+            doctor = new Doctor(id, std::string(info[1]), std::string(info[2]), std::string(info[3]),
+                                maxNormal, maxEmergency);
+            if (sectionCount > 1 && sections[1].substr(0, 8) == "regular:") {
+                addSlotList(doctor, sections[1].substr(8), false);
+            }
+            if (sectionCount > 2 && sections[2].substr(0, 10) == "emergency:") {
+                addSlotList(doctor, sections[2].substr(10), true);
+            }
+            return doctor;
+        } catch (const std::exception& e) {
+            std::cerr << ("Error loading doctor " + id + " (line " + std::to_string(lineNumber) + "): " + e.what() + "\n");
+            delete doctor;  // Never add a doctor with an invalid schedule
+            return nullptr;
         }
+    }
 
-        for (const auto& pair : users) {
-            file << pair.first << "," << pair.second.first << "," << pair.second.second << "\n";
+    // Parses one patients.dat line: id,name,location
+    Patient* parsePatientLine(std::string_view line, size_t lineNumber, const std::string& source) {
+        std::string_view fields[3];
+        if (RecordParser::split(line, ',', fields, 3) < 3) {
+            RecordParser::reportMalformed(source, lineNumber, "expected 3 patient fields");
+            return nullptr;
         }
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Error saving users: " << e.what() << std::endl;
-        return false;
+        // Anything after a further comma was ignored by the old reader too
+        std::string_view location = fields[2].substr(0, fields[2].find(','));
+        std::string id(fields[0]);
+        try {
+            return new Patient(id, std::string(fields[1]), std::string(location));
+        } catch (const std::exception& e) {
+            std::cerr << ("Error loading patient " + id + " (line " + std::to_string(lineNumber) + "): " + e.what() + "\n");
+            return nullptr;
+        }
+    }
+
+    bool isBlank(std::string_view line) {
+        return line.find_first_not_of(" \t") == std::string_view::npos;
     }
 }
 
-bool UserFileHandler::addUser(const std::string& id, const std::string& password, const std::string& role) {
-    if (users.find(id) != users.end()) {
+UserFileHandler::UserFileHandler() {
+    loadUsers();
+}
+
+bool UserFileHandler::loadUsers() {
+    CredentialStore& credentials = CredentialStore::instance();
+    credentials.open();
+    if (credentials.size() == 0) {
+        std::cout << "No existing users found. Starting with empty user database.\n";
         return false;
     }
-    users[id] = std::make_pair(password, role);
-    return saveUsers();
+    return true;
+}
+
+bool UserFileHandler::saveUsers() {
+    return CredentialStore::instance().flush();
+}
+
+bool UserFileHandler::addUser(const std::string& id, const std::string& password, const std::string& role) {
+    return CredentialStore::instance().add(id, password, role);
 }
 
 bool UserFileHandler::removeUser(const std::string& id) {
-    if (users.find(id) == users.end()) {
-        return false;
-    }
-    users.erase(id);
-    return saveUsers();
+    return CredentialStore::instance().remove(id);
 }
 
 std::pair<std::string, std::string> UserFileHandler::getUser(const std::string& id) const {
-    auto it = users.find(id);
-    if (it != users.end()) {
-        return it->second;
+    const CredentialStore::Credential* credential = CredentialStore::instance().find(id);
+    if (credential) {
+        return std::make_pair(credential->password, credential->role);
     }
     return std::make_pair("", "");
 }
 
 bool UserFileHandler::userExists(const std::string& id) const {
-    return users.find(id) != users.end();
+    return CredentialStore::instance().find(id) != nullptr;
 }
 
 void UserFileHandler::saveUserData(const DoctorManager& doctorManager, const std::vector<Patient*>& patients) {
+    std::string snapshotPath = Utils::getDataPath(SNAPSHOT_FILE);
+    if (SnapshotFile::save(snapshotPath, doctorManager, patients)) {
+        std::cout << "Doctors, patients and appointments saved to snapshot.\n";
+    } else {
+        std::cerr << "Error: Snapshot not saved, previous snapshot kept\n";
+    }
+}
+
+void UserFileHandler::exportUserData(const DoctorManager& doctorManager, const std::vector<Patient*>& patients) {
     // Save doctors
     std::string doctorPath = Utils::getDataPath(DOCTORS_FILE);
-    Utils::backupFile(doctorPath);
+    BackupManager::keepPreviousVersion(doctorPath);
 
     try {
-        std::ofstream doctorFile(doctorPath);
-        if (doctorFile.is_open()) {
+        bool saved = Utils::writeFileAtomically(doctorPath, [&doctorManager](std::ostream& doctorFile) {
             for (const auto& doctor : doctorManager.getAllDoctors()) {
                 doctorFile << doctor->getId() << ","
                           << doctor->getName() << ","
@@ -110,18 +169,19 @@ void UserFileHandler::saveUserData(const DoctorManager& doctorManager, const std
                 // Save regular slots
                 doctorFile << ";regular:";
                 for (const auto& slot : doctor->getNormalSlots()) {
-                    doctorFile << slot.time << ",";
+                    doctorFile << slot.getTime() << ",";
                 }
 
                 // Save emergency slots
                 doctorFile << ";emergency:";
                 for (const auto& slot : doctor->getEmergencySlots()) {
-                    doctorFile << slot.time << ",";
+                    doctorFile << slot.getTime() << ",";
                 }
                 
                 doctorFile << "\n";
             }
-            doctorFile.close();
+        });
+        if (saved) {
             std::cout << "Doctors data saved successfully.\n";
         }
     } catch (const std::exception& e) {
@@ -130,11 +190,10 @@ void UserFileHandler::saveUserData(const DoctorManager& doctorManager, const std
 
     // Save patients
     std::string patientPath = Utils::getDataPath(PATIENTS_FILE);
-    Utils::backupFile(patientPath);
+    BackupManager::keepPreviousVersion(patientPath);
 
     try {
-        std::ofstream patientFile(patientPath);
-        if (patientFile.is_open()) {
+        bool saved = Utils::writeFileAtomically(patientPath, [&patients](std::ostream& patientFile) {
             for (const auto& patient : patients) {
                 if (patient) {  // Check for null pointer
                     patientFile << patient->getId() << ","
@@ -142,7 +201,8 @@ void UserFileHandler::saveUserData(const DoctorManager& doctorManager, const std
                                << patient->getLocation() << "\n";
                 }
             }
-            patientFile.close();
+        });
+        if (saved) {
             std::cout << "Patients data saved successfully.\n";
         }
     } catch (const std::exception& e) {
@@ -150,7 +210,7 @@ void UserFileHandler::saveUserData(const DoctorManager& doctorManager, const std
     }
 }
 
-void UserFileHandler::loadUserData(DoctorManager& doctorManager, std::vector<Patient*>& patients) {
+bool UserFileHandler::loadUserData(DoctorManager& doctorManager, std::vector<Patient*>& patients) {
     // Clear existing data
     doctorManager.clearDoctors();
     for (auto* patient : patients) {
@@ -158,96 +218,297 @@ void UserFileHandler::loadUserData(DoctorManager& doctorManager, std::vector<Pat
     }
     patients.clear();
 
-    // Load doctors
+    // Prefer the binary snapshot; the text files are read only when it is
+    // missing or unreadable
+    std::string snapshotPath = Utils::getDataPath(SNAPSHOT_FILE);
+    // Kept by compact(); damaged appointment runs are rebuilt from them
+    ScheduleStore::instance().setPreviousVersion(snapshotPath + ".bak", Utils::getDataPath(JOURNAL_FILE) + ".bak");
+    auto loadSnapshot = [&]() {
+        try {
+            if (SnapshotFile::load(snapshotPath, doctorManager, patients)) {
+                return true;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading snapshot: " << e.what() << std::endl;
+        }
+        doctorManager.clearDoctors();
+        for (auto* patient : patients) {
+            delete patient;
+        }
+        patients.clear();
+        return false;
+    };
+    if (Utils::isFileValid(snapshotPath)) {
+        if (loadSnapshot() || (rollBackCompaction() && loadSnapshot())) {
+            return true;
+        }
+        std::cout << "Falling back to text data files.\n";
+    }
+
+    ThreadPool& pool = ThreadPool::instance();
+
+    // Load doctors. Lines are parsed in parallel, then registered in file
+    // order on this thread.
     std::string doctorPath = Utils::getDataPath(DOCTORS_FILE);
-    try {
-        if (Utils::isFileValid(doctorPath)) {
-            std::ifstream doctorFile(doctorPath);
-            std::string line;
-            while (std::getline(doctorFile, line)) {
-                std::stringstream ss(line);
-                std::string id, name, specialization, location, maxNormalStr, maxEmergencyStr;
-                std::string regularSlots, emergencySlots;
-
-                // Read basic doctor info
-                if (std::getline(ss, id, ',') &&
-                    std::getline(ss, name, ',') &&
-                    std::getline(ss, specialization, ',') &&
-                    std::getline(ss, location, ',') &&
-                    std::getline(ss, maxNormalStr, ',') &&
-                    std::getline(ss, maxEmergencyStr, ';')) {
-                    
-                    int maxNormal = std::stoi(maxNormalStr);
-                    int maxEmergency = std::stoi(maxEmergencyStr);
-                    Doctor* doctor = new Doctor(id, name, specialization, location, maxNormal, maxEmergency);
-
-                    // Read regular slots
-                    if (std::getline(ss, regularSlots, ';')) {
-                        if (regularSlots.substr(0, 8) == "regular:") {
-                            std::stringstream slotStream(regularSlots.substr(8));
-                            std::string slotTime;
-                            while (std::getline(slotStream, slotTime, ',')) {
-                                if (!slotTime.empty()) {
-                                    try {
-                                        doctor->addSlot(slotTime);
-                                    } catch (const std::invalid_argument& e) {
-                                        std::cerr << "Error adding regular slot " << slotTime << " for Dr. " << doctor->getName() << ": " << e.what() << std::endl;
-                                        delete doctor;
-                                        throw;  // Re-throw to prevent adding invalid doctor
-                                    }
-                                }
-                            }
-                        }
-                    }
-
-                    // Read emergency slots
-                    if (std::getline(ss, emergencySlots)) {
-                        if (emergencySlots.substr(0, 10) == "emergency:") {
-                            std::stringstream slotStream(emergencySlots.substr(10));
-                            std::string slotTime;
-                            while (std::getline(slotStream, slotTime, ',')) {
-                                if (!slotTime.empty()) {
-                                    try {
-                                        doctor->addEmergencySlot(slotTime);
-                                    } catch (const std::invalid_argument& e) {
-                                        std::cerr << "Error adding emergency slot " << slotTime << " for Dr. " << doctor->getName() << ": " << e.what() << std::endl;
-                                        delete doctor;
-                                        throw;  // Re-throw to prevent adding invalid doctor
-                                    }
-                                }
-                            }
-                        }
-                    }
-
-                    doctorManager.addDoctor(doctor);
-                }
+    MappedFile doctorFile;
+    if (doctorFile.open(doctorPath)) {
+        std::vector<std::string_view> lines = RecordParser::splitLines(doctorFile.data(), doctorFile.size());
+        std::vector<Doctor*> parsed(lines.size(), nullptr);
+        pool.parallelFor(lines.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!isBlank(lines[i])) parsed[i] = parseDoctorLine(lines[i], i + 1, doctorPath);
             }
-            doctorFile.close();
-            std::cout << "Doctors data loaded successfully.\n";
+        }, 256);
+        for (Doctor* doctor : parsed) {
+            if (doctor) doctorManager.addDoctor(doctor);
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading doctors: " << e.what() << std::endl;
+        std::cout << "Doctors data loaded successfully.\n";
     }
 
     // Load patients
     std::string patientPath = Utils::getDataPath(PATIENTS_FILE);
-    try {
-        if (Utils::isFileValid(patientPath)) {
-            std::ifstream patientFile(patientPath);
-            std::string line;
-            while (std::getline(patientFile, line)) {
-                std::stringstream ss(line);
-                std::string id, name, location;
-                if (std::getline(ss, id, ',') &&
-                    std::getline(ss, name, ',') &&
-                    std::getline(ss, location, ',')) {
-                    patients.push_back(new Patient(id, name, location));
+    MappedFile patientFile;
+    if (patientFile.open(patientPath)) {
+        std::vector<std::string_view> lines = RecordParser::splitLines(patientFile.data(), patientFile.size());
+        std::vector<Patient*> parsed(lines.size(), nullptr);
+        pool.parallelFor(lines.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (!isBlank(lines[i])) parsed[i] = parsePatientLine(lines[i], i + 1, patientPath);
+            }
+        }, 1024);
+        patients.reserve(patients.size() + parsed.size());
+        for (Patient* patient : parsed) {
+            if (patient) patients.push_back(patient);
+        }
+        std::cout << "Patients data loaded successfully.\n";
+    }
+    return false;
+}
+
+// Puts the files back as they were before the last compaction: the
+// previous snapshot, and a journal holding the records it was compacted
+// from followed by everything since. The damaged snapshot is kept beside
+// them for inspection.
+bool UserFileHandler::rollBackCompaction() {
+    std::string snapshotPath = Utils::getDataPath(SNAPSHOT_FILE);
+    std::string journalPath = Utils::getDataPath(JOURNAL_FILE);
+    std::string previousSnapshot = snapshotPath + ".bak";
+    std::string previousJournal = journalPath + ".bak";
+    std::error_code ec;
+    if (!std::filesystem::exists(previousSnapshot, ec)) return false;
+
+    Journal::instance().close();
+    if (std::filesystem::exists(previousJournal, ec)) {
+        bool merged = Utils::writeFileAtomically(journalPath, [&](std::ostream& out) {
+            for (const std::string& path : {previousJournal, journalPath}) {
+                std::ifstream in(path, std::ios::binary);
+                if (in.is_open() && in.peek() != std::ifstream::traits_type::eof()) out << in.rdbuf();
+            }
+        }, true);
+        if (!merged) return false;
+        std::filesystem::remove(previousJournal, ec);
+    }
+
+    std::filesystem::rename(snapshotPath, snapshotPath + ".damaged", ec);
+    std::filesystem::copy_file(previousSnapshot, snapshotPath, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        std::cerr << "Error: Could not restore the previous snapshot: " << ec.message() << "\n";
+        return false;
+    }
+    std::cout << "Recovering from the previous snapshot and journal; the damaged snapshot was kept as "
+              << snapshotPath << ".damaged\n";
+    return true;
+}
+
+void UserFileHandler::replayJournal(DoctorManager& doctorManager, std::vector<Patient*>& patients) {
+    std::string journalPath = Utils::getDataPath(JOURNAL_FILE);
+    Journal& journal = Journal::instance();
+    journal.close();
+
+    // Everything loaded so far is already on disk
+    PatientIndex patientsById = buildPatientIndex(patients);
+    for (Patient* patient : patients) {
+        if (patient) patient->dirty = false;
+    }
+    for (Doctor* doctor : doctorManager.getAllDoctors()) {
+        doctor->dirty = false;
+    }
+
+    size_t applied = 0;
+    size_t records = Journal::read(journalPath, [&](const std::vector<std::string>& fields, size_t lineNumber) {
+        try {
+            if (applyJournalRecord(fields, doctorManager, patients, patientsById)) {
+                ++applied;
+                return;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Journal line " << lineNumber << ": " << e.what() << std::endl;
+            return;
+        }
+        std::cerr << "Warning: Skipped journal line " << lineNumber << "\n";
+    });
+    if (records > 0) {
+        std::cout << "Journal replayed: " << applied << " of " << records << " records applied.\n";
+    }
+
+    journal.open(journalPath, records);
+}
+
+// Records may already be reflected in the snapshot when a compaction was
+// interrupted before the journal was emptied, so every record is applied
+// only when it still changes something.
+bool UserFileHandler::applyJournalRecord(const std::vector<std::string>& fields, DoctorManager& doctorManager,
+                                         std::vector<Patient*>& patients,
+                                         PatientIndex& patientsById) {
+    if (fields.empty()) return false;
+    const std::string& type = fields[0];
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+
+    if (type == Journal::USER_ADD && fields.size() == 4) {
+        CredentialStore::instance().replayAdd(fields[1], fields[2], fields[3]);
+        return true;
+    }
+    if (type == Journal::USER_REMOVE && fields.size() == 2) {
+        CredentialStore::instance().replayRemove(fields[1]);
+        return true;
+    }
+    if (type == Journal::DOCTOR_ADD && (fields.size() == 8 || fields.size() == 9)) {
+        if (doctorManager.getDoctorByID(fields[1])) return true;
+        Doctor* doctor = new Doctor(fields[1], fields[2], fields[3], fields[4], std::stoi(fields[5]), std::stoi(fields[6]));
+        try {
+            std::stringstream regular(fields[7]);
+            std::string slotTime;
+            while (std::getline(regular, slotTime, ',')) {
+                doctor->addSlot(slotTime, true);
+            }
+            if (fields.size() == 9) {
+                std::stringstream emergency(fields[8]);
+                while (std::getline(emergency, slotTime, ',')) {
+                    doctor->addEmergencySlot(slotTime, true);
                 }
             }
-            patientFile.close();
-            std::cout << "Patients data loaded successfully.\n";
+        } catch (...) {
+            delete doctor;
+            throw;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading patients: " << e.what() << std::endl;
+        doctorManager.addDoctor(doctor, true);
+        return true;
+    }
+    if (type == Journal::DOCTOR_DELETE && fields.size() == 2) {
+        if (doctorManager.getDoctorByID(fields[1])) {
+            doctorManager.deleteDoctor(fields[1]);
+        }
+        return true;
+    }
+    if (type == Journal::PATIENT_ADD && fields.size() == 4) {
+        if (patientsById.count(fields[1])) return true;
+        Patient* patient = new Patient(fields[1], fields[2], fields[3]);
+        patients.push_back(patient);
+        patientsById[patient->getId()] = patient;
+        return true;
+    }
+    if (type == Journal::PATIENT_UPDATE && fields.size() == 3) {
+        auto it = patientsById.find(fields[1]);
+        if (it == patientsById.end()) return false;
+        it->second->setUrgencyLevel(std::stoi(fields[2]));
+        it->second->dirty = false;
+        return true;
+    }
+    if (type == Journal::BOOK && fields.size() == 8) {
+        uint32_t id = static_cast<uint32_t>(std::stoul(fields[1]));
+        if (registry.find(id)) return true;
+        Doctor* doctor = doctorManager.getDoctorByID(fields[2]);
+        if (!doctor) return false;
+        auto patientIt = patientsById.find(fields[3]);
+        Patient* patient = patientIt == patientsById.end() ? nullptr : patientIt->second;
+        bool emergency = fields[6] == "1";
+        int32_t slotIndex = std::stoi(fields[7]);
+
+        Appointment appointment(fields[4], fields[5], doctor, patient, emergency);
+        appointment.id = id;
+        doctor->restoreSlot(registry.insert(appointment), slotIndex);
+        return true;
+    }
+    if (type == Journal::CANCEL && fields.size() == 2) {
+        uint32_t id = static_cast<uint32_t>(std::stoul(fields[1]));
+        if (registry.find(id)) {
+            CancelAppointmentManager().cancelAppointment(id, true);
+        }
+        return true;
+    }
+    if (type == Journal::MISSED && fields.size() == 2) {
+        Appointment* appointment = registry.find(static_cast<uint32_t>(std::stoul(fields[1])));
+        if (appointment) appointment->markMissed();
+        return true;
+    }
+    if (type == Journal::REBOOK && fields.size() == 5) {
+        uint32_t id = static_cast<uint32_t>(std::stoul(fields[1]));
+        const AppointmentRegistry::Location* location = registry.locate(id);
+        if (!location) return true;
+        Doctor* doctor = location->doctor;
+        Appointment& appointment = doctor->appointments[location->doctorIndex];
+        int32_t newIndex = std::stoi(fields[4]);
+
+        std::vector<Slot>& slots = appointment.isEmergency() ? doctor->getEmergencySlots() : doctor->getNormalSlots();
+        if (newIndex >= 0 && static_cast<size_t>(newIndex) < slots.size()) {
+            int32_t oldIndex = location->slotIndex;
+            if (oldIndex >= 0 && oldIndex != newIndex && slots[oldIndex].appointmentId == id) {
+                doctor->setSlotBooked(slots[oldIndex], false);
+                slots[oldIndex].appointmentId = Slot::NO_APPOINTMENT;
+            }
+            doctor->setSlotBooked(slots[newIndex], true);
+            slots[newIndex].appointmentId = id;
+            registry.attachSlot(id, newIndex);
+        }
+        appointment.reschedule(fields[2], fields[3]);
+        return true;
+    }
+    if ((type == Journal::EMERGENCY_QUEUE && fields.size() == 5) ||
+        (type == Journal::EMERGENCY_DEQUEUE && fields.size() == 3)) {
+        Doctor* doctor = doctorManager.getDoctorByID(fields[1]);
+        auto patientIt = patientsById.find(fields[2]);
+        if (!doctor || patientIt == patientsById.end()) return false;
+        if (type == Journal::EMERGENCY_DEQUEUE) {
+            doctor->emergencyQueue.remove(patientIt->second);
+            return true;
+        }
+        EmergencyQueue::Entry entry{patientIt->second, std::stoll(fields[4]), std::stoi(fields[3])};
+        if (!doctor->emergencyQueue.contains(entry.patient, entry.enqueuedAt)) {
+            doctor->emergencyQueue.push(entry);
+        }
+        return true;
+    }
+    if (type == Journal::ARCHIVE && fields.size() == 2) {
+        // Segments already holding these appointments are left as they are
+        AppointmentArchive::instance().archiveBefore(Utils::packDate(fields[1]), doctorManager, true);
+        return true;
     }
-} 
\ No newline at end of file
+    return false;
+}
+
+size_t UserFileHandler::savePatientChanges(const std::vector<Patient*>& patients) {
+    size_t saved = 0;
+    for (Patient* patient : patients) {
+        if (!patient || !patient->dirty) continue;
+        // Appointment lists are rebuilt from the doctors' appointments, so
+        // the urgency level is the only patient state left to record
+        Journal::instance().patientUpdated(patient);
+        patient->dirty = false;
+        ++saved;
+    }
+    return saved;
+}
+
+bool UserFileHandler::compact(const DoctorManager& doctorManager, const std::vector<Patient*>& patients) {
+    std::string snapshotPath = Utils::getDataPath(SNAPSHOT_FILE);
+    // Paired with the journal kept by Journal::truncate, for rollBackCompaction
+    BackupManager::keepPreviousVersion(snapshotPath);
+    if (!SnapshotFile::save(snapshotPath, doctorManager, patients) || !saveUsers()) {
+        std::cerr << "Error: Compaction failed, journal kept\n";
+        return false;
+    }
+    // The snapshot and users.dat now cover every journal record. Back up
+    // first: this is the last point where the journal holds them.
+    BackupManager::instance().createBackup(true);
+    return Journal::instance().truncate();
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "Doctor.h"
 #include "Patient.h"
 #include "DoctorManager.h"
@@ -11,6 +12,7 @@
 class UserFileHandler {
 public:
     UserFileHandler();
+    // User accounts, kept in CredentialStore
     bool loadUsers();
     bool saveUsers();
     bool addUser(const std::string& id, const std::string& password, const std::string& role);
@@ -20,13 +22,32 @@ public:
 
     // New methods for doctor and patient data
     static void saveUserData(const DoctorManager& doctorManager, const std::vector<Patient*>& patients);
-    static void loadUserData(DoctorManager& doctorManager, std::vector<Patient*>& patients);
+    static void exportUserData(const DoctorManager& doctorManager, const std::vector<Patient*>& patients);
+    // Returns true when the data came from the snapshot. The text files
+    // hold no appointments; those are then in the appointment store.
+    static bool loadUserData(DoctorManager& doctorManager, std::vector<Patient*>& patients);
+
+    // Applies the journal on top of what loadUserData restored, then opens
+    // it for appending. Call once at startup, after loadUserData.
+    void replayJournal(DoctorManager& doctorManager, std::vector<Patient*>& patients);
+    // Records every patient changed since the last call and clears its
+    // dirty flag. Returns how many were written.
+    size_t savePatientChanges(const std::vector<Patient*>& patients);
+    // Writes the snapshot and users.dat, then empties the journal. The
+    // previous snapshot and journal stay as .bak files, which loadUserData
+    // falls back to when the snapshot fails its checksum.
+    bool compact(const DoctorManager& doctorManager, const std::vector<Patient*>& patients);
     
 private:
-    std::map<std::string, std::pair<std::string, std::string>> users; // ID -> (password, role)
-    static const std::string USERS_FILE;
     static const std::string DOCTORS_FILE;
     static const std::string PATIENTS_FILE;
+    static const std::string SNAPSHOT_FILE;
+    static const std::string JOURNAL_FILE;
+
+    static bool rollBackCompaction();
+    bool applyJournalRecord(const std::vector<std::string>& fields, DoctorManager& doctorManager,
+                            std::vector<Patient*>& patients,
+                            PatientIndex& patientsById);
 };
 
 #endif 
\ No newline at end of file
@@ -1,60 +1,25 @@
 #include "UserHandler.h"
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include "CredentialStore.h"
 
 UserHandler::UserHandler() {
-    loadUsers();
-}
-
-void UserHandler::loadUsers() {
-    std::ifstream file("users.txt");
-    if (!file.is_open()) {
-        return;
-    }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string id, password, role;
-        if (std::getline(ss, id, ',') && 
-            std::getline(ss, password, ',') && 
-            std::getline(ss, role)) {
-            users[id] = std::make_pair(password, role);
-        }
-    }
-    file.close();
-}
-
-void UserHandler::saveUsers() {
-    std::ofstream file("users.txt");
-    if (!file.is_open()) {
-        return;
+    CredentialStore& credentials = CredentialStore::instance();
+    if (!credentials.isOpen()) {
+        credentials.open();
     }
-
-    for (const auto& user : users) {
-        file << user.first << "," << user.second.first << "," << user.second.second << "\n";
-    }
-    file.close();
 }
 
 bool UserHandler::userExists(const std::string& id) const {
-    return users.find(id) != users.end();
+    return CredentialStore::instance().find(id) != nullptr;
 }
 
 bool UserHandler::addUser(const std::string& id, const std::string& password, const std::string& role) {
-    if (userExists(id)) {
-        return false;
-    }
-    users[id] = std::make_pair(password, role);
-    saveUsers();
-    return true;
+    return CredentialStore::instance().add(id, password, role);
 }
 
 std::pair<std::string, std::string> UserHandler::getUser(const std::string& id) const {
-    auto it = users.find(id);
-    if (it != users.end()) {
-        return it->second;
+    const CredentialStore::Credential* credential = CredentialStore::instance().find(id);
+    if (credential) {
+        return std::make_pair(credential->password, credential->role);
     }
     return std::make_pair("", "");
-} 
\ No newline at end of file
+}
\ No newline at end of file
@@ -2,15 +2,11 @@
 #define USERHANDLER_H
 
 #include <string>
-#include <map>
 #include <utility>
 
+// The user table through CredentialStore, which also holds the accounts
+// this class used to keep in users.txt
 class UserHandler {
-private:
-    std::map<std::string, std::pair<std::string, std::string>> users;
-    void loadUsers();
-    void saveUsers();
-
 public:
     UserHandler();
     bool userExists(const std::string& id) const;
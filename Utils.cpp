@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include "FixedString.h"
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -7,6 +8,16 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -19,31 +30,33 @@ namespace Utils {
     }
 
     bool isValidID(const std::string& id) {
-        try {
-            int numID = std::stoi(id);
-            return numID > 0;
-        } catch (...) {
-            return false;
-        }
+        // IDs are stored in an IdString, so anything longer cannot be kept
+        if (id.empty() || id.size() > IdString::capacity()) return false;
+        if (!std::all_of(id.begin(), id.end(), [](unsigned char c) { return std::isdigit(c); })) return false;
+        // 15 digits always fit in an unsigned long long, so this cannot throw
+        return std::stoull(id) > 0;
     }
 
     bool isValidName(const std::string& name) {
         if (name.empty() || name.length() > 30) return false;
-        return std::regex_match(name, std::regex("^[a-zA-Z0-9\\s]+$"));
+        // Spaces only: a tab or line break would split a journal record
+        static const std::regex pattern("^[a-zA-Z0-9 ]+$");
+        return std::regex_match(name, pattern);
     }
 
     bool isValidSpecialization(const std::string& spec) {
         if (spec.empty() || spec.length() > 20) return false;
-        return std::regex_match(spec, std::regex("^[a-zA-Z0-9\\s]+$"));
+        static const std::regex pattern("^[a-zA-Z0-9 ]+$");
+        return std::regex_match(spec, pattern);
     }
 
     bool isValidDate(const std::string& date) {
-        std::regex datePattern("^(0[1-9]|[12][0-9]|3[01])-(0[1-9]|1[0-2])-([0-9]{4})$");
+        static const std::regex datePattern("^(0[1-9]|[12][0-9]|3[01])-(0[1-9]|1[0-2])-([0-9]{4})$");
         return std::regex_match(date, datePattern);
     }
 
     bool isValidTime(const std::string& time) {
-        std::regex timePattern("^([01][0-9]|2[0-3]):([0-5][0-9])$");
+        static const std::regex timePattern("^([01][0-9]|2[0-3]):([0-5][0-9])$");
         return std::regex_match(time, timePattern);
     }
 
@@ -62,6 +75,133 @@ namespace Utils {
         }
     }
 
+    static int parseDigits(const std::string& text, size_t pos, size_t count) {
+        int value = 0;
+        for (size_t i = pos; i < pos + count; ++i) {
+            // The message is only built on failure: this runs for every
+            // date and time loaded
+            if (!std::isdigit(static_cast<unsigned char>(text[i]))) {
+                validateOrThrow(false, "Invalid digit in '" + text + "'");
+            }
+            value = value * 10 + (text[i] - '0');
+        }
+        return value;
+    }
+
+    uint32_t packDate(const std::string& date) {
+        if (date.size() != 10 || date[2] != '-' || date[5] != '-') {
+            validateOrThrow(false, "Invalid date format: " + date);
+        }
+        uint32_t day = parseDigits(date, 0, 2);
+        uint32_t month = parseDigits(date, 3, 2);
+        uint32_t year = parseDigits(date, 6, 4);
+        return (year << 9) | (month << 5) | day;
+    }
+
+    std::string unpackDate(uint32_t packed) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%02u-%02u-%04u",
+                      packed & 0x1F, (packed >> 5) & 0x0F, packed >> 9);
+        return buffer;
+    }
+
+    uint16_t packTime(const std::string& time) {
+        if (time.size() != 5 || time[2] != ':') {
+            validateOrThrow(false, "Invalid time format: " + time);
+        }
+        return static_cast<uint16_t>(parseDigits(time, 0, 2) * 60 + parseDigits(time, 3, 2));
+    }
+
+    std::string unpackTime(uint16_t minutes) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "%02u:%02u", minutes / 60u, minutes % 60u);
+        return buffer;
+    }
+
+    uint32_t crc32(const void* data, std::size_t size, uint32_t crc) {
+        static const auto table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) value = (value >> 1) ^ (0xEDB88320u & (0u - (value & 1)));
+                entries[i] = value;
+            }
+            return entries;
+        }();
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (std::size_t i = 0; i < size; ++i) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    bool syncFile(const std::string& path) {
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+        if (fd < 0) return false;
+        bool synced = _commit(fd) == 0;
+        _close(fd);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+#endif
+        return synced;
+    }
+
+    bool writeFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write, bool binary) {
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream out(tempPath, binary ? std::ios::binary | std::ios::trunc : std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open " << tempPath << " for writing\n";
+                return false;
+            }
+            write(out);
+            out.flush();
+            if (!out) {
+                std::cerr << "Error: Failed writing " << tempPath << "\n";
+                out.close();
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+
+        if (!syncFile(tempPath)) {
+            std::cerr << "Error: Could not flush " << tempPath << " to disk\n";
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec) {
+            std::cerr << "Error: Could not replace " << path << ": " << ec.message() << "\n";
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void dropIncompleteLastLine(const std::string& path) {
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec || size == 0) return;
+
+        std::ifstream file(path, std::ios::binary);
+        std::uintmax_t end = size;
+        char c = 0;
+        while (end > 0) {
+            file.seekg(static_cast<std::streamoff>(end - 1));
+            if (!file.get(c) || c == '\n') break;
+            --end;
+        }
+        file.close();
+        if (end != size) {
+            std::filesystem::resize_file(path, end, ec);
+        }
+    }
+
     int getSafeInt(const std::string& prompt) {
         while (true) {
             std::cout << prompt;
@@ -89,24 +229,4 @@ void ensureDataDirExists() {
         filesystem::create_directory(dataDir);
     }
 }
-
-void backupFile(const string& filename) {
-    if (!filesystem::exists(filename)) return;
-    
-    time_t now = time(nullptr);
-    tm* ltm = localtime(&now);
-    
-    stringstream backupName;
-    backupName << filename << "." 
-               << (1900 + ltm->tm_year) 
-               << (1 + ltm->tm_mon) 
-               << ltm->tm_mday 
-               << "_" 
-               << ltm->tm_hour 
-               << ltm->tm_min 
-               << ltm->tm_sec 
-               << ".bak";
-               
-    filesystem::copy_file(filename, backupName.str(), 
-                         filesystem::copy_options::overwrite_existing);
-} 
\ No newline at end of file
+ 
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <string>
@@ -11,10 +13,10 @@
 #include <regex>
 #include <stdexcept>
 #include <map>
+#include <functional>
 
 std::string getLineInput(const std::string& prompt);
 void ensureDataDirExists();
-void backupFile(const std::string& filename);
 
 namespace Utils {
     static inline const std::string DATA_DIR = "data";
@@ -37,14 +39,6 @@ namespace Utils {
         return file.good();
     }
 
-    static void backupFile(const std::string& filename) {
-        if (!isFileValid(filename)) return;
-        std::string backupName = filename + ".bak";
-        std::ifstream src(filename, std::ios::binary);
-        std::ofstream dst(backupName, std::ios::binary);
-        dst << src.rdbuf();
-    }
-
     // Data validation methods
     bool isValidID(const std::string& id);
     bool isValidName(const std::string& name);
@@ -54,6 +48,31 @@ namespace Utils {
     bool isValidUrgencyLevel(int level);  // 1 is highest priority, 4 is lowest priority
     bool isValidSector(const std::string& sector);
 
+    // Compact encodings for DD-MM-YYYY dates and HH:MM times. Packed dates
+    // compare in chronological order; packed times are minutes since midnight.
+    uint32_t packDate(const std::string& date);
+    std::string unpackDate(uint32_t packed);
+    uint16_t packTime(const std::string& time);
+    std::string unpackTime(uint16_t minutes);
+
+    // CRC-32 (IEEE), continuing from crc to checksum data in pieces
+    uint32_t crc32(const void* data, std::size_t size, uint32_t crc = 0);
+
+    // Forces the contents of an already written file to disk
+    bool syncFile(const std::string& path);
+
+    // Writes a file through a temporary beside it and renames that over
+    // path, so a crash or failed write never leaves a partial file behind.
+    // The temporary is synced before the rename, so the new name never
+    // points at data still in the page cache.
+    // Returns false and keeps the old file if anything fails.
+    bool writeFileAtomically(const std::string& path, const std::function<void(std::ostream&)>& write,
+                             bool binary = false);
+
+    // Cuts a last line left without its newline by an interrupted append,
+    // so the next append starts on a fresh line.
+    void dropIncompleteLastLine(const std::string& path);
+
     // Helper function to throw formatted validation errors
     void validateOrThrow(bool condition, const std::string& message);
 
@@ -6,17 +6,25 @@
 #include <algorithm>
 #include <unordered_map>
 #include <map>
+#include <ctime>
 #include "Doctor.h"
 #include "Patient.h"
 #include "DoctorManager.h"
 #include "MedicalHistoryManager.h"
-#include "AppointmentFileHandler.h"
+#include "AppointmentStore.h"
 #include "MissedAppointmentManager.h"
 #include "UserFileHandler.h"
+#include "Journal.h"
 #include "Graph.h"
 #include "Utils.h"
 #include "NearestDoctorFinder.h"
 #include "CancelAppointmentManager.h"
+#include "RequestArena.h"
+#include "BackupManager.h"
+#include "AppointmentArchive.h"
+#include "ScheduleStore.h"
+#include "AppointmentEvents.h"
+#include "AppointmentViews.h"
 
 using namespace std;
 
@@ -61,15 +69,31 @@ int main() {
 
     vector<Patient*> patients;
     DoctorManager doctorManager;
-    MedicalHistoryManager historyManager;
-    AppointmentFileHandler fileHandler;
+    MedicalHistoryManager& historyManager = MedicalHistoryManager::instance();
+    AppointmentArchive& archive = AppointmentArchive::instance();
+    AppointmentEventLog& eventLog = AppointmentEventLog::instance();
+    AppointmentViews& views = AppointmentViews::instance();
+    ScheduleStore& scheduleStore = ScheduleStore::instance();
+    AppointmentStore appointmentStore;
     MissedAppointmentManager missedManager;
     CancelAppointmentManager cancelManager;
     UserFileHandler userHandler;
     Graph city;
-
-    // Load saved user data at startup
-    userHandler.loadUserData(doctorManager, patients);
+    RequestArena arena;  // Scratch memory for a single menu request
+
+    // Load saved user data. Appointments come from the snapshot or, without
+    // one, from the appointment store; the journal then brings both up to
+    // date, so stored IDs are taken before anything new is booked.
+    auto loadData = [&]() {
+        if (!userHandler.loadUserData(doctorManager, patients)) {
+            appointmentStore.loadAll(doctorManager, patients);
+        }
+        archive.open();
+        userHandler.replayJournal(doctorManager, patients);
+        historyManager.open();
+        eventLog.open(doctorManager);
+    };
+    loadData();
 
     // Setup city sectors
     city.addEdge("G-9", "G-10", 2);
@@ -80,6 +104,11 @@ int main() {
 
     int choice;
     do {
+        arena.reset();
+        if (Journal::instance().needsCompaction()) {
+            userHandler.compact(doctorManager, patients);
+        }
+        scheduleStore.evictIdle();
         cout << "\nAppointment Management System\n";
         cout << "1. Add Doctor\n";
         cout << "2. Add Patient\n";
@@ -94,6 +123,12 @@ int main() {
         cout << "11. Save Data\n";
         cout << "12. Load Data\n";
         cout << "13. Cancel Appointment\n";
+        cout << "14. Export Data (text)\n";
+        cout << "15. Backup Data\n";
+        cout << "16. Restore Backup\n";
+        cout << "17. Search Medical Histories\n";
+        cout << "18. Appointment Archive\n";
+        cout << "19. Appointment History\n";
         cout << "0. Exit\n";
         cout << "Enter choice: ";
         
@@ -109,7 +144,7 @@ int main() {
         if (choice == 1) {
             string id = Utils::getLineInput("Doctor ID: ");
             if (!Utils::isValidID(id)) {
-                cout << "Invalid Doctor ID. Must be a positive integer.\n";
+                cout << "Invalid Doctor ID. Must be a positive integer of at most 15 digits.\n";
                 continue;
             }
 
@@ -223,7 +258,7 @@ int main() {
 
             if (addedSuccessfully) {
                 doctorManager.addDoctor(doc);
-                userHandler.saveUserData(doctorManager, patients);
+                Journal::instance().doctorAdded(doc);
                 cout << "\nDoctor " << name << " added successfully with the following schedule:\n";
                 doc->displayAvailableSlots();
             } else {
@@ -234,7 +269,7 @@ int main() {
         else if (choice == 2) {
             string id = Utils::getLineInput("Patient ID: ");
             if (!Utils::isValidID(id)) {
-                cout << "Invalid Patient ID. Must be a positive integer.\n";
+                cout << "Invalid Patient ID. Must be a positive integer of at most 15 digits.\n";
                 continue;
             }
 
@@ -265,7 +300,7 @@ int main() {
 
             patients.push_back(new Patient(id, name, location));
             cout << "Patient added successfully.\n";
-            userHandler.saveUserData(doctorManager, patients);
+            Journal::instance().patientAdded(patients.back());
         }
         else if (choice == 3) {
             string pid = Utils::getLineInput("Patient ID: ");
@@ -287,15 +322,7 @@ int main() {
                 continue;
             }
             
-            // Get all doctors with the required specialization
-            vector<Doctor*> availableDoctors;
-            for (auto doc : doctorManager.getAllDoctors()) {
-                if (doc->getSpecialization() == spec) {
-                    availableDoctors.push_back(doc);
-                }
-            }
-
-            if (availableDoctors.empty()) {
+            if (doctorManager.getDoctorsBySpecialization(spec).empty()) {
                 cout << "No doctors found with specialization " << spec << ".\n";
                 continue;
             }
@@ -314,13 +341,19 @@ int main() {
                 continue;
             }
 
+            // Only doctors with an unbooked regular slot at this time
+            pmr::vector<Doctor*> availableDoctors = doctorManager.getFreeDoctorsAt(spec, time, arena.get());
+            if (availableDoctors.empty()) {
+                cout << "\nNo " << spec << " doctors have a free slot at " << time << ".\n";
+                continue;
+            }
+
             // Sort doctors by distance from patient
+            pmr::unordered_map<string, int> distances(arena.get());
+            city.dijkstra(pat->getLocation(), distances);
             sort(availableDoctors.begin(), availableDoctors.end(), 
-                [&city, &pat](Doctor* a, Doctor* b) {
-                    unordered_map<string, int> distancesA, distancesB;
-                    city.dijkstra(pat->getLocation(), distancesA);
-                    city.dijkstra(pat->getLocation(), distancesB);
-                    return distancesA[a->getLocation()] < distancesB[b->getLocation()];
+                [&distances](Doctor* a, Doctor* b) {
+                    return distances[a->getLocation()] < distances[b->getLocation()];
                 });
 
             // Try each doctor in order of distance
@@ -419,12 +452,7 @@ int main() {
             }
 
             // Find nearest doctors with the required specialization
-            vector<Doctor*> availableDoctors;
-            for (auto& doc : doctorManager.getAllDoctors()) {
-                if (doc->getSpecialization() == spec) {
-                    availableDoctors.push_back(doc);
-                }
-            }
+            const vector<Doctor*>& availableDoctors = doctorManager.getDoctorsBySpecialization(spec);
 
             if (availableDoctors.empty()) {
                 cout << "\nNo doctors found with specialization: " << spec << "\n";
@@ -432,8 +460,9 @@ int main() {
             }
 
             // Use NearestDoctorFinder to get sorted list of doctors by distance
-            vector<pair<Doctor*, int>> sortedDoctors;
-            unordered_map<string, int> distances;
+            pmr::vector<pair<Doctor*, int>> sortedDoctors(arena.get());
+            sortedDoctors.reserve(availableDoctors.size());
+            pmr::unordered_map<string, int> distances(arena.get());
             city.dijkstra(pat->getLocation(), distances);
             
             for (auto& doc : availableDoctors) {
@@ -474,8 +503,12 @@ int main() {
             }
 
             if (!appointmentBooked) {
+                // Waits for the nearest doctor's next free emergency slot
+                Doctor* nearest = sortedDoctors.front().first;
+                nearest->enqueueEmergencyPatient(pat);
                 cout << "\nNo emergency slots available with any doctor in specialization " << spec << ".\n";
-                cout << "Patient has been added to the emergency queue.\n";
+                cout << "Patient has been added to Dr. " << nearest->getName() << "'s emergency queue ("
+                     << nearest->emergencyQueue.size() << " waiting).\n";
             }
         }
         else if (choice == 5) {
@@ -485,19 +518,19 @@ int main() {
                 continue;
             }
             string spec = Utils::getLineInput("Enter specialization: ");
-            Doctor* nearest = NearestDoctorFinder::findNearestDoctor(city, sector, spec, doctorManager.getAllDoctors());
+            Doctor* nearest = NearestDoctorFinder::findNearestDoctor(city, sector, spec,
+                                                                     doctorManager.getDoctorsBySpecialization(spec),
+                                                                     arena.get());
             if (nearest) {
                 cout << "\nYou can book an appointment with Dr. " << nearest->getName() << "\n";
             }
         }
         else if (choice == 6) {
-            string did = Utils::getLineInput("Doctor ID: ");
-            string pid = Utils::getLineInput("Patient ID: ");
-            Doctor* doc = doctorManager.getDoctorByID(did);
-            if (doc)
-                missedManager.markAppointmentAsMissed(doc, pid);
+            int appointmentId = Utils::getSafeInt("Appointment ID: ");
+            if (appointmentId > 0)
+                missedManager.markAppointmentAsMissed(appointmentId);
             else
-                cout << "Doctor not found.\n";
+                cout << "Invalid appointment ID.\n";
         }
         else if (choice == 7) {
             string did = Utils::getLineInput("Doctor ID: ");
@@ -524,15 +557,11 @@ int main() {
             }
         }
         else if (choice == 9) {
-            string did = Utils::getLineInput("Doctor ID: ");
-            string pid = Utils::getLineInput("Patient ID: ");
-            Doctor* doc = doctorManager.getDoctorByID(did);
-            Patient* pat = nullptr;
-            for (auto p : patients) if (p->getId() == pid) pat = p;
-            if (doc && pat)
-                missedManager.rebookMissedAppointment(doc, pat);
+            int appointmentId = Utils::getSafeInt("Appointment ID: ");
+            if (appointmentId > 0)
+                missedManager.rebookMissedAppointment(appointmentId);
             else
-                cout << "Doctor or patient not found.\n";
+                cout << "Invalid appointment ID.\n";
         }
         else if (choice == 10) {
             string pid = Utils::getLineInput("Patient ID: ");
@@ -547,7 +576,7 @@ int main() {
                 cout << "Patient not found.\n";
                 continue;
             }
-            cout << "1. View  2. Add: ";
+            cout << "1. View  2. Add  3. View Page: ";
             string input;
             getline(cin, input);
             try {
@@ -556,6 +585,8 @@ int main() {
                     historyManager.viewMedicalHistory(p);
                 else if (sub == 2)
                     historyManager.addMedicalHistory(p, Utils::getLineInput("Enter history record: "));
+                else if (sub == 3)
+                    historyManager.viewMedicalHistoryPage(p, Utils::getSafeInt("Page number: "));
                 else
                     cout << "Invalid choice.\n";
             } catch (...) {
@@ -563,34 +594,180 @@ int main() {
             }
         }
         else if (choice == 11) {
-            // Save appointments for each doctor
-            auto doctors = doctorManager.getAllDoctors();
-            for (const auto& doc : doctors) {
-                string filename = "appointments_" + doc->getId() + ".txt";
-                fileHandler.saveAppointmentsToFile(doc, filename);
-            }
-            // Also save user data
-            userHandler.saveUserData(doctorManager, patients);
-            cout << "All data saved successfully.\n";
+            // Only doctors and patients changed since the last save are
+            // written; everything else is already in the snapshot and journal
+            size_t savedDoctors = appointmentStore.save(doctorManager);
+            size_t savedPatients = userHandler.savePatientChanges(patients);
+            cout << "Saved " << savedDoctors << " changed doctor(s) and " << savedPatients << " changed patient(s).\n";
         }
         else if (choice == 12) {
-            // Load appointments for each doctor
-            auto doctors = doctorManager.getAllDoctors();
-            vector<bool> arr(patients.size());
-            for (const auto& doc : doctors) {
-                string filename = "appointments_" + doc->getId() + ".txt";
-                fileHandler.loadAppointmentsFromFile(doc, arr, patients.size(), filename);
+            // Stored appointments are loaded at startup; older saves kept one
+            // appointments_<id>.txt per doctor, which are imported here
+            size_t imported = appointmentStore.importLegacyFiles(doctorManager, patients);
+            if (imported > 0) {
+                appointmentStore.save(doctorManager);
+                cout << "Imported " << imported << " legacy appointment file(s) into the appointment store.\n";
+            } else {
+                cout << "No legacy appointment files to import.\n";
             }
-            cout << "All appointments loaded successfully.\n";
         }
         else if (choice == 13) {
-            string did = Utils::getLineInput("Doctor ID: ");
-            string pid = Utils::getLineInput("Patient ID: ");
-            Doctor* doc = doctorManager.getDoctorByID(did);
-            if (doc) {
-                cancelManager.cancelAppointment(doc, pid);
+            int appointmentId = Utils::getSafeInt("Appointment ID: ");
+            if (appointmentId > 0) {
+                cancelManager.cancelAppointment(appointmentId);
             } else {
-                cout << "Doctor not found.\n";
+                cout << "Invalid appointment ID.\n";
+            }
+        }
+        else if (choice == 14) {
+            userHandler.exportUserData(doctorManager, patients);
+        }
+        else if (choice == 15) {
+            // The journal holds every change not yet in the snapshot, so
+            // the files on disk are already complete
+            BackupManager::instance().createBackup();
+        }
+        else if (choice == 16) {
+            vector<BackupManager::BackupInfo> backups = BackupManager::instance().listBackups();
+            if (backups.empty()) {
+                cout << "No backups found.\n";
+                continue;
+            }
+            cout << "Available backups:\n";
+            for (const auto& backup : backups) {
+                cout << "  " << backup.id << " (" << backup.storedBytes << " bytes of journal/store data)\n";
+            }
+            string id = Utils::getLineInput("Backup ID to restore: ");
+
+            // The restored files replace the journal and the snapshot, so
+            // everything is closed, and the snapshot unmapped, which Windows
+            // needs before renaming over it; all data is reloaded afterwards
+            Journal::instance().close();
+            historyManager.close();
+            eventLog.close();
+            scheduleStore.detach();
+            BackupManager::instance().restore(id);
+            userHandler = UserFileHandler();
+            appointmentStore = AppointmentStore();
+            loadData();
+        }
+        else if (choice == 17) {
+            historyManager.searchMedicalHistories(Utils::getLineInput(
+                "Search (terms, OR, -term, \"phrase\"): "));
+        }
+        else if (choice == 18) {
+            cout << archive.rowCount() << " appointment(s) archived (" << archive.storedBytes() << " bytes).\n";
+            cout << "1. Archive Old  2. Find by ID  3. By Doctor  4. By Patient: ";
+            string input;
+            getline(cin, input);
+            try {
+                int sub = stoi(input);
+                vector<AppointmentArchive::Row> rows;
+                if (sub == 1) {
+                    string date = Utils::getLineInput("Archive appointments before (DD-MM-YYYY): ");
+                    if (Utils::isValidDate(date))
+                        archive.archiveBefore(Utils::packDate(date), doctorManager);
+                    else
+                        cout << "Invalid date.\n";
+                    continue;
+                }
+                else if (sub == 2) {
+                    AppointmentArchive::Row row;
+                    int appointmentId = Utils::getSafeInt("Appointment ID: ");
+                    if (appointmentId > 0 && archive.find(static_cast<uint32_t>(appointmentId), row))
+                        rows.push_back(row);
+                }
+                else if (sub == 3 || sub == 4) {
+                    AppointmentArchive::Query query;
+                    (sub == 3 ? query.doctorID : query.patientID) = Utils::getLineInput(sub == 3 ? "Doctor ID: " : "Patient ID: ");
+                    string from = Utils::getLineInput("From date (DD-MM-YYYY, blank for any): ");
+                    string to = Utils::getLineInput("To date (DD-MM-YYYY, blank for any): ");
+                    if ((!from.empty() && !Utils::isValidDate(from)) || (!to.empty() && !Utils::isValidDate(to))) {
+                        cout << "Invalid date.\n";
+                        continue;
+                    }
+                    if (!from.empty()) query.fromDate = Utils::packDate(from);
+                    if (!to.empty()) query.toDate = Utils::packDate(to);
+                    rows = archive.query(query);
+                }
+                else {
+                    cout << "Invalid choice.\n";
+                    continue;
+                }
+                if (rows.empty())
+                    cout << "No archived appointments found.\n";
+                for (const auto& row : rows) {
+                    cout << "#" << row.id << "  " << row.getDate() << " " << row.getTime()
+                         << "  Doctor " << row.doctorID << "  Patient " << (row.patientID.empty() ? "-" : row.patientID);
+                    if (row.flags & Appointment::EMERGENCY) cout << " [EMERGENCY]";
+                    if (row.flags & Appointment::MISSED) cout << " [MISSED]";
+                    cout << "\n";
+                }
+            } catch (...) {
+                cout << "Invalid choice.\n";
+            }
+        }
+        else if (choice == 19) {
+            cout << eventLog.lastSequence() << " appointment event(s) recorded.\n";
+            cout << "1. Doctor Schedule  2. Patient Timeline  3. By Specialization  4. Rebuild Views: ";
+            string input;
+            getline(cin, input);
+            try {
+                int sub = stoi(input);
+                if (sub == 1) {
+                    string doctorId = Utils::getLineInput("Doctor ID: ");
+                    const DoctorScheduleView::Schedule* schedule = views.doctorSchedules().schedule(doctorId);
+                    if (!schedule) {
+                        cout << "No appointments recorded for doctor " << doctorId << ".\n";
+                        continue;
+                    }
+                    // Listed by date and time
+                    vector<pair<uint32_t, const DoctorScheduleView::Entry*>> entries;
+                    for (const auto& [id, entry] : *schedule) entries.push_back({id, &entry});
+                    sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+                        return make_pair(a.second->packedDate, a.second->minutes) < make_pair(b.second->packedDate, b.second->minutes);
+                    });
+                    for (const auto& [id, entry] : entries) {
+                        cout << "#" << id << "  " << Utils::unpackDate(entry->packedDate) << " " << Utils::unpackTime(entry->minutes)
+                             << "  Patient " << (entry->patientId.empty() ? "-" : entry->patientId);
+                        if (entry->emergency) cout << " [EMERGENCY]";
+                        if (entry->missed) cout << " [MISSED]";
+                        cout << "\n";
+                    }
+                }
+                else if (sub == 2) {
+                    string patientId = Utils::getLineInput("Patient ID: ");
+                    const PatientTimelineView::Timeline* timeline = views.patientTimelines().timeline(patientId);
+                    if (!timeline) {
+                        cout << "No appointment history for patient " << patientId << ".\n";
+                        continue;
+                    }
+                    for (const auto& entry : *timeline) {
+                        char recorded[32];
+                        strftime(recorded, sizeof(recorded), "%Y-%m-%d %H:%M", localtime(&entry.recordedAt));
+                        cout << recorded << "  " << AppointmentEvent::typeName(entry.type) << " #" << entry.appointmentId
+                             << "  Doctor " << entry.doctorId << "  " << Utils::unpackDate(entry.packedDate) << " "
+                             << Utils::unpackTime(entry.minutes) << "\n";
+                    }
+                }
+                else if (sub == 3) {
+                    const auto& counters = views.specializationUtilization().all();
+                    if (counters.empty())
+                        cout << "No appointments recorded.\n";
+                    for (const auto& [specialization, count] : counters) {
+                        cout << specialization << ": " << count.active() << " active, " << count.booked << " booked, "
+                             << count.cancelled << " cancelled, " << count.missed << " missed, " << count.rebooked << " rebooked\n";
+                    }
+                }
+                else if (sub == 4) {
+                    views.rebuild();
+                    cout << "Views rebuilt up to event " << views.lastSequence() << ".\n";
+                }
+                else {
+                    cout << "Invalid choice.\n";
+                }
+            } catch (...) {
+                cout << "Invalid choice.\n";
             }
         }
         else if (choice != 0) {
@@ -0,0 +1,984 @@
+// Integrity checker for the data directory. Reads every data file without
+// changing any of them and reports:
+//   - lines that cannot be parsed, and damaged journal, event log,
+//     snapshot and users.db records
+//   - duplicate doctor, patient, user and appointment IDs
+//   - appointments whose doctor or patient does not exist, and
+//     appointments_<id>.txt files of doctors that do not exist
+//   - slot times listed twice for a doctor, or beyond its slot limits
+//   - two appointments of a doctor at the same date and time
+//
+// The text files and the snapshot are checked as two separate data sets:
+// the snapshot is what the program loads when it exists, the text files
+// what it falls back to and what it imported from.
+//
+// Files are mapped and parsed in parallel chunks on the shared ThreadPool,
+// and the ID checks are split into shards by hash, one pool task each.
+//
+// With --repair, a snapshot built from the text files with the problems
+// left out is written to the given path (never over the data directory's
+// own files): the first of duplicate doctors and the last of duplicate
+// patients are kept, as the program does when loading; duplicate or
+// overlapping appointments after the first, appointments of unknown
+// doctors and unusable slot times are dropped; appointments of unknown
+// patients are kept without a patient.
+//
+// Usage: ams_check [--repair <snapshot>] [--limit <n>] [data directory]
+// Exit status: 0 if nothing was found, 1 if problems were, 2 on errors.
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/ams_check.cpp $(ls *.cpp | grep -v '^main.cpp$') -o ams_check
+
+#include "AppointmentEvents.h"
+#include "AppointmentRegistry.h"
+#include "BTreeStorage.h"
+#include "Doctor.h"
+#include "DoctorManager.h"
+#include "Journal.h"
+#include "MappedFile.h"
+#include "Patient.h"
+#include "RecordParser.h"
+#include "ScheduleStore.h"
+#include "SnapshotFile.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    const char* const UNPARSABLE = "Unparsable lines";
+    const char* const DAMAGED = "Damaged records";
+    const char* const DUPLICATES = "Duplicate IDs";
+    const char* const DANGLING = "Dangling references";
+    const char* const ORPHANS = "Orphan appointment files";
+    const char* const SLOTS = "Overlapping slots";
+    const char* const OVERLAPS = "Overlapping appointments";
+    const char* const CATEGORIES[] = {UNPARSABLE, DAMAGED, DUPLICATES, DANGLING, ORPHANS, SLOTS, OVERLAPS};
+
+    // Where a finding is; line 0 for the file as a whole
+    struct Place {
+        string source;
+        size_t line;
+
+        Place(string source, size_t line = 0) : source(std::move(source)), line(line) {}
+        string text() const { return line ? source + ":" + to_string(line) : source; }
+        bool operator<(const Place& other) const { return tie(source, line) < tie(other.source, other.line); }
+    };
+
+    Place at(const string& source, size_t line) {
+        return Place(source, line);
+    }
+
+    // Findings by category, added to from pool threads
+    class Report {
+    public:
+        void add(const char* category, const Place& place, const string& message) {
+            lock_guard<mutex> lock(guard);
+            findings[category].emplace_back(place, message);
+        }
+
+        size_t total() const {
+            size_t count = 0;
+            for (const auto& entry : findings) count += entry.second.size();
+            return count;
+        }
+
+        void print(size_t limit) {
+            for (const char* category : CATEGORIES) {
+                vector<pair<Place, string>>& list = findings[category];
+                cout << category << ": " << list.size() << "\n";
+                sort(list.begin(), list.end());
+                for (size_t i = 0; i < list.size() && i < limit; ++i) {
+                    cout << "  " << list[i].first.text() << ": " << list[i].second << "\n";
+                }
+                if (list.size() > limit) cout << "  ... and " << list.size() - limit << " more\n";
+            }
+        }
+
+    private:
+        mutex guard;
+        map<string, vector<pair<Place, string>>> findings;
+    };
+
+    // --- Records ---
+
+    struct DoctorRow {
+        string_view id, name, specialization, location;
+        int maxNormal = 0, maxEmergency = 0;
+        vector<string_view> normalSlots, emergencySlots;  // Usable times only
+        const string* source = nullptr;
+        size_t line = 0;
+    };
+
+    struct PatientRow {
+        string_view id, name, location;
+        const string* source = nullptr;
+        size_t line = 0;
+    };
+
+    struct UserRow {
+        string_view id;
+        const string* source = nullptr;
+        size_t line = 0;
+    };
+
+    struct AppointmentRow {
+        uint32_t id = 0;  // 0 in legacy files written before IDs
+        string_view doctorId, patientId;  // Empty patient: none
+        uint32_t packedDate = 0;
+        uint16_t minutes = 0;
+        uint8_t flags = 0;  // Appointment::Flags
+        int32_t slotIndex = AppointmentRegistry::NO_SLOT;
+        const string* source = nullptr;
+        size_t line = 0;
+    };
+
+    struct DataSet {
+        string name;
+        vector<DoctorRow> doctors;
+        vector<PatientRow> patients;
+        vector<UserRow> users;
+        vector<AppointmentRow> appointments;
+    };
+
+    // Owns the mapped files, file names and strings the rows point into
+    struct Storage {
+        deque<MappedFile> files;
+        deque<string> strings;
+        mutex guard;
+
+        const MappedFile* map(const string& path) {
+            lock_guard<mutex> lock(guard);
+            files.emplace_back();
+            if (!files.back().open(path) || files.back().size() == 0) {
+                files.pop_back();
+                return nullptr;
+            }
+            return &files.back();
+        }
+
+        const string* keep(string text) {
+            lock_guard<mutex> lock(guard);
+            strings.push_back(std::move(text));
+            return &strings.back();
+        }
+    };
+
+    bool isBlank(string_view line) {
+        return line.find_first_not_of(" \t\r") == string_view::npos;
+    }
+
+    string_view trim(string_view text) {
+        size_t first = text.find_first_not_of(" \t");
+        if (first == string_view::npos) return string_view();
+        return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+    }
+
+    bool packDateTime(string_view date, string_view time, uint32_t& packedDate, uint16_t& minutes) {
+        try {
+            packedDate = Utils::packDate(string(date));
+            minutes = Utils::packTime(string(time));
+        } catch (const exception&) {
+            return false;
+        }
+        uint32_t day = packedDate & 0x1F, month = (packedDate >> 5) & 0x0F;
+        return day >= 1 && day <= 31 && month >= 1 && month <= 12 && minutes < 24 * 60;
+    }
+
+    // Parses the lines of a mapped file on the pool, keeping the rows in
+    // line order. parse returns false for a line it could not use.
+    template <typename Row, typename Parse>
+    vector<Row> parseLines(const MappedFile& file, const string* source, Parse parse) {
+        vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+        vector<Row> rows(lines.size());
+        vector<char> used(lines.size(), 0);
+        ThreadPool::instance().parallelFor(lines.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (isBlank(lines[i])) continue;
+                rows[i].source = source;
+                rows[i].line = i + 1;
+                used[i] = parse(lines[i], rows[i]);
+            }
+        }, 4096);
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!used[i]) continue;
+            if (kept != i) rows[kept] = std::move(rows[i]);
+            ++kept;
+        }
+        rows.resize(kept);
+        return rows;
+    }
+
+    // --- Text files ---
+
+    // id,name,specialization,location,maxNormal,maxEmergency;regular:<times>;emergency:<times>
+    bool parseDoctor(string_view line, DoctorRow& row, Report& report) {
+        Place where = at(*row.source, row.line);
+        string_view sections[3];
+        size_t sectionCount = RecordParser::split(line, ';', sections, 3);
+        string_view info[6];
+        if (RecordParser::split(sections[0], ',', info, 6) < 6 || info[0].empty() ||
+            !RecordParser::toInt(info[4], row.maxNormal) || !RecordParser::toInt(info[5], row.maxEmergency)) {
+            report.add(UNPARSABLE, where, "expected id,name,specialization,location,maxNormal,maxEmergency");
+            return false;
+        }
+        row.id = info[0];
+        row.name = info[1];
+        row.specialization = info[2];
+        row.location = info[3];
+
+        set<uint16_t> taken;
+        auto readTimes = [&](string_view section, size_t prefix, bool emergency) {
+            vector<string_view>& slots = emergency ? row.emergencySlots : row.normalSlots;
+            int limit = emergency ? row.maxEmergency : row.maxNormal;
+            string_view times = section.substr(prefix);
+            while (!times.empty()) {
+                size_t comma = times.find(',');
+                string_view time = trim(times.substr(0, comma));
+                times = comma == string_view::npos ? string_view() : times.substr(comma + 1);
+                if (time.empty()) continue;
+
+                uint32_t unusedDate;
+                uint16_t minutes;
+                if (!packDateTime("01-01-2000", time, unusedDate, minutes)) {
+                    report.add(UNPARSABLE, where, "slot time '" + string(time) + "' of doctor " + string(row.id));
+                } else if (!taken.insert(minutes).second) {
+                    report.add(SLOTS, where, "doctor " + string(row.id) + " lists " + string(time) + " twice");
+                } else if (static_cast<int>(slots.size()) >= limit) {
+                    report.add(SLOTS, where, "doctor " + string(row.id) + " has more " +
+                               (emergency ? "emergency" : "regular") + " slots than its limit of " + to_string(limit));
+                } else {
+                    slots.push_back(time);
+                }
+            }
+        };
+        if (sectionCount > 1 && sections[1].substr(0, 8) == "regular:") readTimes(sections[1], 8, false);
+        if (sectionCount > 2 && sections[2].substr(0, 10) == "emergency:") readTimes(sections[2], 10, true);
+        return true;
+    }
+
+    // id,name,location
+    bool parsePatient(string_view line, PatientRow& row, Report& report) {
+        string_view fields[3];
+        if (RecordParser::split(line, ',', fields, 3) < 3 || fields[0].empty()) {
+            report.add(UNPARSABLE, at(*row.source, row.line), "expected id,name,location");
+            return false;
+        }
+        row.id = fields[0];
+        row.name = fields[1];
+        row.location = fields[2].substr(0, fields[2].find(','));  // As the program reads it
+        return true;
+    }
+
+    // id,password,role
+    bool parseUser(string_view line, UserRow& row, Report& report) {
+        string_view fields[3];
+        if (RecordParser::split(line, ',', fields, 3) < 3 || fields[0].empty()) {
+            report.add(UNPARSABLE, at(*row.source, row.line), "expected id,password,role");
+            return false;
+        }
+        row.id = fields[0];
+        return true;
+    }
+
+    // An appointments_<id>.txt file: two sections, each a count then
+    // "<appointmentID> <patientID> <date> <time>" lines (the ID is missing
+    // in files written before appointments had one)
+    vector<AppointmentRow> parseLegacyAppointments(const MappedFile& file, const string* source, string_view doctorId,
+                                                   Report& report) {
+        vector<AppointmentRow> rows;
+        vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+        bool emergency = false;
+        int remaining = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            string_view line = trim(lines[i]);
+            if (line.empty()) continue;
+            if (line == "REGULAR_APPOINTMENTS" || line == "EMERGENCY_APPOINTMENTS") {
+                emergency = line == "EMERGENCY_APPOINTMENTS";
+                if (i + 1 >= lines.size() || !RecordParser::toInt(trim(lines[i + 1]), remaining) || remaining < 0) {
+                    report.add(UNPARSABLE, at(*source, i + 2), "expected an appointment count");
+                    remaining = 0;
+                }
+                ++i;
+                continue;
+            }
+            if (remaining == 0) {
+                report.add(UNPARSABLE, at(*source, i + 1), "line outside an appointment section");
+                continue;
+            }
+            --remaining;
+
+            string_view tokens[5];
+            size_t count = 0;
+            for (size_t start = 0; start < line.size() && count < 5;) {
+                size_t end = line.find_first_of(" \t", start);
+                if (end == string_view::npos) end = line.size();
+                if (end > start) tokens[count++] = line.substr(start, end - start);
+                start = end + 1;
+            }
+            AppointmentRow row;
+            size_t first = count >= 4 ? 1 : 0;
+            int id = 0;
+            if (count < 3 || count > 4 || (first == 1 && (!RecordParser::toInt(tokens[0], id) || id <= 0)) ||
+                !packDateTime(tokens[first + 1], tokens[first + 2], row.packedDate, row.minutes)) {
+                report.add(UNPARSABLE, at(*source, i + 1), "expected [id] patient date time");
+                continue;
+            }
+            row.id = static_cast<uint32_t>(id);
+            row.doctorId = doctorId;
+            row.patientId = tokens[first] == "-" ? string_view() : tokens[first];
+            row.flags = emergency ? Appointment::EMERGENCY : 0;
+            row.source = source;
+            row.line = i + 1;
+            rows.push_back(row);
+        }
+        return rows;
+    }
+
+    // appointments.store: segments of "SEGMENT <doctorID> <count>" then
+    // "<id> <patient> <date> <time> <flags> <slotIndex>" lines. A later
+    // segment of a doctor replaces the earlier ones. Leaves room for
+    // extraCapacity more rows.
+    vector<AppointmentRow> parseStore(const MappedFile& file, const string* source, size_t extraCapacity,
+                                      Report& report) {
+        vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+        vector<AppointmentRow> rows;
+        rows.reserve(lines.size() + extraCapacity);
+        rows.resize(lines.size());
+        vector<char> kind(lines.size(), 0);  // 0 blank or bad, 1 segment, 2 row
+        ThreadPool::instance().parallelFor(lines.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (isBlank(lines[i])) continue;
+                string_view fields[6];
+                size_t count = RecordParser::split(lines[i], ' ', fields, 6);
+                AppointmentRow& row = rows[i];
+                row.source = source;
+                row.line = i + 1;
+                int number = 0;
+                if (count == 3 && fields[0] == "SEGMENT" && RecordParser::toInt(fields[2], number) && number >= 0) {
+                    row.doctorId = fields[1];
+                    row.id = static_cast<uint32_t>(number);  // Row count
+                    kind[i] = 1;
+                    continue;
+                }
+                int id = 0, flags = 0, slot = 0;
+                if (count == 6 && RecordParser::toInt(fields[0], id) && id > 0 && RecordParser::toInt(fields[4], flags) &&
+                    RecordParser::toInt(fields[5], slot) && packDateTime(fields[2], fields[3], row.packedDate, row.minutes)) {
+                    row.id = static_cast<uint32_t>(id);
+                    row.patientId = fields[1] == "-" ? string_view() : fields[1];
+                    row.flags = static_cast<uint8_t>(flags);
+                    row.slotIndex = slot;
+                    kind[i] = 2;
+                    continue;
+                }
+                report.add(UNPARSABLE, at(*source, i + 1), "expected a segment header or appointment row");
+            }
+        }, 4096);
+
+        // Rows of the latest segment of each doctor
+        unordered_map<string_view, size_t> latest;  // Doctor -> line of its last segment
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (kind[i] == 1) latest[rows[i].doctorId] = i;
+        }
+        // Kept in place: a live row only moves towards the front, past the
+        // headers and replaced rows before it
+        size_t kept = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (kind[i] != 1) continue;
+            string_view doctorId = rows[i].doctorId;
+            bool current = latest[doctorId] == i;
+            size_t expected = rows[i].id, seen = 0;
+            for (size_t j = i + 1; j < lines.size() && kind[j] != 1 && seen < expected; ++j) {
+                if (kind[j] != 2) continue;
+                ++seen;
+                if (!current) continue;
+                rows[j].doctorId = doctorId;
+                rows[kept++] = rows[j];
+            }
+            if (seen < expected) {
+                report.add(DAMAGED, at(*source, i + 1), "segment of doctor " + string(doctorId) + " holds " +
+                           to_string(seen) + " of its " + to_string(expected) + " rows");
+            }
+        }
+        rows.resize(kept);
+        return rows;
+    }
+
+    // The B+tree the users are kept in once users.dat was imported. Opening
+    // an existing file only reads it; a scan that ends before the record
+    // count stored in it has hit a damaged page.
+    void readUserStorage(const string& path, Storage& storage, DataSet& data, Report& report) {
+        error_code ec;
+        if (filesystem::file_size(path, ec) == 0 || ec) return;
+        BTreeStorage users(path);
+        if (!users.isOpen()) {
+            report.add(DAMAGED, path, "not a storage file or damaged, see the messages above");
+            return;
+        }
+        const string* source = storage.keep(path);
+        size_t read = 0;
+        users.scan("", "", [&](const string& id, const string& value) {
+            UserRow row;
+            row.id = *storage.keep(id);
+            row.source = source;
+            data.users.push_back(row);
+            if (value.find(',') == string::npos) report.add(UNPARSABLE, path, "user " + id + " has no role");
+            ++read;
+            return true;
+        });
+        if (read < users.size()) {
+            report.add(DAMAGED, path, "only " + to_string(read) + " of " + to_string(users.size()) + " users are readable");
+        }
+    }
+
+    DataSet readTextFiles(const string& dataDir, Storage& storage, Report& report) {
+        DataSet data;
+        data.name = "text files";
+        ThreadPool& pool = ThreadPool::instance();
+
+        auto mapFile = [&](const string& name, const string*& source) {
+            source = storage.keep(dataDir + "/" + name);
+            return storage.map(*source);
+        };
+        const string* source;
+        if (const MappedFile* file = mapFile("doctors.dat", source)) {
+            data.doctors = parseLines<DoctorRow>(*file, source, [&](string_view line, DoctorRow& row) {
+                return parseDoctor(line, row, report);
+            });
+        }
+        if (const MappedFile* file = mapFile("patients.dat", source)) {
+            data.patients = parseLines<PatientRow>(*file, source, [&](string_view line, PatientRow& row) {
+                return parsePatient(line, row, report);
+            });
+        }
+        if (const MappedFile* file = mapFile("users.dat", source)) {
+            data.users = parseLines<UserRow>(*file, source, [&](string_view line, UserRow& row) {
+                return parseUser(line, row, report);
+            });
+        }
+        readUserStorage(dataDir + "/users.db", storage, data, report);
+
+        // Legacy appointment files, looked for where the program imports
+        // them from: the data directory and the working directory above it
+        vector<pair<string, string>> legacy;  // Path, doctor ID
+        filesystem::path parent = filesystem::absolute(dataDir).lexically_normal().parent_path();
+        set<filesystem::path> seen;
+        for (const filesystem::path& dir : {filesystem::path(dataDir), parent}) {
+            error_code ec;
+            if (!seen.insert(filesystem::absolute(dir).lexically_normal()).second) continue;
+            for (const auto& entry : filesystem::directory_iterator(dir, ec)) {
+                string name = entry.path().filename().string();
+                const string prefix = "appointments_", suffix = ".txt";
+                if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                    name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+                    continue;
+                }
+                legacy.emplace_back(entry.path().string(),
+                                    name.substr(prefix.size(), name.size() - prefix.size() - suffix.size()));
+            }
+        }
+        sort(legacy.begin(), legacy.end());
+        vector<vector<AppointmentRow>> legacyRows(legacy.size());
+        vector<const string*> legacyDoctor(legacy.size());
+        for (size_t i = 0; i < legacy.size(); ++i) legacyDoctor[i] = storage.keep(legacy[i].second);
+        pool.parallelFor(legacy.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const string* path = storage.keep(legacy[i].first);
+                if (const MappedFile* file = storage.map(*path)) {
+                    legacyRows[i] = parseLegacyAppointments(*file, path, *legacyDoctor[i], report);
+                }
+            }
+        });
+
+        // Orphan files: the whole file belongs to a doctor that is not there
+        unordered_set<string_view> doctorIds;
+        for (const DoctorRow& doctor : data.doctors) doctorIds.insert(doctor.id);
+        size_t legacyCount = 0;
+        for (size_t i = 0; i < legacy.size(); ++i) {
+            if (doctorIds.count(*legacyDoctor[i])) {
+                legacyCount += legacyRows[i].size();
+                continue;
+            }
+            report.add(ORPHANS, legacy[i].first, "no doctor " + legacy[i].second + " (" +
+                       to_string(legacyRows[i].size()) + " appointment(s))");
+            legacyRows[i].clear();
+        }
+
+        // The store's appointments come first, then the legacy ones, in one
+        // vector sized for both
+        if (const MappedFile* file = mapFile("appointments.store", source)) {
+            data.appointments = parseStore(*file, source, legacyCount, report);
+        }
+        data.appointments.reserve(data.appointments.size() + legacyCount);
+        for (vector<AppointmentRow>& rows : legacyRows) {
+            data.appointments.insert(data.appointments.end(), rows.begin(), rows.end());
+            vector<AppointmentRow>().swap(rows);
+        }
+        return data;
+    }
+
+    // --- Journal and event log ---
+
+    void checkJournal(const string& path, Report& report) {
+        static const set<string> keywords = {Journal::USER_ADD, Journal::USER_REMOVE, Journal::DOCTOR_ADD,
+                                             Journal::DOCTOR_DELETE, Journal::PATIENT_ADD, Journal::PATIENT_UPDATE,
+                                             Journal::BOOK, Journal::CANCEL, Journal::MISSED, Journal::REBOOK,
+                                             Journal::ARCHIVE, Journal::EMERGENCY_QUEUE, Journal::EMERGENCY_DEQUEUE};
+        MappedFile file;
+        if (!file.open(path) || file.size() == 0) return;
+        vector<string_view> lines = RecordParser::splitLines(file.data(), file.size());
+        if (file.data()[file.size() - 1] != '\n') {
+            report.add(DAMAGED, at(path, lines.size()), "last record was cut off");
+            lines.pop_back();
+        }
+        ThreadPool::instance().parallelFor(lines.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                string_view line = lines[i];
+                if (line.empty()) continue;
+                if (!Journal::checkRecord(line)) {
+                    report.add(DAMAGED, at(path, i + 1), "checksum mismatch");
+                } else if (!keywords.count(string(line.substr(0, line.find('\t'))))) {
+                    report.add(UNPARSABLE, at(path, i + 1), "unknown record type");
+                }
+            }
+        }, 4096);
+    }
+
+    void checkEventLog(const string& path, Report& report) {
+        MappedFile file;
+        if (!file.open(path) || file.size() == 0) return;
+        size_t lines = count(file.data(), file.data() + file.size(), '\n');
+        file.close();
+        // readAll reports each line it skips
+        size_t intact = AppointmentEventLog::readAll(path).size();
+        if (intact < lines) {
+            report.add(DAMAGED, path, to_string(lines - intact) + " event(s) skipped, see the messages above");
+        }
+    }
+
+    // --- Snapshot ---
+
+    // Patient references are indices checked when the snapshot is loaded,
+    // so appointment rows leave them out
+
+    bool readSnapshot(const string& path, DoctorManager& doctorManager, vector<Patient*>& patients, Storage& storage,
+                      DataSet& data, Report& report) {
+        data.name = "snapshot";
+        if (!filesystem::exists(path)) return false;
+        if (!SnapshotFile::load(path, doctorManager, patients)) {
+            report.add(DAMAGED, path, "the snapshot cannot be loaded, see the messages above");
+            return false;
+        }
+        const string* source = storage.keep(path);
+        for (Patient* patient : patients) {
+            PatientRow row;
+            row.id = *storage.keep(patient->getId());
+            row.source = source;
+            data.patients.push_back(row);
+        }
+
+        vector<Doctor*> doctors = doctorManager.getAllDoctors();
+        vector<vector<ScheduleStore::StoredAppointment>> stored(doctors.size());
+        vector<char> intact(doctors.size(), 1);
+        for (Doctor* doctor : doctors) {
+            DoctorRow row;
+            row.id = *storage.keep(doctor->getId());
+            row.source = source;
+            data.doctors.push_back(row);
+        }
+        ThreadPool::instance().parallelFor(doctors.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (doctors[i]->scheduleLoaded) {
+                    for (const Appointment& appointment : doctors[i]->appointments) {
+                        stored[i].push_back(ScheduleStore::StoredAppointment{appointment, AppointmentRegistry::NO_SLOT});
+                    }
+                } else {
+                    intact[i] = ScheduleStore::instance().readStored(doctors[i], stored[i]);
+                }
+            }
+        }, 64);
+        if (!ScheduleStore::instance().lookupValid()) {
+            report.add(DAMAGED, path, "the appointment ID index fails its checksum");
+        }
+        size_t total = 0;
+        for (const auto& appointments : stored) total += appointments.size();
+        data.appointments.reserve(total);
+        for (size_t i = 0; i < doctors.size(); ++i) {
+            if (!intact[i]) {
+                report.add(DAMAGED, path, "appointments of doctor " + string(data.doctors[i].id) + " fail their checksum");
+            }
+            for (const ScheduleStore::StoredAppointment& entry : stored[i]) {
+                AppointmentRow row;
+                row.id = entry.appointment.id;
+                row.doctorId = data.doctors[i].id;
+                row.packedDate = entry.appointment.packedDate;
+                row.minutes = entry.appointment.minutes;
+                row.flags = entry.appointment.flags;
+                row.source = source;
+                data.appointments.push_back(row);
+            }
+            vector<ScheduleStore::StoredAppointment>().swap(stored[i]);
+        }
+        return true;
+    }
+
+    // --- Checks across records ---
+
+    // A doctor's date and time, for finding overlapping appointments
+    struct SlotKey {
+        string_view doctorId;
+        uint32_t packedDate;
+        uint16_t minutes;
+
+        bool operator==(const SlotKey& other) const {
+            return packedDate == other.packedDate && minutes == other.minutes && doctorId == other.doctorId;
+        }
+    };
+
+    uint64_t hashKey(string_view key) { return hash<string_view>()(key); }
+    uint64_t hashKey(uint32_t key) { return key * 0x9E3779B97F4A7C15ULL; }
+    uint64_t hashKey(const SlotKey& key) {
+        return hashKey(key.doctorId) ^ hashKey((key.packedDate << 11) | key.minutes);
+    }
+
+    const auto EVERY_ROW = [](size_t) { return true; };
+
+    // Pairs (later, first) of the wanted rows among 0..count-1 whose keys
+    // are equal. Rows are split into shards by the hash of their key; each
+    // shard sorts its entries, a 32-bit hash above the row number, on its
+    // own pool task, so equal keys end up next to each other, in row order.
+    template <typename KeyOf, typename Wanted>
+    vector<pair<size_t, size_t>> findDuplicates(size_t count, KeyOf keyOf, Wanted wanted) {
+        ThreadPool& pool = ThreadPool::instance();
+        size_t shards = max<size_t>(1, pool.size());
+        vector<uint32_t> hashes(count);
+        vector<char> used(count);
+        pool.parallelFor(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                used[i] = wanted(i);
+                if (used[i]) hashes[i] = static_cast<uint32_t>(hashKey(keyOf(i)) >> 32);
+            }
+        }, 16384);
+
+        vector<vector<pair<size_t, size_t>>> found(shards);
+        vector<future<void>> pending;
+        for (size_t shard = 0; shard < shards; ++shard) {
+            pending.push_back(pool.submit([&, shard]() {
+                vector<uint64_t> entries;
+                for (size_t i = 0; i < count; ++i) {
+                    if (used[i] && hashes[i] % shards == shard) entries.push_back(uint64_t(hashes[i]) << 32 | i);
+                }
+                sort(entries.begin(), entries.end());
+                vector<size_t> firsts;  // Rows with distinct keys in this run of equal hashes
+                for (size_t run = 0; run < entries.size();) {
+                    firsts.assign(1, entries[run] & UINT32_MAX);
+                    size_t next = run + 1;
+                    for (; next < entries.size() && entries[next] >> 32 == entries[run] >> 32; ++next) {
+                        size_t row = entries[next] & UINT32_MAX;
+                        auto first = find_if(firsts.begin(), firsts.end(), [&](size_t other) {
+                            return keyOf(other) == keyOf(row);
+                        });
+                        if (first == firsts.end()) {
+                            firsts.push_back(row);
+                        } else {
+                            found[shard].emplace_back(row, *first);
+                        }
+                    }
+                    run = next;
+                }
+            }));
+        }
+        for (auto& future : pending) future.get();
+
+        vector<pair<size_t, size_t>> duplicates;
+        for (auto& part : found) duplicates.insert(duplicates.end(), part.begin(), part.end());
+        sort(duplicates.begin(), duplicates.end());
+        return duplicates;
+    }
+
+    // The IDs of rows, split into shards by hash, each an open-addressing
+    // table holding the IDs' characters, so a lookup touches its slot and
+    // the ID it matches and nothing else. Lookups are safe from any thread.
+    class IdSet {
+    public:
+        template <typename Row>
+        explicit IdSet(const vector<Row>& rows) : shards(max<size_t>(1, ThreadPool::instance().size())) {
+            ThreadPool& pool = ThreadPool::instance();
+            vector<uint64_t> hashes(rows.size());
+            pool.parallelFor(rows.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) hashes[i] = hashKey(rows[i].id);
+            }, 16384);
+
+            vector<future<void>> pending;
+            for (size_t shard = 0; shard < shards.size(); ++shard) {
+                pending.push_back(pool.submit([&, shard]() {
+                    size_t count = 0;
+                    for (uint64_t hash : hashes) count += hash % shards.size() == shard;
+                    size_t capacity = 16;
+                    while (capacity < count * 2) capacity *= 2;
+                    vector<Slot>& table = shards[shard];
+                    table.assign(capacity, Slot{nullptr, 0, 0});
+                    for (size_t i = 0; i < rows.size(); ++i) {
+                        if (hashes[i] % shards.size() != shard) continue;
+                        size_t at = probeStart(hashes[i], capacity);
+                        while (table[at].data) at = (at + 1) & (capacity - 1);
+                        table[at] = Slot{rows[i].id.data(), static_cast<uint32_t>(rows[i].id.size()),
+                                         static_cast<uint32_t>(hashes[i] >> 32)};
+                    }
+                }));
+            }
+            for (auto& future : pending) future.get();
+        }
+
+        bool contains(string_view id) const {
+            uint64_t hash = hashKey(id);
+            const vector<Slot>& table = shards[hash % shards.size()];
+            uint32_t tag = static_cast<uint32_t>(hash >> 32);
+            for (size_t at = probeStart(hash, table.size());; at = (at + 1) & (table.size() - 1)) {
+                const Slot& slot = table[at];
+                if (!slot.data) return false;
+                if (slot.tag == tag && string_view(slot.data, slot.size) == id) return true;
+            }
+        }
+
+    private:
+        struct Slot {
+            const char* data;  // Null if free
+            uint32_t size;
+            uint32_t tag;      // High half of the hash
+        };
+
+        vector<vector<Slot>> shards;
+
+        // Bits above the ones that picked the shard
+        static size_t probeStart(uint64_t hash, size_t capacity) { return (hash >> 8) & (capacity - 1); }
+    };
+
+    string describe(const AppointmentRow& row) {
+        return "appointment " + (row.id ? "#" + to_string(row.id) : string("without ID")) + " of doctor " +
+               string(row.doctorId) + " on " + Utils::unpackDate(row.packedDate) + " " + Utils::unpackTime(row.minutes);
+    }
+
+    // Appointments that are not missed and share their doctor, date and
+    // time with an earlier one. The same appointment stored twice is a
+    // duplicate ID, not an overlap.
+    vector<pair<size_t, size_t>> findOverlaps(const vector<AppointmentRow>& appointments) {
+        auto slotOf = [&](size_t i) {
+            return SlotKey{appointments[i].doctorId, appointments[i].packedDate, appointments[i].minutes};
+        };
+        auto active = [&](size_t i) { return !(appointments[i].flags & Appointment::MISSED); };
+        vector<pair<size_t, size_t>> overlaps;
+        for (const auto& [later, first] : findDuplicates(appointments.size(), slotOf, active)) {
+            uint32_t id = appointments[later].id;
+            if (id != 0 && id == appointments[first].id) continue;
+            overlaps.emplace_back(later, first);
+        }
+        return overlaps;
+    }
+
+    struct Problems {
+        set<size_t> droppedAppointments;  // Indices into DataSet::appointments
+        set<size_t> droppedDoctors;       // Later duplicates
+        set<size_t> droppedPatients;      // Earlier duplicates
+    };
+
+    Problems checkDataSet(const DataSet& data, bool checkReferences, Report& report) {
+        Problems problems;
+        auto where = [](const auto& row) { return at(*row.source, row.line); };
+
+        auto doctorId = [&](size_t i) { return data.doctors[i].id; };
+        for (const auto& [later, first] : findDuplicates(data.doctors.size(), doctorId, EVERY_ROW)) {
+            report.add(DUPLICATES, where(data.doctors[later]), "doctor " + string(data.doctors[later].id) +
+                       " is already at " + where(data.doctors[first]).text());
+            problems.droppedDoctors.insert(later);
+        }
+        auto patientId = [&](size_t i) { return data.patients[i].id; };
+        for (const auto& [later, first] : findDuplicates(data.patients.size(), patientId, EVERY_ROW)) {
+            report.add(DUPLICATES, where(data.patients[later]), "patient " + string(data.patients[later].id) +
+                       " is already at " + where(data.patients[first]).text());
+            problems.droppedPatients.insert(first);  // The last one is the one looked up
+        }
+        auto userId = [&](size_t i) { return data.users[i].id; };
+        for (const auto& [later, first] : findDuplicates(data.users.size(), userId, EVERY_ROW)) {
+            report.add(DUPLICATES, where(data.users[later]), "user " + string(data.users[later].id) +
+                       " is already at " + where(data.users[first]).text());
+        }
+
+        const vector<AppointmentRow>& appointments = data.appointments;
+        auto appointmentId = [&](size_t i) { return appointments[i].id; };
+        auto hasId = [&](size_t i) { return appointments[i].id != 0; };
+        for (const auto& [later, first] : findDuplicates(appointments.size(), appointmentId, hasId)) {
+            const AppointmentRow& row = appointments[later];
+            report.add(DUPLICATES, where(row), describe(row) + " has the ID of " + where(appointments[first]).text());
+            problems.droppedAppointments.insert(later);
+        }
+        for (const auto& [later, first] : findOverlaps(appointments)) {
+            const AppointmentRow& row = appointments[later];
+            report.add(OVERLAPS, where(row), describe(row) + " is at the same time as " + where(appointments[first]).text());
+            problems.droppedAppointments.insert(later);
+        }
+
+        if (checkReferences) {
+            IdSet doctorIds(data.doctors), patientIds(data.patients);
+            vector<char> missingDoctor(data.appointments.size(), 0), missingPatient(data.appointments.size(), 0);
+            ThreadPool::instance().parallelFor(data.appointments.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const AppointmentRow& row = data.appointments[i];
+                    missingDoctor[i] = !doctorIds.contains(row.doctorId);
+                    missingPatient[i] = !row.patientId.empty() && !patientIds.contains(row.patientId);
+                }
+            }, 16384);
+            for (size_t i = 0; i < data.appointments.size(); ++i) {
+                const AppointmentRow& row = data.appointments[i];
+                if (missingDoctor[i]) {
+                    report.add(DANGLING, where(row), describe(row) + ": no such doctor");
+                    problems.droppedAppointments.insert(i);
+                }
+                if (missingPatient[i]) {
+                    report.add(DANGLING, where(row), describe(row) + ": no patient " + string(row.patientId));
+                }
+            }
+        }
+        return problems;
+    }
+
+    // --- Repair ---
+
+    bool writeRepairedSnapshot(const string& path, const DataSet& data, const Problems& problems) {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        AppointmentRegistry& registry = AppointmentRegistry::instance();
+        registry.clear();
+        bool saved = false;
+        try {
+            for (size_t i = 0; i < data.patients.size(); ++i) {
+                if (problems.droppedPatients.count(i)) continue;
+                const PatientRow& row = data.patients[i];
+                patients.push_back(new Patient(string(row.id), string(row.name), string(row.location)));
+            }
+            for (size_t i = 0; i < data.doctors.size(); ++i) {
+                if (problems.droppedDoctors.count(i)) continue;
+                const DoctorRow& row = data.doctors[i];
+                Doctor* doctor = new Doctor(string(row.id), string(row.name), string(row.specialization),
+                                            string(row.location), row.maxNormal, row.maxEmergency);
+                for (string_view time : row.normalSlots) doctor->addSlot(string(time), true);
+                for (string_view time : row.emergencySlots) doctor->addEmergencySlot(string(time), true);
+                doctorManager.addDoctor(doctor, true);
+            }
+            PatientIndex patientIndex = buildPatientIndex(patients);
+            for (size_t i = 0; i < data.appointments.size(); ++i) {
+                if (problems.droppedAppointments.count(i)) continue;
+                const AppointmentRow& row = data.appointments[i];
+                Doctor* doctor = doctorManager.getDoctorByID(string(row.doctorId));
+                if (!doctor) continue;
+                auto patient = patientIndex.find(string(row.patientId));
+                Appointment appointment;
+                appointment.id = row.id;
+                appointment.doctor = doctor;
+                appointment.patient = patient == patientIndex.end() ? nullptr : patient->second;
+                appointment.packedDate = row.packedDate;
+                appointment.minutes = row.minutes;
+                appointment.flags = row.flags;
+                doctor->restoreSlot(registry.insert(appointment), row.slotIndex);
+            }
+            saved = SnapshotFile::save(path, doctorManager, patients);
+        } catch (const exception& e) {
+            cerr << "Error: Could not build the repaired data: " << e.what() << "\n";
+        }
+        doctorManager.clearDoctors();
+        for (Patient* patient : patients) delete patient;
+        return saved;
+    }
+
+    void printCounts(const DataSet& data) {
+        cout << "  " << data.name << ": " << data.doctors.size() << " doctors, " << data.patients.size()
+             << " patients, " << data.users.size() << " users, " << data.appointments.size() << " appointments\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string dataDir = Utils::DATA_DIR;
+    string repairPath;
+    size_t limit = 20;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--repair" && i + 1 < argc) {
+            repairPath = argv[++i];
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = static_cast<size_t>(atol(argv[++i]));
+        } else if (!arg.empty() && arg[0] != '-') {
+            dataDir = arg;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--repair <snapshot>] [--limit <n>] [data directory]\n";
+            return 2;
+        }
+    }
+    if (!filesystem::is_directory(dataDir)) {
+        cerr << "Error: " << dataDir << " is not a directory\n";
+        return 2;
+    }
+    if (!repairPath.empty()) {
+        // Never over the snapshot the program may be using
+        filesystem::path repairDir = filesystem::path(repairPath).parent_path();
+        error_code ec;
+        if (filesystem::equivalent(repairDir.empty() ? filesystem::path(".") : repairDir, dataDir, ec)) {
+            cerr << "Error: Write the repaired snapshot outside " << dataDir << ", then move it in\n";
+            return 2;
+        }
+    }
+
+    auto started = chrono::steady_clock::now();
+    Report report;
+    Storage storage;
+
+    // The logs first, so the events read from them are freed before the
+    // text files are parsed
+    checkJournal(dataDir + "/ams.journal", report);
+    checkEventLog(dataDir + "/" + AppointmentEventLog::FILE_NAME, report);
+    DataSet text = readTextFiles(dataDir, storage, report);
+    Problems textProblems = checkDataSet(text, true, report);
+
+    DataSet snapshot;
+    bool hasSnapshot;
+    {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        hasSnapshot = readSnapshot(dataDir + "/ams.snap", doctorManager, patients, storage, snapshot, report);
+        if (hasSnapshot) checkDataSet(snapshot, false, report);
+        doctorManager.clearDoctors();
+        for (Patient* patient : patients) delete patient;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "Checked " << dataDir << " in " << seconds << " s\n";
+    printCounts(text);
+    if (hasSnapshot) printCounts(snapshot);
+    report.print(limit);
+
+    if (!repairPath.empty()) {
+        if (!writeRepairedSnapshot(repairPath, text, textProblems)) {
+            cerr << "Error: Could not write the repaired snapshot to " << repairPath << "\n";
+            return 2;
+        }
+        cout << "Repaired snapshot written to " << repairPath << ". To use it, stop the program and replace "
+             << dataDir << "/ams.snap with it; the journal must be empty.\n";
+    }
+    return report.total() == 0 ? 0 : 1;
+}
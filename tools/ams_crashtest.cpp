@@ -0,0 +1,370 @@
+// Fault-injection harness for startup recovery. Builds a data directory
+// the way the program does: doctors and patients, a compaction, booked
+// appointments, a second compaction, then a journal tail of 10% of the
+// appointments. It then damages a copy of that directory, runs the startup
+// load sequence on it (UserFileHandler::loadUserData, the appointment
+// store without a snapshot, replayJournal) and compares the appointments
+// it recovers with the ones booked:
+//   - journal cut at random byte offsets: every record that ended before
+//     the cut is kept, nothing else changes
+//   - a random byte of the journal flipped: only the hit record is lost
+//   - the snapshot cut short or a random byte of it flipped: everything is
+//     recovered, from the previous snapshot and the journal it was
+//     compacted from
+// Afterwards it times recovery of larger data sets with an intact and
+// with a damaged snapshot.
+//
+// Everything is written to a scratch directory, never to data/.
+//
+// Usage: ams_crashtest [--trials <n>] [--seed <n>] [--scratch <directory>] [appointments...]
+// Exit status: 0 if every trial recovered, 1 if any failed, 2 on errors.
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/ams_crashtest.cpp $(ls *.cpp | grep -v '^main.cpp$') -o ams_crashtest
+
+#include "AppointmentRegistry.h"
+#include "AppointmentStore.h"
+#include "Doctor.h"
+#include "DoctorManager.h"
+#include "Journal.h"
+#include "Patient.h"
+#include "ScheduleStore.h"
+#include "UserFileHandler.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    const size_t SLOTS_PER_DOCTOR = 48;
+    const size_t FAULT_APPOINTMENTS = 2000;
+    const int TIMING_RUNS = 3;
+
+    // Appointment ID -> its fields, as recovered
+    using State = map<uint32_t, string>;
+
+    // Keeps the loaders' messages out of the report
+    class Quiet {
+    public:
+        Quiet() : out(cout.rdbuf(nullptr)), err(cerr.rdbuf(nullptr)) {}
+        ~Quiet() {
+            cout.rdbuf(out);
+            cerr.rdbuf(err);
+            cout.clear();
+            cerr.clear();
+        }
+
+    private:
+        streambuf* out;
+        streambuf* err;
+    };
+
+    string slotTime(size_t slot) {
+        return Utils::unpackTime(static_cast<uint16_t>(8 * 60 + slot * 15));
+    }
+
+    State collect(const DoctorManager& doctorManager) {
+        ScheduleStore::instance().loadAll();
+        State state;
+        for (const Doctor* doctor : doctorManager.getAllDoctors()) {
+            for (const Appointment& appointment : doctor->appointments) {
+                state[appointment.id] = doctor->getId() + " " +
+                                        (appointment.patient ? appointment.patient->getId() : string("-")) + " " +
+                                        appointment.getDate() + " " + appointment.getTime() + " " +
+                                        to_string(appointment.flags);
+            }
+        }
+        return state;
+    }
+
+    void release(DoctorManager& doctorManager, vector<Patient*>& patients) {
+        Journal::instance().close();
+        doctorManager.clearDoctors();
+        for (Patient* patient : patients) {
+            delete patient;
+        }
+        patients.clear();
+    }
+
+    // Builds data/ in the working directory and returns what was booked
+    State generate(size_t appointments) {
+        Quiet quiet;
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        UserFileHandler userHandler;
+        userHandler.replayJournal(doctorManager, patients);  // Opens the empty journal
+
+        size_t doctors = (appointments + SLOTS_PER_DOCTOR - 1) / SLOTS_PER_DOCTOR;
+        size_t patientCount = max<size_t>(appointments / 10, 1);
+        for (size_t d = 0; d < doctors; ++d) {
+            Doctor* doctor = new Doctor(to_string(d + 1), "Doctor " + to_string(d + 1), "Cardiology", "G-10",
+                                        static_cast<int>(SLOTS_PER_DOCTOR), 1);
+            for (size_t s = 0; s < SLOTS_PER_DOCTOR; ++s) {
+                doctor->addSlot(slotTime(s), true);
+            }
+            doctorManager.addDoctor(doctor, true);
+        }
+        for (size_t p = 0; p < patientCount; ++p) {
+            patients.push_back(new Patient(to_string(p + 1), "Patient " + to_string(p + 1), "G-9"));
+        }
+        userHandler.compact(doctorManager, patients);
+
+        vector<Doctor*> byId(doctors);
+        for (Doctor* doctor : doctorManager.getAllDoctors()) {
+            byId[stoul(doctor->getId()) - 1] = doctor;
+        }
+        // Later bookings take later slots of every doctor, so the journal
+        // tail touches all of them
+        size_t tailStart = appointments - appointments / 10;
+        for (size_t i = 0; i < appointments; ++i) {
+            if (i == tailStart) userHandler.compact(doctorManager, patients);
+            byId[i % doctors]->bookRegularAppointment(patients[i % patientCount], "15-06-2030",
+                                                      slotTime(i / doctors));
+        }
+
+        State booked = collect(doctorManager);
+        release(doctorManager, patients);
+        return booked;
+    }
+
+    // The startup load sequence of main(), timed in milliseconds
+    State recover(double* milliseconds = nullptr) {
+        Quiet quiet;
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        auto started = chrono::steady_clock::now();
+        UserFileHandler userHandler;
+        if (!UserFileHandler::loadUserData(doctorManager, patients)) {
+            AppointmentStore().loadAll(doctorManager, patients);
+        }
+        userHandler.replayJournal(doctorManager, patients);
+        if (milliseconds) {
+            *milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        }
+        State state = collect(doctorManager);
+        release(doctorManager, patients);
+        return state;
+    }
+
+    // The data files, without backups/, which recovery does not read
+    void copyData(const filesystem::path& from, const filesystem::path& to) {
+        filesystem::remove_all(to);
+        filesystem::create_directories(to);
+        for (const auto& entry : filesystem::directory_iterator(from)) {
+            if (entry.is_regular_file()) {
+                filesystem::copy_file(entry.path(), to / entry.path().filename());
+            }
+        }
+    }
+
+    string readFile(const filesystem::path& path) {
+        ifstream in(path, ios::binary);
+        ostringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    void writeFile(const filesystem::path& path, const string& contents) {
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(contents.data(), static_cast<streamsize>(contents.size()));
+    }
+
+    // One journal line: where it ends, and the appointment it books
+    struct JournalLine {
+        size_t begin;
+        size_t end;  // Past its newline
+        uint32_t bookedId;
+    };
+
+    vector<JournalLine> journalLines(const string& journal) {
+        vector<JournalLine> lines;
+        size_t begin = 0;
+        while (begin < journal.size()) {
+            size_t newline = journal.find('\n', begin);
+            size_t end = newline == string::npos ? journal.size() : newline + 1;
+            JournalLine line{begin, end, 0};
+            if (journal.compare(begin, 5, string(Journal::BOOK) + "\t") == 0) {
+                line.bookedId = static_cast<uint32_t>(strtoul(journal.c_str() + begin + 5, nullptr, 10));
+            }
+            lines.push_back(line);
+            begin = end;
+        }
+        return lines;
+    }
+
+    // Recovered must hold every required appointment, and nothing that was
+    // not booked or differs from how it was booked
+    bool matches(const State& recovered, const State& booked, const State& required, string& problem) {
+        for (const auto& [id, fields] : required) {
+            if (!recovered.count(id)) {
+                problem = "appointment " + to_string(id) + " lost";
+                return false;
+            }
+        }
+        for (const auto& [id, fields] : recovered) {
+            auto it = booked.find(id);
+            if (it == booked.end() || it->second != fields) {
+                problem = "appointment " + to_string(id) + " recovered wrongly: " + fields;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Trials {
+        int failures = 0;
+        int run = 0;
+
+        void check(const string& name, const State& recovered, const State& booked, const State& required) {
+            ++run;
+            string problem;
+            if (!matches(recovered, booked, required, problem)) {
+                if (++failures <= 5) cout << "  FAIL " << name << ": " << problem << "\n";
+            }
+        }
+    };
+}
+
+int main(int argc, char* argv[]) {
+    int trials = 100;
+    unsigned seed = 2024;
+    filesystem::path scratch = filesystem::temp_directory_path() / "ams_crashtest_data";
+    vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--trials" && i + 1 < argc) {
+            trials = atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            scratch = argv[++i];
+        } else if (!arg.empty() && isdigit(static_cast<unsigned char>(arg[0]))) {
+            sizes.push_back(strtoul(arg.c_str(), nullptr, 10));
+        } else {
+            cerr << "Usage: " << argv[0] << " [--trials <n>] [--seed <n>] [--scratch <directory>] [appointments...]\n";
+            return 2;
+        }
+    }
+    if (sizes.empty()) sizes = {10000, 100000};
+
+    // The data files are found relative to the working directory
+    filesystem::path workingDir = filesystem::current_path();
+    scratch = filesystem::absolute(scratch);
+    filesystem::remove_all(scratch);
+    filesystem::path pristine = scratch / "pristine";
+    filesystem::path work = scratch / "work";
+    filesystem::create_directories(work);
+    filesystem::current_path(work);
+    filesystem::path data = work / Utils::DATA_DIR;
+    mt19937 random(seed);
+
+    cout << "Fault injection, " << FAULT_APPOINTMENTS << " appointments, " << trials << " trials each:\n";
+    State booked = generate(FAULT_APPOINTMENTS);
+    copyData(data, pristine);
+    State snapshotState = booked;
+    const string journal = readFile(pristine / "ams.journal");
+    const string snapshot = readFile(pristine / "ams.snap");
+    vector<JournalLine> lines = journalLines(journal);
+    for (const JournalLine& line : lines) {
+        snapshotState.erase(line.bookedId);
+    }
+    if (booked.size() != FAULT_APPOINTMENTS || journal.empty() || snapshot.empty()) {
+        cerr << "Error: Could not build the test data\n";
+        return 2;
+    }
+    auto lineAt = [&](size_t offset) {
+        return *find_if(lines.begin(), lines.end(), [offset](const JournalLine& line) { return offset < line.end; });
+    };
+    Trials total;
+
+    // Journal cut short, as by a crash part way through an append
+    Trials cut;
+    for (int t = 0; t < trials; ++t) {
+        size_t offset = random() % journal.size();
+        copyData(pristine, data);
+        writeFile(data / "ams.journal", journal.substr(0, offset));
+        State required = snapshotState;
+        for (const JournalLine& line : lines) {
+            if (line.end <= offset && line.bookedId) required[line.bookedId] = booked.at(line.bookedId);
+        }
+        cut.check("journal cut at byte " + to_string(offset), recover(), booked, required);
+    }
+    printf("  journal cut at a random byte        %3d of %3d failed\n", cut.failures, cut.run);
+
+    // One journal byte flipped; a flipped newline also takes the next line
+    Trials flipped;
+    for (int t = 0; t < trials; ++t) {
+        size_t offset = random() % journal.size();
+        string damaged = journal;
+        damaged[offset] = static_cast<char>(damaged[offset] ^ (1 << (random() % 8)));
+        copyData(pristine, data);
+        writeFile(data / "ams.journal", damaged);
+        State required = booked;
+        required.erase(lineAt(offset).bookedId);
+        if (journal[offset] == '\n' && offset + 1 < journal.size()) required.erase(lineAt(offset + 1).bookedId);
+        flipped.check("journal byte " + to_string(offset) + " flipped", recover(), booked, required);
+    }
+    printf("  journal byte flipped                %3d of %3d failed\n", flipped.failures, flipped.run);
+
+    // Snapshot cut short or one byte of it flipped
+    Trials damagedSnapshot;
+    for (int t = 0; t < trials; ++t) {
+        size_t offset = random() % snapshot.size();
+        string damaged = snapshot;
+        string name;
+        if (t % 2 == 0) {
+            damaged.resize(offset);
+            name = "snapshot cut at byte " + to_string(offset);
+        } else {
+            damaged[offset] = static_cast<char>(damaged[offset] ^ (1 << (random() % 8)));
+            name = "snapshot byte " + to_string(offset) + " flipped";
+        }
+        copyData(pristine, data);
+        writeFile(data / "ams.snap", damaged);
+        damagedSnapshot.check(name, recover(), booked, booked);
+    }
+    printf("  snapshot cut or byte flipped        %3d of %3d failed\n", damagedSnapshot.failures, damagedSnapshot.run);
+    total.failures = cut.failures + flipped.failures + damagedSnapshot.failures;
+
+    // Recovery time, best of TIMING_RUNS each
+    cout << "\nRecovery time, journal tail of 10% of the appointments:\n";
+    printf("  %12s %12s %18s\n", "appointments", "normal", "damaged snapshot");
+    for (size_t size : sizes) {
+        filesystem::remove_all(data);
+        State sizeBooked = generate(size);
+        copyData(data, pristine);
+        string fullSnapshot = readFile(pristine / "ams.snap");
+
+        double normal = 0;
+        double damaged = 0;
+        bool recovered = true;
+        for (int run = 0; run < TIMING_RUNS; ++run) {
+            double ms = 0;
+            copyData(pristine, data);
+            recovered = recover(&ms) == sizeBooked && recovered;
+            normal = run == 0 ? ms : min(normal, ms);
+
+            copyData(pristine, data);
+            writeFile(data / "ams.snap", fullSnapshot.substr(0, fullSnapshot.size() / 2));
+            recovered = recover(&ms) == sizeBooked && recovered;
+            damaged = run == 0 ? ms : min(damaged, ms);
+        }
+        printf("  %12zu %9.0f ms %15.0f ms%s\n", size, normal, damaged, recovered ? "" : "  (not fully recovered)");
+        if (!recovered) ++total.failures;
+    }
+
+    filesystem::current_path(workingDir);
+    filesystem::remove_all(scratch);
+    return total.failures == 0 ? 0 : 1;
+}
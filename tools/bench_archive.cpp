@@ -0,0 +1,224 @@
+// Benchmark for the appointment archive: hot against archived data. Books
+// appointments spread evenly over a number of months, archives everything
+// before the last two months, and reports:
+//   - memory of the hot structures before and after archiving
+//   - size of the archive segments on disk
+//   - lookup by ID: in the registry, and in the archive with the segment
+//     cached (warm) and with it decoded first (cold)
+//   - one doctor's month: scanned from the doctor's appointments, and
+//     queried from the archive, warm and cold
+//   - one doctor across every archived month
+// Everything is written to a scratch directory, never to data/.
+//
+// Usage: bench_archive [appointments] [doctors] [patients] [months] [scratch directory]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_archive.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_archive
+
+#include "AppointmentArchive.h"
+#include "AppointmentRegistry.h"
+#include "Doctor.h"
+#include "DoctorManager.h"
+#include "Patient.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+static const int FIRST_YEAR = 2023;
+static const int HOT_MONTHS = 2;
+static const size_t HOT_LOOKUPS = 200000;
+static const size_t WARM_LOOKUPS = 2000;
+static const int RUNS = 3;
+
+// Resident set size in bytes, or 0 where it cannot be read. Freed memory
+// is handed back to the system first, so what the archive released shows.
+static size_t residentBytes() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    long pages = 0;
+    long resident = 0;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+static double megabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Packed date of a day (1-28) of the month-th month after January FIRST_YEAR
+static uint32_t dateOf(int month, int day) {
+    return Utils::packDate((day < 10 ? "0" : "") + to_string(day) + (month % 12 < 9 ? "-0" : "-") +
+                           to_string(month % 12 + 1) + "-" + to_string(FIRST_YEAR + month / 12));
+}
+
+// Average microseconds per call of lookup(i), best of RUNS
+template <typename Lookup>
+static double averageMicroseconds(size_t calls, Lookup lookup) {
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto started = chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; ++i) lookup(i);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / calls;
+        best = run == 0 ? us : min(best, us);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t appointments = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t doctorCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200;
+    size_t patientCount = argc > 3 ? strtoul(argv[3], nullptr, 10) : 20000;
+    int months = argc > 4 ? atoi(argv[4]) : 24;
+    filesystem::path scratch = argc > 5 ? filesystem::path(argv[5])
+                                        : filesystem::temp_directory_path() / "ams_bench_archive";
+    // Cold lookups need more archived months than the archive caches
+    if (appointments == 0 || doctorCount == 0 || patientCount == 0 ||
+        months <= HOT_MONTHS + static_cast<int>(AppointmentArchive::CACHED_SEGMENTS) ||
+        appointments < static_cast<size_t>(months)) {
+        cerr << "Usage: " << argv[0] << " [appointments] [doctors] [patients] [months] [scratch directory]\n";
+        return 2;
+    }
+
+    // The segments are written relative to the working directory
+    filesystem::path workingDir = filesystem::current_path();
+    scratch = filesystem::absolute(scratch);
+    filesystem::remove_all(scratch);
+    filesystem::create_directories(scratch);
+    filesystem::current_path(scratch);
+
+    size_t baseline = residentBytes();
+    DoctorManager doctorManager;
+    vector<Doctor*> doctors;
+    vector<Patient*> patients;
+    for (size_t d = 0; d < doctorCount; ++d) {
+        doctors.push_back(new Doctor(to_string(d + 1), "Doctor " + to_string(d + 1), "Cardiology", "G-9", 0, 0));
+        doctorManager.addDoctor(doctors.back(), true);
+    }
+    for (size_t p = 0; p < patientCount; ++p) {
+        patients.push_back(new Patient(to_string(p + 1), "Patient " + to_string(p + 1), "F-8"));
+    }
+
+    // Appointment i falls in month i * months / appointments, so every
+    // month holds a contiguous run of IDs
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    vector<uint32_t> firstIdOfMonth(months + 1, 0);
+    for (size_t i = 0; i < appointments; ++i) {
+        int month = static_cast<int>(i * months / appointments);
+        Appointment appointment;
+        appointment.doctor = doctors[i % doctorCount];
+        appointment.patient = patients[(i * 7) % patientCount];
+        appointment.packedDate = dateOf(month, static_cast<int>(i % 28) + 1);
+        appointment.minutes = static_cast<uint16_t>(8 * 60 + (i % 32) * 15);
+        uint32_t id = registry.insert(appointment).id;
+        if (firstIdOfMonth[month] == 0) firstIdOfMonth[month] = id;
+    }
+    firstIdOfMonth[months] = static_cast<uint32_t>(appointments) + 1;
+    size_t hotBefore = residentBytes() - baseline;
+
+    mt19937 rng(1);
+    auto idIn = [&](int month) {
+        return uniform_int_distribution<uint32_t>(firstIdOfMonth[month], firstIdOfMonth[month + 1] - 1)(rng);
+    };
+    uniform_int_distribution<int> anyArchivedMonth(0, months - HOT_MONTHS - 1);
+
+    // Hot: the registry, and a scan of the doctor's appointments
+    size_t found = 0;
+    double hotIdUs = averageMicroseconds(HOT_LOOKUPS, [&](size_t) {
+        found += registry.find(idIn(anyArchivedMonth(rng))) != nullptr;
+    });
+    Doctor* doctor = doctors.front();
+    double hotMonthUs = averageMicroseconds(WARM_LOOKUPS, [&](size_t i) {
+        uint32_t from = dateOf(static_cast<int>(i) % (months - HOT_MONTHS), 1);
+        uint32_t to = dateOf(static_cast<int>(i) % (months - HOT_MONTHS), 28);
+        found += count_if(doctor->appointments.begin(), doctor->appointments.end(),
+                          [&](const Appointment& a) { return a.packedDate >= from && a.packedDate <= to; });
+    });
+
+    AppointmentArchive& archive = AppointmentArchive::instance();
+    archive.open();
+    auto started = chrono::steady_clock::now();
+    size_t archived = archive.archiveBefore(dateOf(months - HOT_MONTHS, 1), doctorManager, true);
+    double archiveSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    size_t hotAfter = residentBytes() - baseline;
+    if (archived == 0) {
+        cerr << "Error: Nothing was archived\n";
+        filesystem::current_path(workingDir);
+        return 1;
+    }
+
+    // Warm: lookups within one month, whose segment stays cached. Cold:
+    // lookups walking the months in turn, more than the cache holds.
+    AppointmentArchive::Row row;
+    size_t archivedFound = 0;
+    archive.find(idIn(0), row);
+    double warmIdUs = averageMicroseconds(WARM_LOOKUPS, [&](size_t) { archivedFound += archive.find(idIn(0), row); });
+    int archivedMonths = months - HOT_MONTHS;
+    size_t coldCalls = static_cast<size_t>(archivedMonths) * 2;
+    double coldIdUs = averageMicroseconds(coldCalls, [&](size_t i) {
+        archivedFound += archive.find(idIn(static_cast<int>(i) % archivedMonths), row);
+    });
+
+    AppointmentArchive::Query monthQuery;
+    monthQuery.doctorID = doctor->getId();
+    auto queryMonth = [&](int month) {
+        monthQuery.fromDate = dateOf(month, 1);
+        monthQuery.toDate = dateOf(month, 28);
+        return archive.query(monthQuery).size();
+    };
+    queryMonth(0);
+    double warmMonthUs = averageMicroseconds(WARM_LOOKUPS, [&](size_t) { found += queryMonth(0); });
+    double coldMonthUs = averageMicroseconds(coldCalls, [&](size_t i) {
+        found += queryMonth(static_cast<int>(i) % archivedMonths);
+    });
+    AppointmentArchive::Query doctorQuery;
+    doctorQuery.doctorID = doctor->getId();
+    size_t doctorRows = 0;
+    double allMonthsUs = averageMicroseconds(1, [&](size_t) { doctorRows = archive.query(doctorQuery).size(); });
+
+    size_t hotAppointments = appointments - archived;
+    printf("%zu appointments over %d months, %zu doctors, %zu patients, the last %d months kept hot\n", appointments,
+           months, doctorCount, patientCount, HOT_MONTHS);
+    printf("  archived             %10zu appointments in %.2f s\n", archived, archiveSeconds);
+    printf("  hot memory before    %10.1f MB (%.0f B/appointment)\n", megabytes(hotBefore),
+           static_cast<double>(hotBefore) / appointments);
+    printf("  hot memory after     %10.1f MB for %zu appointments\n", megabytes(hotAfter), hotAppointments);
+    printf("  archive on disk      %10.1f MB (%.1f B/appointment)\n", megabytes(archive.storedBytes()),
+           static_cast<double>(archive.storedBytes()) / archive.rowCount());
+    printf("%-28s %12s %12s %12s\n", "lookup", "hot", "warm", "cold");
+    printf("%-28s %9.2f us %9.2f us %9.0f us\n", "by ID", hotIdUs, warmIdUs, coldIdUs);
+    printf("%-28s %9.2f us %9.2f us %9.0f us\n", "one doctor's month", hotMonthUs, warmMonthUs, coldMonthUs);
+    printf("%-28s %12s %12s %9.0f us (%zu rows)\n", "one doctor, all archived", "", "", allMonthsUs, doctorRows);
+    if (found == 0 || archivedFound == 0) cerr << "Warning: lookups found nothing\n";
+
+    registry.clear();
+    for (Patient* patient : patients) {
+        delete patient;
+    }
+    filesystem::current_path(workingDir);
+    filesystem::remove_all(scratch);
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Benchmark for the slot availability index: "which Cardiology doctors are
+// free at 10:30", answered by walking the Doctor and Slot objects and by
+// DoctorManager::getFreeDoctorsAt. Builds the doctors in memory, about a
+// third of the slots booked; nothing is read from or written to data/.
+//
+// Usage: bench_availability [doctors] [queries]
+//
+// Build from the repository root (see README); add -mavx2 for the AVX2
+// kernel:
+//   g++ -O2 -I. tools/bench_availability.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_availability
+
+#include "Doctor.h"
+#include "DoctorManager.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* SLOT_TIMES[] = {"09:00", "09:30", "10:00", "10:30", "11:00", "11:30", "12:00", "12:30"};
+
+int main(int argc, char* argv[]) {
+    int doctors = argc > 1 ? atoi(argv[1]) : 20000;
+    int queries = argc > 2 ? atoi(argv[2]) : 200;
+    if (doctors <= 0 || queries <= 0) {
+        cerr << "Usage: " << argv[0] << " [doctors] [queries]\n";
+        return 2;
+    }
+
+    DoctorManager manager;
+    unsigned seed = 12345;
+    for (int d = 0; d < doctors; ++d) {
+        Doctor* doctor = new Doctor(to_string(d + 1), "Doctor " + to_string(d + 1), "Cardiology", "G-10", 8, 1);
+        for (const char* time : SLOT_TIMES) {
+            doctor->addSlot(time, true);
+        }
+        manager.addDoctor(doctor, true);
+        for (Slot& slot : doctor->normalSlots) {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 3 == 0) {
+                doctor->setSlotBooked(slot, true);
+            }
+        }
+    }
+
+    const string specialization = "Cardiology";
+    const string time = "10:30";
+    size_t objectFree = 0;
+    size_t indexFree = 0;
+
+    auto started = chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        vector<Doctor*> free;
+        for (Doctor* doctor : manager.getDoctorsBySpecialization(specialization)) {
+            for (const Slot& slot : doctor->normalSlots) {
+                if (slot.isAt(time) && slot.isAvailable()) {
+                    free.push_back(doctor);
+                    break;
+                }
+            }
+        }
+        objectFree = free.size();
+    }
+    double objectUs = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / queries;
+
+    started = chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        indexFree = manager.getFreeDoctorsAt(specialization, time).size();
+    }
+    double indexUs = chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / queries;
+
+    if (objectFree != indexFree) {
+        cerr << "Error: Object scan found " << objectFree << " free doctors, the index " << indexFree << "\n";
+        return 1;
+    }
+
+#if defined(__AVX2__)
+    const char* kernel = "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    const char* kernel = "SSE2";
+#else
+    const char* kernel = "scalar";
+#endif
+    printf("%d doctors x 8 slots, %zu free at %s, %d queries\n", doctors, indexFree, time.c_str(), queries);
+    printf("  per-object Doctor/Slot scan: %10.1f us/query\n", objectUs);
+    printf("  index, %-6s               %10.1f us/query\n", (string(kernel) + ":").c_str(), indexUs);
+    return 0;
+}
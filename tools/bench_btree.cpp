@@ -0,0 +1,198 @@
+// Benchmark for BTreeStorage at user-account scale. Fills a B+tree file
+// with records shaped like users.db entries (an ID key, a password and
+// role value) in random key order, flushing every FILL_BATCH records,
+// then reopens it and reports:
+//   - open time
+//   - average random get, on keys that exist
+//   - average put followed by a durable flush (two fsyncs)
+//   - range scan throughput
+//   - file size and the resident memory of the process
+// With --text it also loads and saves the same records with
+// TextFileStorage, the legacy backend, for comparison. Everything is
+// written to a scratch directory, never to data/.
+//
+// Usage: bench_btree [records] [cachePages] [--text] [--scratch <directory>]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_btree.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_btree
+
+#include "BTreeStorage.h"
+#include "TextFileStorage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const size_t FILL_BATCH = 100000;
+static const size_t GETS = 200000;
+static const size_t DURABLE_PUTS = 200;
+
+// Resident set size in bytes, or 0 where it cannot be read
+static size_t residentBytes() {
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    long pages = 0;
+    long resident = 0;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+// The i-th distinct 13-digit ID; multiplying by an odd constant modulo
+// 2^40 permutes the indexes, so keys arrive in random order
+static string keyOf(uint64_t i) {
+    string digits = to_string((i * 2654435761ULL) & ((1ULL << 40) - 1));
+    return string(13 - digits.size(), '0') + digits;
+}
+
+static string valueOf(uint64_t i) {
+    return "password" + to_string(i % 100000) + ",patient";
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point started) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+}
+
+static bool fill(const string& path, size_t records, size_t cachePages) {
+    BTreeStorage tree(path, cachePages);
+    if (!tree.isOpen()) return false;
+    for (size_t i = 0; i < records; ++i) {
+        if (!tree.put(keyOf(i), valueOf(i))) return false;
+        if ((i + 1) % FILL_BATCH == 0 && !tree.flush()) return false;
+    }
+    return tree.flush();
+}
+
+static int benchText(const filesystem::path& scratch, size_t records) {
+    string path = (scratch / "users.dat").string();
+    {
+        TextFileStorage text(path, ',');
+        for (size_t i = 0; i < records; ++i) text.put(keyOf(i), valueOf(i));
+        if (!text.flush()) {
+            cerr << "Error: Could not write " << path << "\n";
+            return 1;
+        }
+    }
+    size_t before = residentBytes();
+    auto started = chrono::steady_clock::now();
+    TextFileStorage text(path, ',');
+    double loadMs = millisecondsSince(started);
+    size_t after = residentBytes();
+    text.put(keyOf(0), valueOf(1));
+    started = chrono::steady_clock::now();
+    bool saved = text.flush();
+    double saveMs = millisecondsSince(started);
+    printf("text backend\n");
+    printf("  load                 %10.1f ms\n", loadMs);
+    printf("  save after 1 change  %10.1f ms%s\n", saveMs, saved ? "" : " (failed)");
+    printf("  memory               %10.1f MB\n", (after > before ? after - before : 0) / (1024.0 * 1024.0));
+    return saved ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    size_t records = 10000000;
+    size_t cachePages = BTreeStorage::DEFAULT_CACHE_PAGES;
+    bool withText = false;
+    filesystem::path scratch = filesystem::temp_directory_path() / "ams_bench_btree";
+    int positional = 0;
+    bool usage = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--text") {
+            withText = true;
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            scratch = argv[++i];
+        } else if (positional == 0) {
+            records = strtoul(argv[i], nullptr, 10);
+            ++positional;
+        } else if (positional == 1) {
+            cachePages = strtoul(argv[i], nullptr, 10);
+            ++positional;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || records == 0 || cachePages == 0) {
+        cerr << "Usage: " << argv[0] << " [records] [cachePages] [--text] [--scratch <directory>]\n";
+        return 2;
+    }
+
+    error_code ec;
+    filesystem::remove_all(scratch, ec);
+    filesystem::create_directories(scratch, ec);
+    string path = (scratch / "users.db").string();
+
+    auto started = chrono::steady_clock::now();
+    if (!fill(path, records, cachePages)) {
+        cerr << "Error: Could not fill " << path << "\n";
+        filesystem::remove_all(scratch, ec);
+        return 1;
+    }
+    double fillSeconds = millisecondsSince(started) / 1000;
+
+    started = chrono::steady_clock::now();
+    BTreeStorage tree(path, cachePages);
+    double openMs = millisecondsSince(started);
+    if (!tree.isOpen() || tree.size() != records) {
+        cerr << "Error: " << path << " did not reopen with " << records << " records\n";
+        filesystem::remove_all(scratch, ec);
+        return 1;
+    }
+
+    mt19937_64 rng(1);
+    uniform_int_distribution<uint64_t> anyRecord(0, records - 1);
+    string value;
+    size_t found = 0;
+    started = chrono::steady_clock::now();
+    for (size_t i = 0; i < GETS; ++i) {
+        found += tree.get(keyOf(anyRecord(rng)), value);
+    }
+    double getUs = millisecondsSince(started) * 1000 / GETS;
+
+    bool durable = true;
+    started = chrono::steady_clock::now();
+    for (size_t i = 0; i < DURABLE_PUTS; ++i) {
+        uint64_t record = anyRecord(rng);
+        durable = tree.put(keyOf(record), valueOf(record + 1)) && tree.flush() && durable;
+    }
+    double putMs = millisecondsSince(started) / DURABLE_PUTS;
+
+    size_t scanned = 0;
+    started = chrono::steady_clock::now();
+    tree.scan("", "", [&](const string&, const string&) {
+        ++scanned;
+        return true;
+    });
+    double scanSeconds = millisecondsSince(started) / 1000;
+
+    printf("%zu records, cache %zu pages (%.0f MB)\n", records, cachePages,
+           cachePages * BTreeStorage::PAGE_SIZE / (1024.0 * 1024.0));
+    printf("B+tree backend\n");
+    printf("  fill (random order)  %10.1f s\n", fillSeconds);
+    printf("  file                 %10.1f MB, %u pages\n", filesystem::file_size(path, ec) / (1024.0 * 1024.0),
+           tree.pageCount());
+    printf("  open                 %10.2f ms\n", openMs);
+    printf("  random get           %10.2f us  (%zu of %zu found)\n", getUs, found, GETS);
+    printf("  put + durable flush  %10.2f ms%s\n", putMs, durable ? "" : " (failed)");
+    printf("  full scan            %10.0f records/s\n", scanned / scanSeconds);
+    printf("  process RSS          %10.1f MB\n", residentBytes() / (1024.0 * 1024.0));
+
+    int status = found == GETS && durable && scanned == records ? 0 : 1;
+    if (withText) status = max(status, benchText(scratch, records));
+    filesystem::remove_all(scratch, ec);
+    return status;
+}
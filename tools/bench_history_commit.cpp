@@ -0,0 +1,137 @@
+// Benchmark for durable medical history appends: opening, appending to,
+// fsyncing and closing a per-patient file for every record, as the
+// medical_history_<id>.txt files were written, against
+// MedicalHistoryStore's group commit with 1, 8 and 32 callers each
+// waiting for its record, and with one caller queueing every record
+// before waiting. Everything is written to a scratch directory.
+//
+// Usage: bench_history_commit [records] [patients] [maxDelay microseconds] [scratch directory]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_history_commit.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_history_commit
+
+#include "MedicalHistoryStore.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static string recordText(size_t i) {
+    return "Visit " + to_string(i) + ": blood pressure normal, follow-up in two weeks";
+}
+
+// One file per patient, opened, appended, synced and closed per record
+static bool appendPerRecord(const string& directory, size_t records, size_t patients) {
+    for (size_t i = 0; i < records; ++i) {
+        string path = directory + "/medical_history_" + to_string(i % patients + 1) + ".txt";
+        string line = recordText(i) + "\n";
+#ifdef _WIN32
+        int fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+        bool ok = fd >= 0 && _write(fd, line.data(), static_cast<unsigned>(line.size())) == static_cast<int>(line.size()) &&
+                  _commit(fd) == 0;
+        if (fd >= 0) _close(fd);
+#else
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        bool ok = fd >= 0 && write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size()) && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+#endif
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// callers threads share the records, each waiting for every append
+static bool appendWaiting(MedicalHistoryStore& store, size_t records, size_t patients, size_t callers) {
+    atomic<size_t> next{0};
+    atomic<bool> ok{true};
+    vector<thread> threads;
+    for (size_t c = 0; c < callers; ++c) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < records; i = next++) {
+                if (!store.append(to_string(i % patients + 1), recordText(i))) ok = false;
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    return ok;
+}
+
+// One caller queues everything, then waits for all of it
+static bool appendPipelined(MedicalHistoryStore& store, size_t records, size_t patients) {
+    vector<future<bool>> pending;
+    pending.reserve(records);
+    for (size_t i = 0; i < records; ++i) {
+        pending.push_back(store.appendAsync(to_string(i % patients + 1), recordText(i)));
+    }
+    bool ok = true;
+    for (future<bool>& done : pending) {
+        ok = done.get() && ok;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    size_t records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4000;
+    size_t patients = argc > 2 ? strtoul(argv[2], nullptr, 10) : 500;
+    long delayUs = argc > 3 ? atol(argv[3]) : 0;
+    filesystem::path scratch = argc > 4 ? filesystem::path(argv[4])
+                                        : filesystem::temp_directory_path() / "ams_bench_history_commit";
+    if (records == 0 || patients == 0 || delayUs < 0) {
+        cerr << "Usage: " << argv[0] << " [records] [patients] [maxDelay microseconds] [scratch directory]\n";
+        return 2;
+    }
+
+    MedicalHistoryStore::GroupCommitOptions options;
+    options.maxDelay = chrono::microseconds(delayUs);
+
+    // Each run gets a fresh directory, so no run appends to a longer file
+    int runNumber = 0;
+    auto freshDirectory = [&]() {
+        string directory = (scratch / to_string(++runNumber)).string();
+        filesystem::create_directories(directory);
+        return directory;
+    };
+    auto recordsPerSecond = [&](auto run) {
+        auto started = chrono::steady_clock::now();
+        bool ok = run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return ok ? records / seconds : -1.0;
+    };
+    auto groupCommit = [&](auto appendAll) {
+        string directory = freshDirectory();
+        MedicalHistoryStore store(directory + "/medical_history.log", directory + "/medical_history.idx", options);
+        return recordsPerSecond([&]() { return appendAll(store); });
+    };
+
+    filesystem::remove_all(scratch);
+    printf("%zu records into %zu patients, maxDelay %ld us\n", records, patients, delayUs);
+    string directory = freshDirectory();
+    printf("  open/append/fsync/close per record  %10.0f rec/s\n",
+           recordsPerSecond([&]() { return appendPerRecord(directory, records, patients); }));
+    for (size_t callers : {1, 8, 32}) {
+        printf("  group commit, %2zu waiting caller(s)   %10.0f rec/s\n", callers,
+               groupCommit([&](MedicalHistoryStore& store) { return appendWaiting(store, records, patients, callers); }));
+    }
+    printf("  group commit, pipelined futures     %10.0f rec/s\n",
+           groupCommit([&](MedicalHistoryStore& store) { return appendPipelined(store, records, patients); }));
+    filesystem::remove_all(scratch);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Benchmark for reading the comma-separated data files: the
+// stringstream-per-line parsing the loaders used before against
+// RecordParser. Both split every line into fields and touch each field;
+// neither builds objects, so this is parse throughput alone. The input is
+// generated in memory in the users.dat and doctors.dat formats, or read
+// from files given on the command line.
+//
+// Usage: bench_parser [megabytes] | bench_parser <file>...
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_parser.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_parser
+
+#include "RecordParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const int RUNS = 3;
+
+static string generateUsers(size_t bytes) {
+    string out;
+    out.reserve(bytes + 64);
+    for (size_t i = 1; out.size() < bytes; ++i) {
+        out += to_string(i) + ",password" + to_string(i * 7919 % 100000) + (i % 5 == 0 ? ",doctor\n" : ",patient\n");
+    }
+    return out;
+}
+
+static string generateDoctors(size_t bytes) {
+    string out;
+    out.reserve(bytes + 128);
+    for (size_t i = 1; out.size() < bytes; ++i) {
+        out += to_string(i) + ",Doctor " + to_string(i) + ",Cardiology,G-10,2,2;regular:10:00,11:00,;emergency:12:00,13:00,\n";
+    }
+    return out;
+}
+
+// Both return the total field length, so the work cannot be optimized away
+static size_t parseWithStringstream(const string& data) {
+    size_t total = 0;
+    istringstream lines(data);
+    string line;
+    while (getline(lines, line)) {
+        if (line.empty()) continue;
+        stringstream fields(line);
+        string field;
+        while (getline(fields, field, ',')) {
+            total += field.size();
+        }
+    }
+    return total;
+}
+
+static size_t parseWithRecordParser(const string& data) {
+    size_t total = 0;
+    RecordParser parser(data.data(), data.size());
+    while (parser.next()) {
+        for (size_t i = 0; i < parser.fieldCount(); ++i) {
+            total += parser.field(i).size();
+        }
+    }
+    return total;
+}
+
+// Best of RUNS, in MB/s
+template <typename Parse>
+static double throughput(const string& data, Parse parse, size_t& checksum) {
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto started = chrono::steady_clock::now();
+        checksum = parse(data);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        best = max(best, data.size() / (1024.0 * 1024.0) / seconds);
+    }
+    return best;
+}
+
+static void report(const string& name, const string& data) {
+    size_t streamFields = 0;
+    size_t parserFields = 0;
+    double stream = throughput(data, parseWithStringstream, streamFields);
+    double parser = throughput(data, parseWithRecordParser, parserFields);
+    printf("  %-14s %6.1f MB  stringstream %8.0f MB/s  RecordParser %8.0f MB/s%s\n", name.c_str(),
+           data.size() / (1024.0 * 1024.0), stream, parser, streamFields == parserFields ? "" : "  (fields differ)");
+}
+
+int main(int argc, char* argv[]) {
+    vector<pair<string, string>> inputs;
+    char* end = nullptr;
+    double megabytes = argc == 2 ? strtod(argv[1], &end) : 32;
+    if (argc <= 1 || (argc == 2 && end && *end == '\0' && megabytes > 0)) {
+        size_t bytes = static_cast<size_t>(megabytes * 1024 * 1024);
+        inputs.push_back({"users.dat", generateUsers(bytes)});
+        inputs.push_back({"doctors.dat", generateDoctors(bytes / 2)});
+    } else {
+        for (int i = 1; i < argc; ++i) {
+            ifstream in(argv[i], ios::binary);
+            if (!in.is_open()) {
+                cerr << "Error: Could not open " << argv[i] << "\n";
+                return 2;
+            }
+            ostringstream contents;
+            contents << in.rdbuf();
+            inputs.push_back({argv[i], contents.str()});
+        }
+    }
+
+    printf("Parse throughput, best of %d:\n", RUNS);
+    for (const auto& [name, data] : inputs) {
+        report(name, data);
+    }
+    return 0;
+}
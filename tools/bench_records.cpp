@@ -0,0 +1,116 @@
+// Benchmark for the in-memory size of slots and appointments. Fills vectors
+// of Slot and Appointment records and, for comparison, of the layout they
+// had before they were packed (fixed-size date/time strings, and a full
+// appointment embedded in every slot), and reports the size of each record
+// and the resident memory each vector adds. Nothing is read from or written
+// to data/.
+//
+// Usage: bench_records [slots] [appointments]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_records.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_records
+
+#include "Appointment.h"
+#include "FixedString.h"
+#include "Slot.h"
+#include "Utils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Appointment and Slot as they were before the packed layout
+struct UnpackedAppointment {
+    DateString date;
+    TimeString time;
+    Doctor* doctor = nullptr;
+    Patient* patient = nullptr;
+    bool isMissed = false;
+    bool isEmergency = false;
+};
+
+struct UnpackedSlot {
+    TimeString time;
+    bool isBooked = false;
+    UnpackedAppointment appointment;
+};
+
+// Resident set size in bytes, or 0 where it cannot be read
+static size_t residentBytes() {
+#ifdef __linux__
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    long pages = 0;
+    long resident = 0;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+// Builds count records with make(i), returns the memory they took: the
+// growth of the resident set, or the vector's own size where that is unknown
+template <typename Record, typename Make>
+static double filledMegabytes(size_t count, Make make) {
+    size_t before = residentBytes();
+    vector<Record> records;
+    records.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        records.push_back(make(i));
+    }
+    size_t after = residentBytes();
+    size_t bytes = after > before ? after - before : records.capacity() * sizeof(Record);
+    return bytes / (1024.0 * 1024.0);
+}
+
+int main(int argc, char* argv[]) {
+    size_t slots = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500000;
+    size_t appointments = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5000000;
+    if (slots == 0 || appointments == 0) {
+        cerr << "Usage: " << argv[0] << " [slots] [appointments]\n";
+        return 2;
+    }
+
+    const string date = "15-06-2025";
+    const string time = "10:30";
+    const uint32_t packedDate = Utils::packDate(date);
+    const uint16_t minutes = Utils::packTime(time);
+
+    double unpackedSlotMb = filledMegabytes<UnpackedSlot>(slots, [&](size_t) {
+        UnpackedSlot slot;
+        slot.time = time;
+        return slot;
+    });
+    double slotMb = filledMegabytes<Slot>(slots, [&](size_t) { return Slot(minutes); });
+
+    double unpackedAppointmentMb = filledMegabytes<UnpackedAppointment>(appointments, [&](size_t) {
+        UnpackedAppointment appointment;
+        appointment.date = date;
+        appointment.time = time;
+        return appointment;
+    });
+    double appointmentMb = filledMegabytes<Appointment>(appointments, [&](size_t i) {
+        Appointment appointment;
+        appointment.id = static_cast<uint32_t>(i + 1);
+        appointment.packedDate = packedDate;
+        appointment.minutes = minutes;
+        return appointment;
+    });
+
+    printf("%-24s %12s %12s\n", "", "unpacked", "packed");
+    printf("%-24s %10zu B %10zu B\n", "sizeof(Slot)", sizeof(UnpackedSlot), sizeof(Slot));
+    printf("%-24s %10zu B %10zu B\n", "sizeof(Appointment)", sizeof(UnpackedAppointment), sizeof(Appointment));
+    printf("%-24s %9.1f MB %9.1f MB\n", (to_string(slots) + " slots").c_str(), unpackedSlotMb, slotMb);
+    printf("%-24s %9.1f MB %9.1f MB\n", (to_string(appointments) + " appointments").c_str(),
+           unpackedAppointmentMb, appointmentMb);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Benchmark for loading doctors and patients: the binary snapshot against
+// the doctors.dat/patients.dat text files. Generates the data in memory,
+// writes both forms into a scratch directory, then times
+// UserFileHandler::loadUserData from each, best of a few runs. The files
+// are in the page cache by then, so this measures parsing and building the
+// objects, not the disk.
+//
+// Usage: bench_snapshot [doctors] [patients] [scratch directory]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_snapshot.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_snapshot
+
+#include "DoctorManager.h"
+#include "Patient.h"
+#include "SnapshotFile.h"
+#include "UserFileHandler.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* SLOT_TIMES[] = {"09:00", "09:30", "10:00", "10:30", "11:00", "11:30"};
+static const char* SPECIALIZATIONS[] = {"Cardiology", "Neurology", "Orthopedics", "Pediatrics"};
+static const int RUNS = 3;
+
+static void generate(DoctorManager& doctorManager, vector<Patient*>& patients, int doctorCount, int patientCount) {
+    for (int d = 0; d < doctorCount; ++d) {
+        Doctor* doctor = new Doctor(to_string(d + 1), "Doctor " + to_string(d + 1), SPECIALIZATIONS[d % 4],
+                                    "G-" + to_string(d % 12 + 1), 6, 1);
+        for (const char* time : SLOT_TIMES) {
+            doctor->addSlot(time, true);
+        }
+        doctorManager.addDoctor(doctor, true);
+    }
+    for (int p = 0; p < patientCount; ++p) {
+        patients.push_back(new Patient(to_string(p + 1), "Patient " + to_string(p + 1), "F-" + to_string(p % 11 + 1)));
+    }
+}
+
+// Best of RUNS loads, in milliseconds; checks every run got everything back
+static double timeLoad(int doctorCount, int patientCount) {
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        // The per-record messages of the text loader are not timed
+        streambuf* console = cout.rdbuf(nullptr);
+        auto started = chrono::steady_clock::now();
+        UserFileHandler::loadUserData(doctorManager, patients);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        cout.rdbuf(console);
+        cout.clear();
+        size_t doctors = doctorManager.getAllDoctors().size();
+        size_t loaded = patients.size();
+        for (Patient* patient : patients) {
+            delete patient;
+        }
+        if (doctors != static_cast<size_t>(doctorCount) || loaded != static_cast<size_t>(patientCount)) {
+            cerr << "Error: Loaded " << doctors << " doctors and " << loaded << " patients\n";
+            return -1;
+        }
+        best = run == 0 ? ms : min(best, ms);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int doctorCount = argc > 1 ? atoi(argv[1]) : 100000;
+    int patientCount = argc > 2 ? atoi(argv[2]) : 1000000;
+    filesystem::path scratch = argc > 3 ? filesystem::path(argv[3])
+                                        : filesystem::temp_directory_path() / "ams_bench_snapshot";
+    if (doctorCount <= 0 || patientCount <= 0) {
+        cerr << "Usage: " << argv[0] << " [doctors] [patients] [scratch directory]\n";
+        return 2;
+    }
+
+    // The data files are found relative to the working directory
+    filesystem::path workingDir = filesystem::current_path();
+    scratch = filesystem::absolute(scratch);
+    filesystem::remove_all(scratch);
+    filesystem::create_directories(scratch);
+    filesystem::current_path(scratch);
+    string snapshotPath = Utils::getDataPath("ams.snap");
+
+    {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        generate(doctorManager, patients, doctorCount, patientCount);
+        UserFileHandler::exportUserData(doctorManager, patients);
+        if (!SnapshotFile::save(snapshotPath, doctorManager, patients)) {
+            cerr << "Error: Could not write " << snapshotPath << "\n";
+            return 2;
+        }
+        for (Patient* patient : patients) {
+            delete patient;
+        }
+    }
+    uintmax_t snapshotBytes = filesystem::file_size(snapshotPath);
+
+    double snapshotMs = timeLoad(doctorCount, patientCount);
+    filesystem::rename(snapshotPath, snapshotPath + ".off");
+    double textMs = timeLoad(doctorCount, patientCount);
+    filesystem::current_path(workingDir);
+    filesystem::remove_all(scratch);
+    if (snapshotMs < 0 || textMs < 0) {
+        return 1;
+    }
+
+    printf("%d doctors (6 slots each), %d patients, best of %d\n", doctorCount, patientCount, RUNS);
+    printf("  text files  %8.0f ms\n", textMs);
+    printf("  snapshot    %8.0f ms (%.0f MB file)\n", snapshotMs, snapshotBytes / (1024.0 * 1024.0));
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Benchmark for the startup loaders that run on the ThreadPool: the text
+// doctors/patients files, the appointment store read after them, and the
+// snapshot. Generates doctors with booked slots and patients in memory,
+// writes all three into a scratch directory, then times each loader, best
+// of a few runs. The snapshot leaves appointments in the file until they
+// are needed, so its time covers doctors, slots and patients only.
+//
+// The pool is sized once per process, so compare thread counts by running
+// it with AMS_THREADS set, e.g. for t in 1 2 4; do AMS_THREADS=$t ./bench_startup; done
+//
+// Usage: bench_startup [doctors] [patients] [scratch directory]
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/bench_startup.cpp $(ls *.cpp | grep -v '^main.cpp$') -o bench_startup
+
+#include "AppointmentRegistry.h"
+#include "AppointmentStore.h"
+#include "DoctorManager.h"
+#include "Patient.h"
+#include "SnapshotFile.h"
+#include "ThreadPool.h"
+#include "UserFileHandler.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* SLOT_TIMES[] = {"09:00", "09:30", "10:00", "10:30", "11:00", "11:30"};
+static const int BOOKED_SLOTS = 3;
+static const int RUNS = 3;
+
+static void generate(DoctorManager& doctorManager, vector<Patient*>& patients, int doctorCount, int patientCount) {
+    for (int p = 0; p < patientCount; ++p) {
+        patients.push_back(new Patient(to_string(p + 1), "Patient " + to_string(p + 1), "F-" + to_string(p % 11 + 1)));
+    }
+    AppointmentRegistry& registry = AppointmentRegistry::instance();
+    for (int d = 0; d < doctorCount; ++d) {
+        Doctor* doctor = new Doctor(to_string(d + 1), "Doctor " + to_string(d + 1), "Cardiology", "G-10", 6, 1);
+        for (const char* time : SLOT_TIMES) {
+            doctor->addSlot(time, true);
+        }
+        doctorManager.addDoctor(doctor, true);
+        for (int s = 0; s < BOOKED_SLOTS; ++s) {
+            Patient* patient = patients[(static_cast<size_t>(d) * BOOKED_SLOTS + s) % patients.size()];
+            doctor->restoreSlot(registry.insert(Appointment("15-06-2030", SLOT_TIMES[s], doctor, patient)));
+        }
+    }
+}
+
+struct Timings {
+    double users = 0;         // loadUserData
+    double appointments = 0;  // AppointmentStore::loadAll, text files only
+    size_t loaded = 0;        // appointments loaded
+};
+
+// Best of RUNS; fromText also loads the appointment store, as startup does
+// when there is no snapshot
+static Timings timeLoad(bool fromText) {
+    Timings best;
+    for (int run = 0; run < RUNS; ++run) {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        Timings timings;
+        // The per-record messages of the text loader are not timed
+        streambuf* console = cout.rdbuf(nullptr);
+        auto started = chrono::steady_clock::now();
+        UserFileHandler::loadUserData(doctorManager, patients);
+        auto usersLoaded = chrono::steady_clock::now();
+        if (fromText) {
+            AppointmentStore store;
+            timings.loaded = store.loadAll(doctorManager, patients);
+        }
+        auto finished = chrono::steady_clock::now();
+        cout.rdbuf(console);
+        cout.clear();
+        timings.users = chrono::duration<double, milli>(usersLoaded - started).count();
+        timings.appointments = chrono::duration<double, milli>(finished - usersLoaded).count();
+
+        doctorManager.clearDoctors();
+        for (Patient* patient : patients) {
+            delete patient;
+        }
+        if (run == 0 || timings.users + timings.appointments < best.users + best.appointments) {
+            best = timings;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int doctorCount = argc > 1 ? atoi(argv[1]) : 20000;
+    int patientCount = argc > 2 ? atoi(argv[2]) : 200000;
+    filesystem::path scratch = argc > 3 ? filesystem::path(argv[3])
+                                        : filesystem::temp_directory_path() / "ams_bench_startup";
+    if (doctorCount <= 0 || patientCount <= 0) {
+        cerr << "Usage: " << argv[0] << " [doctors] [patients] [scratch directory]\n";
+        return 2;
+    }
+
+    // The data files are found relative to the working directory
+    filesystem::path workingDir = filesystem::current_path();
+    scratch = filesystem::absolute(scratch);
+    filesystem::remove_all(scratch);
+    filesystem::create_directories(scratch);
+    filesystem::current_path(scratch);
+    string snapshotPath = Utils::getDataPath("ams.snap");
+
+    {
+        DoctorManager doctorManager;
+        vector<Patient*> patients;
+        generate(doctorManager, patients, doctorCount, patientCount);
+        UserFileHandler::exportUserData(doctorManager, patients);
+        AppointmentStore store;
+        store.save(doctorManager);
+        if (!SnapshotFile::save(snapshotPath, doctorManager, patients)) {
+            cerr << "Error: Could not write " << snapshotPath << "\n";
+            return 2;
+        }
+        doctorManager.clearDoctors();
+        for (Patient* patient : patients) {
+            delete patient;
+        }
+    }
+
+    Timings snapshot = timeLoad(false);
+    filesystem::rename(snapshotPath, snapshotPath + ".off");
+    Timings text = timeLoad(true);
+    filesystem::current_path(workingDir);
+    filesystem::remove_all(scratch);
+
+    size_t expected = static_cast<size_t>(doctorCount) * BOOKED_SLOTS;
+    if (text.loaded != expected) {
+        cerr << "Error: Loaded " << text.loaded << " of " << expected << " stored appointments\n";
+        return 1;
+    }
+
+    printf("%d doctors, %d patients, %zu appointments, %zu thread(s), best of %d\n", doctorCount, patientCount,
+           expected, ThreadPool::instance().size(), RUNS);
+    printf("  text files         %8.0f ms\n", text.users);
+    printf("  appointment store  %8.0f ms\n", text.appointments);
+    printf("  snapshot           %8.0f ms\n", snapshot.users);
+    return 0;
+}
@@ -0,0 +1,247 @@
+// Randomized test of BTreeStorage against std::map. Runs a random mix of
+// put, erase, get, range scan, flush and reopen on a B+tree file in a
+// scratch directory and checks every result against a map kept alongside:
+//   - get, scan and size always agree with the map
+//   - reopening after a flush keeps everything
+//   - reopening without a flush drops every change since the last flush,
+//     so the file matches the map as of that flush
+//   - records over MAX_RECORD_SIZE are refused and change nothing
+// The cache is kept to a few pages, so changed pages are evicted and
+// written to their copies before the flush, and the key space is small
+// enough that keys are replaced and erased many times over.
+//
+// Usage: btree_check [--ops <n>] [--keys <n>] [--seed <n>] [--scratch <directory>]
+// Exit status: 0 if every check passed, 1 if any failed, 2 on errors.
+//
+// Build from the repository root (see README):
+//   g++ -O2 -I. tools/btree_check.cpp $(ls *.cpp | grep -v '^main.cpp$') -o btree_check
+
+#include "BTreeStorage.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    const size_t CACHE_PAGES = 8;
+    const size_t MAX_FAILURES_SHOWN = 10;
+
+    using Model = map<string, string>;
+
+    class Checker {
+    public:
+        Checker(const string& path, size_t keys, uint32_t seed) : path(path), keys(keys), rng(seed) {}
+
+        bool run(size_t ops);
+        size_t failures() const { return failed; }
+        size_t reopens() const { return reopened; }
+        size_t flushes() const { return flushed; }
+        uint32_t pageCount() const { return tree ? tree->pageCount() : 0; }
+
+    private:
+        string path;
+        size_t keys;
+        mt19937 rng;
+        unique_ptr<BTreeStorage> tree;
+        Model model;    // What the tree holds now
+        Model durable;  // What it held at the last flush
+        size_t failed = 0;
+        size_t reopened = 0;
+        size_t flushed = 0;
+        size_t op = 0;
+
+        size_t below(size_t n) { return uniform_int_distribution<size_t>(0, n - 1)(rng); }
+        string randomKey();
+        string randomValue(size_t maxLength);
+        void fail(const string& what);
+        bool reopen(bool afterFlush);
+        void checkGet(const string& key);
+        void checkScan();
+        void checkAll();
+    };
+
+    // Keys of varied length that share prefixes, so pages split on long
+    // and short separators alike
+    string Checker::randomKey() {
+        size_t k = below(keys);
+        string key = "k" + to_string(k);
+        if (k % 7 == 0) key += string(1 + k % 40, static_cast<char>('a' + k % 26));
+        return key;
+    }
+
+    // Mostly short values, now and then one near the record limit
+    string Checker::randomValue(size_t maxLength) {
+        size_t length = below(10) == 0 ? below(maxLength + 1) : below(min<size_t>(maxLength, 64) + 1);
+        string value(length, '\0');
+        for (char& c : value) c = static_cast<char>(below(256));
+        return value;
+    }
+
+    void Checker::fail(const string& what) {
+        if (failed++ < MAX_FAILURES_SHOWN) cerr << "Operation " << op << ": " << what << "\n";
+    }
+
+    bool Checker::reopen(bool afterFlush) {
+        if (afterFlush) {
+            if (!tree->flush()) {
+                fail("flush failed");
+                return false;
+            }
+            durable = model;
+        }
+        tree.reset();
+        tree = make_unique<BTreeStorage>(path, CACHE_PAGES);
+        if (!tree->isOpen()) {
+            fail("reopen failed");
+            return false;
+        }
+        model = durable;
+        ++reopened;
+        checkAll();
+        return true;
+    }
+
+    void Checker::checkGet(const string& key) {
+        string value;
+        bool found = tree->get(key, value);
+        auto it = model.find(key);
+        if (found != (it != model.end())) {
+            fail("get " + key + (found ? " found a record the map does not hold" : " missed a record"));
+        } else if (found && value != it->second) {
+            fail("get " + key + " returned a different value");
+        }
+    }
+
+    // A random range, half of the time unbounded above
+    void Checker::checkScan() {
+        string from = below(4) == 0 ? string() : randomKey();
+        string to = below(2) == 0 ? string() : randomKey();
+        if (!to.empty() && to < from) swap(from, to);
+        size_t limit = below(3) == 0 ? below(50) + 1 : SIZE_MAX;
+
+        vector<pair<string, string>> seen;
+        tree->scan(from, to, [&](const string& key, const string& value) {
+            seen.emplace_back(key, value);
+            return seen.size() < limit;
+        });
+        vector<pair<string, string>> expected;
+        for (auto it = model.lower_bound(from); it != model.end() && (to.empty() || it->first < to); ++it) {
+            if (expected.size() == limit) break;
+            expected.emplace_back(it->first, it->second);
+        }
+        if (seen != expected) {
+            fail("scan [" + from + ", " + to + ") returned " + to_string(seen.size()) + " records, expected " +
+                 to_string(expected.size()));
+        }
+    }
+
+    void Checker::checkAll() {
+        if (tree->size() != model.size()) {
+            fail("size " + to_string(tree->size()) + ", expected " + to_string(model.size()));
+        }
+        vector<pair<string, string>> seen;
+        tree->scan("", "", [&](const string& key, const string& value) {
+            seen.emplace_back(key, value);
+            return true;
+        });
+        if (seen != vector<pair<string, string>>(model.begin(), model.end())) {
+            fail("full scan differs from the map (" + to_string(seen.size()) + " records, expected " +
+                 to_string(model.size()) + ")");
+        }
+    }
+
+    bool Checker::run(size_t ops) {
+        filesystem::remove(path);
+        tree = make_unique<BTreeStorage>(path, CACHE_PAGES);
+        if (!tree->isOpen()) {
+            fail("could not create " + path);
+            return false;
+        }
+        for (op = 1; op <= ops; ++op) {
+            size_t roll = below(1000);
+            if (roll < 450) {
+                string key = randomKey();
+                string value = randomValue(BTreeStorage::MAX_RECORD_SIZE - key.size());
+                if (!tree->put(key, value)) {
+                    fail("put " + key + " failed");
+                } else {
+                    model[key] = value;
+                }
+            } else if (roll < 700) {
+                string key = randomKey();
+                bool erased = tree->erase(key);
+                if (erased != (model.erase(key) != 0)) fail("erase " + key + " returned " + (erased ? "true" : "false"));
+            } else if (roll < 900) {
+                checkGet(randomKey());
+            } else if (roll < 980) {
+                checkScan();
+            } else if (roll < 985) {
+                // Refused, and nothing changes
+                string key = randomKey();
+                streambuf* errorBuffer = cerr.rdbuf(nullptr);
+                bool stored = tree->put(key, string(BTreeStorage::MAX_RECORD_SIZE + 1 - key.size(), 'x'));
+                cerr.rdbuf(errorBuffer);
+                if (stored) fail("put of an oversized record " + key + " succeeded");
+                checkGet(key);
+            } else if (roll < 993) {
+                if (!tree->flush()) {
+                    fail("flush failed");
+                } else {
+                    durable = model;
+                    ++flushed;
+                }
+            } else if (!reopen(roll < 996)) {
+                return false;
+            }
+        }
+        checkAll();
+        return reopen(true);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t ops = 50000;
+    size_t keys = 5000;
+    uint32_t seed = random_device()();
+    filesystem::path scratch = filesystem::temp_directory_path() / "ams_btree_check";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--ops" && i + 1 < argc) {
+            ops = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--keys" && i + 1 < argc) {
+            keys = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            scratch = argv[++i];
+        } else {
+            ops = 0;
+            break;
+        }
+    }
+    if (ops == 0 || keys == 0) {
+        cerr << "Usage: " << argv[0] << " [--ops <n>] [--keys <n>] [--seed <n>] [--scratch <directory>]\n";
+        return 2;
+    }
+
+    error_code ec;
+    filesystem::create_directories(scratch, ec);
+    if (ec) {
+        cerr << "Error: Could not create " << scratch.string() << "\n";
+        return 2;
+    }
+    Checker checker((scratch / "check.db").string(), keys, seed);
+    bool completed = checker.run(ops);
+    printf("%zu operations on %zu keys, seed %u: %zu flushes, %zu reopens, %u pages\n", ops, keys, seed,
+           checker.flushes(), checker.reopens(), checker.pageCount());
+    printf("%s: %zu failed check(s)\n", checker.failures() == 0 && completed ? "PASS" : "FAIL", checker.failures());
+    filesystem::remove_all(scratch, ec);
+    return checker.failures() == 0 && completed ? 0 : 1;
+}